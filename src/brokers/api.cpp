@@ -9,10 +9,17 @@
 #include "api.h"
 
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 #include <unordered_map>
 #include <imtjson/string.h>
 #include <imtjson/array.h>
 #include <imtjson/object.h>
+#include <imtjson/parser.h>
+#include <imtjson/serializer.h>
 #include <shared/linear_map.h>
 #include <imtjson/binjson.tcc>
 #include <imtjson/binary.h>
@@ -124,6 +131,23 @@ static Value placeOrder(AbstractBrokerAPI &handler, const Value &req) {
 			req["replaceOrderSize"].getNumber());
 }
 
+static Value placeOrders(AbstractBrokerAPI &handler, const Value &req) {
+	std::vector<AbstractBrokerAPI::NewOrder> orders;
+	for (Value o: req["orders"]) {
+		orders.push_back({
+			o["size"].getNumber(),
+			o["price"].getNumber(),
+			o["clientOrderId"],
+			o["replaceOrderId"],
+			o["replaceOrderSize"].getNumber()});
+	}
+	auto res = handler.placeOrders(req["pair"].getString(), orders);
+	return Value(json::array, res.begin(), res.end(), [](const AbstractBrokerAPI::NewOrderResult &r) {
+		if (r.error.empty()) return Value({true, r.id});
+		else return Value({false, r.error});
+	});
+}
+
 static Value enableDebug(AbstractBrokerAPI &handler, const Value &req) {
 	AbstractBrokerAPI *h = dynamic_cast<AbstractBrokerAPI *>(&handler);
 	if (h) {
@@ -261,6 +285,15 @@ Value enableBinary(AbstractBrokerAPI &handle, const Value &) {
 	return json::undefined;
 }
 
+Value enableMux(AbstractBrokerAPI &handle, const Value &req) {
+	unsigned int limit = std::max<unsigned int>(1, req.getUInt());
+	handle.mux_limit = limit;
+	return Object{
+		{"concurrency", std::min(limit, std::max(1U, handle.getMaxConcurrency()))},
+		{"limit", limit}
+	};
+}
+
 Value handleSubaccount(AbstractBrokerAPI &handler, const Value &req) {
 	static std::unordered_map<Value, std::unique_ptr<AbstractBrokerAPI> > subList;
 	if (req.hasValue()) {
@@ -321,6 +354,7 @@ static MethodMap methodMap ({
 			{"getOpenOrders",&getOpenOrders},
 			{"getTicker",&getTicker},
 			{"placeOrder",&placeOrder},
+			{"placeOrders",&placeOrders},
 			{"reset",&reset},
 			{"getAllPairs",&getAllPairs},
 			{"getInfo",&getInfo},
@@ -339,6 +373,7 @@ static MethodMap methodMap ({
 			{"areMinuteDataAvailable",&areMinuteDataAvailable},
 			{"downloadMinuteData",&downloadMinuteData},
 			{"bin",&enableBinary},
+			{"mux",&enableMux},
 
 	});
 
@@ -370,18 +405,245 @@ void AbstractBrokerAPI::disconnectStreams() {
 
 }
 
+///Reads the input by blocks
+/**
+ * Frames are parsed from the internal buffer, so the input is not read character by character
+ */
+class AbstractBrokerAPI::InputReader {
+public:
+	InputReader(std::istream &input):input(&input) {}
+	InputReader(int fd):fd(fd) {}
+
+	int operator()() {
+		if (pos == len && !fill()) return EOF;
+		return static_cast<unsigned char>(buffer[pos++]);
+	}
+
+	///Skips whitespaces
+	/**
+	 * @retval true there is next frame
+	 * @retval false end of the stream
+	 */
+	bool skipWhitespace() {
+		do {
+			while (pos < len) {
+				if (!isspace(static_cast<unsigned char>(buffer[pos]))) return true;
+				pos++;
+			}
+		} while (fill());
+		return false;
+	}
+
+	Value read(bool binary) {
+		if (binary) return Value::parseBinary([&]{return (*this)();}, json::base64);
+		else return Value::parse([&]{return (*this)();});
+	}
+
+protected:
+	std::istream *input = nullptr;
+	int fd = -1;
+	char buffer[16384];
+	std::size_t pos = 0;
+	std::size_t len = 0;
+
+	bool fill() {
+		pos = 0;
+		len = 0;
+		if (input) {
+			//wait for the first character, then take everything what is already buffered
+			auto sb = input->rdbuf();
+			int c = sb->sbumpc();
+			if (c == EOF) return false;
+			buffer[len++] = static_cast<char>(c);
+			std::streamsize avail = sb->in_avail();
+			if (avail > 0) len += sb->sgetn(buffer+len, std::min<std::streamsize>(avail, sizeof(buffer)-len));
+		} else {
+			ssize_t r;
+			do {
+				r = ::read(fd, buffer, sizeof(buffer));
+			} while (r < 0 && errno == EINTR);
+			if (r <= 0) return false;
+			len = r;
+		}
+		return true;
+	}
+};
+
+static bool isExclusiveMethod(std::string_view cmd) {
+	return cmd == "reset" || cmd == "setApiKey" || cmd == "setSettings" || cmd == "restoreSettings"
+			|| cmd == "subaccount" || cmd == "enableDebug" || cmd == "bin" || cmd == "mux";
+}
+
+///Returns pair of the request, requests of the same pair are executed in order
+static Value requestPair(std::string_view cmd, const Value &args) {
+	if (cmd == "getTicker" || cmd == "getOpenOrders" || cmd == "getInfo") return args;
+	if (cmd == "syncTrades" || cmd == "placeOrder" || cmd == "placeOrders" || cmd == "getBalance") return args["pair"];
+	return Value();
+}
+
+///Executes requests of the multiplexed protocol
+/**
+ * Request frame is [id, method, args], reply frame is [id, ok, result]. Reader thread
+ * parses frames and puts them to the queue, requests are executed on a pool of workers.
+ * Count of queued and running requests is limited by the limit requested by the client, the
+ * reader stops reading when the limit is reached.
+ */
+class AbstractBrokerAPI::MuxDispatcher {
+public:
+
+	MuxDispatcher(AbstractBrokerAPI &handler, std::ostream &output, std::ostream &error, bool binary)
+		:handler(handler),output(output),error(error),binary(binary),limit(std::max(1U,handler.mux_limit)) {}
+
+	~MuxDispatcher() {
+		finish();
+	}
+
+	void run(InputReader &input, bool &inited) {
+		unsigned int threads = std::min(limit, std::max(1U, handler.getMaxConcurrency()));
+		for (unsigned int i = 0; i < threads; i++) {
+			workers.emplace_back([this]{worker();});
+		}
+		while (input.skipWhitespace()) {
+			Value req = input.read(binary);
+			Value cmd = req[1];
+			std::string_view cmdstr = cmd.getString();
+			if (!inited && cmdstr != "enableDebug") {
+				waitIdle();
+				handler.loadKeys();
+				handler.onInit();
+				inited = true;
+			}
+			push(Task{req[0], cmd, req[2], requestPair(cmdstr, req[2]), isExclusiveMethod(cmdstr)});
+		}
+		finish();
+	}
+
+protected:
+
+	struct Task {
+		Value id;
+		Value cmd;
+		Value args;
+		Value pair;
+		bool exclusive;
+	};
+
+	AbstractBrokerAPI &handler;
+	std::ostream &output;
+	std::ostream &error;
+	bool binary;
+	unsigned int limit;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<Task> pending;
+	std::vector<Value> running_pairs;
+	std::vector<Value> skipped_pairs;
+	std::vector<std::thread> workers;
+	unsigned int running = 0;
+	bool running_exclusive = false;
+	bool stopping = false;
+
+	void push(Task &&t) {
+		std::unique_lock lk(lock);
+		cond.wait(lk, [&]{return pending.size() + running < limit;});
+		if (pending.empty() && running == 0) handler.connectStreams(error, output);
+		pending.push_back(std::move(t));
+		cond.notify_all();
+	}
+
+	void waitIdle() {
+		std::unique_lock lk(lock);
+		cond.wait(lk, [&]{return pending.empty() && running == 0;});
+	}
+
+	void finish() {
+		{
+			std::unique_lock lk(lock);
+			stopping = true;
+		}
+		cond.notify_all();
+		for (auto &t: workers) t.join();
+		workers.clear();
+	}
+
+	///Finds first request, which can be started now
+	std::deque<Task>::iterator pick() {
+		if (running_exclusive) return pending.end();
+		skipped_pairs.clear();
+		for (auto iter = pending.begin(); iter != pending.end(); ++iter) {
+			if (iter->exclusive) {
+				//exclusive request waits for all previous requests, and blocks all following requests
+				return iter == pending.begin() && running == 0?iter:pending.end();
+			}
+			if (!iter->pair.defined()) return iter;
+			if (std::find(running_pairs.begin(), running_pairs.end(), iter->pair) == running_pairs.end()
+				&& std::find(skipped_pairs.begin(), skipped_pairs.end(), iter->pair) == skipped_pairs.end()) return iter;
+			skipped_pairs.push_back(iter->pair);
+		}
+		return pending.end();
+	}
+
+	void worker() {
+		std::unique_lock lk(lock);
+		while (true) {
+			auto iter = pick();
+			if (iter == pending.end()) {
+				if (stopping && pending.empty()) break;
+				cond.wait(lk);
+				continue;
+			}
+			Task t = std::move(*iter);
+			pending.erase(iter);
+			running++;
+			if (t.exclusive) running_exclusive = true;
+			else if (t.pair.defined()) running_pairs.push_back(t.pair);
+			lk.unlock();
+
+			Value r = handler.callMethod(t.cmd.getString(), t.args);
+			write(Value({t.id, r[0], r[1]}));
+
+			lk.lock();
+			running--;
+			if (t.exclusive) running_exclusive = false;
+			else if (t.pair.defined()) running_pairs.erase(std::find(running_pairs.begin(), running_pairs.end(), t.pair));
+			if (pending.empty() && running == 0) handler.disconnectStreams();
+			cond.notify_all();
+		}
+	}
+
+	///Writes whole reply at once
+	void write(const Value &v) {
+		std::string buff;
+		if (binary) {
+			v.serializeBinary([&](char c){buff.push_back(c);}, json::compressKeys);
+		} else {
+			v.serialize([&](char c){buff.push_back(c);});
+			buff.push_back('\n');
+		}
+		std::lock_guard _(handler.outLock);
+		output.write(buff.data(), buff.size());
+		output.flush();
+	}
+};
+
 void AbstractBrokerAPI::dispatch(std::istream& input, std::ostream& output, std::ostream &error, AbstractBrokerAPI &handler) {
+	InputReader rd(input);
+	dispatch(rd, output, error, handler);
+}
+
+void AbstractBrokerAPI::dispatch(InputReader &input, std::ostream& output, std::ostream &error, AbstractBrokerAPI &handler) {
 
 	bool inited = false;
 	handler.logProvider->setDefault();
 	try {
-		Value v = Value::fromStream(input);
+		Value v = input.read(false);
 		handler.connectStreams(error, output);
 		bool binmode = false;
 		while (true) {
 			if (!inited) {
 				auto cmd = v[0].getString();
-				if (cmd != "bin" && cmd != "enableDebug") {
+				if (cmd != "bin" && cmd != "enableDebug" && cmd != "mux") {
 					handler.loadKeys();
 					handler.onInit();
 					inited = true;
@@ -389,25 +651,26 @@ void AbstractBrokerAPI::dispatch(std::istream& input, std::ostream& output, std:
 			}
 			Value res = handler.callMethod(v[0].getString(), v[1]);
 			if (binmode) {
-				res.serializeBinary([&](char c){output.put(c);}, json::compressKeys);
+				res.serializeBinary(json::toStream(output), json::compressKeys);
+				output.flush();
 			} else {
 				res.toStream(output);
 				output << std::endl;
 			}
 			handler.disconnectStreams();
 			binmode = handler.binary_mode;
-			int i = input.get();
-			while (i != EOF && isspace(i)) i = input.get();
-			if (i == EOF) break;
-			input.putback(i);
-			if (binmode) {
-				v = Value::parseBinary([&]{return input.get();}, json::base64);
-			} else {
-				v = Value::fromStream(input);
+			if (handler.mux_limit) {
+				//rest of the communication is multiplexed
+				MuxDispatcher mux(handler, output, error, binmode);
+				mux.run(input, inited);
+				break;
 			}
+			if (!input.skipWhitespace()) break;
+			v = input.read(binmode);
 			handler.connectStreams(error, output);
 		}
 	} catch (std::exception &e) {
+		std::lock_guard _(handler.outLock);
 		Value({false, e.what()}).toStream(output);
 		output << std::endl;
 	}
@@ -440,7 +703,9 @@ void AbstractBrokerAPI::loadKeys() {
 }
 
 void AbstractBrokerAPI::dispatch() {
-	dispatch(std::cin, std::cout, std::cerr, *this);
+	//stdin is read directly, std::cin would read it by characters
+	InputReader rd(0);
+	dispatch(rd, std::cout, std::cerr, *this);
 }
 
 void AbstractBrokerAPI::setApiKey(json::Value keyData) {
@@ -452,7 +717,7 @@ void AbstractBrokerAPI::setApiKey(json::Value keyData) {
 		umask( S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 		std::ofstream f(secure_storage_path);
 		if (!f) throw std::runtime_error("Failed to store API key");
-		keyData.serializeBinary([&](char c){f.put(c);}, compressKeys);
+		keyData.serializeBinary(json::toStream(f), compressKeys);
 		if (!f) throw std::runtime_error("Failed to store API key");
 	} catch (...) {
 		try {
@@ -516,6 +781,7 @@ json::Value AbstractBrokerAPI::getMarkets() const  {
 }
 
 void AbstractBrokerAPI::need_more_time() {
+	std::lock_guard _(outLock);
 	if (outStream) *outStream << std::endl;
 }
 
@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <limits>
+#include <mutex>
 
 #include <imtjson/value.h>
 #include "../main/apikeys.h"
@@ -122,6 +123,20 @@ public:
 
 
 	bool binary_mode = false;
+	///in-flight limit requested by the client (command "mux"), 0 - multiplexing is not active
+	unsigned int mux_limit = 0;
+
+	///Returns count of requests, which can be executed concurrently
+	/**
+	 * When the client enables multiplexing, requests are executed on a pool of this many threads.
+	 * Requests for the same pair are always executed in order of arrival, requests which change
+	 * state of the whole broker (reset, setApiKey, settings, subaccounts) are executed alone.
+	 *
+	 * Default implementation returns 1, because most of brokers are not thread safe. Override
+	 * this function if the broker can process multiple requests at the same time
+	 */
+	virtual unsigned int getMaxConcurrency() const {return 1;}
+
 	///tests, whether keys are valid
 	///default implementation calls getWallet_direct(), as the feature is not implemented on brokers yet
 	///however, this should be improved later
@@ -138,6 +153,8 @@ protected:
 	std::vector<std::string> logMessages;
 	std::ostream *logStream = nullptr;;
 	std::ostream *outStream = nullptr;;
+	///serializes writes to outStream (replies and keep-alive)
+	std::mutex outLock;
 	virtual void flushMessages();
 	void connectStreams(std::ostream &log, std::ostream &out);
 	void disconnectStreams();
@@ -146,6 +163,11 @@ protected:
 	class LogProvider;
 	ondra_shared::RefCntPtr<LogProvider> logProvider;
 
+	class InputReader;
+	class MuxDispatcher;
+
+	static void dispatch(InputReader &input, std::ostream &output, std::ostream &error, AbstractBrokerAPI &handler);
+
 	friend json::Value handleSubaccount(AbstractBrokerAPI &handler, const json::Value &req);
 
 	///function is not used here
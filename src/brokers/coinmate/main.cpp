@@ -448,8 +448,7 @@ inline uint64_t Interface::downloadMinuteData(const std::string_view &asset,
 	auto st = std::find_if(std::begin(histDataSets), std::end(histDataSets),[&](const HistDataSet &x){
 		return x.toMS() > hpt;
 	});
-	HTTPJson hapi(cm.httpc);
-	hapi.setBaseUrl("https://coinmate.io/");
+	HTTPJson hapi(simpleServer::HttpClient(cm.httpc.getClient()), "https://coinmate.io/");
 	if (st == std::end(histDataSets)) return 0;
 	std::uint64_t start = std::max(now - st->toMS(), time_from);
 	json::Value hdata = hapi.GET(std::string("guirest/rateGraph?currencyPairName=").append(name.getString()).append("&interval=").append(std::to_string(st->interval)));
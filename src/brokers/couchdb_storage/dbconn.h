@@ -0,0 +1,580 @@
+/*
+ * dbconn.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_BROKERS_COUCHDB_STORAGE_DBCONN_H_
+#define SRC_BROKERS_COUCHDB_STORAGE_DBCONN_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <imtjson/binary.h>
+#include <imtjson/string.h>
+#include <imtjson/binjson.tcc>
+#include <imtjson/object.h>
+#include <imtjson/serializer.h>
+#include <shared/logOutput.h>
+#include <simpleServer/urlencode.h>
+#include "../httpjson.h"
+
+static std::string_view cfg_prefix = "cfg.";
+static std::string_view trade_prefix = "t.";
+static json::Value design_document = json::Value(json::object,{
+	json::Value("_id","_design/report"),
+	json::Value("language","javascript"),
+	json::Value("views",json::Value(json::object,{
+		json::Value("month", json::Value(json::object,{
+			json::Value("map",R"js(
+function(doc) {
+   if (doc._id[0] == 't' && !doc.deleted) {
+	  var d = new Date(doc.time);
+	  var m = d.getYear()*12+d.getMonth();
+	  if (typeof doc.change == "number") emit([doc.ident,m,doc.currency],doc.change);
+   }
+}
+			)js"),
+			json::Value("reduce","_sum")
+		})),
+		json::Value("day", json::Value(json::object,{
+			json::Value("map",R"js(
+function(doc) {
+   if (doc._id[0] == 't' && !doc.deleted) {
+	  var m = Math.floor(doc.time/(24*60*60*1000));
+	  if (typeof doc.change == "number") emit([doc.ident,m,doc.currency],doc.change);
+   }
+}
+			)js"),
+			json::Value("reduce","_sum")
+		}))
+
+	})),
+
+
+
+
+});
+
+///Connection to the database
+/**
+ * Writes are not sent immediately. They are collected in a queue (write-behind) and
+ * written by a background thread using single _bulk_docs request. Multiple writes to the same
+ * name are coalesced, so only the last version is written. The queue is flushed after
+ * flush interval elapses since the first unwritten change, or when count of queued documents
+ * reaches the flush size.
+ *
+ * Errors of the background writes are kept per name and reported by check_error() with the
+ * same name, so failure of one document is not reported to the owner of another one. Unwritten
+ * data are kept in the queue and written again. Trades rejected by the database are reported
+ * by check_trade_error(), they are written again unless the database forbids them
+ */
+class DBConn {
+public:
+
+	DBConn(const std::string_view &url, const std::string_view &login, const std::string_view &password, const std::string_view &ident,
+			std::chrono::milliseconds flushInterval, std::size_t flushSize);
+	~DBConn();
+
+	void put(const std::string_view &name, const json::Value &data);
+	json::Value get(const std::string_view &name);
+	void erase(const std::string_view &name);
+
+	void put_trade(const json::Value &trade);
+	json::Value get_report();
+
+	///Writes all queued changes now
+	void flush();
+	///Throws exception, if the last background write of the name failed
+	void check_error(const std::string_view &name);
+	///Throws exception, if some trades were not written
+	void check_trade_error();
+
+
+protected:
+	///Queued changes, undefined value means erase
+	using Changes = std::map<std::string, json::Value, std::less<> >;
+
+	HTTPJson api;
+	json::Value auth;
+	json::Value rev;
+	std::string ident;
+
+	///protects HTTP client, also serializes writes
+	std::mutex apiLock;
+	///protects the queue
+	std::mutex qlock;
+	std::condition_variable qsignal;
+	Changes pending;
+	Changes inflight;
+	std::vector<json::Value> trades;
+	std::chrono::steady_clock::time_point firstPending;
+	std::chrono::steady_clock::time_point retryAfter;
+	///errors of the writes per name
+	std::map<std::string, std::string, std::less<> > errors;
+	std::string tradeError;
+	bool stopped = false;
+	std::chrono::milliseconds flushInterval;
+	std::size_t flushSize;
+	std::thread writer;
+
+	std::string buildPath(const std::string_view &name) const;
+	std::string docPath() const;
+	std::string docId() const;
+	static std::string attachmentName(const std::string_view &name);
+	void updateRev();
+	void markPending();
+	void worker();
+	std::string write_pending();
+	std::vector<json::Value> bulk_write(const Changes &chg, const std::vector<json::Value> &trades, std::string &tradeErr);
+	json::Value get_report_lk(bool rep);
+};
+
+inline json::Value createAuthStr(const std::string_view &username, const std::string_view &password) {
+	std::string buff;
+	std::string res;
+	buff.reserve(username.length()+1+password.length());
+	buff.append(username);
+	buff.push_back(':');
+	buff.append(password);
+	res.reserve((buff.size()+4)*4/3);
+	json::base64->encodeBinaryValue(
+			json::BinaryView(reinterpret_cast<const unsigned char *>(buff.data()),buff.length()),
+			[&](const std::string_view &txt){
+		res.append(txt);
+	});
+	return json::Value(json::object, {
+			json::Value("Authorization", json::String({"Basic ",res}))
+	});
+}
+
+
+inline DBConn::DBConn(const std::string_view &url,
+		const std::string_view &login, const std::string_view &password,
+		const std::string_view &ident, std::chrono::milliseconds flushInterval, std::size_t flushSize)
+:api(simpleServer::HttpClient("", simpleServer::newHttpsProvider(), 0, 0), url)
+,auth(createAuthStr(login, password))
+,ident(ident)
+,flushInterval(flushInterval)
+,flushSize(std::max<std::size_t>(flushSize,1))
+{
+	updateRev();
+	writer = std::thread([this]{worker();});
+}
+
+inline DBConn::~DBConn() {
+	{
+		std::unique_lock _(qlock);
+		stopped = true;
+	}
+	qsignal.notify_all();
+	writer.join();
+}
+
+inline void DBConn::markPending() {
+	if (pending.empty() && trades.empty()) {
+		firstPending = std::chrono::steady_clock::now();
+		//the writer waits without timeout on empty queue
+		qsignal.notify_all();
+	}
+}
+
+inline void DBConn::put(const std::string_view &name, const json::Value &data) {
+	std::unique_lock _(qlock);
+	markPending();
+	auto iter = pending.find(name);
+	if (iter == pending.end()) pending.emplace(std::string(name), data);
+	else iter->second = data;
+	if (pending.size() + trades.size() >= flushSize) qsignal.notify_all();
+}
+
+inline json::Value DBConn::get(const std::string_view &name) {
+	{
+		//queued data are newer than data in the database
+		std::unique_lock _(qlock);
+		const json::Value *queued = nullptr;
+		auto iter = pending.find(name);
+		if (iter != pending.end()) {
+			queued = &iter->second;
+		} else {
+			auto iter2 = inflight.find(name);
+			if (iter2 != inflight.end()) queued = &iter2->second;
+		}
+		if (queued) {
+			if (queued->defined()) return *queued;
+			throw std::runtime_error("not_found");
+		}
+	}
+	std::unique_lock _(apiLock);
+	json::Value res = api.GET(buildPath(name), json::Value(auth));
+	return res;
+}
+
+inline void DBConn::erase(const std::string_view &name) {
+	put(name, json::undefined);
+}
+
+inline void DBConn::check_error(const std::string_view &name) {
+	std::unique_lock _(qlock);
+	auto iter = errors.find(name);
+	if (iter != errors.end()) {
+		std::string msg = "Storage write failed (will retry): " + iter->second;
+		errors.erase(iter);
+		throw std::runtime_error(msg);
+	}
+}
+
+inline void DBConn::check_trade_error() {
+	std::unique_lock _(qlock);
+	if (!tradeError.empty()) {
+		std::string msg = "Failed to store trades: " + tradeError;
+		tradeError.clear();
+		throw std::runtime_error(msg);
+	}
+}
+
+inline void DBConn::flush() {
+	std::string err = write_pending();
+	if (!err.empty()) throw std::runtime_error("Storage write failed (will retry): " + err);
+}
+
+inline void DBConn::worker() {
+	std::unique_lock lk(qlock);
+	while (!stopped) {
+		auto now = std::chrono::steady_clock::now();
+		if (pending.empty() && trades.empty()) {
+			qsignal.wait(lk);
+		} else if (now < retryAfter) {
+			qsignal.wait_until(lk, retryAfter);
+		} else if (pending.size() + trades.size() < flushSize && now < firstPending + flushInterval) {
+			qsignal.wait_until(lk, firstPending + flushInterval);
+		} else {
+			lk.unlock();
+			write_pending();
+			lk.lock();
+		}
+	}
+}
+
+///Writes queued changes, returns error message or empty string
+inline std::string DBConn::write_pending() {
+	std::unique_lock _(apiLock);
+	std::vector<json::Value> tr;
+	{
+		std::unique_lock lk(qlock);
+		if (pending.empty() && trades.empty()) return std::string();
+		std::swap(inflight, pending);
+		std::swap(tr, trades);
+	}
+	try {
+		std::string tradeErr;
+		std::vector<json::Value> failed = bulk_write(inflight, tr, tradeErr);
+		std::unique_lock lk(qlock);
+		for (const auto &c: inflight) errors.erase(c.first);
+		inflight.clear();
+		if (!failed.empty()) {
+			markPending();
+			retryAfter = std::chrono::steady_clock::now() + flushInterval;
+			trades.insert(trades.begin(), failed.begin(), failed.end());
+			qsignal.notify_all();
+		}
+		if (!tradeErr.empty()) {
+			tradeError = tradeErr;
+			ondra_shared::logError("Error writing trades to database: $1", tradeErr);
+		}
+		return tradeErr;
+	} catch (std::exception &e) {
+		std::unique_lock lk(qlock);
+		//return unwritten data to the queue, don't overwrite newer changes
+		markPending();
+		retryAfter = std::chrono::steady_clock::now() + flushInterval;
+		for (const auto &c: inflight) errors[c.first] = e.what();
+		pending.merge(inflight);
+		inflight.clear();
+		trades.insert(trades.begin(), tr.begin(), tr.end());
+		qsignal.notify_all();
+		ondra_shared::logError("Error writing to database: $1", e.what());
+		return e.what();
+	}
+}
+
+///Writes changes and trades
+/**
+ * @param chg changes of the settings
+ * @param trades trades
+ * @param tradeErr receives error of rejected trades
+ * @return trades which must be written again
+ * @exception std::exception settings were not written
+ */
+inline std::vector<json::Value> DBConn::bulk_write(const Changes &chg, const std::vector<json::Value> &trades, std::string &tradeErr) {
+	using namespace json;
+	//Settings are stored as attachments of single document, merge changes with current set of attachments
+	auto build_cfg_doc = [&]{
+		Value doc;
+		try {
+			doc = api.GET(docPath(), Value(auth));
+		} catch (HTTPJson::UnknownStatusException &e) {
+			if (e.getStatusCode() != 404) throw;
+			doc = Value(object,{Value("_id",docId())});
+		}
+		Object atts(doc["_attachments"]);
+		for (const auto &c: chg) {
+			std::string aname = attachmentName(c.first);
+			if (c.second.defined()) {
+				String txt = c.second.stringify();
+				atts.set(aname, Value(object,{
+						Value("content_type","application/json"),
+						Value("data",Value(json::map_str2bin(txt.str()), base64))
+				}));
+			} else {
+				atts.unset(aname);
+			}
+		}
+		return doc.replace("_attachments", atts);
+	};
+
+	std::vector<Value> docs;
+	docs.reserve(trades.size()+1);
+	if (!chg.empty()) docs.push_back(build_cfg_doc());
+	docs.insert(docs.end(), trades.begin(), trades.end());
+	std::vector<Value> failed;
+	for (int retry = 0; !docs.empty(); retry++) {
+		Value res = api.POST("/_bulk_docs", Value(object,{
+				Value("docs",Value(array,docs.begin(), docs.end(),[](Value x){return x;}))
+		}), Value(auth));
+		if (res.type() != json::array || res.size() != docs.size())
+			throw std::runtime_error(String({"Unexpected reply of _bulk_docs: ", res.toString()}).str());
+		if (retry == 0) {
+			//trades are never updated, so conflict means, that trade has been already stored
+			for (std::size_t i = 0, ofs = chg.empty()?0:1; i < trades.size(); i++) {
+				Value r = res[i+ofs];
+				Value err = r["error"];
+				if (!err.defined() || err.getString() == "conflict") continue;
+				tradeErr = String({r["id"].toString(), ": ", err.toString(), " ", r["reason"].toString()}).str();
+				//forbidden document is rejected by validation, it can't be written later
+				if (err.getString() != "forbidden") failed.push_back(trades[i]);
+			}
+		}
+		if (chg.empty()) return failed;
+		Value r = res[0];
+		if (r["rev"].defined()) {
+			rev = r["rev"];
+			return failed;
+		}
+		if (r["error"].getString() != "conflict" || retry >= 2)
+			throw std::runtime_error(String({"Unable to store settings: ", r["error"].toString(), " ", r["reason"].toString()}).str());
+		docs.clear();
+		docs.push_back(build_cfg_doc());
+	}
+	return failed;
+}
+
+inline std::string DBConn::docId() const {
+	return std::string(cfg_prefix)+ident;
+}
+
+inline std::string DBConn::attachmentName(const std::string_view &name) {
+	if (name.empty()) return "empty_empty";
+	else if (name[0] == '_') return "X"+std::string(name);
+	else return std::string(name);
+}
+
+inline std::string DBConn::docPath() const {
+	std::string out;
+	out.reserve(100);
+	out.push_back('/');
+	auto fn = [&](char c) {
+		out.push_back(c);
+	};
+	out.append(cfg_prefix);
+	simpleServer::UrlEncode<decltype(fn) &> encoder(fn);
+	for (char c: ident) encoder(c);
+	return out;
+}
+
+inline std::string DBConn::buildPath(const std::string_view &name) const {
+	std::string out = docPath();
+	auto fn = [&](char c) {
+		out.push_back(c);
+	};
+	simpleServer::UrlEncode<decltype(fn) &> encoder(fn);
+	out.push_back('/');
+	if (name.empty()) out.append("empty_empty");
+	else if (name[0] == '_') out.push_back('X');
+	for (char c: name) encoder(c);
+	if (rev.defined()) {
+		out.append("?rev=");
+		out.append(rev.getString());
+	}
+	return out;
+}
+
+inline void DBConn::put_trade(const json::Value &trade) {
+	using namespace json;
+	std::string id;
+	std::string buff;
+	Value identData={ident,trade["uid"],trade["tradeId"]};
+	identData.serializeBinary([&](char c){
+		buff.push_back(c);
+	});
+	id = trade_prefix;
+	base64url->encodeBinaryValue(json::map_str2bin(buff),[&](StrViewA str){
+		id.append(str.data, str.length);
+	});
+	Value doc = trade.replace("_id", id).replace("ident", ident);
+	std::unique_lock _(qlock);
+	markPending();
+	trades.push_back(doc);
+	if (pending.size() + trades.size() >= flushSize) qsignal.notify_all();
+}
+
+inline json::Value DBConn::get_report() {
+	std::unique_lock _(apiLock);
+	return get_report_lk(true);
+}
+
+inline json::Value DBConn::get_report_lk(bool rep) {
+	using namespace json;
+	try {
+		auto now = std::chrono::system_clock::now();
+		auto timestamp = std::chrono::system_clock::to_time_t(now);
+		struct tm tmstruct;
+		gmtime_r(&timestamp, &tmstruct);
+		auto month_id = tmstruct.tm_year*12+tmstruct.tm_mon;
+		tmstruct.tm_mday = 1;
+		tmstruct.tm_hour = 0;
+		tmstruct.tm_min = 0;
+		tmstruct.tm_sec = 0;
+		time_t from_tm = timegm(&tmstruct);
+
+		Value month_date_from = {ident, 0};
+		Value month_date_to = {ident, month_id};
+		Value day_date_from = {ident, from_tm/(24*60*60)};
+		Value day_date_to = {ident, ""};
+
+		std::string uri;
+		auto srl_to_url=[&](char c){uri.push_back(c);};
+		simpleServer::UrlEncode<decltype(srl_to_url) &> enc(srl_to_url);
+
+		uri.reserve(200);
+		//don't wait for the index update, the report can be slightly outdated
+		uri.append("/_design/report/_view/month?group_level=3&update=lazy");
+		uri.append("&exclude_end=false");
+		uri.append("&start_key=");
+		month_date_from.serialize(enc);
+		uri.append("&end_key=");
+		month_date_to.serialize(enc);
+
+		Value month_data = api.GET(uri, Value(auth))["rows"];
+
+		uri.clear();
+		uri.append("/_design/report/_view/day?group_level=3&update=lazy");
+		uri.append("&start_key=");
+		day_date_from.serialize(enc);
+		uri.append("&end_key=");
+		day_date_to.serialize(enc);
+
+		Value day_data = api.GET(uri, Value(auth))["rows"];
+
+		std::unordered_map<json::Value, json::Value> row;
+		std::unordered_map<json::Value, double> sums;
+		for(Value x: month_data) {
+			Value k = x["key"][2];
+			row[k] = 0;
+			sums[k] = 0;
+		}
+		for(Value x: day_data) {
+			Value k = x["key"][2];
+			row[k] = 0;
+			sums[k] = 0;
+		}
+
+		Value hdrs (array,row.begin(), row.end(),[](const auto &x){
+			return x.first;
+		});
+		hdrs.unshift("Date");
+
+		std::vector<json::Value> outdata;
+
+		auto append_row = [&](auto &x){
+			Value res = x.second;
+			x.second = 0;
+			sums[x.first]+=res.getNumber();
+			return res;
+		};
+
+		auto build_rows=[&](Value data, auto &&tmfn) {
+			std::uint64_t ln = 0;
+			for (Value x: data) {
+				auto m = x["key"][1].getUInt();
+				if (ln != m) {
+					if (ln) {
+						Value r(array, row.begin(), row.end(), append_row);
+						r.unshift(tmfn(ln));
+						outdata.push_back(r);
+					}
+				}
+				Value k = x["key"][2];
+				Value v = x["value"];
+				row[k] = v;
+				ln = m;
+			}
+			if (ln) {
+				Value r(array, row.begin(), row.end(), append_row);
+				r.unshift(tmfn(ln));
+				outdata.push_back(r);
+			}
+		};
+
+		build_rows(month_data,[](std::uint64_t ln){
+			struct tm t = {};
+			t.tm_year = ln/12;
+			t.tm_mon = (ln%12)+1;
+			return timegm(&t);
+		});
+		build_rows(day_data,[](std::uint64_t ln){
+			return ln*24*60*60;
+		});
+		Value jrows(array,outdata.begin(),outdata.end(),[](Value x){return x;});
+		Value jsums(array,sums.begin(),sums.end(),[](auto &x){return x.second;});
+		return Value(object,{
+				Value("hdr", hdrs),
+				Value("rows", jrows),
+				Value("sums", jsums),
+		});
+	} catch (HTTPJson::UnknownStatusException &e) {
+		if (e.getStatusCode() == 404) {
+			try {
+				api.POST("/", design_document, Value(auth));
+				if (rep) return get_report_lk(false);
+				else throw;
+			} catch (HTTPJson::UnknownStatusException &e) {
+				if (e.getStatusCode() == 403) {
+					return Value(object,{
+							Value("hdrs", {"Date","Error"}),
+							Value("rows", {std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()),"Database account need temporary admin level to initialize database"}),
+							Value("sums", {0})
+					});
+				}
+				throw;
+			}
+		}
+		throw;
+	}
+};
+
+inline void DBConn::updateRev() {
+	using namespace json;
+	String doc({cfg_prefix,ident});
+	Value v = api.POST("/_all_docs", Value(object,{
+			Value("keys",Value(array,{Value(doc)}))}), Value(auth), 200);
+	rev = v["rows"][0]["value"]["rev"];
+}
+
+#endif /* SRC_BROKERS_COUCHDB_STORAGE_DBCONN_H_ */
@@ -46,7 +46,7 @@ Value readPrices(const std::string_view &asset, const std::string_view &currency
 			<< "&currency=" << simpleServer::urlEncode(currency)
 			<< "&from=" << fromTime;
 
-	return httpc.GET(url.str()).map([&](Value v){return v[1];});
+	return httpc.GET(url.str()).map([&](Value v){return Value({v[0], v[1]});});
 
 }
 
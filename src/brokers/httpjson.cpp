@@ -91,13 +91,7 @@ json::Value HTTPJson::GET(const std::string_view &path, json::Value &&headers, u
 	logDebug("GET $1", url);
 
 	auto resp = httpc.request("GET", url, hdrs(headers));
-	const simpleServer::ReceivedHeaders &hdrs = resp.getHeaders();
-	simpleServer::HeaderValue datehdr = hdrs["Date"];
-	if (datehdr.defined()) {
-		if (parseHttpDate(datehdr, lastServerTime)) {
-			lastLocalTime = std::chrono::steady_clock::now();
-		}
-	}
+	updateServerTime(resp.getHeaders());
 	unsigned int st = resp.getStatus();
 	if ((expectedCode && st != expectedCode) || (!expectedCode && st/100 != 2)) {
 		throw UnknownStatusException(st, resp.getMessage(),resp);
@@ -129,13 +123,7 @@ json::Value HTTPJson::SEND(const std::string_view &path,
 
 
 	auto resp = httpc.request(method, url, hdrs(headers), sdata.str());
-	const simpleServer::ReceivedHeaders &hdrs = resp.getHeaders();
-	simpleServer::HeaderValue datehdr = hdrs["Date"];
-	if (datehdr.defined()) {
-		if (parseHttpDate(datehdr, lastServerTime)) {
-			lastLocalTime = std::chrono::steady_clock::now();
-		}
-	}
+	updateServerTime(resp.getHeaders());
 	unsigned int st = resp.getStatus();
 	if ((expectedCode && st != expectedCode) || (!expectedCode && st/100 != 2)) {
 		throw UnknownStatusException(st, resp.getMessage(), resp);
@@ -288,7 +276,18 @@ bool HTTPJson::parseHttpDate(const std::string_view &date, std::chrono::system_c
 	return parseRfc1123_date(date, tp) || parseRfc850_date(date, tp);
 }
 
+void HTTPJson::updateServerTime(const simpleServer::ReceivedHeaders &hdrs) {
+	simpleServer::HeaderValue datehdr = hdrs["Date"];
+	std::chrono::system_clock::time_point tp;
+	if (datehdr.defined() && parseHttpDate(datehdr, tp)) {
+		std::lock_guard _(timeLock);
+		lastServerTime = tp;
+		lastLocalTime = std::chrono::steady_clock::now();
+	}
+}
+
 std::chrono::system_clock::time_point HTTPJson::now() {
+	std::lock_guard _(timeLock);
 	if (lastServerTime.time_since_epoch().count() == 0) {
 		return std::chrono::system_clock::now();
 	} else {
@@ -9,6 +9,7 @@
 #define SRC_SIMPLEFX_HTTPJSON_H_
 
 #include <chrono>
+#include <mutex>
 #include <string_view>
 #include <imtjson/value.h>
 #include <simpleServer/http_client.h>
@@ -61,7 +62,10 @@ public:
 	void setBaseUrl(const std::string &url);
 	simpleServer::HttpClient &getClient() {return httpc;}
 
-	const auto &getLastServerTime() const {return lastServerTime;}
+	std::chrono::system_clock::time_point getLastServerTime() const {
+		std::lock_guard _(timeLock);
+		return lastServerTime;
+	}
 	std::chrono::system_clock::time_point now();
 
 	void set_reading_fn(std::function<void()> reading_fn) {this->reading_fn = reading_fn;}
@@ -73,11 +77,14 @@ protected:
 	std::string baseUrl;
 	std::chrono::system_clock::time_point lastServerTime;
 	std::chrono::steady_clock::time_point lastLocalTime;
+	///protects the server time, requests can be executed from multiple threads
+	mutable std::mutex timeLock;
 	std::function<void()> reading_fn;
 	bool force_json = false;
 
 
 	static bool parseHttpDate(const std::string_view &date, std::chrono::system_clock::time_point & tp);
+	void updateServerTime(const simpleServer::ReceivedHeaders &hdrs);
 	json::Value parseResponse(simpleServer::HttpResponse &resp, json::Value &headers);
 };
 
@@ -61,20 +61,17 @@ AbstractBrokerAPI* Interface::createSubaccount(
 	return new Interface(secure_storage_path);
 }
 
-const Interface::MarketInfo &Interface::getMkInfo(const std::string_view &pair) {
-	auto iter = mkcache.find(pair);
-	if (iter == mkcache.end()) {
-		getMarketInfo(pair);
-		iter = mkcache.find(pair);
-		if (iter == mkcache.end()) throw std::runtime_error("Unknown instrument");
+Interface::MarketInfo Interface::getMkInfo(const std::string_view &pair) {
+	{
+		std::lock_guard _(lock);
+		auto iter = mkcache.find(pair);
+		if (iter != mkcache.end()) return iter->second;
 	}
-	return iter->second;
-
+	return getMarketInfo(pair);
 }
 
 IStockApi::MarketInfo Interface::getMarketInfo(const std::string_view &pair) {
-	updateInstruments();
-	Value f = instr_cache.find([&](Value x){
+	Value f = getInstruments().find([&](Value x){
 		return x["instId"].getString() == pair;
 	});
 	if (f.defined()) {
@@ -94,6 +91,7 @@ IStockApi::MarketInfo Interface::getMarketInfo(const std::string_view &pair) {
 			/*private_chart = */false,
 			/*wallet_id= */ "spot"
 		};
+		std::lock_guard _(lock);
 		mkcache[std::string(pair)] = nfo;
 		return nfo;
 	} else {
@@ -128,14 +126,19 @@ IBrokerControl::BrokerInfo Interface::getBrokerInfo() {
 	};
 }
 
-void Interface::updateInstruments() const {
-	if (!instr_cache.defined())
-		instr_cache = api.GET("/api/v5/public/instruments?instType=SPOT")["data"];
+json::Value Interface::getInstruments() const {
+	{
+		std::lock_guard _(lock);
+		if (instr_cache.defined()) return instr_cache;
+	}
+	Value data = api.GET("/api/v5/public/instruments?instType=SPOT")["data"];
+	std::lock_guard _(lock);
+	instr_cache = data;
+	return data;
 }
 
 json::Value Interface::getMarkets() const {
-	updateInstruments();
-	Value items = instr_cache.sort([](Value a, Value b){
+	Value items = getInstruments().sort([](Value a, Value b){
 		auto x = Value::compare(a["baseCcy"],b["baseCcy"]);
 		if (x) return x;
 		else return Value::compare(a["quoteCcy"],b["quoteCcy"]);
@@ -158,14 +161,14 @@ json::Value Interface::getMarkets() const {
 }
 
 bool Interface::reset() {
+	std::lock_guard _(lock);
 	instr_cache=Value();
 	account_cache=Value();
 	return true;
 }
 
 std::vector<std::string> Interface::getAllPairs() {
-	updateInstruments();
-	return mapJSON(instr_cache, [](Value x){
+	return mapJSON(getInstruments(), [](Value x){
 		return std::string(x["instId"].getString());
 	}, std::vector<std::string>());
 
@@ -192,15 +195,20 @@ json::Value Interface::testCall(const std::string_view &method,
 	return nullptr;
 }
 
-void Interface::updateAccountData() {
-	if (!account_cache.defined())
-		account_cache = authReq("GET", "/api/v5/account/account-position-risk", Value());
+json::Value Interface::getAccountData() {
+	{
+		std::lock_guard _(lock);
+		if (account_cache.defined()) return account_cache;
+	}
+	Value data = authReq("GET", "/api/v5/account/account-position-risk", Value());
+	std::lock_guard _(lock);
+	account_cache = data;
+	return data;
 }
 
 double Interface::getBalance(const std::string_view &symb,
 		const std::string_view &pair) {
-	updateAccountData();
-	Value entry = account_cache["data"][0]["balData"].find([&](Value v){
+	Value entry = getAccountData()["data"][0]["balData"].find([&](Value v){
 		return v["ccy"].getString() == symb;
 	});
 	return entry["eq"].getNumber();
@@ -228,7 +236,7 @@ IStockApi::TradesSync Interface::syncTrades(json::Value lastId,
 			return TradesSync{{}, lastId};
 		} else {
 			Value new_lastId = res[res.size()-1]["billId"];
-			const MarketInfo &mk = getMkInfo(pair);
+			MarketInfo mk = getMkInfo(pair);
 			return TradesSync{
 				mapJSON(res, [&](Value z){
 					double size = z["fillSz"].getNumber();
@@ -334,10 +342,8 @@ double Interface::getFees(const std::string_view &pair) {
 }
 
 IBrokerControl::AllWallets Interface::getWallet() {
-	updateAccountData();
-
 	return AllWallets{
-		Wallet{"spot",mapJSON(account_cache["data"][0]["balData"],[](Value c){
+		Wallet{"spot",mapJSON(getAccountData()["data"][0]["balData"],[](Value c){
 			return WalletItem {
 				c["ccy"].toString(),
 				c["eq"].getNumber()
@@ -421,11 +427,13 @@ std::string Interface::createTag(const Value &clientId) {
 	std::string buff="mm";
 	base64url->encodeBinaryValue(json::BinaryView(reinterpret_cast<const unsigned char *>(&hash),4),
 			[&](StrViewA c){buff.append(c.data, c.length);});
+	std::lock_guard _(lock);
 	clientIdMap[buff] = clientId;
 	return buff;
 }
 
 json::Value Interface::parseTag(const std::string_view &tag) {
+	std::lock_guard _(lock);
 	auto iter = clientIdMap.find(tag);
 	if (iter == clientIdMap.end()) return json::Value();
 	else return iter->second;
@@ -9,6 +9,7 @@
 #define SRC_BROKERS_OKX_INTERFACE_H_
 
 #include <chrono>
+#include <mutex>
 #include "../api.h"
 #include "../httpjson.h"
 #include "../orderdatadb.h"
@@ -41,20 +42,25 @@ public:
 	virtual IStockApi::Ticker getTicker(const std::string_view &piar) override;
 	virtual std::vector<std::string> getAllPairs() override;;
 	virtual void onInit() override;
+	virtual unsigned int getMaxConcurrency() const override {return 4;}
 protected:
 
 	mutable HTTPJson api;
 	std::string api_key, api_secret, api_passphrase;
 
+	///protects caches, requests are executed concurrently (see getMaxConcurrency())
+	/** the lock is never held during a request to the exchange */
+	mutable std::mutex lock;
+
 	mutable json::Value instr_cache;
 	json::Value account_cache;
 
 	json::Value authReq(std::string_view method, std::string_view uri, json::Value body) const;
-	void updateAccountData();
-	void updateInstruments() const;
+	json::Value getAccountData();
+	json::Value getInstruments() const;
 
 	std::map<std::string, MarketInfo, std::less<> > mkcache;
-	const MarketInfo &getMkInfo(const std::string_view &pair);
+	MarketInfo getMkInfo(const std::string_view &pair);
 
 	std::map<std::string, json::Value, std::less<> > clientIdMap;
 
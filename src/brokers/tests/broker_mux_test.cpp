@@ -0,0 +1,195 @@
+/*
+ * broker_mux_test.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <imtjson/object.h>
+#include <imtjson/string.h>
+#include <imtjson/value.h>
+#include <tests/testClass.h>
+
+#include "../api.h"
+
+using namespace json;
+
+///Broker which only records, how the requests are executed
+/**
+ * The pair of getTicker and syncTrades contains delay of the request in milliseconds
+ * after the colon (for example "A:300")
+ */
+class MockBroker: public AbstractBrokerAPI {
+public:
+	MockBroker(unsigned int concurrency)
+		:AbstractBrokerAPI("/nonexistent/mock_broker_key", Value())
+		,concurrency(concurrency) {}
+
+	virtual unsigned int getMaxConcurrency() const override {return concurrency;}
+	virtual void onLoadApiKey(json::Value) override {}
+	virtual void onInit() override {}
+	virtual bool reset() override {
+		exec("reset");
+		return true;
+	}
+	virtual double getBalance(const std::string_view &, const std::string_view &) override {return 1;}
+	virtual TradesSync syncTrades(json::Value lastId, const std::string_view &pair) override {
+		exec(pair);
+		return {{}, lastId};
+	}
+	virtual Orders getOpenOrders(const std::string_view &) override {return {};}
+	virtual Ticker getTicker(const std::string_view &pair) override {
+		exec(pair);
+		return {1,2,1.5,0};
+	}
+	virtual json::Value placeOrder(const std::string_view &pair, double, double, json::Value clientId, json::Value, double) override {
+		if (pair == "ERR") throw std::runtime_error("rejected");
+		std::this_thread::sleep_for(std::chrono::milliseconds(clientId.getUInt()*7%5));
+		std::lock_guard _(lock);
+		orders[std::string(pair)].push_back(clientId.getUInt());
+		return clientId;
+	}
+	virtual MarketInfo getMarketInfo(const std::string_view &) override {return {};}
+	virtual std::vector<std::string> getAllPairs() override {return {};}
+	virtual AbstractBrokerAPI *createSubaccount(const std::string &) override {return nullptr;}
+
+	///Runs the dispatcher with the mux protocol, returns ids of the replies in order of arrival
+	std::vector<Value> run(unsigned int limit, const std::vector<Value> &frames) {
+		std::ostringstream input, output, error;
+		Value({"mux", limit}).toStream(input);
+		input << std::endl;
+		for (const Value &f: frames) {
+			f.toStream(input);
+			input << std::endl;
+		}
+		std::istringstream in(input.str());
+		dispatch(in, output, error, *this);
+		std::istringstream out(output.str());
+		std::string ln;
+		std::vector<Value> ids;
+		std::getline(out, ln);
+		while (std::getline(out, ln)) {
+			replies.push_back(Value::fromString(ln));
+			ids.push_back(replies.back()[0]);
+		}
+		return ids;
+	}
+
+	///Returns index of the event (start or end of the request), or -1 if not found
+	int event(const std::string &name) const {
+		auto iter = std::find(events.begin(), events.end(), name);
+		return iter == events.end()?-1:static_cast<int>(std::distance(events.begin(), iter));
+	}
+
+	unsigned int concurrency;
+	std::mutex lock;
+	std::vector<std::string> events;
+	std::map<std::string, std::vector<unsigned int> > orders;
+	std::vector<Value> replies;
+	unsigned int running = 0;
+	unsigned int max_running = 0;
+
+protected:
+	void exec(std::string_view name) {
+		std::string n(name);
+		{
+			std::lock_guard _(lock);
+			events.push_back("start "+n);
+			max_running = std::max(max_running, ++running);
+		}
+		auto sep = n.find(':');
+		if (sep != n.npos) std::this_thread::sleep_for(std::chrono::milliseconds(std::stoi(n.substr(sep+1))));
+		std::lock_guard _(lock);
+		events.push_back("end "+n);
+		--running;
+	}
+};
+
+static Value ticker(unsigned int id, std::string_view pair) {
+	return {id, "getTicker", pair};
+}
+
+int main(int, char **) {
+
+	TestSimple tst;
+
+	tst.test("broker_mux.concurrent", "2 3 1") >> [&](std::ostream &out) {
+		MockBroker b(4);
+		auto ids = b.run(4, {
+			{1, "syncTrades", Object{{"pair","A:300"},{"lastId",1}}},
+			ticker(2, "B:10"),
+			ticker(3, "C:100")
+		});
+		out << Value(json::array, ids.begin(), ids.end(), [](Value v){return v;}).join(" ");
+	};
+
+	tst.test("broker_mux.sequential", "1 2 3") >> [&](std::ostream &out) {
+		MockBroker b(1);
+		auto ids = b.run(4, {
+			{1, "syncTrades", Object{{"pair","A:100"},{"lastId",1}}},
+			ticker(2, "B:10"),
+			ticker(3, "C:0")
+		});
+		out << Value(json::array, ids.begin(), ids.end(), [](Value v){return v;}).join(" ");
+	};
+
+	tst.test("broker_mux.pair_order", "true 24") >> [&](std::ostream &out) {
+		MockBroker b(4);
+		std::vector<Value> frames;
+		for (unsigned int i = 0; i < 24; i++) {
+			frames.push_back({i, "placeOrder", Object{
+				{"pair", "P"+std::to_string(i%3)},
+				{"size", 1},
+				{"price", 1},
+				{"clientOrderId", i}
+			}});
+		}
+		auto ids = b.run(8, frames);
+		bool ordered = b.orders.size() == 3;
+		for (const auto &[pair, lst]: b.orders) ordered = ordered && std::is_sorted(lst.begin(), lst.end());
+		out << std::boolalpha << ordered << " " << ids.size();
+	};
+
+	tst.test("broker_mux.exclusive", "true true") >> [&](std::ostream &out) {
+		MockBroker b(4);
+		b.run(4, {
+			ticker(1, "X:100"),
+			ticker(2, "Y:20"),
+			{3, "reset", Value()},
+			ticker(4, "Z:0")
+		});
+		int r = b.event("start reset");
+		out << std::boolalpha << (r > b.event("end X:100") && r > b.event("end Y:20"))
+			<< " " << (b.event("start Z:0") > b.event("end reset"));
+	};
+
+	tst.test("broker_mux.limit", "2") >> [&](std::ostream &out) {
+		MockBroker b(4);
+		std::vector<Value> frames;
+		for (unsigned int i = 0; i < 8; i++) frames.push_back(ticker(i, "T"+std::to_string(i)+":20"));
+		b.run(2, frames);
+		out << b.max_running;
+	};
+
+	tst.test("broker_mux.error", "[2,false,\"rejected\"]") >> [&](std::ostream &out) {
+		MockBroker b(4);
+		b.run(4, {
+			ticker(1, "A:0"),
+			{2, "placeOrder", Object{{"pair","ERR"},{"size",1},{"price",1}}}
+		});
+		auto iter = std::find_if(b.replies.begin(), b.replies.end(), [](Value v){return v[0].getUInt() == 2;});
+		if (iter != b.replies.end()) out << iter->toString();
+	};
+
+	return tst.didFail()?1:0;
+}
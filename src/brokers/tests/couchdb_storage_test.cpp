@@ -0,0 +1,319 @@
+/*
+ * couchdb_storage_test.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <imtjson/binary.h>
+#include <imtjson/object.h>
+#include <imtjson/string.h>
+#include <imtjson/value.h>
+#include <simpleServer/address.h>
+#include <simpleServer/exceptions.h>
+#include <simpleServer/http_parser.h>
+#include <simpleServer/http_server.h>
+#include <tests/testClass.h>
+
+#include "../couchdb_storage/dbconn.h"
+
+using namespace json;
+using namespace simpleServer;
+
+///First port tried for the stand-in server
+static constexpr unsigned int firstPort = 18765;
+
+///CouchDB-compatible stand-in server
+/**
+ * Implements only requests used by DBConn: document and attachment GET, _all_docs and _bulk_docs.
+ * Documents are held in the memory. Requests and documents can be failed on demand to test the retry.
+ * Documents with the field "reject" are forbidden
+ */
+class CouchStandIn {
+public:
+	CouchStandIn(unsigned int port):port(port),srv(NetAddr::create("127.0.0.1", port),1,1) {
+		srv >> [this](HTTPRequest req) {
+			if (req.getMethod() == "POST") {
+				req.readBodyAsync(16*1024*1024, [this](HTTPRequest req) {
+					const auto &buff = req.getUserBuffer();
+					Value body = Value::fromString(std::string_view(reinterpret_cast<const char *>(buff.data()), buff.size()));
+					handle(req, body);
+				});
+			} else {
+				handle(req, Value());
+			}
+		};
+	}
+
+	///Starts the server on first free port
+	static std::unique_ptr<CouchStandIn> start() {
+		for (unsigned int p = firstPort; ; p++) {
+			try {
+				return std::make_unique<CouchStandIn>(p);
+			} catch (const SystemException &) {
+				if (p - firstPort > 100) throw;
+			}
+		}
+	}
+
+	std::string url() const {
+		return "http://127.0.0.1:"+std::to_string(port);
+	}
+
+	///Fails next requests
+	void failNext(int count) {
+		std::lock_guard _(lock);
+		fail = count;
+	}
+	///Fails next documents of _bulk_docs
+	void failNextDocs(int count) {
+		std::lock_guard _(lock);
+		failDocs = count;
+	}
+	///Count of successful _bulk_docs requests
+	int bulkCount() {
+		std::lock_guard _(lock);
+		return bulk;
+	}
+	///Count of stored documents with the prefix
+	std::size_t docCount(const std::string_view &prefix) {
+		std::lock_guard _(lock);
+		std::size_t cnt = 0;
+		for (const auto &[id, doc]: docs) if (std::string_view(id).substr(0,prefix.size()) == prefix) cnt++;
+		return cnt;
+	}
+	///Content of an attachment (undefined - not stored)
+	Value attachment(const std::string &docid, const std::string &name) {
+		std::lock_guard _(lock);
+		auto iter = docs.find(docid);
+		if (iter == docs.end()) return Value();
+		Value a = iter->second["_attachments"][name];
+		if (!a.defined()) return Value();
+		return Value::fromString(map_bin2str(a["data"].getBinary(base64)));
+	}
+
+	///Waits until the condition is met
+	static bool waitFor(const std::function<bool()> &cond, std::chrono::milliseconds timeout = std::chrono::milliseconds(3000)) {
+		auto until = std::chrono::steady_clock::now() + timeout;
+		while (!cond()) {
+			if (std::chrono::steady_clock::now() > until) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return true;
+	}
+
+protected:
+	unsigned int port;
+	MiniHttpServer srv;
+	std::mutex lock;
+	std::map<std::string, Value, std::less<> > docs;
+	int fail = 0;
+	int failDocs = 0;
+	int bulk = 0;
+
+	static void send(HTTPRequest &req, Value data, int code) {
+		std::string txt = data.stringify().str();
+		req.sendResponse("application/json", std::string_view(txt), code);
+	}
+
+	void handle(HTTPRequest &req, Value body) {
+		std::lock_guard _(lock);
+		if (fail > 0) {
+			--fail;
+			send(req, Object{{"error","unavailable"}}, 503);
+			return;
+		}
+		std::string_view path = req.getPath();
+		path = path.substr(0, path.find('?'));
+		if (req.getMethod() == "POST") {
+			if (path == "/_all_docs") {
+				send(req, Object{{"rows", Value(array, body["keys"].begin(), body["keys"].end(), [&](Value k) -> Value {
+					auto iter = docs.find(k.getString());
+					if (iter == docs.end()) return Object{{"key",k},{"error","not_found"}};
+					return Object{{"key",k},{"value",Object{{"rev",iter->second["_rev"]}}}};
+				})}}, 200);
+			} else if (path == "/_bulk_docs") {
+				bulk++;
+				send(req, Value(array, body["docs"].begin(), body["docs"].end(), [&](Value d) -> Value {
+					std::string id = d["_id"].getString();
+					if (d["reject"].defined()) return Object{{"id",id},{"error","forbidden"},{"reason","rejected"}};
+					if (failDocs > 0) {
+						--failDocs;
+						return Object{{"id",id},{"error","internal_error"},{"reason","failed"}};
+					}
+					auto iter = docs.find(id);
+					int revnum = 0;
+					if (iter != docs.end()) {
+						if (iter->second["_rev"] != d["_rev"]) return Object{{"id",id},{"error","conflict"}};
+						revnum = std::stoi(std::string(iter->second["_rev"].getString()));
+					}
+					std::string rev = std::to_string(revnum+1)+"-standin";
+					docs[id] = d.replace("_rev", rev);
+					return Object{{"ok",true},{"id",id},{"rev",rev}};
+				}), 201);
+			} else {
+				send(req, Object{{"error","not_found"}}, 404);
+			}
+			return;
+		}
+		std::string_view docid = path.substr(1);
+		std::string_view attname;
+		auto sep = docid.find('/');
+		if (sep != docid.npos) {
+			attname = docid.substr(sep+1);
+			docid = docid.substr(0, sep);
+		}
+		auto iter = docs.find(docid);
+		if (iter == docs.end()) {
+			send(req, Object{{"error","not_found"}}, 404);
+		} else if (attname.empty()) {
+			send(req, iter->second, 200);
+		} else {
+			Value a = iter->second["_attachments"][attname];
+			if (!a.defined()) send(req, Object{{"error","not_found"}}, 404);
+			else send(req, Value::fromString(map_bin2str(a["data"].getBinary(base64))), 200);
+		}
+	}
+};
+
+int main(int, char **) {
+
+	TestSimple tst;
+	auto psrv = CouchStandIn::start();
+	CouchStandIn &srv = *psrv;
+	auto url = [&]{return srv.url();};
+
+	tst.test("couchdb.coalesce", "1 3 3") >> [&](std::ostream &out) {
+		int b = srv.bulkCount();
+		{
+			DBConn db(url(), "user", "pass", "coalesce", std::chrono::milliseconds(100), 64);
+			db.put("a", 1);
+			db.put("a", 2);
+			db.put("a", 3);
+			db.put("b", 3);
+			CouchStandIn::waitFor([&]{return srv.bulkCount() > b;});
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		out << srv.bulkCount() - b << " " << srv.attachment("cfg.coalesce","a").toString() << " " << srv.attachment("cfg.coalesce","b").toString();
+	};
+
+	tst.test("couchdb.flush_size", "true 3") >> [&](std::ostream &out) {
+		int b = srv.bulkCount();
+		DBConn db(url(), "user", "pass", "flushsize", std::chrono::milliseconds(60000), 3);
+		for (int i = 0; i < 3; i++) {
+			db.put_trade(Object{{"uid",1},{"tradeId",i},{"time",1000*i},{"change",i}});
+		}
+		bool flushed = CouchStandIn::waitFor([&]{return srv.bulkCount() > b;});
+		out << std::boolalpha << flushed << " " << srv.docCount("t.");
+	};
+
+	tst.test("couchdb.get_queued", "42 not_found true 42") >> [&](std::ostream &out) {
+		DBConn db(url(), "user", "pass", "queued", std::chrono::milliseconds(60000), 64);
+		db.put("x", 42);
+		db.put("y", 1);
+		db.erase("y");
+		out << db.get("x").toString() << " ";
+		try {
+			db.get("y");
+			out << "found";
+		} catch (std::exception &e) {
+			out << e.what();
+		}
+		db.flush();
+		out << " " << std::boolalpha << !srv.attachment("cfg.queued","y").defined() << " " << db.get("x").toString();
+	};
+
+	tst.test("couchdb.retry", "failed 7") >> [&](std::ostream &out) {
+		DBConn db(url(), "user", "pass", "retry", std::chrono::milliseconds(50), 64);
+		srv.failNext(1);
+		db.put("r", 7);
+		try {
+			db.flush();
+			out << "written";
+		} catch (std::exception &) {
+			out << "failed";
+		}
+		CouchStandIn::waitFor([&]{return srv.attachment("cfg.retry","r").defined();});
+		out << " " << srv.attachment("cfg.retry","r").toString();
+	};
+
+	tst.test("couchdb.error_per_name", "ok failed ok 1") >> [&](std::ostream &out) {
+		DBConn db(url(), "user", "pass", "pername", std::chrono::milliseconds(60000), 64);
+		db.put("a", 1);
+		srv.failNext(1);
+		try {db.flush();} catch (std::exception &) {}
+		auto check = [&](std::string_view name) {
+			try {
+				db.check_error(name);
+				out << "ok";
+			} catch (std::exception &) {
+				out << "failed";
+			}
+		};
+		check("b");
+		out << " ";
+		check("a");
+		out << " ";
+		check("a");
+		db.flush();
+		out << " " << srv.attachment("cfg.pername","a").toString();
+	};
+
+	tst.test("couchdb.trade_requeue", "failed reported 2") >> [&](std::ostream &out) {
+		DBConn db(url(), "user", "pass", "requeue", std::chrono::milliseconds(50), 64);
+		srv.failNextDocs(1);
+		db.put_trade(Object{{"uid",2},{"tradeId",1},{"time",1000},{"change",1}});
+		db.put_trade(Object{{"uid",2},{"tradeId",2},{"time",2000},{"change",1}});
+		try {
+			db.flush();
+			out << "written";
+		} catch (std::exception &) {
+			out << "failed";
+		}
+		CouchStandIn::waitFor([&]{return srv.docCount("t.") >= 5;});
+		try {
+			db.check_trade_error();
+			out << " ok";
+		} catch (std::exception &) {
+			out << " reported";
+		}
+		out << " " << srv.docCount("t.")-3;
+	};
+
+	tst.test("couchdb.trade_forbidden", "Failed to store trades: rejected 0") >> [&](std::ostream &out) {
+		std::size_t cnt = srv.docCount("t.");
+		DBConn db(url(), "user", "pass", "forbidden", std::chrono::milliseconds(50), 64);
+		db.put_trade(Object{{"uid",3},{"tradeId",1},{"time",1000},{"reject",true}});
+		db.put("c", 1);
+		try {db.flush();} catch (std::exception &) {}
+		try {
+			db.check_error("c");
+			db.check_trade_error();
+		} catch (std::exception &e) {
+			std::string_view msg = e.what();
+			out << msg.substr(0, msg.find(':')+1) << " " << msg.substr(msg.rfind(' ')+1);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		out << " " << srv.docCount("t.")-cnt;
+	};
+
+	tst.test("couchdb.final_flush", "5") >> [&](std::ostream &out) {
+		{
+			DBConn db(url(), "user", "pass", "final", std::chrono::milliseconds(60000), 64);
+			db.put("f", 5);
+			db.flush();
+		}
+		out << srv.attachment("cfg.final","f").toString();
+	};
+
+	return tst.didFail()?1:0;
+}
@@ -0,0 +1,265 @@
+/*
+ * arena.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <vector>
+
+#include "value.h"
+#include "binary.h"
+
+namespace json {
+
+static constexpr std::size_t arenaAlign = alignof(std::max_align_t);
+static constexpr std::size_t maxChunkSize = 4*1024*1024;
+
+static constexpr std::size_t alignSize(std::size_t sz) {
+	return (sz + arenaAlign - 1) & ~(arenaAlign - 1);
+}
+
+struct ArenaChunk {
+	ArenaChunk *next;
+	Arena *owner;
+	char *end;
+
+	char *begin() {return reinterpret_cast<char *>(this)+alignSize(sizeof(ArenaChunk));}
+};
+
+///Maps chunks of orphaned arenas to arenas, so any thread can find owner of a pointer
+/**
+ * Arena is orphaned, when its scope ended while some values allocated inside are still alive.
+ * Such values can be released by any thread. Arenas with living scope are found through
+ * the thread local chain, so the registry (and its lock) is used only when an orphaned arena exists
+ */
+class ArenaRegistry {
+public:
+	void add(ArenaChunk *chunk) {
+		std::unique_lock _(lock);
+		chunks.emplace(chunk->begin(), chunk);
+	}
+	void remove(ArenaChunk *chunk) {
+		std::unique_lock _(lock);
+		chunks.erase(chunk->begin());
+	}
+	void addOrphan() {
+		orphans.fetch_add(1, std::memory_order_release);
+	}
+	void removeOrphan() {
+		orphans.fetch_sub(1, std::memory_order_release);
+	}
+	bool empty() const {
+		return orphans.load(std::memory_order_acquire) == 0;
+	}
+	Arena *find(const void *ptr) const {
+		const char *p = reinterpret_cast<const char *>(ptr);
+		std::shared_lock _(lock);
+		auto iter = chunks.upper_bound(p);
+		if (iter == chunks.begin()) return nullptr;
+		--iter;
+		if (p < iter->second->end) return iter->second->owner;
+		return nullptr;
+	}
+
+protected:
+	mutable std::shared_mutex lock;
+	std::map<const char *, ArenaChunk *> chunks;
+	std::atomic<std::size_t> orphans = 0;
+};
+
+static ArenaRegistry &getRegistry() {
+	static ArenaRegistry registry;
+	return registry;
+}
+
+class Arena {
+public:
+
+	Arena(std::size_t chunkSize, Arena *prev)
+		:prev(prev),nextSize(std::max<std::size_t>(alignSize(chunkSize),4096)) {}
+
+	void *alloc(std::size_t sz) {
+		sz = alignSize(std::max<std::size_t>(sz,1));
+		if (static_cast<std::size_t>(end - pos) < sz) addChunk(sz);
+		void *ret = pos;
+		pos += sz;
+		allocated += sz;
+		live.fetch_add(1, std::memory_order_relaxed);
+		return ret;
+	}
+
+	bool owns(const void *ptr) const {
+		const char *p = reinterpret_cast<const char *>(ptr);
+		for (ArenaChunk *c = chunks; c; c = c->next) {
+			if (p >= c->begin() && p < c->end) return true;
+		}
+		return false;
+	}
+
+	///Called when the scope ends. Registers the arena, if values allocated inside are still alive
+	void closeScope() {
+		if (live.load(std::memory_order_acquire) > 1) {
+			auto &reg = getRegistry();
+			for (ArenaChunk *c = chunks; c; c = c->next) reg.add(c);
+			orphaned = true;
+			reg.addOrphan();
+		}
+		release();
+	}
+
+	///Releases one reference (allocation or the scope). Destroys arena when it was last one
+	void release() {
+		if (live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete this;
+		}
+	}
+
+	Arena * const prev;
+	std::size_t allocated = 0;
+
+protected:
+	///counts living allocations + 1 for the scope
+	std::atomic<std::size_t> live = 1;
+	ArenaChunk *chunks = nullptr;
+	char *pos = nullptr;
+	char *end = nullptr;
+	std::size_t nextSize;
+	bool orphaned = false;
+
+	void addChunk(std::size_t need) {
+		std::size_t sz = std::max(need, nextSize);
+		nextSize = std::min(nextSize * 2, maxChunkSize);
+		void *mem = ::operator new(alignSize(sizeof(ArenaChunk)) + sz);
+		ArenaChunk *c = reinterpret_cast<ArenaChunk *>(mem);
+		c->next = chunks;
+		c->owner = this;
+		c->end = c->begin() + sz;
+		chunks = c;
+		pos = c->begin();
+		end = c->end;
+	}
+
+	~Arena() {
+		auto &reg = getRegistry();
+		while (chunks) {
+			ArenaChunk *c = chunks;
+			chunks = c->next;
+			if (orphaned) reg.remove(c);
+			::operator delete(c);
+		}
+		if (orphaned) reg.removeOrphan();
+	}
+};
+
+static thread_local Arena *curArena = nullptr;
+
+static Arena *findArena(const void *ptr) {
+	for (Arena *a = curArena; a; a = a->prev) {
+		if (a->owns(ptr)) return a;
+	}
+	const auto &reg = getRegistry();
+	if (reg.empty()) return nullptr;
+	return reg.find(ptr);
+}
+
+ArenaScope::ArenaScope(std::size_t chunkSize):arena(new Arena(chunkSize, curArena)) {
+	curArena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+	curArena = arena->prev;
+	arena->closeScope();
+}
+
+std::size_t ArenaScope::allocated() const {
+	return arena->allocated;
+}
+
+void *ArenaScope::alloc(std::size_t sz) {
+	if (curArena) return curArena->alloc(sz);
+	else return ::operator new(sz);
+}
+
+void ArenaScope::dealloc(void *ptr) {
+	if (ptr == nullptr) return;
+	Arena *a = findArena(ptr);
+	if (a) a->release();
+	else ::operator delete(ptr);
+}
+
+bool ArenaScope::isInArena(const void *ptr) {
+	return findArena(ptr) != nullptr;
+}
+
+static Value copyToHeap(const Value &v);
+
+static Value copyContent(const Value &v, bool own) {
+	switch (v.type()) {
+	case array:
+	case object: {
+		std::vector<Value> items;
+		items.reserve(v.size());
+		bool changed = own;
+		for (Value x: v) {
+			Value y = copyToHeap(x);
+			changed = changed || y.getHandle() != x.getHandle();
+			items.push_back(y);
+		}
+		if (!changed) return v;
+		if (items.empty()) return Value(v.type());
+		return Value(v.type(), items.begin(), items.end(), false);
+	}
+	case number:
+		if (!own) return v;
+		if (v.flags() & preciseNumber) return Value::preciseNumber(v.getString());
+		if (v.flags() & numberUnsignedInteger) return Value(v.getUIntLong());
+		if (v.flags() & numberInteger) return Value(v.getIntLong());
+		return Value(v.getNumber());
+	case string:
+		if (!own) return v;
+		if (v.flags() & binaryString) {
+			BinaryEncoding enc = Binary::getEncoding(v.getHandle());
+			return Value(v.getBinary(enc), enc);
+		}
+		return Value(v.getString());
+	default:
+		return v;
+	}
+}
+
+static Value copyToHeap(const Value &v) {
+	PValue h = v.getHandle();
+	const IValue *inner = h->unproxy();
+	if (inner->flags() & userDefined) return v;
+	Value c = copyContent(Value(inner), ArenaScope::isInArena(inner));
+	if (h->flags() & proxy) {
+		if (static_cast<const IValue *>(c.getHandle()) == inner && !ArenaScope::isInArena(h)) return v;
+		return Value(v.getKey(), c);
+	}
+	return c;
+}
+
+Value ArenaScope::promote(const Value &v) {
+	if (curArena == nullptr && getRegistry().empty()) return v;
+	Arena *save = curArena;
+	curArena = nullptr;
+	try {
+		Value r = copyToHeap(v);
+		curArena = save;
+		return r;
+	} catch (...) {
+		curArena = save;
+		throw;
+	}
+}
+
+}
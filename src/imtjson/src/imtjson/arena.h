@@ -0,0 +1,89 @@
+/*
+ * arena.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_IMTJSON_ARENA_H_
+#define SRC_IMTJSON_ARENA_H_
+
+#include <cstddef>
+
+namespace json {
+
+class Value;
+class Arena;
+
+///Scoped monotonic allocation for transient JSON values
+/**
+ * While the object exists, every JSON value created by the current thread is allocated
+ * from a thread local arena. Memory is allocated from large chunks by moving a pointer,
+ * deallocation doesn't return memory back until whole arena is released. Arena is released
+ * when the scope ends and there is no more living value allocated inside.
+ *
+ * Scopes can be nested, the innermost scope is used for allocations.
+ *
+ * Values which should survive the scope should be passed through the function promote(), which
+ * copies the value to the heap. If a value escapes without promotion, it still
+ * stays valid, but it holds whole arena until it is destroyed. Such arena is registered
+ * in a global registry and while any such arena exists, every deallocation looks to the registry
+ * under a lock. Deallocations of threads without escaped values otherwise check only the arenas
+ * of the current thread.
+ *
+ * @code
+ * json::Value result;
+ * {
+ *    json::ArenaScope _;
+ *    json::Object obj;
+ *    ... build large temporary value ...
+ *    storage->store(obj);
+ *    result = json::ArenaScope::promote(obj["summary"]);
+ * }
+ * @endcode
+ *
+ * @note the object must be destroyed by the same thread, which created it. Values allocated
+ * in the arena must not be passed to other threads before the scope ends, unless they are promoted
+ */
+class ArenaScope {
+public:
+	///Opens new scope
+	/**
+	 * @param chunkSize size of the first chunk. Next chunks grows up to 4MB
+	 */
+	explicit ArenaScope(std::size_t chunkSize = 65536);
+	///Closes the scope
+	~ArenaScope();
+
+	ArenaScope(const ArenaScope &) = delete;
+	ArenaScope &operator=(const ArenaScope &) = delete;
+
+	///Copies value to the heap
+	/** Only nodes allocated in an arena are copied, other nodes are shared. If the value
+	 * doesn't contain any node allocated in an arena, it is returned unchanged
+	 *
+	 * @param v value to promote
+	 * @return value which doesn't depend on any arena
+	 */
+	static Value promote(const Value &v);
+
+	///Returns true, when specified pointer has been allocated in an arena
+	static bool isInArena(const void *ptr);
+
+	///Returns count of bytes allocated in the scope
+	std::size_t allocated() const;
+
+	///Allocation function used by default allocator
+	static void *alloc(std::size_t sz);
+	///Deallocation function used by default allocator
+	static void dealloc(void *ptr);
+
+protected:
+	Arena *arena;
+};
+
+}
+
+
+
+#endif /* SRC_IMTJSON_ARENA_H_ */
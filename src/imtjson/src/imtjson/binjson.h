@@ -12,6 +12,7 @@
 #include <unordered_map>
 #include <memory>
 #include "base64.h"
+#include "streams.h"
 
 namespace json {
 
@@ -80,6 +81,14 @@ public:
 
 	///Serialize to binary stream
 	void serialize(const Value &v);
+	///Starts an array of given count of items
+	/**
+	 * Allows to serialize large array without building it in the memory. The header must be
+	 * followed by exactly 'count' items, each serialized by the function serialize()
+	 *
+	 * @param count count of items
+	 */
+	void beginArray(std::size_t count);
 	///Preloads to achieve better compression from the beginning
 	/**
 	 * Adds keys to the dictionary, so the key will be compressed on the first appeareance. You need
@@ -120,6 +129,8 @@ protected:
 	template<typename T>
 	void writePOD(const T &val, unsigned char type);
 
+	void writeBlock(const std::string_view &data);
+
 	void serialize(const IValue *v);
 	void serializeContainer(const IValue *v, unsigned char type);
 	void serializeString(const std::string_view &str, unsigned char type);
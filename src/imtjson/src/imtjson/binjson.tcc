@@ -73,6 +73,11 @@ void BinarySerializer<Fn>::serialize(const Value &v) {
 
 }
 
+template<typename Fn>
+void BinarySerializer<Fn>::beginArray(std::size_t count) {
+	serializeInteger(count, opcode::array);
+}
+
 template<typename Fn>
 void BinarySerializer<Fn>::serialize(const IValue *v) {
 	std::string_view key = v->getMemberName();
@@ -127,7 +132,7 @@ void BinarySerializer<Fn>::serializeString(const std::string_view &str, unsigned
 		return;
 	} else {
 		if (type == opcode::binstring) {
-			for (unsigned char c: str) fn(c);
+			writeBlock(str);
 		} else {
 			if ((flags & compressTokenStrings) && canCompressString(str)) {
 				if (btable == nullptr) {
@@ -138,13 +143,13 @@ void BinarySerializer<Fn>::serializeString(const std::string_view &str, unsigned
 				unsigned char first = btable->table[(unsigned)str[0]] |0x80;
 				fn(first);
 				Base64Encoding::decoderCore(reinterpret_cast<unsigned char *>(buffer.data()), str.substr(1), str.size()-1, *btable);
-				for (auto c: buffer) fn(c);
+				writeBlock(buffer);
 			} else {
 				unsigned char first = str[0];
 				//prevent the first character to be an invalid UTF-8 sequence
 				first = first | ((first & 0x80)>>1);
 				fn(first);
-				for (unsigned char c: str.substr(1)) fn(c);
+				writeBlock(str.substr(1));
 			}
 		}
 	}
@@ -415,8 +420,16 @@ Value BinaryParser<Fn>::parseItem() {
 template<typename Fn>
 template<typename T>
 void BinarySerializer<Fn>::writePOD(const T &val) {
-	auto c = reinterpret_cast<const unsigned char *>(&val);
-	for (unsigned int i = 0; i < sizeof(T); i++) fn(*c++);
+	writeBlock(std::string_view(reinterpret_cast<const char *>(&val), sizeof(T)));
+}
+
+template<typename Fn>
+void BinarySerializer<Fn>::writeBlock(const std::string_view &data) {
+	if constexpr(HasBlockWrite<Fn>::value) {
+		fn.write(data);
+	} else {
+		for (unsigned char c: data) fn(c);
+	}
 }
 
 template<typename Fn>
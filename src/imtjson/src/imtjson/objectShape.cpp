@@ -0,0 +1,283 @@
+/*
+ * objectShape.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "objectShape.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "fnv.h"
+#include "objectValue.h"
+
+namespace json {
+
+class KeyPool {
+public:
+	///Interns the key
+	/**
+	 * @param name name of the key
+	 * @param hash hash of the key
+	 * @param force intern the key even if the pool is full (InternedKey). Such key is never released
+	 * @return interned string, or nullptr, when the pool is full
+	 */
+	const InternedString *intern(const std::string_view &name, std::uint64_t hash, bool force) {
+		{
+			std::shared_lock _(lock);
+			auto iter = keys.find(name);
+			if (iter != keys.end() && (!force || iter->second.forced)) return iter->second.str;
+		}
+		std::unique_lock _(lock);
+		auto iter = keys.find(name);
+		if (iter != keys.end()) {
+			iter->second.forced = iter->second.forced || force;
+			return iter->second.str;
+		}
+		if (!force && keys.size() >= ObjectShape::maxPoolKeys) return nullptr;
+		//allocated directly on heap - must not be placed into an arena
+		void *mem = ::operator new(sizeof(InternedString)+name.size());
+		InternedString *s = reinterpret_cast<InternedString *>(mem);
+		s->hash = hash;
+		s->length = name.size();
+		std::memcpy(s->str, name.data(), name.size());
+		s->str[name.size()] = 0;
+		keys.emplace(s->view(), Entry{s, force});
+		return s;
+	}
+
+	///Releases keys, which are not used by any shape nor by any InternedKey
+	/** @param used keys used by the shapes */
+	void sweep(const std::unordered_set<const InternedString *> &used) {
+		std::unique_lock _(lock);
+		for (auto iter = keys.begin(); iter != keys.end();) {
+			const Entry &e = iter->second;
+			if (!e.forced && used.find(e.str) == used.end()) {
+				const InternedString *str = e.str;
+				iter = keys.erase(iter);
+				::operator delete(const_cast<InternedString *>(str));
+			} else {
+				++iter;
+			}
+		}
+	}
+
+protected:
+	struct Entry {
+		const InternedString *str;
+		///key is used by InternedKey
+		bool forced;
+	};
+	std::shared_mutex lock;
+	std::unordered_map<std::string_view, Entry> keys;
+};
+
+static KeyPool &getKeyPool() {
+	static KeyPool pool;
+	return pool;
+}
+
+///count of shapes which are not referenced
+static std::atomic<std::size_t> unusedShapes = 0;
+
+class ShapeRegistry {
+public:
+	///Finds existing shape, adds reference
+	const ObjectShape *find(const ObjectValue &obj, std::uint64_t seqhash) const {
+		std::shared_lock _(lock);
+		const ObjectShape *s = find_lk(obj, seqhash);
+		if (s) s->addRef();
+		return s;
+	}
+	///Creates new shape, adds reference
+	const ObjectShape *create(const ObjectValue &obj, std::uint64_t seqhash) {
+		//registry is full and nothing can be released
+		if (full.load(std::memory_order_relaxed) && unusedShapes.load(std::memory_order_relaxed) == 0) return nullptr;
+		std::unique_lock _(lock);
+		const ObjectShape *s = find_lk(obj, seqhash);
+		if (s) {
+			s->addRef();
+			return s;
+		}
+		if (shapes.size() >= ObjectShape::maxShapes && !sweep_lk()) return nullptr;
+		std::vector<const InternedString *> keys;
+		//keys are interned under the lock, so the sweep cannot release them
+		if (!internKeys(obj, keys) && (!sweep_lk() || !internKeys(obj, keys))) return nullptr;
+		full.store(false, std::memory_order_relaxed);
+		ObjectShape *ns = new ObjectShape(std::move(keys));
+		shapes.emplace(seqhash, ns);
+		return ns;
+	}
+
+protected:
+	mutable std::shared_mutex lock;
+	std::unordered_multimap<std::uint64_t, const ObjectShape *> shapes;
+	///set when the limit was reached, cleared when a shape is created
+	std::atomic<bool> full = false;
+
+	const ObjectShape *find_lk(const ObjectValue &obj, std::uint64_t seqhash) const {
+		auto rng = shapes.equal_range(seqhash);
+		for (auto iter = rng.first; iter != rng.second; ++iter) {
+			const ObjectShape *s = iter->second;
+			if (s->matches(obj)) return s;
+		}
+		return nullptr;
+	}
+
+	bool internKeys(const ObjectValue &obj, std::vector<const InternedString *> &keys) {
+		KeyPool &pool = getKeyPool();
+		keys.clear();
+		keys.reserve(obj.size());
+		for (const PValue &v: obj) {
+			std::string_view name = v->getMemberName();
+			const InternedString *k = pool.intern(name, InternedKey::calcHash(name), false);
+			if (k == nullptr) return false;
+			keys.push_back(k);
+		}
+		return true;
+	}
+
+	///Releases unreferenced shapes and their keys
+	/**
+	 * Shapes are referenced under the lock of the registry or through a reference
+	 * held by the thread cache, so an unreferenced shape cannot be referenced during the sweep
+	 *
+	 * @retval true some shapes were released
+	 * @retval false nothing released, registry is full
+	 */
+	bool sweep_lk() {
+		full.store(true, std::memory_order_relaxed);
+		if (unusedShapes.load(std::memory_order_acquire) == 0) return false;
+		std::size_t removed = 0;
+		std::unordered_set<const InternedString *> used;
+		for (auto iter = shapes.begin(); iter != shapes.end();) {
+			const ObjectShape *s = iter->second;
+			if (s->refs.load(std::memory_order_acquire) == 0) {
+				iter = shapes.erase(iter);
+				delete s;
+				++removed;
+			} else {
+				used.insert(s->keys.begin(), s->keys.end());
+				++iter;
+			}
+		}
+		unusedShapes.fetch_sub(removed, std::memory_order_relaxed);
+		getKeyPool().sweep(used);
+		return removed != 0;
+	}
+};
+
+static ShapeRegistry &getShapeRegistry() {
+	static ShapeRegistry registry;
+	return registry;
+}
+
+InternedKey::InternedKey(const std::string_view &name)
+	:str(getKeyPool().intern(name, calcHash(name), true)) {}
+
+std::uint64_t InternedKey::calcHash(const std::string_view &name) {
+	std::uint64_t h;
+	FNV1a64 fnv(h);
+	for (char c: name) fnv(c);
+	return h;
+}
+
+ObjectShape::ObjectShape(std::vector<const InternedString *> &&keys):keys(std::move(keys)) {
+	std::size_t sz = 16;
+	while (sz < this->keys.size() * 2) sz <<= 1;
+	mask = sz - 1;
+	slots.resize(sz, 0);
+	for (std::size_t i = 0, cnt = this->keys.size(); i < cnt; i++) {
+		std::size_t pos = this->keys[i]->hash & mask;
+		while (slots[pos]) pos = (pos + 1) & mask;
+		slots[pos] = static_cast<std::uint8_t>(i + 1);
+	}
+}
+
+int ObjectShape::find(const std::string_view &name, std::uint64_t hash) const {
+	for (std::size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		std::uint8_t s = slots[pos];
+		if (!s) return -1;
+		const InternedString *k = keys[s-1];
+		if (k->hash == hash && k->view() == name) return s-1;
+	}
+}
+
+int ObjectShape::find(const InternedKey &key) const {
+	const InternedString *ks = key.get();
+	for (std::size_t pos = ks->hash & mask;; pos = (pos + 1) & mask) {
+		std::uint8_t s = slots[pos];
+		if (!s) return -1;
+		if (keys[s-1] == ks) return s-1;
+	}
+}
+
+void ObjectShape::addRef() const {
+	if (refs.fetch_add(1, std::memory_order_relaxed) == 0) unusedShapes.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ObjectShape::release() const {
+	if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) unusedShapes.fetch_add(1, std::memory_order_release);
+}
+
+bool ObjectShape::matches(const ObjectValue &obj) const {
+	std::size_t cnt = keys.size();
+	if (obj.size() != cnt) return false;
+	std::size_t i = 0;
+	while (i < cnt && keys[i]->view() == obj[i]->getMemberName()) ++i;
+	return i == cnt;
+}
+
+///Recently used shapes of the thread, so the registry is not locked for known shapes
+struct ShapeCacheEntry {
+	std::uint64_t seqhash;
+	const ObjectShape *shape;
+};
+
+static constexpr std::size_t shapeCacheSize = 64;
+
+///Cache holds reference of every cached shape
+struct ShapeCache {
+	ShapeCacheEntry entries[shapeCacheSize] = {};
+
+	~ShapeCache() {
+		for (const auto &e: entries) if (e.shape) e.shape->release();
+	}
+	void set(ShapeCacheEntry &ce, std::uint64_t seqhash, const ObjectShape *s) {
+		s->addRef();
+		if (ce.shape) ce.shape->release();
+		ce = {seqhash, s};
+	}
+};
+
+static thread_local ShapeCache shapeCache;
+
+const ObjectShape *ObjectShape::get(const ObjectValue &obj) {
+	std::size_t cnt = obj.size();
+	if (cnt < minKeys || cnt > maxKeys) return nullptr;
+	std::uint64_t seqhash;
+	FNV1a64 fnv(seqhash);
+	for (const PValue &v: obj) {
+		for (char c: v->getMemberName()) fnv(c);
+		fnv(0);
+	}
+	ShapeCacheEntry &ce = shapeCache.entries[seqhash & (shapeCacheSize-1)];
+	if (ce.shape && ce.seqhash == seqhash && ce.shape->matches(obj)) {
+		ce.shape->addRef();
+		return ce.shape;
+	}
+	ShapeRegistry &reg = getShapeRegistry();
+	const ObjectShape *s = reg.find(obj, seqhash);
+	if (s == nullptr) s = reg.create(obj, seqhash);
+	if (s) shapeCache.set(ce, seqhash, s);
+	return s;
+}
+
+}
@@ -0,0 +1,130 @@
+/*
+ * objectShape.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_IMTJSON_OBJECTSHAPE_H_
+#define SRC_IMTJSON_OBJECTSHAPE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+class ObjectValue;
+
+///Interned string, which is never released
+struct InternedString {
+	std::uint64_t hash;
+	std::size_t length;
+	char str[1];
+
+	std::string_view view() const {return std::string_view(str, length);}
+};
+
+///Key of an object member with precomputed hash
+/**
+ * All instances with the same text share the same interned string, so they can be
+ * compared by pointer. Lookup through this key doesn't need to calculate hash nor
+ * compare strings when the object has a shape assigned
+ *
+ * Intended to be declared as static variable for frequently used keys
+ *
+ * @code
+ * static const json::InternedKey k_price("price");
+ * double price = trade[k_price].getNumber();
+ * @endcode
+ */
+class InternedKey {
+public:
+	explicit InternedKey(const std::string_view &name);
+
+	const InternedString *get() const {return str;}
+	std::uint64_t hash() const {return str->hash;}
+	std::string_view view() const {return str->view();}
+	operator std::string_view() const {return str->view();}
+
+	static std::uint64_t calcHash(const std::string_view &name);
+
+protected:
+	const InternedString *str;
+};
+
+
+///Shape of an object - describes layout of keys
+/**
+ * Objects which contain the same set of keys share the same shape. The shape contains
+ * hash table, which maps the key to the index of the item in the object. Shapes are interned
+ * and shared. Shapes are created only for objects having a reasonable count of keys, also
+ * total count of shapes and total count of interned keys is limited. Once the limit is
+ * reached, shapes which are no longer attached to any object are released along with their
+ * keys, so new key sets get shapes again. While all shapes are in use, new key sets are
+ * searched by binary search.
+ *
+ * Every thread caches recently used shapes, so known shapes are attached without locking.
+ * Cached shapes are kept alive by the cache
+ */
+class ObjectShape {
+public:
+
+	///Minimal count of keys to attach a shape. Smaller objects are searched by binary search
+	/** Trades (5-6 keys) and tickers (4 keys) have shapes */
+	static constexpr std::size_t minKeys = 4;
+	///Maximal count of keys to attach a shape.
+	static constexpr std::size_t maxKeys = 64;
+	///Maximum count of shapes
+	static constexpr std::size_t maxShapes = 4096;
+	///Maximum count of keys interned for shapes (keys of InternedKey are not limited)
+	static constexpr std::size_t maxPoolKeys = 16384;
+
+	///Retrieves shape for the object
+	/**
+	 * @param obj sorted object
+	 * @return pointer to shape, or nullptr if the object cannot have a shape. The shape is
+	 * referenced for the caller, call release() when it is no longer attached
+	 */
+	static const ObjectShape *get(const ObjectValue &obj);
+
+	///Find the index of a key
+	/**
+	 * @param name name of the key
+	 * @param hash hash of the key (see InternedKey::calcHash)
+	 * @return index of the item or -1 if not found
+	 */
+	int find(const std::string_view &name, std::uint64_t hash) const;
+	///Find the index of an interned key
+	int find(const InternedKey &key) const;
+
+	///Returns count of keys
+	std::size_t size() const {return keys.size();}
+	///Returns key at given index
+	const InternedString *key(std::size_t idx) const {return keys[idx];}
+	///Determines, whether the object has exactly the keys of the shape
+	bool matches(const ObjectValue &obj) const;
+
+	///Adds reference
+	void addRef() const;
+	///Releases reference. Unreferenced shape can be released when the registry is full
+	void release() const;
+
+	///Construct the shape, it has one reference
+	ObjectShape(std::vector<const InternedString *> &&keys);
+
+protected:
+	std::vector<const InternedString *> keys;
+	std::vector<std::uint8_t> slots;
+	std::size_t mask;
+	mutable std::atomic<std::size_t> refs = 1;
+
+	friend class ShapeRegistry;
+};
+
+}
+
+
+
+#endif /* SRC_IMTJSON_OBJECTSHAPE_H_ */
@@ -17,11 +17,55 @@ namespace json {
 		return getUndefined();
 	}
 
+	///Marks objects, which cannot have a shape
+	static const char noShapeMark = 0;
+	static const ObjectShape * const noShape = reinterpret_cast<const ObjectShape *>(&noShapeMark);
+
 	RefCntPtr<const IValue>  ObjectValue::member(const std::string_view& name) const {
-		const IValue *r = findSorted(name);
+		const IValue *r;
+		const ObjectShape *s = getShape();
+		if (s) {
+			int idx = s->find(name, InternedKey::calcHash(name));
+			r = idx < 0?nullptr:(const IValue *)operator[](idx);
+		} else {
+			r = findSorted(name);
+		}
 		if (r == nullptr) return getUndefined();
 		else return r;
 	}
+
+	const IValue *ObjectValue::findInterned(const InternedKey &key) const {
+		const ObjectShape *s = getShape();
+		if (s) {
+			int idx = s->find(key);
+			return idx < 0?nullptr:(const IValue *)operator[](idx);
+		} else {
+			return findSorted(key.view());
+		}
+	}
+
+	const ObjectShape *ObjectValue::getShape() const {
+		if (curSize < ObjectShape::minKeys || curSize > ObjectShape::maxKeys) return nullptr;
+		const ObjectShape *s = shape.load(std::memory_order_acquire);
+		if (s == nullptr) {
+			const ObjectShape *ns = ObjectShape::get(*this);
+			if (ns == nullptr) ns = noShape;
+			//other thread could attach the shape meanwhile, keep its shape
+			if (shape.compare_exchange_strong(s, ns, std::memory_order_acq_rel)) s = ns;
+			else if (ns != noShape) ns->release();
+		}
+		return s == noShape?nullptr:s;
+	}
+
+	void ObjectValue::resetShape() {
+		const ObjectShape *s = shape.exchange(nullptr, std::memory_order_acq_rel);
+		if (s != nullptr && s != noShape) s->release();
+	}
+
+	ObjectValue::~ObjectValue() {
+		resetShape();
+	}
+
 	const IValue *ObjectValue::findSorted(const std::string_view &name) const
 	{
 		std::size_t l = 0;
@@ -44,6 +88,7 @@ namespace json {
 
 
 	void ObjectValue::sort() {
+		resetShape();
 		std::stable_sort(begin(),end(),[](const PValue &left, const PValue &right) {
 			return left->getMemberName().compare(right->getMemberName()) < 0;
 		});
@@ -73,6 +118,7 @@ namespace json {
 	ObjectValue& ObjectValue::operator =(const ObjectValue& other) {
 		Container<PValue>::operator =(other);
 		isDiff = other.isDiff;
+		resetShape();
 		return *this;
 	}
 
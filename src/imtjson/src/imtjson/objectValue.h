@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include "basicValues.h"
 #include "container.h"
+#include "objectShape.h"
 
 namespace json {
 
@@ -12,6 +14,7 @@ namespace json {
 	public:
 
 		using Container<PValue>::Container;
+		~ObjectValue();
 
 		virtual std::size_t size() const override;
 		virtual RefCntPtr<const IValue> itemAtIndex(std::size_t index) const override;
@@ -21,6 +24,13 @@ namespace json {
 
 		void sort();
 		const IValue *findSorted(const std::string_view &name) const;
+		///Finds item using interned key
+		const IValue *findInterned(const InternedKey &key) const;
+		///Retrieves shape of the object, attaches the shape on first access
+		/** @return shape or nullptr, if the object has no shape. Don't call this function
+		 * while the object is being built
+		 */
+		const ObjectShape *getShape() const;
 
 		static RefCntPtr<ObjectValue> create(std::size_t capacity);
 		RefCntPtr<ObjectValue> clone() const;
@@ -34,6 +44,12 @@ namespace json {
 
 		ObjectValue &operator=(const ObjectValue &other);
 
+	protected:
+		mutable std::atomic<const ObjectShape *> shape = nullptr;
+
+		///Detaches the shape
+		void resetShape();
+
 	};
 
 
@@ -203,6 +203,7 @@ namespace json {
 	class ParserHelper {
 		template<typename Fn>
 		friend class Parser;
+		friend class SpanParser;
 		static Value numberFromStringRaw(std::string_view str, bool force_double);
 	};
 
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <string_view>
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
 #include <cmath>
 #include <vector>
 #include "value.h"
 #include "binary.h"
 #include "utf8.h"
+#include "streams.h"
 
 namespace json {
 
@@ -20,6 +23,41 @@ namespace json {
 	is emitEscaped*/
 	extern UnicodeFormat defaultUnicodeFormat;
 
+	///Formats unsigned number to the end of the buffer
+	/**
+	 * @param value value to format
+	 * @param end end of the buffer, buffer must have space for 20 characters
+	 * @return pointer to the first character
+	 */
+	inline char *formatUnsigned(ULongInt value, char *end) {
+		static const char digitPairs[] =
+				"00010203040506070809"
+				"10111213141516171819"
+				"20212223242526272829"
+				"30313233343536373839"
+				"40414243444546474849"
+				"50515253545556575859"
+				"60616263646566676869"
+				"70717273747576777879"
+				"80818283848586878889"
+				"90919293949596979899";
+		char *p = end;
+		while (value >= 100) {
+			unsigned int idx = static_cast<unsigned int>(value % 100) * 2;
+			value /= 100;
+			*--p = digitPairs[idx+1];
+			*--p = digitPairs[idx];
+		}
+		if (value >= 10) {
+			unsigned int idx = static_cast<unsigned int>(value) * 2;
+			*--p = digitPairs[idx+1];
+			*--p = digitPairs[idx];
+		} else {
+			*--p = static_cast<char>('0' + value);
+		}
+		return p;
+	}
+
 
 	template<typename Fn>
 	class Serializer {
@@ -47,9 +85,7 @@ namespace json {
 
 		void write(const std::string_view &text);
 		void writeUnsigned(UInt value);
-		void writeUnsignedRec(UInt value);
 		void writeUnsignedLong(ULongInt value);
-		void writeUnsignedRecLong(ULongInt value);
 		void writeUnsigned(UInt value, UInt digits);
 		void writeSigned(Int value);
 		void writeSignedLong(LongInt value);
@@ -193,177 +229,157 @@ namespace json {
 	template<typename Fn>
 	inline void Serializer<Fn>::write(const std::string_view& text)
 	{
-		for (auto &&x : text) target(x);
-	}
-
-	template<typename Fn>
-	inline void Serializer<Fn>::writeUnsignedRec(UInt value) {
-		if (value) {
-			writeUnsignedRec(value / 10);
-			target('0' + (value % 10));
+		if constexpr(HasBlockWrite<Fn>::value) {
+			target.write(text);
+		} else {
+			for (auto &&x : text) target(x);
 		}
 	}
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeUnsigned(UInt value)
 	{
-		if (value) writeUnsignedRec(value);
-		else target('0');
-	}
-	template<typename Fn>
-	inline void Serializer<Fn>::writeUnsignedRecLong(ULongInt value) {
-		if (value) {
-			writeUnsignedRecLong(value / 10);
-			target('0' + (value % 10));
-		}
+		writeUnsignedLong(value);
 	}
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeUnsignedLong(ULongInt value)
 	{
-		if (value) writeUnsignedRecLong(value);
-		else target('0');
+		char buff[24];
+		char *end = buff+sizeof(buff);
+		char *beg = formatUnsigned(value, end);
+		write(std::string_view(beg, end - beg));
 	}
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeUnsigned(UInt value, UInt digits)
 	{
-		if (digits>1) writeUnsigned(value/10,digits-1);
-		target('0'+(value % 10));
+		char buff[24];
+		char *end = buff+sizeof(buff);
+		char *beg = formatUnsigned(value, end);
+		//left padding by zeroes, extra digits are removed
+		while (static_cast<UInt>(end - beg) < digits) *--beg = '0';
+		if (static_cast<UInt>(end - beg) > digits) beg = end - digits;
+		write(std::string_view(beg, end - beg));
 	}
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeSigned(Int value)
 	{
-		if (value < 0) {
-			target('-');
-			writeUnsigned(-value);
-		}
-		else {
-			writeUnsigned(value);
-		}
+		writeSignedLong(value);
 	}
 	template<typename Fn>
 	inline void Serializer<Fn>::writeSignedLong(LongInt value)
 	{
+		char buff[24];
+		char *end = buff+sizeof(buff);
+		char *beg;
 		if (value < 0) {
-			target('-');
-			writeUnsignedLong(-value);
-		}
-		else {
-			writeUnsignedLong(value);
+			beg = formatUnsigned(static_cast<ULongInt>(0) - static_cast<ULongInt>(value), end);
+			*--beg = '-';
+		} else {
+			beg = formatUnsigned(static_cast<ULongInt>(value), end);
 		}
+		write(std::string_view(beg, end - beg));
 	}
 
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeDouble(double value)
 	{
-		static UInt fracMultTable[10] = {
-				1, //0
-				10, //1
-				100, //2
-				1000, //3
-				10000, //4
-				100000, //5
-				1000000, //6
-				10000000, //7
-				100000000, //8
- 				1000000000 //9
-		};
-
 		if (!std::isfinite(value)) {
 			if (value<0) writeString("-∞");
 			else writeString("∞");
 			return;
 		}
-
-		const char *inf = "Inf";
-
-		bool sign = value < 0;
-		UInt precisz = std::min<UInt>(maxPrecisionDigits, 9);
-
-		value = std::abs(value);
-		//calculate exponent of value
-		//123897 -> 5 (1.23897e5)
-		//0.001248 -> 3 (1.248e-3)
-		double fexp = floor(log10(fabs(value)));
-		//if fexp is Inf, handle special case. -Inf means, that value is zero or very nearly zero
-		if (!std::isfinite(fexp)) {
-				if (fexp < 0) {
-					//print zero
-					target('0');
-				} else {
-					//in this case, value is infinity
-					if (sign) target('-');
-					const char *z = inf;
-					while (*z) target(*z++);
-				}
-				return;
+		if (value == 0) {
+			target('0');
+			return;
+		}
+		int precisz = static_cast<int>(std::min<UInt>(maxPrecisionDigits, 9));
+		char sci[32];
+		//one extra position for the carry
+		char digits[24];
+		char *d;
+		int ndigits;
+		int iexp;
+		//splits d.ddde[+-]xx to digits and exponent
+		auto parse = [&](const char *end) {
+			const char *e = std::find<const char *>(sci, end, 'e');
+			d = digits+1;
+			d[0] = sci[0];
+			ndigits = 1;
+			if (sci[1] == '.') {
+				std::copy<const char *>(sci+2, e, d+1);
+				ndigits += e - sci - 2;
 			}
-		//convert it to integer
-		Int iexp = (Int)fexp;
-		//if exponent is in some reasonable range, set iexp to 0
-		if (iexp > -3 && iexp < 8) {
 			iexp = 0;
-		}
-		else {
-			//otherwise normalize number to be between 1 and 10
-			value = value * pow(0.1, iexp);
-		}		
-		double fint;
-		//separate number to integer and fraction
-		double frac = modf(value, &fint);
-		//calculate multiplication of fraction
-		UInt fractMultiply = fracMultTable[precisz];
-		//multiplicate fraction to receive best rounded number to given decimal places
-		double fm = floor(frac * fractMultiply +0.5);
-
-		//convert finteger to integer
-		UInt intp(static_cast<UInt>(fint));
-		//mantisa as integer number (without left zeroes)
-		UInt m(static_cast<UInt>(fm));
-
-
-		//if floating multiplied fraction is above or equal fractMultiply
-		//something very bad happen, probably rounding error happened, so we need adjust
-		if (m >= fractMultiply) {
-			//increment integer part number
-			intp = intp+1;
-			//decrease fm
-			m-=fractMultiply;
-			//if integer part is equal or above 10
-			if (intp >= 10 && iexp) {
-				//set  integer part to 1 (because 9.99999 -> 10 -> 1e1)
-				intp=1;
-				//increase exponent
-				iexp++;
+			for (const char *c = e+2; c != end; ++c) iexp = iexp * 10 + (*c - '0');
+			if (e[1] == '-') iexp = -iexp;
+		};
+		//shortest representation which parses back to the same value
+		parse(std::to_chars(sci, sci+sizeof(sci), std::abs(value), std::chars_format::scientific).ptr);
+
+		//numbers of reasonable size are written without exponent
+		bool fixed = iexp > -3 && iexp < 8;
+		//count of significant digits allowed by the precision
+		int keep = fixed?iexp + 1 + precisz:1 + precisz;
+		if (keep < ndigits) {
+			if (keep > 0 && keep == ndigits-1 && d[keep] == '5') {
+				//shortest representation ends by 5, so direction of the rounding depends on the exact value
+				parse(std::to_chars(sci, sci+sizeof(sci), std::abs(value), std::chars_format::scientific, keep-1).ptr);
+				fixed = iexp > -3 && iexp < 8;
+			} else {
+				bool up = keep >= 0 && d[keep] >= '5';
+				ndigits = std::max(keep, 0);
+				int i = ndigits;
+				while (up && i > 0) {
+					if (d[--i] == '9') d[i] = '0';
+					else {++d[i]; up = false;}
+				}
+				if (up) {
+					//carry over all digits (9.99 -> 10.0)
+					*--d = '1';
+					++ndigits;
+					++iexp;
+					fixed = iexp > -3 && iexp < 8;
+				}
+			}
+			while (ndigits && d[ndigits-1] == '0') --ndigits;
+			if (ndigits == 0) {
+				target('0');
+				return;
 			}
 		}
 
-		//write signum for negative number
-		if (sign) target('-');
-		//write absolute integer number (remove sign)
-		writeUnsigned(intp);
-		UInt digits = precisz;
-
-		if (m) {
-			//put dot
-			target('.');
-			//remove any rightmost zeroes
-			while (m && (m % 10) == 0) {m = m / 10;--digits;}
-			//write final number
-			writeUnsigned(m, digits);
-		}
-		//if exponent is set
-		if (iexp) {
-			//put E
-			target('e');
-			if (iexp > 0) target('+');
-			//write signed exponent
-			writeSigned(iexp);
+		char buff[48];
+		char *p = buff;
+		if (value < 0) *p++ = '-';
+		if (!fixed) {
+			*p++ = d[0];
+			if (ndigits > 1) {
+				*p++ = '.';
+				p = std::copy(d+1, d+ndigits, p);
+			}
+			*p++ = 'e';
+			if (iexp > 0) *p++ = '+';
+			p = std::to_chars(p, buff+sizeof(buff), iexp).ptr;
+		} else if (iexp < 0) {
+			*p++ = '0';
+			*p++ = '.';
+			p = std::fill_n(p, -iexp-1, '0');
+			p = std::copy(d, d+ndigits, p);
+		} else {
+			int intDigits = iexp+1;
+			int n = std::min(intDigits, ndigits);
+			p = std::copy(d, d+n, p);
+			p = std::fill_n(p, intDigits - n, '0');
+			if (ndigits > intDigits) {
+				*p++ = '.';
+				p = std::copy(d+intDigits, d+ndigits, p);
+			}
 		}
-		//all done
+		write(std::string_view(buff, p - buff));
 	}
 
 	static inline void notValidUTF8(const std::string &text) {
@@ -399,14 +415,23 @@ namespace json {
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writePreciseNumber(const std::string_view& text) {
-		for (auto c: text) target(c);
+		write(text);
 	}
 
 	template<typename Fn>
 	inline void Serializer<Fn>::writeStringBody(const std::string_view& text)
 	{
+		//characters which don't need escaping are written as one block
+		auto plain = std::find_if(text.begin(), text.end(), [](char c) {
+			unsigned char u = static_cast<unsigned char>(c);
+			return u < 32 || u >= 128 || c == '"' || c == '\\';
+		});
+		std::size_t plainLen = plain - text.begin();
+		if (plainLen) write(text.substr(0, plainLen));
+		if (plainLen == text.size()) return;
+
 		Utf8ToWide conv;
-		auto strrd = fromString(text);
+		auto strrd = fromString(text.substr(plainLen));
 		conv([&] {
 
 			do {
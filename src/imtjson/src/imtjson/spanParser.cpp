@@ -0,0 +1,350 @@
+/*
+ * spanParser.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "spanParser.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "parser.h"
+#include "utf8.h"
+
+namespace json {
+
+static inline bool isWs(char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+///Skips whitespaces
+static const char *skipWs(const char *p, const char *end) {
+#ifdef __SSE2__
+	//short runs are common in compact documents, check them first
+	if (p < end && !isWs(*p)) return p;
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i tb = _mm_set1_epi8('\t');
+	const __m128i vt = _mm_set1_epi8('\v');
+	const __m128i ff = _mm_set1_epi8('\f');
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_or_si128(
+				_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+							 _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tb))),
+				_mm_or_si128(_mm_cmpeq_epi8(v, vt), _mm_cmpeq_epi8(v, ff)));
+		unsigned int mask = ~static_cast<unsigned int>(_mm_movemask_epi8(m)) & 0xFFFF;
+		if (mask) return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	while (p < end && isWs(*p)) ++p;
+	return p;
+}
+
+///Finds first character which needs special processing in the string - quote, backslash or non-ascii
+static const char *scanString(const char *p, const char *end) {
+#ifdef __SSE2__
+	const __m128i qt = _mm_set1_epi8('"');
+	const __m128i bs = _mm_set1_epi8('\\');
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, qt), _mm_cmpeq_epi8(v, bs)), v);
+		unsigned int mask = _mm_movemask_epi8(m);
+		if (mask) return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	while (p < end) {
+		unsigned char c = static_cast<unsigned char>(*p);
+		if (c == '"' || c == '\\' || c >= 0x80) return p;
+		++p;
+	}
+	return p;
+}
+
+int SpanParser::nextWs() {
+	pos = skipWs(pos, end);
+	return pos == end?-1:*pos;
+}
+
+Value SpanParser::parse() {
+	int c = nextWs();
+	switch (c) {
+		case '{': ++pos; return parseObject();
+		case '[': ++pos; return parseArray();
+		case '"': ++pos; return parseString();
+		case 't': checkString("true"); return Value(true);
+		case 'f': checkString("false"); return Value(false);
+		case 'n': checkString("null"); return Value(nullptr);
+		case -1: throw ParseError("Unexpected end of stream",c);
+		default: if (isDigit(c) || c == '+' || c == '-' || c == '.')
+						return (flags & allowPreciseNumbers)?parsePreciseNumber():parseNumber();
+					else
+						throw ParseError("Unexpected data",c);
+	}
+}
+
+Value SpanParser::parseObject() {
+	std::size_t tmpArrPos = tmpArr.size();
+	int c = nextWs();
+	if (c == '}') {
+		++pos;
+		return Value(object);
+	}
+	std::string keybuff;
+	std::string_view name;
+	bool cont;
+	do {
+		if (c != '"')
+			throw ParseError("Expected a key (string)", c);
+		++pos;
+		try {
+			name = readString();
+			//slow strings are stored in tmpstr, which can be overwritten by the value
+			if (name.data() == tmpstr.data()) {
+				keybuff = name;
+				name = keybuff;
+			}
+			c = nextWs();
+			if (c != ':')
+				throw ParseError("Expected ':'", c);
+			++pos;
+			Value v = parse();
+			tmpArr.push_back(Value(name,v));
+		}
+		catch (ParseError &e) {
+			e.addContext(name);
+			throw;
+		}
+		c = nextWs();
+		if (c != -1) ++pos;
+		if (c == '}') {
+			cont = false;
+		}
+		else if (c == ',') {
+			cont = true;
+			c = nextWs();
+		}
+		else {
+			throw ParseError("Expected ',' or '}'", c);
+		}
+	} while (cont);
+	auto len = tmpArr.size() - tmpArrPos;
+	Value res(object, tmpArr.begin()+tmpArrPos, tmpArr.end(), true);
+	if (((flags & allowDupKeys) == 0) && (res.size() != len)) {
+		throw ParseError("Duplicated keys",c);
+	}
+	tmpArr.resize(tmpArrPos);
+	return res;
+}
+
+Value SpanParser::parseArray() {
+	std::size_t tmpArrPos = tmpArr.size();
+	int c = nextWs();
+	if (c == ']') {
+		++pos;
+		return Value(array);
+	}
+	bool cont;
+	do {
+		try {
+			tmpArr.push_back(parse());
+			c = nextWs();
+			if (c != -1) ++pos;
+			if (c == ']') {
+				cont = false;
+			}
+			else if (c == ',') {
+				cont = true;
+			}
+			else {
+				throw ParseError("Expected ',' or ']'", c);
+			}
+		}
+		catch (ParseError &e) {
+			std::ostringstream buff;
+			buff << "[" << (tmpArr.size()-tmpArrPos) << "]";
+			e.addContext(buff.str());
+			throw;
+		}
+	} while (cont);
+	Value res(array, tmpArr.begin()+tmpArrPos, tmpArr.end(), true);
+	tmpArr.resize(tmpArrPos);
+	return res;
+}
+
+void SpanParser::checkString(const std::string_view &str) {
+	for (char x: str) {
+		int c = readChar();
+		if (c != x) throw ParseError("Unknown keyword", c);
+	}
+}
+
+Value SpanParser::parseString() {
+	std::string_view str = readString();
+	if (str == "∞") return Value(std::numeric_limits<double>::infinity());
+	else if (str == "-∞") return Value(-std::numeric_limits<double>::infinity());
+	else return Value(str);
+}
+
+std::string_view SpanParser::readString() {
+	const char *start = pos;
+	const char *p = scanString(pos, end);
+	if (p != end && *p == '"') {
+		pos = p+1;
+		return std::string_view(start, p - start);
+	}
+	tmpstr.assign(start, p);
+	pos = p;
+	readStringSlow();
+	return tmpstr;
+}
+
+///Continues reading of the string, which contains escape sequences or non-ascii characters
+/** It follows rules of the streaming parser, so result is the same */
+void SpanParser::readStringSlow() {
+	Utf8ToWide conv;
+	conv([&]{
+		do {
+			int c = readChar();
+			if (c == -1) {
+				throw ParseError("Unexpected end of file", c);
+			}
+			else if (c == '"') {
+				return -1;
+			}else if (c == '\\') {
+				c = readChar();
+				switch (c) {
+				case '"':
+				case '\\':
+				case '/': tmpstr.push_back(c); break;
+				case 'b': tmpstr.push_back('\b'); break;
+				case 'f': tmpstr.push_back('\f'); break;
+				case 'n': tmpstr.push_back('\n'); break;
+				case 'r': tmpstr.push_back('\r'); break;
+				case 't': tmpstr.push_back('\t'); break;
+				case 'u': parseUnicode();break;
+				default:
+					throw ParseError("Unexpected escape sequence in the string", c);
+				}
+			}
+			else {
+				return c;
+			}
+		} while (true);
+	},[&](int w) {
+		storeUnicode(w);
+	});
+}
+
+void SpanParser::parseUnicode() {
+	UInt uchar = 0;
+	for (int i = 0; i < 4; i++) {
+		int c = readChar();
+		uchar *= 16;
+		if (isDigit(c)) uchar += (c - '0');
+		else if (c >= 'A' && c <= 'F') uchar += (c - 'A' + 10);
+		else if (c >= 'a' && c <= 'f') uchar += (c - 'a' + 10);
+		else throw ParseError("Expected '0'...'9' or 'A'...'F' after the escape sequence \\u", c);
+	}
+	storeUnicode(uchar);
+}
+
+void SpanParser::storeUnicode(UInt uchar) {
+	WideToUtf8 conv;
+	conv(oneCharStream((int)uchar),[&](char c){tmpstr.push_back(c);});
+}
+
+Value SpanParser::parseNumber() {
+	const char *start = pos;
+	bool isneg = false;
+	if (*pos == '-' || *pos == '+') {
+		isneg = *pos == '-';
+		++pos;
+	}
+	if (pos == end || (!isDigit(*pos) && *pos != '.'))
+		throw ParseError("Expected '0'...'9', '.', '+' or '-'", pos == end?-1:*pos);
+
+	const UInt overflowDetection = ((UInt)-1) / 10;
+	UInt intpart = 0;
+	bool isfloat = false;
+	while (pos != end && isDigit(*pos)) {
+		if (!isfloat) {
+			UInt nextVal = intpart * 10 + (*pos - '0');
+			if (intpart > overflowDetection || nextVal < intpart) isfloat = true;
+			else intpart = nextVal;
+		}
+		++pos;
+	}
+	if (pos != end && *pos == '.') {
+		++pos;
+		if (pos == end || !isDigit(*pos))
+			throw ParseError("Expected '0'...'9' after '.'", pos == end?-1:*pos);
+		while (pos != end && isDigit(*pos)) ++pos;
+		isfloat = true;
+	}
+	if (pos != end && (*pos == 'e' || *pos == 'E')) {
+		++pos;
+		if (pos != end && (*pos == '+' || *pos == '-')) ++pos;
+		if (pos == end || !isDigit(*pos))
+			throw ParseError("Expected '0'...'9' after 'E'", pos == end?-1:*pos);
+		while (pos != end && isDigit(*pos)) ++pos;
+		isfloat = true;
+	}
+	if (!isfloat) {
+		if (isneg) {
+			if (intpart & (UInt(1) << (sizeof(intpart) * 8 - 1))) {
+				return Value(-(double)intpart);
+			} else {
+				return Value(-intptr_t(intpart));
+			}
+		} else {
+			return Value(intpart);
+		}
+	}
+	if (*start == '+') ++start;
+	double d = 0;
+	auto r = std::from_chars(start, pos, d);
+	if (r.ec != std::errc()) {
+		//out of range - let strtod to return infinity or zero
+		d = std::strtod(std::string(start, pos).c_str(), nullptr);
+	}
+	return Value(d);
+}
+
+Value SpanParser::parsePreciseNumber() {
+	const char *start = pos;
+	bool hint_is_float = false;
+	if (*pos == '+' || *pos == '-') ++pos;
+	if (pos == end || !isDigit(*pos)) throw ParseError("Expected a number", pos == end?-1:*pos);
+	while (pos != end && isDigit(*pos)) ++pos;
+	if (pos != end && *pos == '.') {
+		hint_is_float = true;
+		++pos;
+		while (pos != end && isDigit(*pos)) ++pos;
+	}
+	if (pos != end && (*pos == 'e' || *pos == 'E')) {
+		hint_is_float = true;
+		++pos;
+		if (pos != end && (*pos == '+' || *pos == '-')) ++pos;
+		if (pos == end || !isDigit(*pos)) throw ParseError("Expected a number", pos == end?-1:*pos);
+		while (pos != end && isDigit(*pos)) ++pos;
+	}
+	return ParserHelper::numberFromStringRaw(std::string_view(start, pos - start), hint_is_float);
+}
+
+}
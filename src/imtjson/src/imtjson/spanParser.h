@@ -0,0 +1,82 @@
+/*
+ * spanParser.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_IMTJSON_SPANPARSER_H_
+#define SRC_IMTJSON_SPANPARSER_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "value.h"
+
+namespace json {
+
+///Parses JSON from a contiguous block of memory
+/**
+ * It is faster version of the Parser, because it can access the whole document directly.
+ * Whitespaces and strings are scanned in blocks (using SSE2 if available). Strings which don't contain
+ * escape sequences neither non-ascii characters are not copied to a temporary buffer. Floating point
+ * numbers are converted using correctly rounded conversion.
+ *
+ * Parsing stops after first complete value. Use getPos() to find out, how many bytes were processed
+ */
+class SpanParser {
+public:
+
+	typedef std::size_t Flags;
+
+	///Allows duplicated keys in object
+	static const Flags allowDupKeys = 1;
+	///Parse numbers as precise
+	static const Flags allowPreciseNumbers = 2;
+
+	SpanParser(const std::string_view &text, Flags flags = 0)
+		:beg(text.data()),pos(text.data()),end(text.data()+text.size()),flags(flags) {}
+
+	///Parses the value
+	Value parse();
+
+	///Returns count of bytes processed
+	std::size_t getPos() const {return pos - beg;}
+
+protected:
+
+	const char *beg;
+	const char *pos;
+	const char *end;
+	Flags flags;
+
+	///Temporary string for strings containing escape sequences
+	std::string tmpstr;
+	///Temporary array - to keep allocated memory
+	std::vector<Value> tmpArr;
+
+	int nextWs();
+	Value parseObject();
+	Value parseArray();
+	Value parseNumber();
+	Value parsePreciseNumber();
+	Value parseString();
+	void checkString(const std::string_view &str);
+
+	///Reads string, opening quote must be already processed
+	/** @return view to the string. It can point to the source text, or to the
+	 * tmpstr. In the second case, the view is valid until the next call.
+	 */
+	std::string_view readString();
+	void readStringSlow();
+	void parseUnicode();
+	void storeUnicode(UInt uchar);
+	int readChar() {return pos == end?-1:static_cast<char>(*pos++);}
+};
+
+}
+
+
+
+#endif /* SRC_IMTJSON_SPANPARSER_H_ */
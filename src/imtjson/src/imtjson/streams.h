@@ -8,7 +8,11 @@
 #ifndef SRC_IMTJSON_STREAMS_H_
 #define SRC_IMTJSON_STREAMS_H_
 
+#include <algorithm>
 #include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 
 #pragma once
@@ -78,6 +82,9 @@ public:
 	void operator()(char c) const {
 		stream.put(c);
 	}
+	void write(const std::string_view &data) const {
+		stream.write(data.data(), data.size());
+	}
 private:
 	std::ostream &stream;
 };
@@ -108,6 +115,95 @@ inline OneCharStream oneCharStream(int item) {
 	return OneCharStream(item);
 }
 
+///Detects, whether the output function is also able to write whole blocks
+/**
+ * The output function has block write, when it has method write(std::string_view). Serializers
+ * use block write to emit strings and numbers in one call instead of writing them character
+ * by character
+ */
+template<typename Fn, typename = void>
+struct HasBlockWrite: std::false_type {};
+
+template<typename Fn>
+struct HasBlockWrite<Fn, std::void_t<decltype(std::declval<Fn &>().write(std::string_view()))> >: std::true_type {};
+
+///Collects output of the serializer to blocks
+/**
+ * Calling a stream or a socket for every character is slow. The buffer collects characters and
+ * passes whole blocks to the output function.
+ *
+ * @tparam Out function which accepts std::string_view
+ *
+ * @code
+ * OutputBuffer buff([&](std::string_view data){f.write(data.data(), data.size());});
+ * v.serializeBinary(buff.sink(), json::compressKeys);
+ * buff.flush();
+ * @endcode
+ *
+ * @note the buffer is flushed by the destructor as well, however errors reported by
+ * the output function are lost there. Call flush() explicitly
+ */
+template<typename Out>
+class OutputBuffer {
+public:
+
+	///Function passed to the serializer, it only references the buffer, so it can be copied
+	class Sink {
+	public:
+		Sink(OutputBuffer &owner):owner(&owner) {}
+		void operator()(char c) const {owner->put(c);}
+		void write(const std::string_view &data) const {owner->write(data);}
+	protected:
+		OutputBuffer *owner;
+	};
+
+	OutputBuffer(Out &&out, std::size_t size = 65536)
+		:out(std::forward<Out>(out)) {
+		buffer.resize(size);
+	}
+	~OutputBuffer() {
+		try {
+			flush();
+		} catch (...) {
+
+		}
+	}
+	OutputBuffer(const OutputBuffer &) = delete;
+	OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+	void put(char c) {
+		if (pos == buffer.size()) flush();
+		buffer[pos++] = c;
+	}
+	void write(const std::string_view &data) {
+		if (data.size() > buffer.size() - pos) {
+			flush();
+			//large blocks are passed directly
+			if (data.size() >= buffer.size()) {
+				out(data);
+				return;
+			}
+		}
+		std::copy(data.begin(), data.end(), buffer.begin()+pos);
+		pos += data.size();
+	}
+	///Passes collected data to the output function
+	void flush() {
+		if (pos) {
+			std::size_t sz = pos;
+			pos = 0;
+			out(std::string_view(buffer.data(), sz));
+		}
+	}
+
+	Sink sink() {return Sink(*this);}
+
+protected:
+	Out out;
+	std::vector<char> buffer;
+	std::size_t pos = 0;
+};
+
 template<typename T>
 class WriteCounter {
 public:
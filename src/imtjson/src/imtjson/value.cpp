@@ -2,6 +2,7 @@
 #include "value.h"
 
 #include <numeric>
+#include <typeinfo>
 
 #include "basicValues.h"
 #include "arrayValue.h"
@@ -16,6 +17,9 @@
 #include "binjson.tcc"
 #include "path.h"
 #include "operations.h"
+#include "arena.h"
+#include "objectShape.h"
+#include "spanParser.h"
 
 namespace json {
 
@@ -82,13 +86,8 @@ namespace json {
 
 	Value Value::fromString(const std::string_view& string)
 	{
-		std::size_t pos = 0;
-		return parse([&pos,&string]() -> char {
-			if (pos == string.size())
-				return -1;
-			else
-				return string[pos++];
-		});
+		SpanParser parser(string, enableParsePreciseNumbers?SpanParser::allowPreciseNumbers:0);
+		return parser.parse();
 	}
 	Value Value::fromString(const BinaryView& string)
 	{
@@ -109,36 +108,39 @@ namespace json {
 		});
 	}
 
+	namespace {
+		class StringSink {
+		public:
+			StringSink(std::string &buff):buff(buff) {}
+			void operator()(char c) {buff.push_back(c);}
+			void write(const std::string_view &data) {buff.append(data);}
+		protected:
+			std::string &buff;
+		};
+	}
+
 	String Value::stringify() const
 	{
 		std::string buff;
-		serialize([&](char c) {
-			buff.push_back(c);
-		});
+		serialize(StringSink(buff));
 		return String(buff);
 	}
 
 	String Value::stringify(UnicodeFormat format) const
 	{
 		std::string buff;
-		serialize(format,[&](char c) {
-			buff.push_back(c);
-		});
+		serialize(format,StringSink(buff));
 		return String(buff);
 	}
 
 	void Value::toStream(std::ostream & output) const
 	{
-		serialize([&](char c) {
-			output.put(c);
-		});
+		serialize(json::toStream(output));
 	}
 
 	void Value::toStream(UnicodeFormat format, std::ostream & output) const
 	{
-		serialize(format, [&](char c) {
-			output.put(c);
-		});
+		serialize(format, json::toStream(output));
 	}
 
 	template<typename T>
@@ -330,6 +332,15 @@ namespace json {
 	Value::Value(const String& value):v(value.getHandle()) {
 	}
 
+	Value Value::operator[](const InternedKey &key) const {
+		const IValue *p = v->unproxy();
+		if (typeid(*p) == typeid(ObjectValue)) {
+			const IValue *r = static_cast<const ObjectValue *>(p)->findInterned(key);
+			if (r) return r; else return Value();
+		}
+		return v->member(key.view());
+	}
+
 	Value Value::reverse() const {
 		Array out;
 		for (UInt i = size(); i > 0; i--) {
@@ -350,8 +361,8 @@ namespace json {
 
 
 	static Allocator defaultAllocator = {
-		&::operator new,
-		&::operator delete
+		&ArenaScope::alloc,
+		&ArenaScope::dealloc
 	};
 
 
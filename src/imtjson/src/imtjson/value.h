@@ -15,6 +15,7 @@ namespace json {
 	class String;
 	class Binary;
 	class ValueBuilder;
+	class InternedKey;
 	struct Allocator;
 	template<typename T> class ConvValueAs;
 	template<typename T> class ConvValueFrom;
@@ -350,6 +351,14 @@ namespace json {
 		 * @return If the object has such an item, it is returned. Otherwise, undefined is returned
 		 */
 		Value operator[](const std::string_view &key) const { return v->member(key); }
+		///Access to an item stored in the object using interned key
+		/**
+		 * @param key the key to retrieve.
+		 * @return If the object has such an item, it is returned. Otherwise, undefined is returned
+		 *
+		 * @note lookup is performed in constant time, when the object has a shape
+		 */
+		Value operator[](const InternedKey &key) const;
 		///Access to an item in a container identified using the Path object
 		/**
 		 * @param path Instance o Path which should refer a desired item
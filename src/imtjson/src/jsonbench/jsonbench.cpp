@@ -0,0 +1,106 @@
+// jsonbench.cpp : Measures speed of the serializers
+//
+// Serializes a document shaped as a state of the trader (minute chart and trades)
+// and reports throughput in MB/s. Optional arguments: count of chart points, count of trades
+//
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include "../imtjson/json.h"
+#include "../imtjson/binjson.tcc"
+
+using namespace json;
+
+static Value createState(std::size_t chartPoints, std::size_t tradeCount) {
+	std::mt19937_64 rnd(1);
+	std::normal_distribution<double> noise(0, 0.001);
+	std::uint64_t tm = 1600000000000ULL;
+	double price = 25000.0;
+	Array chart;
+	chart.reserve(chartPoints);
+	for (std::size_t i = 0; i < chartPoints; i++) {
+		price *= std::exp(noise(rnd));
+		chart.push_back(Object({
+			{"time", tm},
+			{"ask", price*1.0001},
+			{"bid", price*0.9999},
+			{"last", price}
+		}));
+		tm += 60000;
+	}
+	Array trades;
+	trades.reserve(tradeCount);
+	double pos = 1;
+	for (std::size_t i = 0; i < tradeCount; i++) {
+		price *= std::exp(noise(rnd)*5);
+		double size = std::round(noise(rnd)*1e5)/1e4;
+		pos += size;
+		trades.push_back(Object({
+			{"id", "T"+std::to_string(i)},
+			{"time", tm - (tradeCount-i)*300000},
+			{"price", price},
+			{"size", size},
+			{"eff_price", price},
+			{"eff_size", size},
+			{"bal", pos},
+			{"np", noise(rnd)},
+			{"ap", noise(rnd)},
+			{"p0", price*0.98},
+			{"man", false}
+		}));
+	}
+	return Object({
+		{"chart", chart},
+		{"trades", trades},
+		{"internal_balance", 1.25},
+		{"lastTradeId", "T"+std::to_string(tradeCount)}
+	});
+}
+
+template<typename Fn>
+static void measure(const char *name, Fn &&fn) {
+	using Clock = std::chrono::steady_clock;
+	const int rounds = 5;
+	std::size_t bytes = 0;
+	auto start = Clock::now();
+	for (int i = 0; i < rounds; i++) bytes += fn();
+	double sec = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << name << ": " << bytes/rounds << " bytes, "
+			<< sec*1000.0/rounds << " ms, "
+			<< bytes/sec/(1024*1024) << " MB/s" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t chartPoints = argc > 1?std::strtoul(argv[1], nullptr, 10):14400;
+	std::size_t tradeCount = argc > 2?std::strtoul(argv[2], nullptr, 10):50000;
+	Value state = createState(chartPoints, tradeCount);
+	std::string out;
+
+	measure("text, character output", [&]{
+		out.clear();
+		state.serialize([&](char c){out.push_back(c);});
+		return out.size();
+	});
+	measure("text, block output", [&]{
+		out.clear();
+		OutputBuffer buff([&](std::string_view data){out.append(data);});
+		state.serialize(buff.sink());
+		buff.flush();
+		return out.size();
+	});
+	measure("binary, character output", [&]{
+		out.clear();
+		state.serializeBinary([&](char c){out.push_back(c);}, compressKeys);
+		return out.size();
+	});
+	measure("binary, block output", [&]{
+		out.clear();
+		OutputBuffer buff([&](std::string_view data){out.append(data);});
+		state.serializeBinary(buff.sink(), compressKeys);
+		buff.flush();
+		return out.size();
+	});
+	return 0;
+}
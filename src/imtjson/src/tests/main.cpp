@@ -13,6 +13,7 @@
 
 #include <memory>
 #include <fstream>
+#include <thread>
 #include "../imtjson/json.h"
 #include "../imtjson/compress.tcc"
 #include "../imtjson/basicValues.h"
@@ -22,6 +23,10 @@
 #include "../imtjson/streams.h"
 #include "../imtjson/valueref.h"
 #include "../imtjson/wrap.h"
+#include "../imtjson/arena.h"
+#include "../imtjson/objectShape.h"
+#include "../imtjson/objectValue.h"
+#include "../imtjson/spanParser.h"
 #include "testClass.h"
 #include <random>
 
@@ -263,6 +268,40 @@ int testMain(bool showOutput) {
 		Value v = -0.000000075;
 		v.toStream(out);
 	};
+	tst.test("Serialize.largeNumber", "12502415.9656") >> [](std::ostream &out) {
+		Value v = 12502415.9656;
+		v.toStream(out);
+	};
+	tst.test("Serialize.roundedNumber", "0.3333") >> [](std::ostream &out) {
+		Value v = 1.0/3.0;
+		v.toStream(out);
+	};
+	tst.test("Serialize.roundCarry", "1e+8") >> [](std::ostream &out) {
+		Value v = 99999999.99999;
+		v.toStream(out);
+	};
+	tst.test("Serialize.integers", "[0,9,10,99,100,-12345,18446744073709551615,-9223372036854775808]") >> [](std::ostream &out) {
+		Value v = {0,9,10,99,100,-12345,std::numeric_limits<ULongInt>::max(),std::numeric_limits<LongInt>::min()};
+		v.toStream(out);
+	};
+	tst.test("Serialize.outputBuffer", "ok") >> [](std::ostream &out) {
+		Value v = Value::fromString("{\"a\":[1,2.5,\"text\",\"esc\\\"aped\\n\",\"\\u010d\"],\"b\":{\"c\":null,\"d\":true}}");
+		std::string blocks;
+		std::size_t calls = 0;
+		{
+			OutputBuffer buff([&](std::string_view data){blocks.append(data);++calls;}, 8);
+			v.serialize(buff.sink());
+		}
+		std::string bin1, bin2;
+		{
+			OutputBuffer buff([&](std::string_view data){bin1.append(data);});
+			v.serializeBinary(buff.sink(), compressKeys);
+			buff.flush();
+		}
+		v.serializeBinary([&](char c){bin2.push_back(c);}, compressKeys);
+		if (blocks == v.stringify().str() && bin1 == bin2 && calls > 1) out << "ok";
+		else out << blocks << " " << calls;
+	};
 	tst.test("Serialize.random_float_numbers", "ok") >> [](std::ostream &out) {
 		json::maxPrecisionDigits = 6;
 	    std::random_device rd;
@@ -1444,6 +1483,76 @@ tst.test("Object.enumItems", "age:19,data:[90,60,90],frobla:12.3,kabrt:289,name:
 	//runRpcTests(tst);
 
 
+	tst.test("arena.promote", "true false {\"a\":[1,-2,3.5],\"b\":\"text\"} {\"x\":42}") >> [](std::ostream &out) {
+		Value promoted, escaped;
+		{
+			ArenaScope arena;
+			Value v = Object{{"a",{1,-2,3.5}},{"b","text"}};
+			promoted = ArenaScope::promote(v);
+			escaped = Object{{"x",42}};
+			out << std::boolalpha << ArenaScope::isInArena(v.getHandle()) << " " << ArenaScope::isInArena(promoted.getHandle()) << " ";
+		}
+		out << promoted.stringify() << " " << escaped.stringify();
+	};
+	tst.test("arena.orphan", "false true {\"x\":[1,2,3]} false") >> [](std::ostream &out) {
+		Value escaped;
+		{
+			ArenaScope arena;
+			escaped = Object{{"x",{1,2,3}}};
+		}
+		Value heap = Object{{"y",1}};
+		out << std::boolalpha << ArenaScope::isInArena(heap.getHandle()) << " " << ArenaScope::isInArena(escaped.getHandle()) << " ";
+		const IValue *h = escaped.getHandle();
+		std::thread thr([v = std::move(escaped), &out]() mutable {
+			out << v.stringify() << " ";
+			v = Value();
+		});
+		thr.join();
+		out << ArenaScope::isInArena(h);
+	};
+	tst.test("shape.lookup", "3 3 8 8 <undefined> true") >> [](std::ostream &out) {
+		static const InternedKey k_c("c"), k_h("h"), k_x("x");
+		Value v1 = Value::fromString(R"({"a":1,"b":2,"c":3,"d":4,"e":5,"f":6,"g":7,"h":8})");
+		Value v2 = Value::fromString(R"({"h":8,"g":7,"f":6,"e":5,"d":4,"c":3,"b":2,"a":1})");
+		out << v1[k_c].getUInt() << " " << v2["c"].getUInt() << " " << v1["h"].getUInt() << " " << v2[k_h].getUInt() << " " << v1[k_x].toString() << " " << (v2[k_h].getKey() == "h"?"true":"false");
+	};
+	tst.test("shape.small", "true false 2 5") >> [](std::ostream &out) {
+		static const InternedKey k_b("b"), k_e("e");
+		auto hasShape = [](const Value &v) {
+			return static_cast<const ObjectValue *>(static_cast<const IValue *>(v.getHandle()))->getShape() != nullptr;
+		};
+		Value v1 = Object{{"a",1},{"b",2},{"c",3},{"d",4},{"e",5}};
+		Value v2 = Object{{"a",1},{"b",2},{"c",3}};
+		out << std::boolalpha << hasShape(v1) << " " << hasShape(v2) << " " << v1[k_b].getUInt() << " " << v1[k_e].getUInt();
+	};
+	tst.test("shape.recover", "false true 7") >> [](std::ostream &out) {
+		auto hasShape = [](const Value &v) {
+			return static_cast<const ObjectValue *>(static_cast<const IValue *>(v.getHandle()))->getShape() != nullptr;
+		};
+		auto make = [](const std::string &prefix) {
+			Object o;
+			for (int k = 0; k < 4; k++) o.set(prefix+"_"+std::to_string(k), k+4);
+			return Value(o);
+		};
+		std::size_t cnt = ObjectShape::maxShapes + ObjectShape::maxPoolKeys/4;
+		std::vector<Value> objs;
+		objs.reserve(cnt);
+		for (std::size_t i = 0; i < cnt; i++) {
+			objs.push_back(make("fill"+std::to_string(i)));
+			hasShape(objs.back());
+		}
+		out << std::boolalpha << hasShape(make("full")) << " ";
+		//objects are released, so their shapes can be released too
+		objs.clear();
+		Value v = make("recovered");
+		out << hasShape(v) << " " << v["recovered_3"].getUInt();
+	};
+	tst.test("spanparser.basic", "[\"abc\",\"a\\\"b\",\"aAb\",-12,1.5e-7,{\"k\":true}] 59") >> [](std::ostream &out) {
+		std::string_view txt = R"(  [ "abc", "a\"b" , "a\u0041b" , -12, 0.15e-6 , {"k":true}] trailing)";
+		SpanParser p(txt);
+		Value v = p.parse();
+		out << v.stringify() << " " << p.getPos();
+	};
 	tst.test("binary.basic", "ok") >> [](std::ostream &out) {
 		if (binTest("src/tests/test.json")) out << "ok"; else out << "not same";
 	};
@@ -15,12 +15,14 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <imtjson/parser.h>
+#include <imtjson/serializer.h>
 #include <poll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <shared/filesystem.h>
 
 #include <cstring>
+#include <optional>
 #include <sstream>
 #include <thread>
 
@@ -110,6 +112,60 @@ AbstractExtern::Pipe AbstractExtern::makePipe() {
 
 
 
+static void waitForRead(int fd, int timeout) {
+	struct pollfd fds = {fd, POLLIN|POLLHUP,0};
+	int r = poll(&fds, 1, timeout);
+	if (r != 1) throw std::runtime_error("Broker read timeout");
+}
+static void waitForWrite(int fd, int timeout) {
+	struct pollfd fds = {fd, POLLOUT,0};
+	int r = poll(&fds, 1, timeout);
+	if (r != 1) throw std::runtime_error("Broker write timeout");
+}
+
+
+class AbstractExtern::Reader {
+public:
+	Reader (FD &fd, int timeout):fd(fd),timeout(timeout) {}
+	std::string_view read() {
+		if (buff.empty()) {
+			return readBuff();
+		}
+		else {
+			auto x = buff;
+			buff = std::string_view();
+			return x;
+		}
+	}
+	void putback(std::string_view data) {
+		buff = data;
+	}
+	bool hasData() const {
+		return !buff.empty();
+	}
+
+	int operator()() {
+		auto d = read();
+		if (d.empty()) return -1;
+		char z = d[0];
+		putback(d.substr(1));
+		return z;
+	}
+
+protected:
+	std::string_view buff;
+	char data[16384];
+	FD &fd;
+	int timeout;
+
+	std::string_view readBuff() {
+		waitForRead(fd,timeout);
+		int i = ::read(fd, data, sizeof(data));
+		if (i < 1) return std::string_view();
+		else return std::string_view(data, i);
+	}
+};
+
 void AbstractExtern::spawn() {
 	Sync _(lock);
 	using ondra_shared::Handle;
@@ -118,6 +174,15 @@ void AbstractExtern::spawn() {
 	//collect any zombie
 	waitpid(-1,&status,WNOHANG);
 
+	{
+		//reader of the previous process must leave first
+		std::unique_lock lk(muxLock);
+		muxCond.wait(lk, [&]{return !muxReading;});
+		mux_mode = false;
+		muxBroken = false;
+		muxInstance++;
+	}
+
 	{
 
 		log.progress("Connecting to broker: cmdline='$1', workdir='$2'", cmdline, workingDir);
@@ -169,6 +234,7 @@ void AbstractExtern::spawn() {
 				extout = std::move(proc_output.read);
 				exterr = std::move(proc_error.read);
 				extin = std::move(proc_input.write);
+				outReader = std::make_unique<Reader>(extout, timeout);
 				chldid = frk;
 			}
 		});
@@ -186,6 +252,7 @@ void AbstractExtern::handleClose(int fd) {
 
 void AbstractExtern::kill() {
 	Sync _(lock);
+	muxFail("Broker process disconnected");
 	if (chldid != -1) {
 
 		ondra_shared::WaitPid wpid(chldid);
@@ -213,57 +280,6 @@ AbstractExtern::~AbstractExtern() {
 	kill();
 }
 
-static void waitForRead(int fd, int timeout) {
-	struct pollfd fds = {fd, POLLIN|POLLHUP,0};
-	int r = poll(&fds, 1, timeout);
-	if (r != 1) throw std::runtime_error("Broker read timeout");
-}
-static void waitForWrite(int fd, int timeout) {
-	struct pollfd fds = {fd, POLLOUT,0};
-	int r = poll(&fds, 1, timeout);
-	if (r != 1) throw std::runtime_error("Broker write timeout");
-}
-
-
-class AbstractExtern::Reader {
-public:
-	Reader (FD &fd, int timeout):fd(fd),timeout(timeout) {}
-	std::string_view read() {
-		if (buff.empty()) {
-			return readBuff();
-		}
-		else {
-			auto x = buff;
-			buff = std::string_view();
-			return x;
-		}
-	}
-	void putback(std::string_view data) {
-		buff = data;
-	}
-
-	int operator()() {
-		auto d = read();
-		if (d.empty()) return -1;
-		char z = d[0];
-		putback(d.substr(1));
-		return z;
-	}
-
-protected:
-	std::string_view buff;
-	char data[1000];
-	FD &fd;
-	int timeout;
-
-	std::string_view readBuff() {
-		waitForRead(fd,timeout);
-		int i = ::read(fd, data, sizeof(data));
-		if (i < 1) return std::string_view();
-		else return std::string_view(data, i);
-	}
-};
-
 bool AbstractExtern::writeString(std::string_view ss, int timeout, FD &fd) {
 	while (!ss.empty()) {
 		waitForWrite(fd, timeout);
@@ -277,15 +293,19 @@ bool AbstractExtern::writeString(std::string_view ss, int timeout, FD &fd) {
 }
 
 bool AbstractExtern::writeJSON(json::Value v, FD& fd, bool binary_mode, int timeout) {
+	//written to the pipe by blocks, so large requests are not copied to a temporary string
+	bool ok = true;
+	json::OutputBuffer buff([&](std::string_view data){
+		if (ok) ok = writeString(data, timeout, fd);
+	});
 	if (binary_mode) {
-		std::string s;
-		v.serializeBinary([&](char c){s.push_back(c);}, json::compressKeys);
-		return writeString(s, timeout, fd);
+		v.serializeBinary(buff.sink(), json::compressKeys);
 	} else {
-		auto s = v.stringify();
-		s = s + "\n";
-		return writeString(s.str(), timeout, fd);
+		v.serialize(buff.sink());
+		buff.put('\n');
 	}
+	buff.flush();
+	return ok;
 }
 
 
@@ -310,22 +330,45 @@ void AbstractExtern::stop() {
 }
 
 json::Value AbstractExtern::jsonExchange(json::Value request) {
-	Sync _(lock);
-
-
-	std::string z;
-	std::string lastStdErr;
+	Sync lk(lock);
 
 	if (chldid == -1) {
 		spawn();
 	}
 	bool verbose = log.isLogLevelEnabled(ondra_shared::LogLevel::debug);
 	if (verbose) log.debug("SEND: $1", request.toString().substr(0,512));
+	if (mux_mode) {
+		int id = msgCntr++;
+		{
+			std::lock_guard _(muxLock);
+			muxSlots.emplace(id, MuxSlot{json::Value(), muxInstance});
+		}
+		if (writeJSON({id, request[0], request[1]}, extin, binary_mode, timeout) == false) {
+			kill();
+		}
+		//other threads can send their requests while this one is waiting
+		lk.unlock();
+		return muxWait(id, request);
+	}
 	if (writeJSON(request, extin, binary_mode, timeout) == false) {
 		kill();
 	}
+	try {
+		return readFrame(request);
+	} catch (...) {
+		kill();
+		throw;
+	}
+}
+
+json::Value AbstractExtern::readFrame(const json::Value &request) {
+	std::string z;
+	std::string lastStdErr;
+	bool verbose = log.isLogLevelEnabled(ondra_shared::LogLevel::debug);
+	Reader &rd = *outReader;
+
 	do {
-		try {
+		if (!rd.hasData()) {
 			struct pollfd fds[2];
 			fds[0].fd = extout;
 			fds[0].events = POLLIN;
@@ -361,33 +404,106 @@ json::Value AbstractExtern::jsonExchange(json::Value request) {
 					} while (true);
 				}while (rep);
 			}
-			if (fds[0].revents) {
-					Reader rd(extout, timeout);
-					auto buff = rd.read();
-					while (!buff.empty() && isspace(buff[0])) {
-						buff = buff.substr(1);
-					}
-					if (!buff.empty()) {
-						rd.putback(buff);
-						auto ret = binary_mode
-								?json::Value::parseBinary<Reader &>(rd, json::base64)
-								:json::Value::parse<Reader &>(rd);
-						if (verbose) log.debug("RECV: $1", ret.toString().substr(0,512));
-						return ret;
-					} else {
-						log.debug("Broker requested more time");
-					}
+			if (!fds[0].revents) continue;
+		}
+		auto buff = rd.read();
+		while (!buff.empty() && isspace(buff[0])) {
+			buff = buff.substr(1);
+		}
+		if (!buff.empty()) {
+			json::Value ret;
+			if (binary_mode) {
+				rd.putback(buff);
+				ret = json::Value::parseBinary<Reader &>(rd, json::base64);
+			} else {
+				//response is always single line, collect it whole, then parse it at once
+				std::string line;
+				auto pos = buff.find('\n');
+				while (pos == buff.npos) {
+					line.append(buff);
+					buff = rd.read();
+					if (buff.empty()) break;
+					pos = buff.find('\n');
+				}
+				if (pos != buff.npos) {
+					line.append(buff.substr(0, pos));
+					//next reply can follow in the same block
+					rd.putback(buff.substr(pos+1));
+				}
+				ret = json::Value::fromString(line);
 			}
-		} catch (...) {
-			kill();
-			throw;
+			if (verbose) log.debug("RECV: $1", ret.toString().substr(0,512));
+			return ret;
+		} else {
+			log.debug("Broker requested more time");
 		}
 	}
 	while (true);
 }
 
+json::Value AbstractExtern::muxWait(int id, const json::Value &request) {
+	std::unique_lock lk(muxLock);
+	while (true) {
+		auto iter = muxSlots.find(id);
+		if (iter == muxSlots.end()) throw std::runtime_error(muxError);
+		if (iter->second.reply.defined()) {
+			json::Value r = iter->second.reply;
+			muxSlots.erase(iter);
+			return r;
+		}
+		if (muxBroken || iter->second.instance != muxInstance) {
+			muxSlots.erase(iter);
+			throw std::runtime_error(muxError);
+		}
+		if (muxReading) {
+			muxCond.wait(lk);
+			continue;
+		}
+		//nobody reads replies, this thread becomes the reader
+		muxReading = true;
+		unsigned int instance = muxInstance;
+		lk.unlock();
+		json::Value frame;
+		std::optional<std::string> err;
+		try {
+			frame = readFrame(request);
+			if (frame[0].type() != json::number) {
+				//untagged reply is an error of the dispatcher, the broker is going to exit
+				err = frame[1].toString().str();
+			}
+		} catch (std::exception &e) {
+			err = e.what();
+		}
+		lk.lock();
+		muxReading = false;
+		if (err.has_value()) {
+			lk.unlock();
+			muxFail(*err);
+			Sync _(lock);
+			if (instance == muxInstance) kill();
+			throw std::runtime_error(*err);
+		}
+		auto f = muxSlots.find(frame[0].getInt());
+		if (f != muxSlots.end() && f->second.instance == instance) {
+			f->second.reply = {frame[1], frame[2]};
+		} else {
+			log.warning("Unexpected reply: $1", frame[0].toString().str());
+		}
+		muxCond.notify_all();
+	}
+}
+
+void AbstractExtern::muxFail(const std::string &msg) {
+	{
+		std::lock_guard _(muxLock);
+		if (!muxBroken) muxError = msg;
+		muxBroken = true;
+		muxSlots.clear();
+	}
+	muxCond.notify_all();
+}
+
 json::Value AbstractExtern::jsonRequestExchange(json::String name, json::Value args) {
-	Sync _(lock);
 	try {
 		auto resp = jsonExchange({name, args});
 		if (resp[0].getBool() == true) {
@@ -7,7 +7,10 @@
 
 #ifndef SRC_MAIN_ABSTRACTEXTERN_H_
 #define SRC_MAIN_ABSTRACTEXTERN_H_
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 
 #include <imtjson/string.h>
 #include <imtjson/value.h>
@@ -86,8 +89,37 @@ protected:
 	static Pipe makePipe();
 	int msgCntr = 1;
 	bool binary_mode = false;
+	///multiplexed protocol is active
+	/**
+	 * Requests are sent as [id, method, args], replies arrive as [id, ok, result] in any order. The
+	 * connection is not locked while the request is waiting for the reply, so multiple threads can
+	 * have their requests in flight. Replies are read by one of the waiting threads.
+	 */
+	bool mux_mode = false;
+
+	struct MuxSlot {
+		json::Value reply;
+		unsigned int instance;
+	};
+
+	std::mutex muxLock;
+	std::condition_variable muxCond;
+	std::unordered_map<int, MuxSlot> muxSlots;
+	std::string muxError;
+	///incremented on every spawn, requests of the previous process are failed
+	unsigned int muxInstance = 0;
+	///the process failed, no more replies are read
+	bool muxBroken = true;
+	///a thread is reading replies
+	bool muxReading = false;
+
+	///Reader of the stdout of the process (kept between the requests, it can contain more replies)
+	std::unique_ptr<Reader> outReader;
 
 	json::Value jsonExchange(json::Value request);
+	json::Value readFrame(const json::Value &request);
+	json::Value muxWait(int id, const json::Value &request);
+	void muxFail(const std::string &msg);
 	static bool writeJSON(json::Value v, FD &fd, bool binary_mode, int timeout);
 //	static json::Value readJSON(FD &fd, int timeout);
 	static bool writeString(std::string_view ss, int timeout, FD &fd);
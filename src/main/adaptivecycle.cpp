@@ -0,0 +1,202 @@
+/*
+ * adaptivecycle.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "adaptivecycle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <vector>
+
+#include "perfstats.h"
+#include "../shared/logOutput.h"
+
+using ondra_shared::logError;
+
+///Weight of the new sample in the volatility estimation
+static constexpr double volatilityAlpha = 0.2;
+///Part of the distance to the order, which the price is expected to move before the next run
+static constexpr double moveFraction = 0.5;
+///Interval used when volatility is not known yet or when the trader failed (seconds)
+static constexpr unsigned int defaultInterval = 60;
+
+///Returns logarithmic distance of the price to the nearest order (or step, when there are no orders)
+static double orderDistance(const MTrader::CycleHint &hint) {
+	double d = 0;
+	if (hint.price > 0) {
+		for (double order: {hint.buy, hint.sell}) {
+			if (order > 0) {
+				double x = std::abs(std::log(order/hint.price));
+				if (d == 0 || x < d) d = x;
+			}
+		}
+	}
+	return d>0?d:hint.step;
+}
+
+AdaptiveCycle::AdaptiveCycle(const Config &cfg,
+		ondra_shared::SharedObject<Traders> traders,
+		PReport rpt,
+		PPerfModule perfmod,
+		ondra_shared::Scheduler sch)
+	:cfg(cfg),traders(traders),rpt(rpt),perfmod(perfmod),sch(sch) {
+	if (this->cfg.max_interval < this->cfg.min_interval) this->cfg.max_interval = this->cfg.min_interval;
+}
+
+void AdaptiveCycle::start() {
+	next_report = Clock::now();
+	tick();
+}
+
+void AdaptiveCycle::tick() {
+	using ondra_shared::SharedObject;
+
+	auto sysnow = std::chrono::system_clock::now();
+	auto probe_interval = std::chrono::seconds(cfg.probe_interval);
+	//brokers are reset at most once per probe interval, so probes and runs inside the interval
+	//share cached market data
+	auto cycle_tp = sysnow - sysnow.time_since_epoch() % std::chrono::seconds(std::max(cfg.probe_interval, 1U));
+
+	std::vector<std::pair<std::string, SharedObject<NamedMTrader> > > lst;
+	traders.lock_shared()->enumTraders([&](const auto &trinfo){
+		lst.emplace_back(std::string(trinfo.first), trinfo.second);
+	});
+
+	std::unordered_map<std::string, TraderState> newstates;
+	for (auto &[ident, trader]: lst) {
+		auto now = Clock::now();
+		auto iter = states.find(ident);
+		TraderState st;
+		if (iter == states.end()) {
+			st.next_run = now;
+			st.last_run = now;
+		} else {
+			st = iter->second;
+		}
+
+		bool due = now >= st.next_run;
+		if (due || now >= st.next_probe) try {
+			auto tl = trader.lock();
+			std::string broker = tl->getConfig().broker;
+			if (!due) {
+				if (takeToken(broker, now, false)) {
+					static PerfHistogram &probe_hist = PerfStats::global().get("adaptive_cycle.probe");
+					PerfProbe probe(probe_hist);
+					auto api = tl->getBroker();
+					std::string pair = tl->getConfig().pairsymb;
+					tl.release();
+					Traders::resetBroker(api, cycle_tp);
+					double price = api->getTicker(pair).last;
+					observe(st, price, now);
+					due = needWakeup(st, price);
+				}
+				st.next_probe = now + probe_interval;
+			}
+			if (due) {
+				if (tl == nullptr) tl = trader.lock();
+				bool overdue = now - st.last_run >= std::chrono::seconds(cfg.max_interval);
+				if (takeToken(broker, now, overdue)) {
+					Traders::resetBroker(tl->getBroker(), cycle_tp);
+					auto t1 = std::chrono::system_clock::now();
+					tl->setAdaptiveCycle(true);
+					tl->perform(false);
+					st.hint = tl->getCycleHint();
+					tl.release();
+					auto t2 = std::chrono::system_clock::now();
+					traders.lock()->report_util(ident, std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count());
+					now = Clock::now();
+					st.last_run = now;
+					if (st.hint.price > 0) observe(st, st.hint.price, now);
+					plan(st, now);
+				} else {
+					//wait for the next token
+					st.next_run = now + std::chrono::milliseconds(60000/std::max(cfg.broker_budget,1U));
+				}
+			}
+		} catch (std::exception &e) {
+			logError("Scheduler exception: $1", e.what());
+			now = Clock::now();
+			st.last_run = now;
+			st.next_run = st.next_probe = now + std::chrono::seconds(defaultInterval);
+		}
+		newstates.emplace(std::move(ident), std::move(st));
+	}
+	//removed traders are dropped here
+	std::swap(states, newstates);
+
+	auto now = Clock::now();
+	if (now >= next_report) {
+		traders.lock()->stockSelector.housekeepingIdle(sysnow);
+		auto rptl = rpt.lock();
+		rptl->perfReport(perfmod.lock()->getReport());
+		rptl->genReport();
+		next_report = now + std::chrono::minutes(1);
+	}
+
+	TimePoint tp = next_report;
+	for (const auto &[ident, st]: states) {
+		tp = std::min({tp, st.next_run, st.next_probe});
+	}
+	schedule(std::max(tp, Clock::now() + std::chrono::seconds(1)));
+}
+
+void AdaptiveCycle::schedule(const TimePoint &tp) {
+	sch.at(tp) >> [me = PAdaptiveCycle(this)]{
+		me->tick();
+	};
+}
+
+bool AdaptiveCycle::takeToken(const std::string &broker, const TimePoint &now, bool force) {
+	if (cfg.broker_budget == 0) return true;
+	auto &b = budgets.try_emplace(broker, Budget{static_cast<double>(cfg.broker_budget), now}).first->second;
+	double elapsed = std::chrono::duration<double>(now - b.last).count();
+	b.tokens = std::min<double>(cfg.broker_budget, b.tokens + elapsed * cfg.broker_budget / 60.0);
+	b.last = now;
+	if (b.tokens < 1 && !force) return false;
+	b.tokens -= 1;
+	return true;
+}
+
+void AdaptiveCycle::observe(TraderState &st, double price, const TimePoint &now) {
+	if (!std::isfinite(price) || price <= 0) return;
+	if (st.price > 0) {
+		double dt = std::chrono::duration<double>(now - st.price_time).count();
+		//too short interval doesn't carry the information
+		if (dt < 1) return;
+		double r = std::log(price/st.price);
+		double v = r*r/dt;
+		st.var = st.var < 0?v:st.var + (v - st.var) * volatilityAlpha;
+	}
+	st.price = price;
+	st.price_time = now;
+}
+
+void AdaptiveCycle::plan(TraderState &st, const TimePoint &now) const {
+	double d = orderDistance(st.hint);
+	double secs;
+	if (st.var < 0 || d <= 0) {
+		secs = defaultInterval;
+	} else if (st.var == 0) {
+		secs = cfg.max_interval;
+	} else {
+		//expected time to move the given fraction of the distance (random walk)
+		double move = d * moveFraction;
+		secs = move * move / st.var;
+	}
+	secs = std::clamp<double>(secs, cfg.min_interval, cfg.max_interval);
+	st.next_run = now + std::chrono::milliseconds(static_cast<long>(secs * 1000));
+	st.next_probe = now + std::chrono::seconds(cfg.probe_interval);
+}
+
+bool AdaptiveCycle::needWakeup(const TraderState &st, double price) {
+	const auto &hint = st.hint;
+	if (hint.price <= 0 || !std::isfinite(price) || price <= 0) return false;
+	if (hint.buy > 0 && price <= hint.buy) return true;
+	if (hint.sell > 0 && price >= hint.sell) return true;
+	double d = orderDistance(hint);
+	return d > 0 && std::abs(std::log(price/hint.price)) >= d * moveFraction;
+}
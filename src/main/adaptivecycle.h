@@ -0,0 +1,110 @@
+/*
+ * adaptivecycle.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_ADAPTIVECYCLE_H_
+#define SRC_MAIN_ADAPTIVECYCLE_H_
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include "../shared/refcnt.h"
+#include "../shared/scheduler.h"
+#include "../shared/shared_object.h"
+#include "traders.h"
+
+///Trading cycle, which performs every trader at own frequency
+/**
+ * The next run of the trader is planned from the volatility of the price and from the distance
+ * to its orders. The trader, whose orders are far from the price is performed rarely, the trader,
+ * whose orders are near is performed often. Between runs, the price is probed through the
+ * ticker (it is cheap, because brokers cache tickers). When the probed price crosses an order
+ * or moves a significant part of the distance to the order, the trader is woken immediately.
+ *
+ * Count of runs and probes is limited per broker (token bucket).
+ *
+ * The object runs on the trading lane, it is not MT safe.
+ */
+class AdaptiveCycle: public ondra_shared::RefCntObj {
+public:
+
+	using Clock = std::chrono::steady_clock;
+	using TimePoint = Clock::time_point;
+
+	struct Config {
+		///minimal interval between runs of the trader (seconds)
+		unsigned int min_interval = 15;
+		///maximal interval between runs of the trader (seconds)
+		unsigned int max_interval = 300;
+		///interval of probing the price between runs (seconds)
+		unsigned int probe_interval = 10;
+		///count of runs and probes per minute for single broker
+		unsigned int broker_budget = 60;
+	};
+
+	AdaptiveCycle(const Config &cfg,
+			ondra_shared::SharedObject<Traders> traders,
+			PReport rpt,
+			PPerfModule perfmod,
+			ondra_shared::Scheduler sch);
+
+	///Starts the cycle
+	void start();
+
+protected:
+
+	struct TraderState {
+		///next planned run
+		TimePoint next_run;
+		///next planned probe
+		TimePoint next_probe;
+		///last run
+		TimePoint last_run;
+		///last observed price
+		double price = 0;
+		///time of the last observed price
+		TimePoint price_time;
+		///variance of the logarithmic returns per second (negative - unknown)
+		double var = -1;
+		///hint from the last run
+		MTrader::CycleHint hint = {};
+	};
+
+	struct Budget {
+		double tokens;
+		TimePoint last;
+	};
+
+	Config cfg;
+	ondra_shared::SharedObject<Traders> traders;
+	PReport rpt;
+	PPerfModule perfmod;
+	ondra_shared::Scheduler sch;
+	std::unordered_map<std::string, TraderState> states;
+	std::unordered_map<std::string, Budget> budgets;
+	TimePoint next_report;
+
+	void tick();
+	void schedule(const TimePoint &tp);
+	///Takes one token from the budget of the broker
+	/**
+	 * @param force take the token even if the budget is exhausted
+	 * @retval true token taken
+	 * @retval false budget exhausted
+	 */
+	bool takeToken(const std::string &broker, const TimePoint &now, bool force);
+	///Updates volatility by new observed price
+	static void observe(TraderState &st, double price, const TimePoint &now);
+	///Plans next run after the trader was performed
+	void plan(TraderState &st, const TimePoint &now) const;
+	///Determines whether the probed price requires the run of the trader
+	static bool needWakeup(const TraderState &st, double price);
+};
+
+using PAdaptiveCycle = ondra_shared::RefCntPtr<AdaptiveCycle>;
+
+
+#endif /* SRC_MAIN_ADAPTIVECYCLE_H_ */
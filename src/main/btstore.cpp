@@ -15,6 +15,8 @@
 
 #include <imtjson/binjson.h>
 #include <imtjson/binjson.tcc>
+#include <imtjson/arena.h>
+#include <imtjson/array.h>
 BacktestStorage::BacktestStorage( std::size_t max_files, bool in_memory)
 	:max_files(std::max<std::size_t>(8,max_files))
 	,in_memory(in_memory)
@@ -88,7 +90,7 @@ void BacktestStorage::remove_metadata(const std::vector<Metadata>::const_iterato
 
 void BacktestStorage::store_data(const json::Value &data, const std::string &id) {
 	if (in_memory) {
-		in_memory_files[id] =  data;
+		in_memory_files[id] =  json::ArenaScope::promote(data);
 		add_metadata({id,id,std::chrono::system_clock::now()});
 	} else {
 		auto tmpPath = std::filesystem::temp_directory_path();
@@ -96,7 +98,7 @@ void BacktestStorage::store_data(const json::Value &data, const std::string &id)
 		auto fpath = tmpPath / ("mmbot_backtest_"+pid+"x"+id);
 		std::ofstream f(fpath, std::ios::binary);
 		if (!(!f)) {
-			data.serializeBinary([&](char c){f.put(c);}, json::compressKeys);
+			data.serializeBinary(json::toStream(f), json::compressKeys);
 			if (!(!f)) {
 				add_metadata({id,fpath.string(),std::chrono::system_clock::now()});
 				return;
@@ -115,6 +117,49 @@ std::string BacktestStorage::store_data(const json::Value &data) {
 	return id;
 }
 
+std::string BacktestStorage::store_array(std::size_t count, const std::function<json::Value(std::size_t)> &gen) {
+	if (in_memory) {
+		json::Array data;
+		data.reserve(count);
+		for (std::size_t i = 0; i < count; i++) data.push_back(gen(i));
+		return store_data(data);
+	}
+	//id is known after the whole array is written, so it is written under temporary name
+	auto tmpPath = std::filesystem::temp_directory_path();
+	std::string pid = std::to_string(getpid());
+	auto upath = tmpPath / ("mmbot_backtest_"+pid+"_upload");
+	std::hash<json::Value> h;
+	std::size_t hval = count;
+	bool ok;
+	{
+		std::ofstream f(upath, std::ios::binary);
+		if (!(!f)) {
+			auto out = json::toStream(f);
+			json::BinarySerializer<decltype(out)> ser(out, json::compressKeys);
+			ser.beginArray(count);
+			for (std::size_t i = 0; i < count; i++) {
+				json::Value v = gen(i);
+				ser.serialize(v);
+				hval ^= h(v) + 0x9e3779b9 + (hval << 6) + (hval >> 2);
+			}
+		}
+		ok = !(!f);
+	}
+	if (ok) {
+		std::string id = std::to_string(hval);
+		auto fpath = tmpPath / ("mmbot_backtest_"+pid+"x"+id);
+		std::error_code ec;
+		std::filesystem::rename(upath, fpath, ec);
+		if (!ec) {
+			add_metadata({id,fpath.string(),std::chrono::system_clock::now()});
+			return id;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::remove(upath, ec);
+	throw std::runtime_error("Inaccessible temporary storage");
+}
+
 json::Value BacktestStorage::load_data(const std::string &id) {
 	auto iter = find(id);
 	if (iter == meta.end()) return json::Value();
@@ -8,6 +8,7 @@
 #ifndef SRC_MAIN_BTSTORE_H_
 #define SRC_MAIN_BTSTORE_H_
 #include <chrono>
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -24,6 +25,16 @@ public:
 	std::string store_data(const json::Value &data);
 	json::Value load_data(const std::string &id);
 	void store_data(const json::Value &data, const std::string &id);
+	///Stores array generated item by item
+	/**
+	 * The array is serialized directly to the storage file, so it is never held in the memory
+	 * as a whole (unless the storage is in the memory)
+	 *
+	 * @param count count of items
+	 * @param gen function generates item at given index
+	 * @return id of the stored data
+	 */
+	std::string store_array(std::size_t count, const std::function<json::Value(std::size_t)> &gen);
 
 
 protected:
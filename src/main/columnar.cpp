@@ -0,0 +1,443 @@
+/*
+ * columnar.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "columnar.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace columnar {
+
+static void corrupted() {
+	throw std::runtime_error("Columnar data are damaged");
+}
+
+void BitWriter::write(std::uint64_t v, unsigned int bits) {
+	while (bits) {
+		unsigned int n = std::min(bits, 8 - nbits);
+		bits -= n;
+		acc = (acc << n) | ((v >> bits) & ((1U << n) - 1));
+		nbits += n;
+		if (nbits == 8) {
+			buff.push_back(static_cast<char>(acc));
+			acc = 0;
+			nbits = 0;
+		}
+	}
+}
+
+void BitWriter::writeVarUInt(std::uint64_t v) {
+	do {
+		std::uint64_t g = v & 0x7F;
+		v >>= 7;
+		write(v?(g | 0x80):g, 8);
+	} while (v);
+}
+
+void BitWriter::writeVarInt(std::int64_t v) {
+	//zigzag
+	writeVarUInt((static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63));
+}
+
+void BitWriter::writeBytes(const std::string_view &str) {
+	for (char c: str) write(static_cast<unsigned char>(c), 8);
+}
+
+const std::string &BitWriter::finish() {
+	if (nbits) write(0, 8 - nbits);
+	return buff;
+}
+
+std::uint64_t BitReader::read(unsigned int bits) {
+	std::uint64_t r = 0;
+	while (bits) {
+		if (nbits == 0) {
+			if (pos >= data.size()) corrupted();
+			acc = static_cast<unsigned char>(data[pos++]);
+			nbits = 8;
+		}
+		unsigned int n = std::min(bits, nbits);
+		nbits -= n;
+		bits -= n;
+		r = (r << n) | ((acc >> nbits) & ((1U << n) - 1));
+	}
+	return r;
+}
+
+std::uint64_t BitReader::readVarUInt() {
+	std::uint64_t r = 0;
+	unsigned int shift = 0;
+	std::uint64_t g;
+	do {
+		if (shift >= 64) corrupted();
+		g = read(8);
+		r |= (g & 0x7F) << shift;
+		shift += 7;
+	} while (g & 0x80);
+	return r;
+}
+
+std::int64_t BitReader::readVarInt() {
+	std::uint64_t v = readVarUInt();
+	return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+std::string BitReader::readBytes(std::size_t count) {
+	if (count > data.size()) corrupted();
+	std::string r;
+	r.reserve(count);
+	for (std::size_t i = 0; i < count; i++) r.push_back(static_cast<char>(read(8)));
+	return r;
+}
+
+void TimeEncoder::push(BitWriter &wr, std::uint64_t tm) {
+	if (count == 0) {
+		wr.write(tm, 64);
+	} else {
+		std::int64_t delta = static_cast<std::int64_t>(tm - prev);
+		std::int64_t dod = delta - prev_delta;
+		if (dod == 0) {
+			wr.writeBit(false);
+		} else {
+			wr.writeBit(true);
+			wr.writeVarInt(dod);
+		}
+		prev_delta = delta;
+	}
+	prev = tm;
+	count++;
+}
+
+std::uint64_t TimeEncoder::pull(BitReader &rd) {
+	if (count == 0) {
+		prev = rd.read(64);
+	} else {
+		if (rd.readBit()) prev_delta += rd.readVarInt();
+		prev += static_cast<std::uint64_t>(prev_delta);
+	}
+	count++;
+	return prev;
+}
+
+///Maximal count of decimal places of the scaled numbers
+static constexpr int maxScale = 12;
+
+static const double pow10[maxScale+1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12
+};
+
+///Converts number to the integer of given scale
+/** @retval true number can be exactly restored from the integer */
+static bool toScaled(double v, int scale, std::int64_t &n) {
+	double x = v * pow10[scale];
+	if (!(std::abs(x) < 9007199254740992.0)) return false;
+	n = std::llround(x);
+	//compared bitwise, so negative zero is not replaced by the positive zero
+	double r = static_cast<double>(n) / pow10[scale];
+	return std::memcmp(&r, &v, sizeof(v)) == 0;
+}
+
+static double fromScaled(std::int64_t n, int scale) {
+	return static_cast<double>(n) / pow10[scale];
+}
+
+//Prefix codes:
+// 0   - same value
+// 10  <delta:varint> - delta of scaled integers, same scale
+// 110 <scale:4> <value:varint> - scaled integer, new scale
+// 111 - XOR with the previous value
+//      0 <bits> - same window
+//      1 <lead:6> <len-1:6> <bits> - new window
+void FloatEncoder::push(BitWriter &wr, double v) {
+	std::uint64_t bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+	if (bits == prev) {
+		wr.writeBit(false);
+		return;
+	}
+	wr.writeBit(true);
+	std::int64_t n;
+	if (scale >= 0 && toScaled(v, scale, n)) {
+		wr.writeBit(false);
+		wr.writeVarInt(n - prev_scaled);
+		prev_scaled = n;
+	} else {
+		wr.writeBit(true);
+		int s = 0;
+		while (s <= maxScale && !toScaled(v, s, n)) s++;
+		if (s <= maxScale) {
+			wr.writeBit(false);
+			wr.write(s, 4);
+			wr.writeVarInt(n);
+			scale = s;
+			prev_scaled = n;
+		} else {
+			wr.writeBit(true);
+			std::uint64_t x = bits ^ prev;
+			unsigned int lz = __builtin_clzll(x);
+			unsigned int tz = __builtin_ctzll(x);
+			if (window && lz >= lead && tz >= trail) {
+				//fits to the previous window
+				wr.writeBit(false);
+				wr.write(x >> trail, 64 - lead - trail);
+			} else {
+				unsigned int len = 64 - lz - tz;
+				wr.writeBit(true);
+				wr.write(lz, 6);
+				wr.write(len - 1, 6);
+				wr.write(x >> tz, len);
+				lead = lz;
+				trail = tz;
+				window = true;
+			}
+			scale = -1;
+		}
+	}
+	prev = bits;
+}
+
+double FloatEncoder::pull(BitReader &rd) {
+	double v;
+	if (rd.readBit()) {
+		if (!rd.readBit()) {
+			if (scale < 0) corrupted();
+			prev_scaled += rd.readVarInt();
+			v = fromScaled(prev_scaled, scale);
+			std::memcpy(&prev, &v, sizeof(prev));
+		} else if (!rd.readBit()) {
+			scale = static_cast<int>(rd.read(4));
+			if (scale > maxScale) corrupted();
+			prev_scaled = rd.readVarInt();
+			v = fromScaled(prev_scaled, scale);
+			std::memcpy(&prev, &v, sizeof(prev));
+		} else {
+			if (rd.readBit()) {
+				lead = static_cast<unsigned int>(rd.read(6));
+				unsigned int len = static_cast<unsigned int>(rd.read(6)) + 1;
+				if (lead + len > 64) corrupted();
+				trail = 64 - lead - len;
+				window = true;
+			} else if (!window) {
+				corrupted();
+			}
+			prev ^= rd.read(64 - lead - trail) << trail;
+			scale = -1;
+		}
+	}
+	std::memcpy(&v, &prev, sizeof(v));
+	return v;
+}
+
+enum IdTag {
+	id_undefined = 0,
+	id_null = 1,
+	id_int = 2,
+	id_uint = 3,
+	id_string = 4,
+	id_json = 5
+};
+
+void IdEncoder::push(BitWriter &wr, const json::Value &id) {
+	auto writeInt = [&](IdTag tag, std::uint64_t v) {
+		wr.write(tag, 3);
+		wr.writeVarInt(static_cast<std::int64_t>(v - prev_int));
+		prev_int = v;
+	};
+	switch (id.type()) {
+		case json::undefined:
+			wr.write(id_undefined, 3);
+			return;
+		case json::null:
+			wr.write(id_null, 3);
+			return;
+		case json::number:
+			if (id.flags() & json::numberUnsignedInteger) {
+				writeInt(id_uint, id.getUIntLong());
+				return;
+			}
+			if (id.flags() & json::numberInteger) {
+				writeInt(id_int, static_cast<std::uint64_t>(id.getIntLong()));
+				return;
+			}
+			break;
+		case json::string:
+			if (!(id.flags() & json::binaryString)) {
+				std::string_view str = id.getString();
+				auto m = std::mismatch(str.begin(), str.end(), prev_str.begin(), prev_str.end());
+				std::size_t common = m.first - str.begin();
+				wr.write(id_string, 3);
+				wr.writeVarUInt(common);
+				wr.writeVarUInt(str.size() - common);
+				wr.writeBytes(str.substr(common));
+				prev_str = str;
+				return;
+			}
+			break;
+		default:
+			break;
+	}
+	json::String s = id.stringify();
+	wr.write(id_json, 3);
+	wr.writeVarUInt(s.length());
+	wr.writeBytes(s.str());
+}
+
+json::Value IdEncoder::pull(BitReader &rd) {
+	switch (rd.read(3)) {
+		case id_undefined:
+			return json::Value();
+		case id_null:
+			return json::Value(nullptr);
+		case id_int:
+			prev_int += static_cast<std::uint64_t>(rd.readVarInt());
+			return json::Value(static_cast<json::LongInt>(prev_int));
+		case id_uint:
+			prev_int += static_cast<std::uint64_t>(rd.readVarInt());
+			return json::Value(static_cast<json::ULongInt>(prev_int));
+		case id_string: {
+			std::size_t common = rd.readVarUInt();
+			if (common > prev_str.size()) corrupted();
+			prev_str.resize(common);
+			prev_str.append(rd.readBytes(rd.readVarUInt()));
+			return json::Value(prev_str);
+		}
+		case id_json:
+			return json::Value::fromString(rd.readBytes(rd.readVarUInt()));
+		default:
+			corrupted();
+			return json::Value();
+	}
+}
+
+static void appendVarUInt(std::string &out, std::uint64_t v) {
+	do {
+		unsigned char g = v & 0x7F;
+		v >>= 7;
+		out.push_back(static_cast<char>(v?(g | 0x80):g));
+	} while (v);
+}
+
+static std::uint64_t readVarUInt(const std::string_view &data, std::size_t &pos) {
+	std::uint64_t r = 0;
+	unsigned int shift = 0;
+	unsigned char g;
+	do {
+		if (pos >= data.size() || shift >= 64) corrupted();
+		g = static_cast<unsigned char>(data[pos++]);
+		r |= static_cast<std::uint64_t>(g & 0x7F) << shift;
+		shift += 7;
+	} while (g & 0x80);
+	return r;
+}
+
+json::Value Writer::finish() {
+	std::string out;
+	out.push_back('C');
+	out.push_back(static_cast<char>(version));
+	out.push_back(static_cast<char>(kind));
+	appendVarUInt(out, count);
+	for (auto &c: columns) {
+		const std::string &d = c.finish();
+		appendVarUInt(out, d.size());
+		out.append(d);
+	}
+	return json::Value(json::map_str2bin(out), json::base64);
+}
+
+Reader::Reader(json::Value data, Kind kind, unsigned int columns) {
+	if (!isColumnar(data)) throw std::runtime_error("Expected columnar data");
+	bin = data.getBinary(json::base64);
+	std::string_view s = json::map_bin2str(bin);
+	if (s.size() < 3 || s[0] != 'C') corrupted();
+	if (static_cast<unsigned char>(s[1]) > version) throw std::runtime_error("Unsupported version of columnar data");
+	if (static_cast<unsigned char>(s[2]) != static_cast<unsigned char>(kind)) throw std::runtime_error("Unexpected kind of columnar data");
+	std::size_t pos = 3;
+	std::uint64_t cnt = readVarUInt(s, pos);
+	this->columns.reserve(columns);
+	for (unsigned int i = 0; i < columns; i++) {
+		std::uint64_t len = readVarUInt(s, pos);
+		if (len > s.size() - pos) corrupted();
+		//every row takes at least one bit in every column
+		if (cnt > len*8) corrupted();
+		this->columns.emplace_back(s.substr(pos, len));
+		pos += len;
+	}
+	count = cnt;
+}
+
+bool Reader::isColumnar(const json::Value &data) {
+	return data.type() == json::string;
+}
+
+ChartWriter::ChartWriter():Writer(Kind::chart, 4) {}
+
+void ChartWriter::push(const IStatSvc::ChartItem &itm) {
+	time.push(columns[0], itm.time);
+	ask.push(columns[1], itm.ask);
+	bid.push(columns[2], itm.bid);
+	last.push(columns[3], itm.last);
+	count++;
+}
+
+ChartReader::ChartReader(json::Value data):Reader(data, Kind::chart, 4) {}
+
+std::optional<IStatSvc::ChartItem> ChartReader::next() {
+	if (pos >= count) return {};
+	pos++;
+	return IStatSvc::ChartItem{
+		time.pull(columns[0]),
+		ask.pull(columns[1]),
+		bid.pull(columns[2]),
+		last.pull(columns[3])
+	};
+}
+
+TradesWriter::TradesWriter():Writer(Kind::trades, 10) {}
+
+void TradesWriter::push(const IStatSvc::TradeRecord &itm) {
+	id.push(columns[0], itm.id);
+	time.push(columns[1], itm.time);
+	trade_size.push(columns[2], itm.size);
+	price.push(columns[3], itm.price);
+	eff_size.push(columns[4], itm.eff_size);
+	eff_price.push(columns[5], itm.eff_price);
+	norm_profit.push(columns[6], itm.norm_profit);
+	norm_accum.push(columns[7], itm.norm_accum);
+	neutral_price.push(columns[8], itm.neutral_price);
+	BitWriter &flags = columns[9];
+	flags.writeBit(itm.manual_trade);
+	flags.writeVarInt(itm.alertSide);
+	flags.writeVarInt(itm.alertReason);
+	count++;
+}
+
+TradesReader::TradesReader(json::Value data):Reader(data, Kind::trades, 10) {}
+
+std::optional<IStatSvc::TradeRecord> TradesReader::next() {
+	if (pos >= count) return {};
+	pos++;
+	IStockApi::Trade t{
+		id.pull(columns[0]),
+		time.pull(columns[1]),
+		trade_size.pull(columns[2]),
+		price.pull(columns[3]),
+		eff_size.pull(columns[4]),
+		eff_price.pull(columns[5])
+	};
+	double np = norm_profit.pull(columns[6]);
+	double ap = norm_accum.pull(columns[7]);
+	double p0 = neutral_price.pull(columns[8]);
+	BitReader &flags = columns[9];
+	bool man = flags.readBit();
+	char as = static_cast<char>(flags.readVarInt());
+	char ar = static_cast<char>(flags.readVarInt());
+	return IStatSvc::TradeRecord(t, np, ap, p0, man, as, ar);
+}
+
+}
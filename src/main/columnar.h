@@ -0,0 +1,199 @@
+/*
+ * columnar.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_COLUMNAR_H_
+#define SRC_MAIN_COLUMNAR_H_
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imtjson/binary.h>
+#include <imtjson/value.h>
+
+#include "../shared/stringview.h"
+#include "istatsvc.h"
+
+///Compact columnar encoding of the chart and the trades
+/**
+ * Rows are split into columns, every column is a bit stream encoded by the kind of its data
+ *
+ * - time - delta of delta, constant interval costs one bit per row
+ * - numbers - decimal numbers as delta of the scaled integers, others as XOR with the previous
+ *   value (Gorilla). Unchanged value costs one bit
+ * - trade ids - integer ids as delta, string ids share the prefix with the previous id
+ *
+ * Encoded data are stored as binary json value. Layout of the binary
+ * @code
+ * 'C' <version> <kind> <count:varint> [<column size:varint> <column data>]...
+ * @endcode
+ *
+ * Readers decode all columns in parallel, so the rows are available one by one without
+ * decoding whole content at once. Both the binary value and the base64 string (when the data
+ * passed through text json) are accepted
+ */
+namespace columnar {
+
+///Version of the encoding
+static constexpr unsigned char version = 1;
+
+enum class Kind: unsigned char {
+	chart = 1,
+	trades = 2
+};
+
+class BitWriter {
+public:
+	void write(std::uint64_t v, unsigned int bits);
+	void writeBit(bool b) {write(b?1:0,1);}
+	void writeVarUInt(std::uint64_t v);
+	void writeVarInt(std::int64_t v);
+	void writeBytes(const std::string_view &str);
+	///Flushes pending bits and returns the data
+	const std::string &finish();
+protected:
+	std::string buff;
+	std::uint64_t acc = 0;
+	unsigned int nbits = 0;
+};
+
+class BitReader {
+public:
+	BitReader() {}
+	explicit BitReader(const std::string_view &data):data(data) {}
+	std::uint64_t read(unsigned int bits);
+	bool readBit() {return read(1) != 0;}
+	std::uint64_t readVarUInt();
+	std::int64_t readVarInt();
+	std::string readBytes(std::size_t count);
+protected:
+	std::string_view data;
+	std::size_t pos = 0;
+	std::uint64_t acc = 0;
+	unsigned int nbits = 0;
+};
+
+///Column of timestamps (delta of delta)
+class TimeEncoder {
+public:
+	void push(BitWriter &wr, std::uint64_t tm);
+	std::uint64_t pull(BitReader &rd);
+protected:
+	std::uint64_t prev = 0;
+	std::int64_t prev_delta = 0;
+	std::size_t count = 0;
+};
+
+///Column of the numbers
+/**
+ * Numbers with few decimal places (prices and sizes rounded to ticks) are stored as the delta
+ * of the scaled integers, other numbers are XORed with the previous value
+ */
+class FloatEncoder {
+public:
+	void push(BitWriter &wr, double v);
+	double pull(BitReader &rd);
+protected:
+	std::uint64_t prev = 0;
+	unsigned int lead = 0;
+	unsigned int trail = 0;
+	bool window = false;
+	///count of decimal places of the previous value (negative - not decimal)
+	int scale = -1;
+	///previous value multiplied by 10^scale
+	std::int64_t prev_scaled = 0;
+};
+
+///Column of the trade ids
+class IdEncoder {
+public:
+	void push(BitWriter &wr, const json::Value &id);
+	json::Value pull(BitReader &rd);
+protected:
+	std::uint64_t prev_int = 0;
+	std::string prev_str;
+};
+
+///Common part of the writers
+class Writer {
+public:
+	Writer(Kind kind, unsigned int columns):kind(kind),columns(columns) {}
+	///Returns encoded data
+	json::Value finish();
+	std::size_t size() const {return count;}
+protected:
+	Kind kind;
+	std::vector<BitWriter> columns;
+	std::size_t count = 0;
+};
+
+///Common part of the readers
+class Reader {
+public:
+	Reader(json::Value data, Kind kind, unsigned int columns);
+	///Count of rows
+	std::size_t size() const {return count;}
+	///Determines whether the value contains the columnar data (otherwise it is an array of objects)
+	static bool isColumnar(const json::Value &data);
+protected:
+	json::Binary bin;
+	std::vector<BitReader> columns;
+	std::size_t count = 0;
+	std::size_t pos = 0;
+};
+
+class ChartWriter: public Writer {
+public:
+	ChartWriter();
+	void push(const IStatSvc::ChartItem &itm);
+protected:
+	TimeEncoder time;
+	FloatEncoder ask, bid, last;
+};
+
+class ChartReader: public Reader {
+public:
+	///Initializes the reader
+	/** @exception std::runtime_error data are not valid */
+	explicit ChartReader(json::Value data);
+	///Decodes next row
+	/** @return row, or no value at the end of the data */
+	std::optional<IStatSvc::ChartItem> next();
+protected:
+	TimeEncoder time;
+	FloatEncoder ask, bid, last;
+};
+
+class TradesWriter: public Writer {
+public:
+	TradesWriter();
+	void push(const IStatSvc::TradeRecord &itm);
+protected:
+	IdEncoder id;
+	TimeEncoder time;
+	FloatEncoder trade_size, price, eff_size, eff_price, norm_profit, norm_accum, neutral_price;
+};
+
+class TradesReader: public Reader {
+public:
+	///Initializes the reader
+	/** @exception std::runtime_error data are not valid */
+	explicit TradesReader(json::Value data);
+	///Decodes next row
+	/** @return row, or no value at the end of the data */
+	std::optional<IStatSvc::TradeRecord> next();
+protected:
+	IdEncoder id;
+	TimeEncoder time;
+	FloatEncoder trade_size, price, eff_size, eff_price, norm_profit, norm_accum, neutral_price;
+};
+
+}
+
+
+#endif /* SRC_MAIN_COLUMNAR_H_ */
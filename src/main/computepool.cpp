@@ -0,0 +1,152 @@
+/*
+ * computepool.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "computepool.h"
+
+#include <chrono>
+#include <exception>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../shared/logOutput.h"
+using ondra_shared::logError;
+
+ComputePool::ComputePool(unsigned int threads, std::size_t queue_limit)
+	:queue_limit(queue_limit)
+{
+	if (threads < 1) threads = 1;
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back([this]{worker();});
+	}
+}
+
+ComputePool::~ComputePool() {
+	{
+		std::unique_lock _(lock);
+		stopped = true;
+		queue.clear();
+	}
+	cond.notify_all();
+	for (auto &t: workers) t.join();
+}
+
+bool ComputePool::run(Job &&job) {
+	{
+		std::unique_lock _(lock);
+		if (stopped || queue.size() >= queue_limit) return false;
+		queue.push_back(std::move(job));
+	}
+	cond.notify_one();
+	return true;
+}
+
+std::size_t ComputePool::getQueueLength() const {
+	std::unique_lock _(lock);
+	return queue.size();
+}
+
+void ComputePool::lowerThreadPriority() {
+	//on linux, nice value is per thread
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+}
+
+bool ComputePool::parallel(unsigned int count, const std::function<void(unsigned int)> &fn, const std::function<bool()> &poll) {
+	//state is shared with the helpers, which can start after the call returned
+	struct State {
+		const std::function<void(unsigned int)> *fn;
+		unsigned int count;
+		std::atomic<unsigned int> next = 0;
+		std::atomic<bool> stop = false;
+		std::mutex lock;
+		std::condition_variable cond;
+		unsigned int running = 0;
+		std::exception_ptr error;
+
+		bool processNext() {
+			if (stop) return false;
+			unsigned int idx = next++;
+			if (idx >= count) return false;
+			try {
+				(*fn)(idx);
+			} catch (...) {
+				std::unique_lock _(lock);
+				if (!error) error = std::current_exception();
+				stop = true;
+			}
+			return true;
+		}
+	};
+
+	if (count == 0) return true;
+	auto st = std::make_shared<State>();
+	st->fn = &fn;
+	st->count = count;
+
+	unsigned int helpers = std::min(getThreadCount(), count) - 1;
+	for (unsigned int i = 0; i < helpers; i++) {
+		bool ok = run([st]{
+			{
+				std::unique_lock _(st->lock);
+				++st->running;
+			}
+			//the caller waits while running is not zero, so the function is still valid
+			while (st->processNext()) {}
+			std::unique_lock _(st->lock);
+			--st->running;
+			st->cond.notify_all();
+		});
+		if (!ok) break;
+	}
+
+	bool canceled = false;
+	auto next_poll = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	auto checkPoll = [&]{
+		auto now = std::chrono::steady_clock::now();
+		if (now >= next_poll) {
+			next_poll = now + std::chrono::seconds(1);
+			if (poll && !poll()) {
+				canceled = true;
+				st->stop = true;
+			}
+		}
+	};
+	while (st->processNext()) checkPoll();
+
+	std::unique_lock lk(st->lock);
+	while (st->running) {
+		st->cond.wait_until(lk, next_poll);
+		lk.unlock();
+		checkPoll();
+		lk.lock();
+	}
+	if (st->error) std::rethrow_exception(st->error);
+	return !canceled;
+}
+
+void ComputePool::worker() {
+	lowerThreadPriority();
+
+	std::unique_lock lk(lock);
+	while (true) {
+		cond.wait(lk, [&]{return stopped || !queue.empty();});
+		if (stopped) break;
+		Job job = std::move(queue.front());
+		queue.pop_front();
+		lk.unlock();
+		try {
+			job();
+		} catch (std::exception &e) {
+			logError("Compute job failed: $1", e.what());
+		} catch (...) {
+			logError("Compute job failed: unknown exception");
+		}
+		job = nullptr;
+		lk.lock();
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * computepool.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_COMPUTEPOOL_H_
+#define SRC_MAIN_COMPUTEPOOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///Thread pool for long running computations (backtests, visualizations)
+/**
+ * The pool has fixed count of threads and bounded queue. It is separated from the http
+ * threads, so heavy computation never blocks serving of the other requests. Threads
+ * run with lowered priority, so they don't delay the trading cycle.
+ */
+class ComputePool {
+public:
+
+	using Job = std::function<void()>;
+
+	///Construct the pool
+	/**
+	 * @param threads count of threads (at least one thread is always created)
+	 * @param queue_limit maximum count of jobs waiting in the queue
+	 */
+	ComputePool(unsigned int threads, std::size_t queue_limit);
+	///Stops the pool - waiting jobs are dropped, running jobs are finished
+	~ComputePool();
+
+	ComputePool(const ComputePool &) = delete;
+	ComputePool &operator=(const ComputePool &) = delete;
+
+	///Enqueues the job
+	/**
+	 * @param job job to run
+	 * @retval true job enqueued
+	 * @retval false queue is full, job was not enqueued
+	 */
+	bool run(Job &&job);
+
+	///Returns count of jobs waiting in the queue
+	std::size_t getQueueLength() const;
+
+	///Returns count of threads of the pool
+	unsigned int getThreadCount() const {return static_cast<unsigned int>(workers.size());}
+
+	///Lowers priority of the current thread to priority of the pool's threads
+	/** Use for helper threads started by the jobs */
+	static void lowerThreadPriority();
+
+	///Calls the function for indexes 0..count-1 in parallel
+	/**
+	 * It is intended to be called from a job. The calling thread processes the indexes and
+	 * idle threads of the pool help it, so no additional threads are created. Helpers are
+	 * enqueued only if there is room in the queue, the call doesn't wait for helpers which
+	 * were not started.
+	 *
+	 * @param count count of indexes
+	 * @param fn function called for each index. When it throws an exception, remaining
+	 * indexes are skipped and the exception is rethrown
+	 * @param poll function called by the calling thread approximately once per second. It
+	 * can return false to stop processing (for example to report progress and cancel)
+	 * @retval true all indexes processed
+	 * @retval false processing was stopped by the poll function
+	 */
+	bool parallel(unsigned int count, const std::function<void(unsigned int)> &fn, const std::function<bool()> &poll = nullptr);
+
+protected:
+	mutable std::mutex lock;
+	std::condition_variable cond;
+	std::deque<Job> queue;
+	std::vector<std::thread> workers;
+	std::size_t queue_limit;
+	bool stopped = false;
+
+	void worker();
+};
+
+using PComputePool = std::shared_ptr<ComputePool>;
+
+
+#endif /* SRC_MAIN_COMPUTEPOOL_H_ */
@@ -0,0 +1,176 @@
+/*
+ * datasetparser.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "datasetparser.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+///Longest accepted number (longer token is considered as invalid)
+static constexpr std::size_t maxTokenLength = 64;
+
+DatasetParser::DatasetParser(std::size_t max_rows):max_rows(max_rows) {}
+
+void DatasetParser::feed(const std::string_view &data) {
+	for (char c: data) parseChar(c);
+}
+
+void DatasetParser::parseChar(char c) {
+	if (c == '\n') line++;
+	if (quoted) {
+		if (c == '"') quoted = false;
+		else if (token.size() < maxTokenLength+1) token.push_back(c);
+		return;
+	}
+	switch (format) {
+		case Format::detect:
+			//skip whitespaces and UTF-8 BOM
+			if (std::isspace(static_cast<unsigned char>(c)) || (c & 0x80)) return;
+			format = c == '['?Format::json:Format::csv;
+			parseChar(c);
+			return;
+		case Format::json:
+			if (done) {
+				if (!std::isspace(static_cast<unsigned char>(c))) error("Unexpected data after the end of the array");
+				return;
+			}
+			switch (c) {
+				case '[':
+					if (++depth > 3) error("Nested arrays are not supported");
+					if (depth == 2) row_content = true;
+					if (depth == 3) {
+						//range of the trade follows time and price
+						if (field_count != 2 || has_range_field) row_invalid = true;
+						has_range_field = true;
+					}
+					return;
+				case ']':
+					if (depth == 0) error("Unexpected ']'");
+					endField();
+					if (--depth == 0) {
+						endRow();
+						done = true;
+					}
+					return;
+				case ',':
+					if (depth == 0) error("Unexpected ','");
+					endField();
+					if (depth == 1) endRow();
+					return;
+				case '{':
+				case '}':
+				case ':':
+					error("Objects are not supported");
+				default:
+					break;
+			}
+			if (depth == 0) error("Expected '['");
+			break;
+		case Format::csv:
+			switch (c) {
+				case '\n':
+					endField();
+					endRow();
+					return;
+				case ',':
+				case ';':
+				case '\t':
+					endField();
+					return;
+				default:
+					break;
+			}
+			break;
+	}
+	if (c == '"') {
+		quoted = true;
+		row_content = true;
+	} else if (std::isspace(static_cast<unsigned char>(c))) {
+		endField();
+	} else if (token.size() < maxTokenLength+1) {
+		token.push_back(c);
+	}
+}
+
+void DatasetParser::endField() {
+	if (token.empty()) return;
+	row_content = true;
+	double v;
+	const char *beg = token.data();
+	const char *end = beg+token.size();
+	if (*beg == '+') ++beg;
+	auto r = std::from_chars(beg, end, v);
+	if (token.size() > maxTokenLength || r.ec != std::errc() || r.ptr != end || !std::isfinite(v)) {
+		row_invalid = true;
+	} else if (depth == 3) {
+		if (range_count < 2) range[range_count++] = v;
+		else row_invalid = true;
+	} else if (field_count < 2) {
+		fields[field_count++] = v;
+	}
+	token.clear();
+}
+
+void DatasetParser::endRow() {
+	if (row_content) {
+		Kind k = field_count == 1?Kind::prices:Kind::trades;
+		if (row_invalid || field_count == 0 || (kind != Kind::unknown && k != kind)
+				|| (k == Kind::trades && fields[0] < 0)
+				|| (has_range_field && range_count != 2)) {
+			skipped++;
+			if (kind == Kind::unknown) header++;
+		} else {
+			if (prices.size() >= max_rows) error("Too many rows");
+			kind = k;
+			if (k == Kind::trades) {
+				if (has_range_field && pmins.size() < prices.size()) {
+					//first row with range, previous rows have range of the price
+					pmins = prices;
+					pmaxs = prices;
+				}
+				if (!pmins.empty() || has_range_field) {
+					pmins.push_back(has_range_field?range[0]:fields[1]);
+					pmaxs.push_back(has_range_field?range[1]:fields[1]);
+				}
+				times.push_back(static_cast<std::uint64_t>(fields[0]));
+				prices.push_back(fields[1]);
+			} else {
+				prices.push_back(fields[0]);
+			}
+		}
+	}
+	row_invalid = false;
+	row_content = false;
+	field_count = 0;
+	range_count = 0;
+	has_range_field = false;
+}
+
+void DatasetParser::finish() {
+	if (quoted) error("Unterminated string");
+	if (format == Format::json) {
+		if (!done) error("Unexpected end of the data");
+	} else {
+		endField();
+		endRow();
+	}
+	if (prices.empty()) throw std::runtime_error("No data found");
+	//same tolerance as the import in the web interface, rows before the first valid row are headers
+	if ((skipped-header)*10 > prices.size()) throw std::runtime_error("Too many invalid rows ("+std::to_string(skipped)+")");
+}
+
+json::Value DatasetParser::getRow(std::size_t idx) const {
+	if (kind != Kind::trades) return prices[idx];
+	if (pmins.empty()) return json::Value(json::array, {times[idx], prices[idx]});
+	return json::Value(json::array, {times[idx], prices[idx], json::Value(json::array, {pmins[idx], pmaxs[idx]})});
+}
+
+void DatasetParser::error(const char *msg) const {
+	throw std::runtime_error(std::string(msg)+" (line "+std::to_string(line)+")");
+}
@@ -0,0 +1,107 @@
+/*
+ * datasetparser.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_DATASETPARSER_H_
+#define SRC_MAIN_DATASETPARSER_H_
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imtjson/value.h>
+
+///Incremental parser of the uploaded backtest datasets
+/**
+ * Accepts data in chunks as they arrive from the request, so the body is never held in
+ * the memory. Parsed values are stored in compact columns.
+ *
+ * Supported formats
+ * - json array of prices: [1.5, 1.6, ...] - minute chart
+ * - json array of pairs: [[time, price], ...] - trades
+ * - json array of trades with range: [[time, price, [pmin, pmax]], ...] - trades generated
+ *   by gen_trades, which are uploaded again, when the stored data expired
+ * - CSV, row per line, fields separated by ',', ';' or tab. Row with one field is price,
+ *   row with two or more fields is time and price
+ *
+ * Numbers can be quoted. The kind of the dataset is determined by the first valid row, rows
+ * of the other kind and rows which cannot be parsed (for example CSV header) are skipped.
+ *
+ * Errors are reported by exceptions (std::runtime_error)
+ */
+class DatasetParser {
+public:
+
+	enum class Kind {
+		///not known yet (no valid row)
+		unknown,
+		///minute prices
+		prices,
+		///trades (time in milliseconds, price)
+		trades
+	};
+
+	///Construct parser
+	/**
+	 * @param max_rows maximum count of rows, parser throws exception when it is exceeded
+	 */
+	explicit DatasetParser(std::size_t max_rows);
+
+	///Parses next chunk of the data
+	void feed(const std::string_view &data);
+	///Finishes parsing, validates whole dataset
+	void finish();
+
+	Kind getKind() const {return kind;}
+	///Count of accepted rows
+	std::size_t getRows() const {return prices.size();}
+	///Count of skipped rows
+	std::size_t getSkipped() const {return skipped;}
+
+	///Returns row of the dataset in the format used by the backtest storage
+	/**
+	 * The dataset is array of rows. It is not built in the memory, rows are serialized
+	 * directly to the storage (see BacktestStorage::store_array)
+	 *
+	 * @param idx index of the row (0..getRows()-1)
+	 */
+	json::Value getRow(std::size_t idx) const;
+
+protected:
+	enum class Format {detect, json, csv};
+
+	std::size_t max_rows;
+	Format format = Format::detect;
+	Kind kind = Kind::unknown;
+	unsigned int depth = 0;
+	bool quoted = false;
+	bool done = false;
+	bool row_invalid = false;
+	bool row_content = false;
+	std::string token;
+	double fields[2];
+	unsigned int field_count = 0;
+	///range of the trade (pmin, pmax)
+	double range[2];
+	unsigned int range_count = 0;
+	bool has_range_field = false;
+	std::size_t line = 1;
+
+	std::vector<double> prices;
+	std::vector<std::uint64_t> times;
+	///columns of the ranges, filled since first row with the range
+	std::vector<double> pmins, pmaxs;
+	std::size_t skipped = 0;
+	std::size_t header = 0;
+
+	void parseChar(char c);
+	void endField();
+	void endRow();
+	[[noreturn]] void error(const char *msg) const;
+};
+
+
+#endif /* SRC_MAIN_DATASETPARSER_H_ */
@@ -12,14 +12,19 @@
 
 #include <imtjson/object.h>
 #include <imtjson/binary.h>
+#include <imtjson/objectShape.h>
 #include <fstream>
+#include <map>
 #include <set>
 
 #include "../shared/finally.h"
+#include "perfstats.h"
 using namespace ondra_shared;
 
 
 
+unsigned int ExtStockApi::max_inflight = 4;
+
 ExtStockApi::ExtStockApi(const std::string_view & workingDir, const std::string_view & name, const std::string_view & cmdline, int timeout)
 :connection(std::make_shared<Connection>(workingDir, name, cmdline, timeout)) {
 }
@@ -27,10 +32,11 @@ ExtStockApi::ExtStockApi(const std::string_view & workingDir, const std::string_
 
 
 double ExtStockApi::getBalance(const std::string_view & symb, const std::string_view & pair) {
-	return requestExchange("getBalance",
+	return mdcache.getBalance(symb, pair, [&]{
+		return requestExchange("getBalance",
 			json::Object({{"pair", pair},
 						{"symbol", symb}})).getNumber();
-
+	});
 }
 
 
@@ -39,6 +45,8 @@ ExtStockApi::TradesSync ExtStockApi::syncTrades(json::Value lastId, const std::s
 														{"pair",pair}}));
 	TradeHistory  th;
 	for (json::Value v: r["trades"]) th.push_back(Trade::fromJSON(v));
+	//executed trades change balances and can change fees
+	if (!th.empty()) mdcache.invalidateAccount();
 	return TradesSync {
 		th, r["lastId"]
 	};
@@ -61,19 +69,24 @@ ExtStockApi::Orders ExtStockApi::getOpenOrders(const std::string_view & pair) {
 }
 
 ExtStockApi::Ticker ExtStockApi::getTicker(const std::string_view & pair) {
-	auto resp =  requestExchange("getTicker", pair);
-	return Ticker {
-		resp["bid"].getNumber(),
-		resp["ask"].getNumber(),
-		resp["last"].getNumber(),
-		resp["timestamp"].getUIntLong(),
-	};
+	static const json::InternedKey k_bid("bid"), k_ask("ask"), k_last("last"), k_timestamp("timestamp");
+	return mdcache.getTicker(pair, [&]{
+		auto resp =  requestExchange("getTicker", pair);
+		return Ticker {
+			resp[k_bid].getNumber(),
+			resp[k_ask].getNumber(),
+			resp[k_last].getNumber(),
+			resp[k_timestamp].getUIntLong(),
+		};
+	});
 }
 
 json::Value  ExtStockApi::placeOrder(const std::string_view & pair,
 		double size, double price,json::Value clientId,
 		json::Value replaceId,double replaceSize) {
 
+	//even failed request could place the order
+	auto inv = ondra_shared::finally([&]{mdcache.invalidateBalances();});
 	return requestExchange("placeOrder",json::Object({
 		{"pair",pair},
 		{"price",price},
@@ -84,6 +97,38 @@ json::Value  ExtStockApi::placeOrder(const std::string_view & pair,
 }
 
 
+std::vector<ExtStockApi::NewOrderResult> ExtStockApi::placeOrders(const std::string_view &pair, const std::vector<NewOrder> &orders) {
+	if (orders.size() < 2 || connection->no_batch_orders) return IStockApi::placeOrders(pair, orders);
+	json::Value req = json::Object({
+		{"pair", pair},
+		{"orders", json::Value(json::array, orders.begin(), orders.end(), [](const NewOrder &o) {
+			return json::Object({
+				{"price",o.price},
+				{"size",o.size},
+				{"clientOrderId",o.clientId},
+				{"replaceOrderId",o.replaceId},
+				{"replaceOrderSize",o.replaceSize}});
+		})}
+	});
+	json::Value resp;
+	auto inv = ondra_shared::finally([&]{mdcache.invalidateBalances();});
+	try {
+		resp = requestExchange("placeOrders", req);
+	} catch (const AbstractExtern::Exception &e) {
+		if (!e.isResponse() || e.getMsg() != "Method not implemented") throw;
+		connection->no_batch_orders = true;
+		return IStockApi::placeOrders(pair, orders);
+	}
+	std::vector<NewOrderResult> res;
+	res.reserve(orders.size());
+	for (json::Value r: resp) {
+		if (r[0].getBool()) res.push_back({r[1], std::string()});
+		else res.push_back({json::Value(), AbstractExtern::Exception(r[1].toString().str(), connection->getName(), "placeOrder", true).what()});
+	}
+	if (res.size() != orders.size()) throw std::runtime_error("placeOrders: invalid response");
+	return res;
+}
+
 void ExtStockApi::reset(const std::chrono::system_clock::time_point &tp) {
 	std::unique_lock _(connection->getLock());
 
@@ -93,15 +138,16 @@ void ExtStockApi::reset(const std::chrono::system_clock::time_point &tp) {
 		} catch (...) {
 			requestExchange("reset",json::Value());
 		}
+		mdcache.newCycle();
 		lastReset = tp;
 	}
 }
 
 ExtStockApi::MarketInfo ExtStockApi::getMarketInfo(const std::string_view & pair) {
-	json::Value v = requestExchange("getInfo",pair);
-
-	return MarketInfo::fromJSON(v);
-
+	return mdcache.getMarketInfo(pair, [&]{
+		json::Value v = requestExchange("getInfo",pair);
+		return MarketInfo::fromJSON(v);
+	});
 }
 
 
@@ -115,6 +161,7 @@ std::vector<std::string> ExtStockApi::getAllPairs() {
 
 void ExtStockApi::Connection::onConnect() {
 	binary_mode = false;
+	no_batch_orders = false;
 	try {
 		jsonRequestExchange("bin", json::Value());
 		binary_mode = true;
@@ -130,6 +177,14 @@ void ExtStockApi::Connection::onConnect() {
 
 		}
 	}
+	if (max_inflight > 1) {
+		try {
+			jsonRequestExchange("mux", max_inflight);
+			mux_mode = true;
+		} catch (AbstractExtern::Exception &) {
+			//broker doesn't support multiplexing
+		}
+	}
 	broker_info = jsonRequestExchange("getBrokerInfo", json::Value());
 	instance_counter++;
 }
@@ -181,6 +236,7 @@ ExtStockApi::BrokerInfo ExtStockApi::getBrokerInfo()  {
 }
 
 void ExtStockApi::setApiKey(json::Value keyData) {
+	mdcache.newCycle();
 	requestExchange("setApiKey",keyData);
 	connection->refreshBrokerInfo();
 }
@@ -194,6 +250,7 @@ json::Value ExtStockApi::getSettings(const std::string_view & pairHint) const {
 }
 
 json::Value ExtStockApi::setSettings(json::Value v) {
+	mdcache.newCycle();
 	return (broker_config = requestExchange("setSettings", v));
 }
 
@@ -224,7 +281,19 @@ ExtStockApi::PageData ExtStockApi::fetchPage(const std::string_view &method,
 	return presp;
 }
 
+///Returns histogram of the broker's command, histograms are cached per thread
+static PerfHistogram &brokerHistogram(const std::string_view &name) {
+	thread_local std::map<std::string, PerfHistogram *, std::less<> > cache;
+	auto iter = cache.find(name);
+	if (iter == cache.end()) {
+		PerfHistogram &h = PerfStats::global().get(std::string("broker.").append(name));
+		iter = cache.emplace(std::string(name), &h).first;
+	}
+	return *iter->second;
+}
+
 json::Value ExtStockApi::requestExchange(json::String name, json::Value args) {
+	PerfProbe probe(brokerHistogram(name.str()));
 	lastActivity = std::chrono::system_clock::now();
 	if (connection->wasRestarted(instance_counter)) {
 		if (broker_config.defined()) {
@@ -244,6 +313,11 @@ json::Value ExtStockApi::requestExchange(json::String name, json::Value args) {
 
 void ExtStockApi::unload() {
 	connection->stop();
+	mdcache.newCycle();
+}
+
+MarketDataCache::PSnapshot ExtStockApi::getMarketSnapshot() const {
+	return mdcache.getSnapshot();
 }
 
 bool ExtStockApi::Connection::wasRestarted(int& counter) {
@@ -267,21 +341,23 @@ json::Value ExtStockApi::getMarkets() const {
 }
 
 ExtStockApi::AllWallets ExtStockApi::getWallet()  {
-	AllWallets w;
-	auto resp = requestExchange("getWallet",json::Value());
-	for (json::Value x: resp) {
-		Wallet sw;
-		for (json::Value y: x) {
-			if (y.getNumber()) {
-				sw.wallet.push_back({
-					y.getKey(), y.getNumber()
-				});
+	return mdcache.getWallet([&]{
+		AllWallets w;
+		auto resp = requestExchange("getWallet",json::Value());
+		for (json::Value x: resp) {
+			Wallet sw;
+			for (json::Value y: x) {
+				if (y.getNumber()) {
+					sw.wallet.push_back({
+						y.getKey(), y.getNumber()
+					});
+				}
 			}
+			sw.walletId = x.getKey();
+			w.push_back(sw);
 		}
-		sw.walletId = x.getKey();
-		w.push_back(sw);
-	}
-	return w;
+		return w;
+	});
 }
 
 bool ExtStockApi::areMinuteDataAvailable(const std::string_view &asset, const std::string_view &currency) {
@@ -14,6 +14,7 @@
 #include "abstractExtern.h"
 #include "apikeys.h"
 #include "ibrokercontrol.h"
+#include "marketdata.h"
 
 
 
@@ -22,7 +23,8 @@ class ExtStockApi: public IStockApi,
 				   public IBrokerControl,
 				   public IBrokerSubaccounts,
 				   public IHistoryDataSource,
-				   public IBrokerInstanceControl
+				   public IBrokerInstanceControl,
+				   public IMarketDataSource
 				   {
 public:
 
@@ -38,6 +40,7 @@ public:
 	virtual json::Value placeOrder(const std::string_view & pair,
 			double size, double price,json::Value clientId,
 			json::Value replaceId,double replaceSize) override;
+	virtual std::vector<NewOrderResult> placeOrders(const std::string_view &pair, const std::vector<NewOrder> &orders) override;
 	virtual void reset(const std::chrono::system_clock::time_point &tp) override;
 	virtual MarketInfo getMarketInfo(const std::string_view & pair) override;
 	virtual std::vector<std::string> getAllPairs() override;
@@ -56,6 +59,7 @@ public:
 	virtual json::Value getMarkets() const override;
 	virtual AllWallets getWallet()  override;
 	virtual bool areMinuteDataAvailable(const std::string_view &asset, const std::string_view &currency) override;
+	virtual MarketDataCache::PSnapshot getMarketSnapshot() const override;
 	virtual std::uint64_t downloadMinuteData(const std::string_view &asset,
 					  const std::string_view &currency,
 					  const std::string_view &hint_pair,
@@ -66,7 +70,12 @@ public:
 
 
 
+	///Sets maximum count of requests in flight for the brokers connected later (1 - disable multiplexing)
+	static void setMaxInflight(unsigned int count) {max_inflight = count;}
+
 protected:
+	static unsigned int max_inflight;
+
 	class Connection: public AbstractExtern {
 	public:
 		using AbstractExtern::AbstractExtern;
@@ -81,6 +90,8 @@ protected:
 		void refreshBrokerInfo();
 		std::chrono::system_clock::time_point getLastActivity();
 		json::Value jsonRequestExchange(json::String name, json::Value args);
+		///broker doesn't implement the command placeOrders (older brokers)
+		std::atomic<bool> no_batch_orders = false;
 	protected:
 		std::atomic<int> instance_counter = 0;
 		json::Value broker_info;
@@ -92,6 +103,7 @@ protected:
 	int instance_counter = 0;
 	std::string subaccount;
 	std::chrono::system_clock::time_point lastActivity, lastReset;
+	MarketDataCache mdcache;
 
 	ExtStockApi(std::shared_ptr<Connection> connection, const std::string &subaccid);
 };
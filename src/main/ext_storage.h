@@ -39,6 +39,10 @@ protected:
 		Handle(std::string name,ondra_shared::RefCntPtr<Proxy> proxy);
 		~Handle();
 
+		///Stores data
+		/** The broker can confirm the request before the data are written (write-behind). In this
+		 * case, failure of such write is reported as exception of the next call
+		 */
 		virtual void store(json::Value data) override;
 		virtual json::Value load()  override;
 		virtual void erase()  override;
@@ -14,6 +14,7 @@
 #include <memory>
 #include <optional>
 
+#include "acb.h"
 #include "istockapi.h"
 
 struct MTrader_Config;
@@ -119,9 +120,58 @@ public:
 
 	};
 
+	///Aggregated values of the trades, which are needed to continue the calculation of the report
+	/**
+	 * It is used as checkpoint of the archived trades, which are no longer passed to the
+	 * report. The calculation is implemented in report.cpp
+	 */
+	struct TradesAggregate {
+		///count of aggregated trades (updated by addAll())
+		std::size_t count = 0;
+		///price of the last trade
+		double prev_price = 0;
+		///profit from position
+		double pl = 0;
+		///position after the last trade
+		double pos = 0;
+		///last normalized profit
+		double pnp = 0;
+		///last normalized accumulation
+		double pap = 0;
+		ACB acb = ACB(0,0);
+		bool normaccum = false;
+		///id of the last record
+		int iid = 0;
+
+		struct Change {
+			double gain;
+			double normch;
+		};
+
+		///Starts aggregation at the price of the first trade and the position before the first trade
+		static TradesAggregate start(double price, double pos);
+		///Returns true, when the trade can be merged with the previous trade to a single record
+		static bool canMerge(const TradeRecord &prev, const TradeRecord &t);
+		///Merges two trades to a single record
+		static TradeRecord merge(const TradeRecord &prev, const TradeRecord &t);
+		///Adds a record (single or merged trade)
+		Change add(const TradeRecord &t);
+		///Adds trades, merges the trades in the same way as the report
+		void addAll(ondra_shared::StringView<TradeRecord> trades);
+
+		json::Value toJSON() const;
+		static TradesAggregate fromJSON(json::Value v);
+	};
+
 	virtual void reportOrders(int n, const std::optional<IStockApi::Order> &buy,
 							  const std::optional<IStockApi::Order> &sell) = 0;
-	virtual void reportTrades(double finalPos, ondra_shared::StringView<TradeRecord> trades) = 0;
+	///Reports trades
+	/**
+	 * @param finalPos position after the last trade
+	 * @param trades trades held in the memory
+	 * @param archived aggregate of the archived trades, which precede the trades
+	 */
+	virtual void reportTrades(double finalPos, ondra_shared::StringView<TradeRecord> trades, const TradesAggregate &archived) = 0;
 	virtual void reportPrice(double price) = 0;
 	virtual void setInfo(const Info &info) = 0;
 	virtual void reportMisc(const MiscData &miscData, bool initial = false) = 0;
@@ -10,23 +10,53 @@
 
 #include <cmath>
 #include <imtjson/object.h>
+#include <imtjson/objectShape.h>
 #include <shared/logOutput.h>
 #include "sgn.h"
 
 using ondra_shared::logDebug;
 
+///keys of records parsed in large quantities (trades, market info)
+/**
+ * Trades and market info have shapes (see ObjectShape::minKeys), so the lookup through
+ * the interned key doesn't calculate the hash nor compare the strings
+ */
+namespace {
+	const json::InternedKey k_id("id");
+	const json::InternedKey k_time("time");
+	const json::InternedKey k_size("size");
+	const json::InternedKey k_price("price");
+	const json::InternedKey k_fee("fee");
+	const json::InternedKey k_eff_size("eff_size");
+	const json::InternedKey k_eff_price("eff_price");
+	const json::InternedKey k_asset_step("asset_step");
+	const json::InternedKey k_currency_step("currency_step");
+	const json::InternedKey k_asset_symbol("asset_symbol");
+	const json::InternedKey k_currency_symbol("currency_symbol");
+	const json::InternedKey k_min_size("min_size");
+	const json::InternedKey k_min_volume("min_volume");
+	const json::InternedKey k_fees("fees");
+	const json::InternedKey k_feeScheme("feeScheme");
+	const json::InternedKey k_leverage("leverage");
+	const json::InternedKey k_invert_price("invert_price");
+	const json::InternedKey k_simulator("simulator");
+	const json::InternedKey k_inverted_symbol("inverted_symbol");
+	const json::InternedKey k_private_chart("private_chart");
+	const json::InternedKey k_wallet_id("wallet_id");
+}
+
 IStockApi::Trade IStockApi::Trade::fromJSON(json::Value x) {
 
-	json::Value f = x["fee"];
-	double size = x["size"].getNumber();
-	double price = x["price"].getNumber();
+	json::Value f = x[k_fee];
+	double size = x[k_size].getNumber();
+	double price = x[k_price].getNumber();
 
 	if (f.defined()) {
-		double fee = x["fee"].getNumber();
+		double fee = f.getNumber();
 
 		return IStockApi::Trade {
-			x["id"].stripKey(),
-			x["time"].getUIntLong(),
+			x[k_id].stripKey(),
+			x[k_time].getUIntLong(),
 			size,
 			price,
 			size,
@@ -34,12 +64,12 @@ IStockApi::Trade IStockApi::Trade::fromJSON(json::Value x) {
 		};
 	} else {
 		return IStockApi::Trade {
-			x["id"].stripKey(),
-			x["time"].getUIntLong(),
+			x[k_id].stripKey(),
+			x[k_time].getUIntLong(),
 			size,
 			price,
-			x["eff_size"].getNumber(),
-			x["eff_price"].getNumber()
+			x[k_eff_size].getNumber(),
+			x[k_eff_price].getNumber()
 		};
 	}
 
@@ -175,20 +205,20 @@ return json::Object({
 }
 IStockApi::MarketInfo IStockApi::MarketInfo::fromJSON(const json::Value &v) {
 	MarketInfo res;
-	res.asset_step = v["asset_step"].getNumber();
-	res.currency_step = v["currency_step"].getNumber();
-	res.asset_symbol = v["asset_symbol"].getString();
-	res.currency_symbol = v["currency_symbol"].getString();
-	res.min_size = v["min_size"].getNumber();
-	res.min_volume= v["min_volume"].getNumber();
-	res.fees = v["fees"].getNumber();
-	res.feeScheme = strFeeScheme[v["feeScheme"].getString()];
-	res.leverage= v["leverage"].getNumber();
-	res.invert_price= v["invert_price"].getBool();
-	res.simulator= v["simulator"].getBool();
-	res.inverted_symbol= v["inverted_symbol"].getString();
-	res.private_chart = v["private_chart"].getBool();
-	res.wallet_id = v["wallet_id"].getString();
+	res.asset_step = v[k_asset_step].getNumber();
+	res.currency_step = v[k_currency_step].getNumber();
+	res.asset_symbol = v[k_asset_symbol].getString();
+	res.currency_symbol = v[k_currency_symbol].getString();
+	res.min_size = v[k_min_size].getNumber();
+	res.min_volume= v[k_min_volume].getNumber();
+	res.fees = v[k_fees].getNumber();
+	res.feeScheme = strFeeScheme[v[k_feeScheme].getString()];
+	res.leverage= v[k_leverage].getNumber();
+	res.invert_price= v[k_invert_price].getBool();
+	res.simulator= v[k_simulator].getBool();
+	res.inverted_symbol= v[k_inverted_symbol].getString();
+	res.private_chart = v[k_private_chart].getBool();
+	res.wallet_id = v[k_wallet_id].getString();
 	return res;
 }
 
@@ -208,3 +238,16 @@ double IStockApi::MarketInfo::tickToPrice(std::int64_t tick) const {
 }
 
 
+
+std::vector<IStockApi::NewOrderResult> IStockApi::placeOrders(const std::string_view &pair, const std::vector<NewOrder> &orders) {
+	std::vector<NewOrderResult> res;
+	res.reserve(orders.size());
+	for (const NewOrder &o: orders) {
+		try {
+			res.push_back({placeOrder(pair, o.size, o.price, o.clientId, o.replaceId, o.replaceSize), std::string()});
+		} catch (std::exception &e) {
+			res.push_back({json::Value(), e.what()});
+		}
+	}
+	return res;
+}
@@ -16,6 +16,8 @@
 #include <imtjson/namedEnum.h>
 #include <memory>
 #include <limits>
+#include <string>
+#include <vector>
 
 ///Interface definition for accessing a stockmarket
 /** Contains minimal set of operations need to be implemented to access the stockmarket */
@@ -262,6 +264,36 @@ public:
 			json::Value clientId = json::Value(),
 			json::Value replaceId = json::Value(),
 			double replaceSize = 0) = 0;
+
+	///One operation of the batch (see placeOrders)
+	struct NewOrder {
+		double size;
+		double price;
+		json::Value clientId;
+		json::Value replaceId;
+		double replaceSize;
+	};
+
+	///Result of one operation of the batch
+	struct NewOrderResult {
+		///Result of the operation, see placeOrder()
+		json::Value id;
+		///Error message, when the operation failed (id is not valid in this case)
+		std::string error;
+	};
+
+	///Place, replace or cancel multiple orders of the same pair at once
+	/**
+	 * @param pair pair identifier
+	 * @param orders operations, meaning of the fields is same as arguments of the placeOrder().
+	 * Operations are executed in the order, failure of one operation doesn't stop the others
+	 * @return results of the operations in the same order
+	 *
+	 * Default implementation calls placeOrder() for every operation. Brokers which support
+	 * batch operations can override it to save round trips
+	 */
+	virtual std::vector<NewOrderResult> placeOrders(const std::string_view &pair, const std::vector<NewOrder> &orders);
+
 	///Reset the API
 	/**
 	 * @param tp time point for which reset is called. Multiple calls with the same timepoint
@@ -0,0 +1,292 @@
+/*
+ * lanes.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "lanes.h"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perfstats.h"
+#include "../shared/logOutput.h"
+
+using ondra_shared::logError;
+
+class LaneScheduler::Core {
+public:
+
+	struct Item {
+		TimePoint tp;
+		std::size_t seq;
+		Duration interval;
+		Msg msg;
+		std::size_t id;
+	};
+
+	struct LaterItem {
+		bool operator()(const Item &a, const Item &b) const {
+			return a.tp == b.tp?a.seq > b.seq:a.tp > b.tp;
+		}
+	};
+
+	Core(const std::string &name)
+		:delay_hist(PerfStats::global().get("lane."+name+".delay"))
+		,task_hist(PerfStats::global().get("lane."+name+".task")) {}
+
+	std::size_t push(const TimePoint &tp, const Duration &interval, Msg &&msg) {
+		std::size_t id;
+		{
+			std::unique_lock _(lock);
+			id = ++idcounter;
+			pushLk(Item{tp, 0, interval, std::move(msg), id});
+		}
+		cond.notify_one();
+		return id;
+	}
+
+	bool remove(std::size_t id) {
+		std::unique_lock _(lock);
+		auto iter = std::find_if(queue.begin(), queue.end(), [&](const Item &itm){return itm.id == id;});
+		if (iter == queue.end()) {
+			//repeating task can be running now, it will not be rescheduled
+			if (std::find(running_ids.begin(), running_ids.end(), id) != running_ids.end()) {
+				removed_ids.push_back(id);
+			}
+			return false;
+		}
+		queue.erase(iter);
+		std::make_heap(queue.begin(), queue.end(), LaterItem());
+		return true;
+	}
+
+	void removeAll() {
+		std::vector<Item> tmp;
+		std::unique_lock _(lock);
+		//items are destroyed outside of the lock
+		std::swap(tmp, queue);
+		removed_ids.insert(removed_ids.end(), running_ids.begin(), running_ids.end());
+	}
+
+	void broadcast(Msg &&msg) {
+		{
+			std::unique_lock _(lock);
+			broadcasts.push_back(std::move(msg));
+		}
+		cond.notify_all();
+	}
+
+	std::size_t size() const {
+		std::unique_lock _(lock);
+		return queue.size();
+	}
+
+	void stop() {
+		std::vector<Item> tmp;
+		{
+			std::unique_lock _(lock);
+			stopped = true;
+			std::swap(tmp, queue);
+		}
+		cond.notify_all();
+	}
+
+	void worker(LaneScheduler *owner) {
+		AbstractScheduler::registerOrGetScheduler(true, owner);
+		std::size_t bcnt = 0;
+		std::unique_lock lk(lock);
+		while (!stopped) {
+			if (bcnt < broadcasts.size()) {
+				Msg msg = broadcasts[bcnt++];
+				lk.unlock();
+				execute(msg);
+				msg = nullptr;
+				lk.lock();
+				continue;
+			}
+			if (queue.empty()) {
+				cond.wait(lk);
+				continue;
+			}
+			TimePoint now = Clock::now();
+			TimePoint tp = queue.front().tp;
+			if (tp > now) {
+				cond.wait_until(lk, tp);
+				continue;
+			}
+			runTop(lk, now);
+		}
+	}
+
+	///Runs tasks, which are ready (called from yield)
+	void runReady() {
+		std::unique_lock lk(lock);
+		TimePoint now = Clock::now();
+		while (!stopped && !queue.empty() && queue.front().tp <= now) {
+			runTop(lk, now);
+		}
+	}
+
+protected:
+	mutable std::mutex lock;
+	std::condition_variable cond;
+	std::vector<Item> queue;
+	std::vector<Msg> broadcasts;
+	std::vector<std::size_t> running_ids;
+	std::vector<std::size_t> removed_ids;
+	std::size_t idcounter = 0;
+	std::size_t seqcounter = 0;
+	bool stopped = false;
+	PerfHistogram &delay_hist;
+	PerfHistogram &task_hist;
+
+	void pushLk(Item &&itm) {
+		itm.seq = ++seqcounter;
+		queue.push_back(std::move(itm));
+		std::push_heap(queue.begin(), queue.end(), LaterItem());
+	}
+
+	void runTop(std::unique_lock<std::mutex> &lk, const TimePoint &now) {
+		std::pop_heap(queue.begin(), queue.end(), LaterItem());
+		Item itm = std::move(queue.back());
+		queue.pop_back();
+		running_ids.push_back(itm.id);
+		lk.unlock();
+
+		delay_hist.record(std::chrono::duration_cast<std::chrono::microseconds>(now - itm.tp).count());
+		{
+			PerfProbe probe(task_hist);
+			execute(itm.msg);
+		}
+
+		lk.lock();
+		running_ids.erase(std::find(running_ids.begin(), running_ids.end(), itm.id));
+		auto riter = std::find(removed_ids.begin(), removed_ids.end(), itm.id);
+		if (riter != removed_ids.end()) {
+			removed_ids.erase(riter);
+		} else if (itm.interval > Duration::zero() && !stopped) {
+			itm.tp = now + itm.interval;
+			pushLk(std::move(itm));
+			cond.notify_one();
+			return;
+		}
+		//the task can hold the last reference of the scheduler, release it outside of the lock
+		lk.unlock();
+		itm.msg = nullptr;
+		lk.lock();
+	}
+
+	static void execute(const Msg &msg) {
+		try {
+			msg();
+		} catch (std::exception &e) {
+			logError("Scheduler exception: $1", e.what());
+		} catch (...) {
+			logError("Scheduler exception: unknown exception");
+		}
+	}
+};
+
+static thread_local int lane_nested = 0;
+
+LaneScheduler::LaneScheduler(const std::string &name, unsigned int threads, int nice)
+	:name(name),core(std::make_shared<Core>(name))
+{
+	if (threads < 1) threads = 1;
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back([core = this->core, owner = this, name, nice]{
+			if (nice) {
+				//on linux, nice value is per thread
+				setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice);
+			}
+			pthread_setname_np(pthread_self(), ("lane_"+name).substr(0,15).c_str());
+			core->worker(owner);
+		});
+	}
+}
+
+LaneScheduler::~LaneScheduler() {
+	stop();
+}
+
+void LaneScheduler::stop() {
+	core->stop();
+	for (auto &t: workers) {
+		if (!t.joinable()) continue;
+		//the last reference can be released by a task of the lane
+		if (t.get_id() == std::this_thread::get_id()) t.detach();
+		else t.join();
+	}
+}
+
+std::size_t LaneScheduler::at(const TimePoint &tp, Msg &&msg) {
+	return core->push(tp, Duration::zero(), std::move(msg));
+}
+
+std::size_t LaneScheduler::each(const Duration &dur, Msg &&msg) {
+	return core->push(Clock::now()+dur, dur, std::move(msg));
+}
+
+void LaneScheduler::remove(std::size_t id, std::function<void(bool)> callback) {
+	bool r = core->remove(id);
+	if (callback != nullptr) callback(r);
+}
+
+void LaneScheduler::removeAll(std::function<void()> callback) {
+	core->removeAll();
+	if (callback != nullptr) callback();
+}
+
+void LaneScheduler::immediate(Msg &&msg) {
+	core->push(Clock::now(), Duration::zero(), std::move(msg));
+}
+
+void LaneScheduler::yield() noexcept {
+	lane_nested++;
+	core->runReady();
+	lane_nested--;
+}
+
+bool LaneScheduler::nested() const noexcept {
+	return lane_nested != 0;
+}
+
+void LaneScheduler::broadcast(Msg &&msg) {
+	core->broadcast(std::move(msg));
+}
+
+std::size_t LaneScheduler::getQueueLength() const {
+	return core->size();
+}
+
+
+SchedulerLanes::SchedulerLanes(unsigned int ui_threads)
+	:trading_lane(new LaneScheduler("trading", 1, 0))
+	,ui_lane(new LaneScheduler("ui", ui_threads, 5))
+	,maintenance_lane(new LaneScheduler("maintenance", 1, 10))
+{
+}
+
+void SchedulerLanes::broadcast(const LaneScheduler::Msg &msg) {
+	trading_lane->broadcast(LaneScheduler::Msg(msg));
+	ui_lane->broadcast(LaneScheduler::Msg(msg));
+	maintenance_lane->broadcast(LaneScheduler::Msg(msg));
+}
+
+void SchedulerLanes::removeAll() {
+	trading_lane->removeAll();
+	ui_lane->removeAll();
+	maintenance_lane->removeAll();
+}
+
+void SchedulerLanes::stop() {
+	trading_lane->stop();
+	ui_lane->stop();
+	maintenance_lane->stop();
+}
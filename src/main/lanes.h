@@ -0,0 +1,110 @@
+/*
+ * lanes.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_LANES_H_
+#define SRC_MAIN_LANES_H_
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../shared/scheduler.h"
+
+///Scheduler which runs its tasks on own thread(s)
+/**
+ * The object implements AbstractScheduler, so it can be used everywhere, where ondra_shared::Scheduler
+ * is used. Unlike the BasicScheduler, multiple threads can run tasks of the single instance. Tasks are
+ * ordered by the time, immediate tasks use the current time, so they are executed in order of
+ * arrival (but before tasks scheduled to the future).
+ *
+ * Delay between the planned start and the real start of every task is recorded into histogram
+ * "lane.<name>.delay", duration of the task is recorded into "lane.<name>.task" (see PerfStats)
+ */
+class LaneScheduler: public ondra_shared::AbstractScheduler<std::chrono::steady_clock::time_point> {
+public:
+	using Clock = std::chrono::steady_clock;
+	using TimePoint = Clock::time_point;
+
+	///Construct the lane
+	/**
+	 * @param name name of the lane (used in metrics and as name of the threads)
+	 * @param threads count of threads (at least one thread is always created)
+	 * @param nice nice value of the threads (0 - don't change). Only lowering of the priority is possible
+	 * without privileges
+	 */
+	LaneScheduler(const std::string &name, unsigned int threads, int nice);
+	///Stops the lane - waiting tasks are dropped, running tasks are finished
+	virtual ~LaneScheduler();
+
+	virtual std::size_t at(const TimePoint &tp, Msg &&msg) override;
+	virtual std::size_t each(const Duration &dur, Msg &&msg) override;
+	virtual void remove(std::size_t id, std::function<void(bool)> callback = nullptr) override;
+	virtual void removeAll(std::function<void()> callback = nullptr) override;
+	virtual void immediate(Msg &&msg) override;
+	virtual void yield() noexcept override;
+	virtual bool nested() const noexcept override;
+
+	///Runs the function once on every thread of the lane (for example to initialize thread local variables)
+	/**
+	 * The function is also executed on threads of the lane, which are busy, but after their current task
+	 */
+	void broadcast(Msg &&msg);
+
+	///Returns count of tasks waiting in the queue (including tasks scheduled to the future)
+	std::size_t getQueueLength() const;
+
+	///Stops the lane - waiting tasks are dropped, function waits for running tasks
+	/** Must not be called from the lane */
+	void stop();
+
+	const std::string &getName() const {return name;}
+
+	class Core;
+protected:
+
+	std::string name;
+	std::shared_ptr<Core> core;
+	std::vector<std::thread> workers;
+};
+
+///Named lanes of the service
+/**
+ * Each lane has own threads, so the work of one lane never waits behind the work of the other lane.
+ *
+ * - trading - trading cycle, only one thread, normal priority
+ * - ui - actions dispatched from the web interface
+ * - maintenance - periodic tasks (pings, news, ...), lowered priority
+ */
+class SchedulerLanes {
+public:
+
+	SchedulerLanes(unsigned int ui_threads);
+
+	ondra_shared::Scheduler trading() const {return ondra_shared::Scheduler(trading_lane);}
+	ondra_shared::Scheduler ui() const {return ondra_shared::Scheduler(ui_lane);}
+	ondra_shared::Scheduler maintenance() const {return ondra_shared::Scheduler(maintenance_lane);}
+
+	///Runs the function once on every thread of all lanes
+	void broadcast(const LaneScheduler::Msg &msg);
+
+	///Removes all scheduled tasks from all lanes
+	void removeAll();
+
+	///Stops all lanes, waits for running tasks
+	void stop();
+
+protected:
+	ondra_shared::RefCntPtr<LaneScheduler> trading_lane;
+	ondra_shared::RefCntPtr<LaneScheduler> ui_lane;
+	ondra_shared::RefCntPtr<LaneScheduler> maintenance_lane;
+};
+
+
+#endif /* SRC_MAIN_LANES_H_ */
@@ -39,6 +39,8 @@
 #include "localdailyperfmod.h"
 #include "stats2report.h"
 #include "traders.h"
+#include "lanes.h"
+#include "adaptivecycle.h"
 #include "../../version.h"
 #include "../imtjson/src/imtjson/operations.h"
 #include "../shared/logOutput.h"
@@ -292,7 +294,8 @@ int main(int argc, char **argv) {
 
 						cntr.enableRestart();
 
-						Scheduler sch = ondra_shared::Scheduler::create();
+						SchedulerLanes lanes(servicesection["ui_threads"].getUInt(1));
+						Scheduler sch = lanes.trading();
 
 
 						auto storagePath = servicesection.mandatory["storage_path"].getPath();
@@ -303,6 +306,18 @@ int main(int argc, char **argv) {
 						auto socket = servicesection["socket"].getPath();
 						auto upload_limit = servicesection["upload_limit"].getUInt(10*1024*1024);
 						auto brk_timeout = servicesection["broker_timeout"].getInt(10000);
+						ExtStockApi::setMaxInflight(servicesection["broker_inflight"].getUInt(4));
+						auto state_format = servicesection["state_format"].getString("columnar");
+						if (state_format != "columnar" && state_format != "objects") throw std::runtime_error("Unknown state_format: "+std::string(state_format));
+						MTrader::setColumnarFormat(state_format == "columnar");
+						auto cycle_mode = servicesection["cycle_mode"].getString("fixed");
+						if (cycle_mode != "fixed" && cycle_mode != "adaptive") throw std::runtime_error("Unknown cycle_mode: "+std::string(cycle_mode));
+						bool adaptive_cycle = cycle_mode == "adaptive";
+						AdaptiveCycle::Config adaptive_cfg;
+						adaptive_cfg.min_interval = servicesection["cycle_min_interval"].getUInt(adaptive_cfg.min_interval);
+						adaptive_cfg.max_interval = servicesection["cycle_max_interval"].getUInt(adaptive_cfg.max_interval);
+						adaptive_cfg.probe_interval = servicesection["cycle_probe_interval"].getUInt(adaptive_cfg.probe_interval);
+						adaptive_cfg.broker_budget = servicesection["cycle_broker_budget"].getUInt(adaptive_cfg.broker_budget);
 						auto rptsect = app.config["report"];
 						auto rptpath = rptsect.mandatory["path"].getPath();
 						auto rptinterval = rptsect["interval"].getUInt(864000000);
@@ -315,6 +330,10 @@ int main(int argc, char **argv) {
 						auto history_broker = backtest_section.mandatory["history_source"];
 						auto backtest_cache_size = backtest_section["backtest_cache_size"].getUInt(8);
 						auto backtest_in_memory = backtest_section["in_memory"].getBool(false);
+						auto compute_threads = backtest_section["threads"].getUInt(1);
+						auto compute_queue = backtest_section["queue"].getUInt(16);
+						auto memory_cache_size = backtest_section["memory_cache_mb"].getUInt(64);
+						auto minute_archive_path = backtest_section["minute_archive"].getPath(storagePath+"/minute_archive");
 						auto news_url=app.config["news"]["url"].getString();
 
 
@@ -358,6 +377,7 @@ int main(int argc, char **argv) {
 						traders = traders.make(
 								sch,app.config["brokers"], sf,rpt,perfmod, rptpath,  brk_timeout
 						);
+						traders.lock()->setLoaderThreads(servicesection["loader_threads"].getUInt(4));
 
 						WebCfg::Users users;
 
@@ -373,7 +393,7 @@ int main(int argc, char **argv) {
 									new AuthUserList,
 									new AuthUserList,
 									new AuthUserList
-						},backtest_cache_size,backtest_in_memory,std::string(news_url));
+						},backtest_cache_size,backtest_in_memory,memory_cache_size*1024*1024,std::string(news_url));
 						webcfgstate.lock()->applyConfig(traders);
 						users = webcfgstate.lock_shared()->users;
 
@@ -410,7 +430,9 @@ int main(int argc, char **argv) {
 								"/api/admin",ondra_shared::shared_function<bool(simpleServer::HTTPRequest, ondra_shared::StrViewA)>(WebCfg(webcfgstate,
 										name,
 										traders,
-										[=](WebCfg::Action &&a) mutable {sch.immediate() >> std::move(a);},jwt, phb, upload_limit))
+										[uisch = lanes.ui()](WebCfg::Action &&a) mutable {uisch.immediate() >> std::move(a);},jwt, phb, upload_limit,
+										std::make_shared<ComputePool>(compute_threads, compute_queue),
+										std::make_shared<MinuteArchive>(minute_archive_path)))
 							});
 							paths.push_back({
 								"/set_cookie",[](simpleServer::HTTPRequest req, const ondra_shared::StrViewA &) mutable {
@@ -613,13 +635,18 @@ int main(int argc, char **argv) {
 									&dynamic_cast<ondra_shared::StdLogProviderFactory &>(*ondra_shared::AbstractLogProviderFactory::getInstance());
 							ondra_shared::PStdLogProviderFactory logcap = Report::captureLog(rpt, current);
 
-							sch.immediate() >> [logcap]{
+							lanes.broadcast([logcap]{
 								ondra_shared::AbstractLogProvider::getInstance() = logcap->create();
-							};
+							});
 
 
-							trader_cycle(rpt, perfmod, sch, 0, std::chrono::steady_clock::now());
-							sch.each(std::chrono::seconds(30)) >> [=]()mutable{
+							if (adaptive_cycle) {
+								PAdaptiveCycle(new AdaptiveCycle(adaptive_cfg, traders, rpt, perfmod, sch))->start();
+							} else {
+								trader_cycle(rpt, perfmod, sch, 0, std::chrono::steady_clock::now());
+							}
+							Scheduler maint = lanes.maintenance();
+							maint.each(std::chrono::seconds(30)) >> [=]()mutable{
 								rpt.lock()->pingStreams();
 							};
 
@@ -631,8 +658,8 @@ int main(int argc, char **argv) {
 									rpt.lock()->setNewsMessages(count);
 								};
 
-								sch.each(std::chrono::minutes(10)) >> checkNews;
-								sch.immediate() >> checkNews;
+								maint.each(std::chrono::minutes(10)) >> checkNews;
+								maint.immediate() >> checkNews;
 							}
 
 							return 0;
@@ -641,9 +668,9 @@ int main(int argc, char **argv) {
 
 						cntr.dispatch();
 
-						sch.removeAll();
+						lanes.removeAll();
 						logNote("---- Waiting to finish cycle ----");
-						sch.sync();
+						lanes.stop();
 						traders.lock()->clear();
 					}
 					logNote("---- Exit ----");
@@ -0,0 +1,105 @@
+/*
+ * marketdata.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "marketdata.h"
+
+#include <imtjson/object.h>
+
+MarketDataCache::MarketDataCache() {
+	newCycle();
+}
+
+void MarketDataCache::newCycle() {
+	std::unique_lock _(lock);
+	auto s = std::make_shared<Snapshot>();
+	s->version = cur?cur->version+1:1;
+	s->created = std::chrono::steady_clock::now();
+	cur = std::move(s);
+}
+
+void MarketDataCache::invalidateAccount() {
+	std::unique_lock _(lock);
+	Snapshot &s = modify();
+	s.balances.clear();
+	s.minfo.clear();
+	s.wallet.reset();
+}
+
+void MarketDataCache::invalidateBalances() {
+	std::unique_lock _(lock);
+	Snapshot &s = modify();
+	s.balances.clear();
+	s.wallet.reset();
+}
+
+MarketDataCache::PSnapshot MarketDataCache::getSnapshot() const {
+	std::unique_lock _(lock);
+	return cur;
+}
+
+const MarketDataCache::Snapshot *MarketDataCache::read() {
+	if (std::chrono::steady_clock::now() - cur->created > maxAge) return nullptr;
+	return cur.get();
+}
+
+MarketDataCache::Snapshot& MarketDataCache::modify() {
+	if (std::chrono::steady_clock::now() - cur->created > maxAge) {
+		auto s = std::make_shared<Snapshot>();
+		s->version = cur->version+1;
+		s->created = std::chrono::steady_clock::now();
+		cur = std::move(s);
+	} else if (cur.use_count() > 1) {
+		//snapshot has been published, make a copy
+		cur = std::make_shared<Snapshot>(*cur);
+	}
+	return *cur;
+}
+
+std::string MarketDataCache::balanceKey(const std::string_view &symb, const std::string_view &pair) {
+	std::string out;
+	out.reserve(symb.size()+pair.size()+1);
+	out.append(symb);
+	out.push_back(0);
+	out.append(pair);
+	return out;
+}
+
+json::Value MarketDataCache::Snapshot::toJSON() const {
+	json::Object tk, nfo, bal, wlt;
+	for (const auto &x: tickers) {
+		tk.set(x.first, json::Object({
+			{"bid", x.second.bid},
+			{"ask", x.second.ask},
+			{"last", x.second.last},
+			{"time", x.second.time}
+		}));
+	}
+	for (const auto &x: minfo) {
+		nfo.set(x.first, x.second.toJSON());
+	}
+	for (const auto &x: balances) {
+		auto sep = x.first.find('\0');
+		std::string_view symb(x.first.data(), sep);
+		std::string_view pair(x.first.data()+sep+1, x.first.size()-sep-1);
+		bal.object(pair).set(symb, x.second);
+	}
+	if (wallet.has_value()) {
+		for (const auto &w: *wallet) {
+			json::Object items;
+			for (const auto &i: w.wallet) items.set(i.symbol.str(), i.balance);
+			wlt.set(w.walletId.str(), items);
+		}
+	}
+	return json::Object({
+		{"version", version},
+		{"age", std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - created).count()},
+		{"tickers", tk},
+		{"markets", nfo},
+		{"balances", bal},
+		{"wallet", wallet.has_value()?json::Value(wlt):json::Value()}
+	});
+}
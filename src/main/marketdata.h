@@ -0,0 +1,160 @@
+/*
+ * marketdata.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_MARKETDATA_H_
+#define SRC_MAIN_MARKETDATA_H_
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "ibrokercontrol.h"
+#include "istockapi.h"
+
+///Caches market data of single broker during one cycle
+/**
+ * Tickers, market informations, balances and wallet are fetched from the broker only once
+ * per cycle, all other requests are served from the cache. So multiple traders which share the
+ * same broker (or even the same pair) don't repeat the same requests.
+ *
+ * The data are held in a versioned snapshot. The snapshot is never modified once it was
+ * returned by getSnapshot(), so it can be read without further locking. New cycle starts new
+ * version.
+ */
+class MarketDataCache {
+public:
+
+	using Ticker = IStockApi::Ticker;
+	using MarketInfo = IStockApi::MarketInfo;
+	using AllWallets = IBrokerControl::AllWallets;
+
+	struct Snapshot {
+		///Version of the snapshot, increased with every cycle
+		unsigned int version = 0;
+		///Time when the cycle started
+		std::chrono::steady_clock::time_point created;
+		std::map<std::string, Ticker, std::less<> > tickers;
+		std::map<std::string, MarketInfo, std::less<> > minfo;
+		///balances, key is symbol and pair separated by zero character
+		std::map<std::string, double, std::less<> > balances;
+		std::optional<AllWallets> wallet;
+
+		json::Value toJSON() const;
+	};
+
+	using PSnapshot = std::shared_ptr<const Snapshot>;
+
+	///Maximum age of the cached data, if the new cycle is not started in time
+	static constexpr std::chrono::seconds maxAge = std::chrono::seconds(60);
+
+	MarketDataCache();
+
+	template<typename Fn>
+	Ticker getTicker(const std::string_view &pair, Fn &&fetch);
+	template<typename Fn>
+	MarketInfo getMarketInfo(const std::string_view &pair, Fn &&fetch);
+	template<typename Fn>
+	double getBalance(const std::string_view &symb, const std::string_view &pair, Fn &&fetch);
+	template<typename Fn>
+	AllWallets getWallet(Fn &&fetch);
+
+	///Starts new cycle - drops all cached data
+	void newCycle();
+	///Drops account related data (balances, wallet and market info, because fees can change)
+	/** Called when trades were executed, or account has been changed */
+	void invalidateAccount();
+	///Drops balances and wallet
+	/** Called after an order was placed or canceled, because it can change available balances */
+	void invalidateBalances();
+
+	///Retrieves current snapshot
+	PSnapshot getSnapshot() const;
+
+protected:
+	mutable std::mutex lock;
+	std::shared_ptr<Snapshot> cur;
+
+	///Retrieves snapshot for update, it also checks its age
+	Snapshot &modify();
+	///Lookups the valid snapshot, returns nullptr if expired
+	const Snapshot *read();
+
+	static std::string balanceKey(const std::string_view &symb, const std::string_view &pair);
+};
+
+///Implemented by brokers which cache the market data
+class IMarketDataSource {
+public:
+	virtual MarketDataCache::PSnapshot getMarketSnapshot() const = 0;
+	virtual ~IMarketDataSource() {}
+};
+
+template<typename Fn>
+inline MarketDataCache::Ticker MarketDataCache::getTicker(const std::string_view &pair, Fn &&fetch) {
+	{
+		std::unique_lock _(lock);
+		const Snapshot *s = read();
+		if (s) {
+			auto iter = s->tickers.find(pair);
+			if (iter != s->tickers.end()) return iter->second;
+		}
+	}
+	Ticker tk = fetch();
+	std::unique_lock _(lock);
+	modify().tickers.insert_or_assign(std::string(pair), tk);
+	return tk;
+}
+
+template<typename Fn>
+inline MarketDataCache::MarketInfo MarketDataCache::getMarketInfo(const std::string_view &pair, Fn &&fetch) {
+	{
+		std::unique_lock _(lock);
+		const Snapshot *s = read();
+		if (s) {
+			auto iter = s->minfo.find(pair);
+			if (iter != s->minfo.end()) return iter->second;
+		}
+	}
+	MarketInfo nfo = fetch();
+	std::unique_lock _(lock);
+	modify().minfo.insert_or_assign(std::string(pair), nfo);
+	return nfo;
+}
+
+template<typename Fn>
+inline double MarketDataCache::getBalance(const std::string_view &symb, const std::string_view &pair, Fn &&fetch) {
+	std::string key = balanceKey(symb, pair);
+	{
+		std::unique_lock _(lock);
+		const Snapshot *s = read();
+		if (s) {
+			auto iter = s->balances.find(key);
+			if (iter != s->balances.end()) return iter->second;
+		}
+	}
+	double b = fetch();
+	std::unique_lock _(lock);
+	modify().balances.insert_or_assign(std::move(key), b);
+	return b;
+}
+
+template<typename Fn>
+inline MarketDataCache::AllWallets MarketDataCache::getWallet(Fn &&fetch) {
+	{
+		std::unique_lock _(lock);
+		const Snapshot *s = read();
+		if (s && s->wallet.has_value()) return *s->wallet;
+	}
+	AllWallets w = fetch();
+	std::unique_lock _(lock);
+	modify().wallet = w;
+	return w;
+}
+
+#endif /* SRC_MAIN_MARKETDATA_H_ */
@@ -0,0 +1,222 @@
+/*
+ * minutearchive.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "minutearchive.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <shared/filesystem.h>
+#include "../shared/logOutput.h"
+
+using ondra_shared::logWarning;
+
+static const char archiveMagic[8] = {'M','M','B','M','I','N','0','1'};
+
+struct MinuteArchive::Mapping {
+	void *addr;
+	std::size_t len;
+	Mapping(void *addr, std::size_t len):addr(addr),len(len) {}
+	~Mapping() {munmap(addr, len);}
+};
+
+namespace {
+
+///Closes file descriptor at the end of the scope
+class FD {
+public:
+	explicit FD(int fd):fd(fd) {}
+	~FD() {if (fd >= 0) ::close(fd);}
+	FD(const FD &) = delete;
+	FD &operator=(const FD &) = delete;
+	operator int() const {return fd;}
+protected:
+	int fd;
+};
+
+void writeAll(int fd, const void *data, std::size_t len, off_t offset, const std::string &fname) {
+	const char *p = reinterpret_cast<const char *>(data);
+	while (len) {
+		auto r = pwrite(fd, p, len, offset);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("Failed to write minute archive: "+fname+" - "+std::strerror(errno));
+		}
+		p += r;
+		len -= r;
+		offset += r;
+	}
+}
+
+///Converts rows of the history source to a column of minute prices
+/**
+ * @param data rows [time, price], time is unix time in seconds. Rows without
+ * timestamp (plain numbers) are placed to the next minute
+ * @param start first minute of the column. If the previous price is not known,
+ * it is moved to the minute of the first row
+ * @param end rows at this minute and later are ignored
+ * @param last price before the start, NaN if not known
+ * @return column of prices. Rows older than start are skipped, missing minutes are
+ * filled by the previous price
+ */
+std::vector<double> toColumn(const json::Value &data, std::uint64_t &start, std::uint64_t end, double last) {
+	std::vector<double> out;
+	std::uint64_t next = start;
+	bool has_last = !std::isnan(last);
+	for (json::Value v: data) {
+		std::uint64_t minute;
+		double price;
+		if (v.type() == json::array) {
+			minute = v[0].getUIntLong()/60;
+			price = v[1].getNumber();
+		} else {
+			minute = next;
+			price = v.getNumber();
+		}
+		if (minute < next || minute >= end) continue;
+		if (!has_last) {
+			start = next = minute;
+			has_last = true;
+		}
+		for (; next < minute; ++next) out.push_back(last);
+		out.push_back(price);
+		last = price;
+		++next;
+	}
+	return out;
+}
+
+std::uint64_t currentMinute() {
+	return std::chrono::duration_cast<std::chrono::minutes>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+MinuteArchive::MinuteArchive(std::string path):path(std::move(path)) {}
+
+std::string MinuteArchive::fileName(const std::string_view &asset, const std::string_view &currency) const {
+	std::string fname = path;
+	fname.push_back('/');
+	auto append = [&](const std::string_view &s) {
+		for (char c: s) {
+			if (std::isalnum(static_cast<unsigned char>(c)) || c == '-') {
+				fname.push_back(std::tolower(static_cast<unsigned char>(c)));
+			} else {
+				fname.push_back('_');
+			}
+		}
+	};
+	append(asset);
+	fname.push_back('_');
+	append(currency);
+	fname.append(".bin");
+	return fname;
+}
+
+std::shared_ptr<std::mutex> MinuteArchive::getPairLock(const std::string &fname) {
+	std::unique_lock _(lock);
+	auto iter = pair_locks.find(fname);
+	if (iter == pair_locks.end()) {
+		iter = pair_locks.emplace(fname, std::make_shared<std::mutex>()).first;
+	}
+	return iter->second;
+}
+
+bool MinuteArchive::readHeader(const std::string &fname, Header &hdr) {
+	FD fd(::open(fname.c_str(), O_RDONLY|O_CLOEXEC));
+	if (fd < 0) return false;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) return false;
+	if (std::memcmp(hdr.magic, archiveMagic, sizeof(archiveMagic)) != 0) return false;
+	return true;
+}
+
+void MinuteArchive::writeFile(const std::string &fname, std::uint64_t start, const json::Value &data) {
+	std::filesystem::create_directories(std::filesystem::path(fname).parent_path());
+	std::vector<double> col = toColumn(data, start, currentMinute()+1, std::numeric_limits<double>::quiet_NaN());
+	Header hdr;
+	std::memcpy(hdr.magic, archiveMagic, sizeof(archiveMagic));
+	hdr.start = start;
+	hdr.count = col.size();
+	hdr.reserved = 0;
+	//written to a temporary file and renamed, so existing mappings stay valid
+	std::string tmpname = fname+".tmp";
+	{
+		FD fd(::open(tmpname.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666));
+		if (fd < 0) throw std::runtime_error("Failed to create minute archive: "+tmpname+" - "+std::strerror(errno));
+		writeAll(fd, &hdr, sizeof(hdr), 0, tmpname);
+		writeAll(fd, col.data(), col.size()*sizeof(double), sizeof(hdr), tmpname);
+	}
+	std::filesystem::rename(tmpname, fname);
+}
+
+void MinuteArchive::appendFile(const std::string &fname, const Header &hdr, const json::Value &data) {
+	FD fd(::open(fname.c_str(), O_RDWR|O_CLOEXEC));
+	if (fd < 0) throw std::runtime_error("Failed to open minute archive: "+fname+" - "+std::strerror(errno));
+	off_t end_ofs = sizeof(hdr)+hdr.count*sizeof(double);
+	double last;
+	if (pread(fd, &last, sizeof(last), end_ofs-sizeof(last)) != sizeof(last))
+		throw std::runtime_error("Failed to read minute archive: "+fname);
+	std::uint64_t start = hdr.start+hdr.count;
+	std::vector<double> col = toColumn(data, start, currentMinute()+1, last);
+	if (col.empty()) return;
+	//data first, then the header, so interrupted append is ignored
+	writeAll(fd, col.data(), col.size()*sizeof(double), end_ofs, fname);
+	Header nhdr = hdr;
+	nhdr.count += col.size();
+	writeAll(fd, &nhdr, sizeof(nhdr), 0, fname);
+}
+
+MinuteArchive::Range MinuteArchive::mapRange(const std::string &fname, std::uint64_t from) {
+	FD fd(::open(fname.c_str(), O_RDONLY|O_CLOEXEC));
+	if (fd < 0) return Range();
+	Header hdr;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+			|| std::memcmp(hdr.magic, archiveMagic, sizeof(archiveMagic)) != 0) return Range();
+	std::uint64_t ofs = from > hdr.start?from - hdr.start:0;
+	if (ofs >= hdr.count) return Range();
+	std::size_t len = sizeof(hdr)+hdr.count*sizeof(double);
+	void *addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) throw std::runtime_error("Failed to map minute archive: "+fname+" - "+std::strerror(errno));
+	auto map = std::make_shared<Mapping>(addr, len);
+	const double *data = reinterpret_cast<const double *>(reinterpret_cast<const char *>(addr)+sizeof(hdr));
+	return Range(map, data+ofs, hdr.count-ofs, hdr.start+ofs);
+}
+
+MinuteArchive::Range MinuteArchive::read(const std::string_view &asset, const std::string_view &currency, std::uint64_t from) const {
+	return mapRange(fileName(asset, currency), from/60);
+}
+
+MinuteArchive::Range MinuteArchive::get(const std::string_view &asset, const std::string_view &currency, std::uint64_t from, const Fetch &fetch) {
+	std::string fname = fileName(asset, currency);
+	auto plk = getPairLock(fname);
+	std::unique_lock _(*plk);
+
+	std::uint64_t from_min = from/60;
+	std::uint64_t now_min = currentMinute();
+	Header hdr;
+	bool exists = readHeader(fname, hdr);
+	try {
+		if (!exists || from_min < hdr.start || hdr.count == 0) {
+			writeFile(fname, from_min, fetch(from_min*60));
+		} else if (hdr.start + hdr.count + refreshInterval.count() < now_min) {
+			appendFile(fname, hdr, fetch((hdr.start + hdr.count)*60));
+		}
+	} catch (std::exception &e) {
+		if (!exists) throw;
+		logWarning("Minute archive $1 not updated: $2", fname, e.what());
+	}
+	return mapRange(fname, from_min);
+}
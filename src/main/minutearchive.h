@@ -0,0 +1,113 @@
+/*
+ * minutearchive.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_MINUTEARCHIVE_H_
+#define SRC_MAIN_MINUTEARCHIVE_H_
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <imtjson/value.h>
+
+///Local archive of minute prices downloaded from the history source
+/**
+ * Every pair (asset, currency) has own file, which contains header and column of prices
+ * (one double per minute). Only minutes newer than the last stored minute are downloaded,
+ * so repeated requests are served locally. Data are read through mmap.
+ *
+ * The history source returns rows [time, price]. Minutes missing in the source are
+ * filled by the previous price, so the archive contains one price per minute and
+ * the time of the price is calculated from its position.
+ */
+class MinuteArchive {
+public:
+
+	///Downloads minute prices starting at given time (unix time in seconds). Returns array of rows [time, price], time is in seconds
+	using Fetch = std::function<json::Value(std::uint64_t from)>;
+
+	struct Mapping;
+
+	///Continuous range of minute prices
+	/** Range holds the mapping, so it stays valid even if the archive is updated */
+	class Range {
+	public:
+		Range() {}
+		Range(std::shared_ptr<const Mapping> map, const double *data, std::size_t count, std::uint64_t start)
+			:map(std::move(map)),data(data),count(count),start(start) {}
+
+		const double *begin() const {return data;}
+		const double *end() const {return data+count;}
+		std::size_t size() const {return count;}
+		bool empty() const {return count == 0;}
+		double operator[](std::size_t idx) const {return data[idx];}
+		///Time of the first price (unix time in seconds)
+		std::uint64_t getStartTime() const {return start*60;}
+
+	protected:
+		std::shared_ptr<const Mapping> map;
+		const double *data = nullptr;
+		std::size_t count = 0;
+		std::uint64_t start = 0;
+	};
+
+	///Archive is not refreshed, if the newest price is not older than this interval
+	static constexpr std::chrono::minutes refreshInterval = std::chrono::minutes(60);
+
+	///Construct archive
+	/**
+	 * @param path path to the directory. It is created when needed
+	 */
+	MinuteArchive(std::string path);
+
+	///Retrieves prices of the pair
+	/**
+	 * @param asset asset symbol
+	 * @param currency currency symbol
+	 * @param from time of the first price (unix time in seconds)
+	 * @param fetch function which downloads missing prices.
+	 * @return prices starting at given time (or later, if the archive starts later)
+	 *
+	 * @note when download fails and the archive contains data, the stored data are returned
+	 */
+	Range get(const std::string_view &asset, const std::string_view &currency, std::uint64_t from, const Fetch &fetch);
+
+	///Returns range which is currently stored, doesn't download anything
+	Range read(const std::string_view &asset, const std::string_view &currency, std::uint64_t from) const;
+
+protected:
+
+	struct Header {
+		char magic[8];
+		///index of the first minute (unix time / 60)
+		std::uint64_t start;
+		///count of stored minutes
+		std::uint64_t count;
+		std::uint64_t reserved;
+	};
+
+	std::string path;
+	std::mutex lock;
+	///Locks per pair - download of one pair doesn't block the others
+	std::map<std::string, std::shared_ptr<std::mutex>, std::less<> > pair_locks;
+
+	std::string fileName(const std::string_view &asset, const std::string_view &currency) const;
+	std::shared_ptr<std::mutex> getPairLock(const std::string &fname);
+
+	static bool readHeader(const std::string &fname, Header &hdr);
+	static void writeFile(const std::string &fname, std::uint64_t start, const json::Value &data);
+	static void appendFile(const std::string &fname, const Header &hdr, const json::Value &data);
+	static Range mapRange(const std::string &fname, std::uint64_t from);
+};
+
+using PMinuteArchive = std::shared_ptr<MinuteArchive>;
+
+
+#endif /* SRC_MAIN_MINUTEARCHIVE_H_ */
@@ -0,0 +1,171 @@
+/*
+ * montecarlo.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "montecarlo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <numeric>
+
+
+namespace {
+
+///Thrown inside of the price source to stop the backtest (not derived from std::exception)
+struct PathCanceled {};
+
+///Converts minute chart to trades, it follows gen_trades of the backtest api
+class PathTrades {
+public:
+	PathTrades(const MonteCarloConfig &cfg, const std::vector<double> &chart, const std::atomic<bool> &stop)
+		:fn(defaultSpreadFunction(cfg.sma, cfg.stdev, cfg.force_spread))
+		,spreadCalc(fn, cfg.spread)
+		,chart(chart)
+		,stop(stop)
+		,init_price(cfg.init_price)
+		,invert(cfg.minfo.invert_price)
+		,t(std::chrono::duration_cast<std::chrono::milliseconds>(
+				(std::chrono::system_clock::now() - std::chrono::minutes(chart.size())).time_since_epoch()).count())
+	{}
+
+	std::optional<BTPrice> operator()() {
+		//the newest trade is held back, because it collects pmin and pmax of following minutes
+		while (pending.size() < 2 && pos < chart.size()) {
+			if ((pos & 0xFFFF) == 0 && stop.load(std::memory_order_relaxed)) throw PathCanceled();
+			double w = chart[pos++];
+			auto res = spreadCalc.point(w);
+			if (res.trade && res.valid) {
+				pending.push_back({t, res.price, res.price, res.price});
+				if (res.trade2) pending.push_back({t, res.price2, res.price2, res.price2});
+			} else if (!pending.empty()) {
+				BTPrice &last = pending.back();
+				if (w < last.pmin) last.pmin = w;
+				else if (w > last.pmax) last.pmax = w;
+			}
+			t+=60000;
+		}
+		if (pending.empty()) return std::optional<BTPrice>();
+		BTPrice r = pending.front();
+		pending.pop_front();
+		if (mlt == 0) mlt = init_price?init_price/r.price:1.0;
+		r.price *= mlt;
+		r.pmin *= mlt;
+		r.pmax *= mlt;
+		if (invert) {
+			r.price = 1.0/r.price;
+			double tmp = 1.0/r.pmin;
+			r.pmin = 1.0/r.pmax;
+			r.pmax = tmp;
+		}
+		return r;
+	}
+
+protected:
+	std::unique_ptr<ISpreadFunction> fn;
+	VisSpread spreadCalc;
+	const std::vector<double> &chart;
+	const std::atomic<bool> &stop;
+	double init_price;
+	bool invert;
+	std::uint64_t t;
+	std::size_t pos = 0;
+	double mlt = 0;
+	std::deque<BTPrice> pending;
+};
+
+MonteCarloPath run_path(const MonteCarloConfig &cfg, std::size_t seed, std::vector<double> &chart, const std::atomic<bool> &stop) {
+	chart.clear();
+	if (cfg.classic_chart) {
+		generate_random_chart(cfg.chart.volatility, cfg.chart.noise, cfg.chart.minutes, seed, chart);
+	} else {
+		RandomChartConfig chcfg = cfg.chart;
+		chcfg.seed = seed;
+		chart.resize(chcfg.minutes);
+		generate_random_chart(chcfg, chart.data());
+	}
+
+	PathTrades source(cfg, chart, stop);
+	BTTrades rs = backtest_cycle(cfg.config, [&]{return source();},
+			cfg.minfo, cfg.init_pos, cfg.balance, cfg.neg_bal, cfg.spend);
+
+	MonteCarloPath r;
+	r.seed = seed;
+	r.trades = rs.size();
+	double peak = 0;
+	for (const BTTrade &x: rs) {
+		peak = std::max(peak, x.pl);
+		r.max_drawdown = std::max(r.max_drawdown, peak - x.pl);
+		switch (x.event) {
+			case BTEvent::liquidation: ++r.liquidations;break;
+			case BTEvent::margin_call: ++r.margin_calls;break;
+			case BTEvent::no_balance: ++r.no_balance;break;
+			case BTEvent::accept_loss: ++r.accept_loss;break;
+			default: break;
+		}
+	}
+	if (!rs.empty()) {
+		r.pl = rs.back().pl;
+		r.npl = rs.back().norm_profit;
+		r.base_balance = cfg.balance;
+		if (cfg.minfo.leverage == 0) {
+			r.base_balance += cfg.init_pos.value_or(0)*rs[0].price;
+		}
+		if (r.base_balance <= 0) r.base_balance = 1;
+	}
+	return r;
+}
+
+}
+
+MonteCarloDistribution MonteCarloDistribution::calc(std::vector<double> &values) {
+	MonteCarloDistribution r;
+	if (values.empty()) return r;
+	std::sort(values.begin(), values.end());
+	auto pct = [&](double p) {
+		//linear interpolation between closest ranks
+		double pos = p * (values.size() - 1);
+		std::size_t i = static_cast<std::size_t>(pos);
+		if (i + 1 >= values.size()) return values.back();
+		double f = pos - i;
+		return values[i] + (values[i+1] - values[i]) * f;
+	};
+	r.min = values.front();
+	r.max = values.back();
+	r.p5 = pct(0.05);
+	r.p25 = pct(0.25);
+	r.p50 = pct(0.5);
+	r.p75 = pct(0.75);
+	r.p95 = pct(0.95);
+	r.mean = std::accumulate(values.begin(), values.end(), 0.0)/values.size();
+	return r;
+}
+
+std::optional<std::vector<MonteCarloPath> > run_montecarlo(const MonteCarloConfig &cfg, ComputePool &pool, const MonteCarloProgress &progress) {
+	std::vector<MonteCarloPath> results(cfg.paths);
+	if (cfg.paths == 0) return results;
+
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned int> done(0);
+
+	bool finished = pool.parallel(cfg.paths, [&](unsigned int idx) {
+		std::vector<double> chart;
+		chart.reserve(cfg.chart.minutes);
+		try {
+			results[idx] = run_path(cfg, cfg.seed+idx, chart, stop);
+			++done;
+		} catch (PathCanceled &) {
+			//nothing, stop is already set
+		}
+	}, [&]{
+		if (!progress(done * 100.0 / cfg.paths)) stop = true;
+		return !stop;
+	});
+	if (!finished || stop) return std::optional<std::vector<MonteCarloPath> >();
+	return results;
+}
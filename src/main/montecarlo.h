@@ -0,0 +1,103 @@
+/*
+ * montecarlo.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_MONTECARLO_H_
+#define SRC_MAIN_MONTECARLO_H_
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "backtest.h"
+#include "computepool.h"
+#include "random_chart.h"
+#include "spread.h"
+
+///Configuration of the Monte-Carlo run
+struct MonteCarloConfig {
+	///Configuration of the trader
+	MTrader_Config config;
+	///Market informations
+	IStockApi::MarketInfo minfo;
+	///Spread generator - arguments of the defaultSpreadFunction
+	double sma = 25;
+	double stdev = 4;
+	double force_spread = 0;
+	///Spread generator - other settings
+	VisSpread::Config spread;
+	///Parameters of the synthetic chart (seed is ignored)
+	RandomChartConfig chart;
+	///Use classic generator (only volatility, noise and minutes are used)
+	bool classic_chart = true;
+	///Count of paths
+	unsigned int paths = 100;
+	///Seed of the first path, other paths use seed+1, seed+2, etc...
+	std::size_t seed = 0;
+	///Price of the first trade (0 = keep generated price)
+	double init_price = 0;
+	///Arguments of the backtest_cycle
+	std::optional<double> init_pos;
+	double balance = 0;
+	bool neg_bal = false;
+	bool spend = false;
+};
+
+///Result of single path
+struct MonteCarloPath {
+	///Seed used to generate the path
+	std::size_t seed = 0;
+	///Count of trades
+	std::size_t trades = 0;
+	///Final profit/loss
+	double pl = 0;
+	///Maximum drawdown of the profit/loss (positive number)
+	double max_drawdown = 0;
+	///Final normalized profit
+	double npl = 0;
+	///Balance used as base for percentage
+	double base_balance = 1;
+	std::size_t liquidations = 0;
+	std::size_t margin_calls = 0;
+	std::size_t no_balance = 0;
+	std::size_t accept_loss = 0;
+};
+
+///Distribution of the single metric
+struct MonteCarloDistribution {
+	double min = 0;
+	double p5 = 0;
+	double p25 = 0;
+	double p50 = 0;
+	double p75 = 0;
+	double p95 = 0;
+	double max = 0;
+	double mean = 0;
+
+	///Calculates distribution of the values (the vector is sorted)
+	static MonteCarloDistribution calc(std::vector<double> &values);
+};
+
+///Reports progress in percent, return false to cancel the run
+using MonteCarloProgress = std::function<bool(double)>;
+
+///Runs the backtest on multiple synthetic charts
+/**
+ * Each path is generated, converted to trades and backtested by a thread of the compute
+ * pool (see ComputePool::parallel). Prices are streamed directly to the backtest, they are
+ * never stored as json. Result doesn't depend on count of threads, because every path has
+ * its own seed.
+ *
+ * @param cfg configuration
+ * @param pool compute pool, the calling thread processes the paths too
+ * @param progress progress callback, it is called from the calling thread
+ * @return results of all paths in order of seeds. Returns no value, if the run was canceled
+ *
+ * @note exception thrown by any path is rethrown
+ */
+std::optional<std::vector<MonteCarloPath> > run_montecarlo(const MonteCarloConfig &cfg, ComputePool &pool, const MonteCarloProgress &progress);
+
+
+#endif /* SRC_MAIN_MONTECARLO_H_ */
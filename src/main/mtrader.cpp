@@ -10,12 +10,15 @@
 #include <shared/logOutput.h>
 #include <imtjson/object.h>
 #include <imtjson/array.h>
+#include <imtjson/arena.h>
 #include <numeric>
 #include <queue>
 #include <random>
 
 #include "../shared/stringview.h"
 #include "papertrading.h"
+#include "columnar.h"
+#include "perfstats.h"
 
 #include "emulatedLeverageBroker.h"
 #include "ibrokercontrol.h"
@@ -111,6 +114,8 @@ void MTrader_Config::loadConfig(json::Value data) {
 
 }
 
+bool MTrader::columnar_format = true;
+
 MTrader::MTrader(IStockSelector &stock_selector,
 		StoragePtr &&storage,
 		PStatSvc &&statsvc,
@@ -190,12 +195,26 @@ bool MTrader::need_init() const {
 
 void MTrader::init() {
 	if (need_load){
-		initialize();
-		loadState();
-		need_load = false;
+		initMarket();
+		initState();
 	}
 }
 
+void MTrader::initMarket() {
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.init_market");
+	PerfProbe probe(probe_hist);
+	initialize();
+}
+
+void MTrader::initState() {
+	if (!need_load) return;
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.load_state");
+	PerfProbe probe(probe_hist);
+	loadState();
+	need_load = false;
+	publishSnapshot();
+}
+
 const MTrader::TradeHistory& MTrader::getTrades() const {
 	return trades;
 }
@@ -246,6 +265,8 @@ void MTrader::dorovnani(Status &st, double assetBalance, double price) {
 
 void MTrader::perform(bool manually) {
 
+	static PerfHistogram &perform_probe_hist = PerfStats::global().get("mtrader.perform");
+	PerfProbe perform_probe(perform_probe_hist);
 	try {
 		init();
 
@@ -261,7 +282,20 @@ void MTrader::perform(bool manually) {
 		//Get opened orders
 		auto orders = getOrders();
 		//get current status
+		static PerfHistogram &status_probe_hist = PerfStats::global().get("mtrader.market_status");
+		PerfProbe status_probe(status_probe_hist);
 		auto status = getMarketStatus();
+		status_probe.stop();
+
+		if (adaptive_cycle) {
+			//longer gap is an outage, it is handled as a single minute (as in fixed cycle)
+			//minutes are counted by boundaries, so the remainder doesn't accumulate
+			constexpr std::uint64_t maxCycleGap = 60;
+			std::uint64_t cur_minute = status.chartItem.time/60000;
+			std::uint64_t last_minute = chart.empty()?0:chart.back().time/60000;
+			std::uint64_t gap = chart.empty()?1:cur_minute > last_minute?cur_minute - last_minute:0;
+			cycle_minutes = gap > maxCycleGap?1:static_cast<unsigned int>(gap);
+		}
 
 		if (status.brokerCurrencyBalance.has_value()) {
 			wcfg.balanceCache.lock()->put(cfg.broker, minfo.wallet_id, minfo.currency_symbol, *status.brokerCurrencyBalance);
@@ -278,7 +312,10 @@ void MTrader::perform(bool manually) {
 		std::string buy_order_error;
 		std::string sell_order_error;
 		//process all new trades
+		static PerfHistogram &trades_probe_hist = PerfStats::global().get("mtrader.process_trades");
+		PerfProbe trades_probe(trades_probe_hist);
 		bool anytrades = processTrades(status);
+		trades_probe.stop();
 
 		BalanceChangeEvent bche = detectLeakedTrade(status);
 		switch (bche) {
@@ -291,8 +328,12 @@ void MTrader::perform(bool manually) {
 				logNote("Adjust added: result - $1", position);
 				adj_wait = 0;
 			} else {
-				if (adj_wait == 0) adj_wait_price = status.curPrice;
-				adj_wait++;
+				if (adj_wait == 0) {
+					adj_wait_price = status.curPrice;
+					adj_wait++;
+				} else {
+					adj_wait += cycle_minutes;
+				}
 				logNote("Need adjust $1 => $2, stage: $3/$4 price: $5",  position, status.assetBalance-getAccumulated(), adj_wait ,cfg.adj_timeout, adj_wait_price);
 				delayed_trade_detect = true;
 			}
@@ -410,14 +451,16 @@ void MTrader::perform(bool manually) {
 			if (status.curStep) {
 
 				if (!cfg.enabled || need_initial_reset || delayed_trade_detect)  {
+					OrderBatch batch;
 					if (orders.buy.has_value())
-						stock->placeOrder(cfg.pairsymb,0,0,magic,orders.buy->id,0);
+						batch.add({0,0,magic,orders.buy->id,0});
 					if (orders.sell.has_value())
-						stock->placeOrder(cfg.pairsymb,0,0,magic,orders.sell->id,0);
+						batch.add({0,0,magic,orders.sell->id,0});
 					if (orders.buy2.has_value())
-						stock->placeOrder(cfg.pairsymb,0,0,magic2,orders.buy2->id,0);
+						batch.add({0,0,magic2,orders.buy2->id,0});
 					if (orders.sell2.has_value())
-						stock->placeOrder(cfg.pairsymb,0,0,magic2,orders.sell2->id,0);
+						batch.add({0,0,magic2,orders.sell2->id,0});
+					batch.commit(*stock, cfg.pairsymb);
 					if (!cfg.hidden) {
 						if (delayed_trade_detect) {
 							if (adj_wait>1) {
@@ -516,43 +559,41 @@ void MTrader::perform(bool manually) {
 						buyorder.alert = IStrategy::Alert::disabled;
 					}
 
-					for (int _i=0;_i<2;_i++) {
+					//both sides are sent at once
+					OrderBatch batch;
+					auto orig_buy = orders.buy;
+					auto orig_sell = orders.sell;
+					auto plan = [&](std::optional<IStockApi::Order> &orig, const Order &order, std::optional<AlertInfo> &alert, std::string &error) {
 						try {
-							setOrder(orders.buy, buyorder, buy_alert, false);
-							if (!orders.buy.has_value()) {
-								acceptLoss(status, 1);
-							}
-							_i=1;
+							setOrder(orig, order, alert, false, batch, error);
 						} catch (std::exception &e) {
-							if (!orders.buy2.has_value() || _i) {
-								buy_order_error = e.what();
-								acceptLoss(status, 1);
-								_i=1;
-							} else {
-								stock->placeOrder(cfg.pairsymb, 0, 0, json::Value(), orders.buy2->id, 0);
-								orders.buy2.reset();
-								logProgress("Canceled 2nd buy order because error $1",e.what());
-							}
+							error = e.what();
 						}
+					};
+					plan(orders.buy, buyorder, buy_alert, buy_order_error);
+					plan(orders.sell, sellorder, sell_alert, sell_order_error);
+					batch.commit(*stock, cfg.pairsymb);
+
+					//failed order is repeated after the secondary order is canceled
+					auto retry = [&](std::optional<IStockApi::Order> &ord, std::optional<IStockApi::Order> &ord2,
+									const std::optional<IStockApi::Order> &orig, const Order &order,
+									std::optional<AlertInfo> &alert, std::string &error, const char *msg) {
+						if (error.empty() || !ord2.has_value()) return;
+						logProgress(msg, error);
+						error.clear();
+						batch.cancel(ord2, error);
+						ord = orig;
+						plan(ord, order, alert, error);
+					};
+					retry(orders.buy, orders.buy2, orig_buy, buyorder, buy_alert, buy_order_error, "Canceled 2nd buy order because error $1");
+					retry(orders.sell, orders.sell2, orig_sell, sellorder, sell_alert, sell_order_error, "Canceled 2nd sell order because error $1");
+					batch.commit(*stock, cfg.pairsymb);
+
+					if (!buy_order_error.empty() || !orders.buy.has_value()) {
+						acceptLoss(status, 1);
 					}
-					for (int _i=0;_i<2;_i++) {
-						try {
-							setOrder(orders.sell, sellorder, sell_alert, false);
-							if (!orders.sell.has_value()) {
-								acceptLoss(status, -1);
-							}
-							_i=1;
-						} catch (std::exception &e) {
-							if (!orders.sell2.has_value() || _i) {
- 								sell_order_error = e.what();
-								acceptLoss(status,-1);
-								_i=1;
-							} else {
-								stock->placeOrder(cfg.pairsymb, 0, 0, json::Value(), orders.sell2->id, 0);
-								orders.sell2.reset();
-								logProgress("Canceled 2nd sell order because error $1",e.what());
-							}
-						}
+					if (!sell_order_error.empty() || !orders.sell.has_value()) {
+						acceptLoss(status, -1);
 					}
 
 					if (buy_alert.has_value() && sell_alert.has_value() && buy_alert->price > sell_alert->price) {
@@ -560,7 +601,7 @@ void MTrader::perform(bool manually) {
 					}
 
 					if (!recalc && !manually) {
-						update_dynmult(false,false);
+						for (unsigned int i = 0; i < cycle_minutes; i++) update_dynmult(false,false);
 					}
 
 					//report order errors to UI
@@ -599,6 +640,8 @@ void MTrader::perform(bool manually) {
 
 
 		if (!cfg.hidden) {
+			static PerfHistogram &report_probe_hist = PerfStats::global().get("mtrader.report");
+			PerfProbe report_probe(report_probe_hist);
 			int last_trade_dir = !anytrades?0:sgn(lastTradeSize);
 			if (fast_trade) {
 				if (last_trade_dir < 0) orders.sell.reset();
@@ -608,11 +651,14 @@ void MTrader::perform(bool manually) {
 			//report orders to UI
 			statsvc->reportOrders(1,orders.buy,orders.sell);
 			//report trades to UI
-			statsvc->reportTrades(position, trades);
+			statsvc->reportTrades(position, trades, archived_agg);
 			//report price to UI
 			statsvc->reportPrice(status.curPrice);
 			//report misc
+			static PerfHistogram &range_probe_hist = PerfStats::global().get("strategy.calc_safe_range");
+			PerfProbe range_probe(range_probe_hist);
 			auto minmax = strategy.calcSafeRange(minfo,status.assetAvailBalance,status.currencyAvailBalance);
+			range_probe.stop();
 			auto budget = strategy.getBudgetInfo();
 			std::optional<double> budget_extra;
 			if (!trades.empty())
@@ -639,8 +685,8 @@ void MTrader::perform(bool manually) {
 				budget.assets,
 				accumulated,
 				budget_extra,
-				trades.size(),
-				trades.empty()?0:(trades.back().time-trades[0].time),
+				archived_count+trades.size(),
+				trades.empty()?0:(trades.back().time-getFirstTradeTime()),
 				centerPrice,
 				position,
 				buy_norm,
@@ -653,69 +699,78 @@ void MTrader::perform(bool manually) {
 		}
 
 		if (!manually) {
-			if (chart.empty() || chart.back().time < status.chartItem.time) {
+			if (adaptive_cycle) {
+				if (cycle_minutes) pushChartItem(status.chartItem, cycle_minutes);
+			} else if (chart.empty() || chart.back().time < status.chartItem.time) {
 				//store current price (to build chart)
+				//very old data are removed from the chart
+				chart.setCapacity(chartCapacity());
 				chart.push_back(status.chartItem);
-				{
-					//delete very old data from chart
-					unsigned int max_count = std::max<unsigned int>(std::max(cfg.spread_calc_sma_hours, cfg.spread_calc_stdev_hours),240*60);
-					if (chart.size() > max_count)
-						chart.erase(chart.begin(),chart.end()-max_count);
-				}
 			}
 		}
 
 		lastTradeId  = status.new_trades.lastId;
 
+		OrderBatch batch2;
+		std::optional<AlertInfo> buy2_alert, sell2_alert;
+		std::string buy2_error, sell2_error;
 		if (cfg.secondary_order_distance > 0 && orders.buy.has_value() && orders.buy->price > 0) {
-			std::optional<AlertInfo> alert;
 			try {
 				auto buyorder = calculateOrder(buy_state,orders.buy->price,-status.curStep,
 												cfg.secondary_order_distance,
 												status.ticker.bid,position+orders.buy->size,
 												status.currencyBalance,false);
-				setOrder(orders.buy2, buyorder, alert, true);
+				setOrder(orders.buy2, buyorder, buy2_alert, true, batch2, buy2_error);
 			} catch (std::exception &e) {
-				logError("Failed to create secondary order: $1", e.what());
+				buy2_error = e.what();
 			}
 		} else if (orders.buy2.has_value()) {
-			stock->placeOrder(cfg.pairsymb, 0, 0, json::Value(), orders.buy2->id, 0);
-			orders.buy2.reset();
+			batch2.cancel(orders.buy2, buy2_error);
 		}
 
 
 		if (cfg.secondary_order_distance > 0 && orders.sell.has_value() && orders.sell->price > 0) {
-			std::optional<AlertInfo> alert;
 			try {
 				auto sellorder = calculateOrder(sell_state,orders.sell->price, status.curStep,
 													 cfg.secondary_order_distance,
 													 status.ticker.ask, position+orders.sell->size,
 													 status.currencyBalance,false);
-				setOrder(orders.sell2, sellorder, alert, true);
+				setOrder(orders.sell2, sellorder, sell2_alert, true, batch2, sell2_error);
 			} catch (std::exception &e) {
-				logError("Failed to create secondary order: $1", e.what());
+				sell2_error = e.what();
 			}
 		} else 	if (orders.sell2.has_value()) {
-			stock->placeOrder(cfg.pairsymb, 0, 0, json::Value(), orders.sell2->id, 0);
-			orders.sell2.reset();
+			batch2.cancel(orders.sell2, sell2_error);
 		}
+		batch2.commit(*stock, cfg.pairsymb);
+		if (!buy2_error.empty()) logError("Failed to create secondary order: $1", buy2_error);
+		if (!sell2_error.empty()) logError("Failed to create secondary order: $1", sell2_error);
 		if (!cfg.hidden) statsvc->reportOrders(2,orders.buy2,orders.sell2);
 
 
 
+		cycle_hint = CycleHint{
+			status.curPrice,
+			orders.buy.has_value()?orders.buy->price:buy_alert.has_value()?buy_alert->price:0,
+			orders.sell.has_value()?orders.sell->price:sell_alert.has_value()?sell_alert->price:0,
+			status.curStep
+		};
+
+		//move old trades to the archive
+		archiveTrades();
 		//save state
 		saveState();
 		first_cycle = false;
 
 	} catch (std::exception &e) {
 		if (!cfg.hidden) {
-			statsvc->reportTrades(position,trades);
+			statsvc->reportTrades(position, trades, archived_agg);
 			std::string error;
 			error.append(e.what());
 			statsvc->reportError(IStatSvc::ErrorObj(error.c_str()));
 			statsvc->reportMisc(IStatSvc::MiscData{
 				0,false,cfg.enabled,0,0,dynmult.getBuyMult(),dynmult.getSellMult(),0,0,0,0,accumulated,0,
-				trades.size(),trades.empty()?0UL:(trades.back().time-trades[0].time),lastTradePrice,position,
+				archived_count+trades.size(),trades.empty()?0UL:(trades.back().time-getFirstTradeTime()),lastTradePrice,position,
 						0,0,acb_state.getOpen(),acb_state.getRPnL(),acb_state.getUPnL(lastTradePrice)
 			},true);
 			statsvc->reportPrice(trades.empty()?1:trades.back().price);
@@ -726,6 +781,8 @@ void MTrader::perform(bool manually) {
 
 
 MTrader::OrderPair MTrader::getOrders() {
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.get_orders");
+	PerfProbe probe(probe_hist);
 	OrderPair ret;
 	auto data = stock->getOpenOrders(cfg.pairsymb);
 	for (auto &&x: data) {
@@ -774,72 +831,106 @@ MTrader::OrderPair MTrader::getOrders() {
 }
 
 
-void MTrader::setOrder(std::optional<IStockApi::Order> &orig, Order neworder, std::optional<AlertInfo> &alert, bool secondary) {
+void MTrader::setOrder(std::optional<IStockApi::Order> &orig, Order neworder, std::optional<AlertInfo> &alert, bool secondary, OrderBatch &batch, std::string &error) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.set_order");
+	PerfProbe probe(probe_hist);
 	alert.reset();
-	try {
-		if (neworder.price < 0) {
-			if (orig.has_value()) return;
-			throw std::runtime_error("Order rejected - negative price");
-		}
-		if (!std::isfinite(neworder.price)) {
-			if (orig.has_value()) return;
-			throw std::runtime_error("Order rejected - Price is not finite");
-		}
-		if (!std::isfinite(neworder.size)) {
-			if (orig.has_value()) return;
-			throw std::runtime_error("Order rejected - Size is not finite");
+	if (neworder.price < 0) {
+		if (orig.has_value()) return;
+		throw std::runtime_error("Order rejected - negative price");
+	}
+	if (!std::isfinite(neworder.price)) {
+		if (orig.has_value()) return;
+		throw std::runtime_error("Order rejected - Price is not finite");
+	}
+	if (!std::isfinite(neworder.size)) {
+		if (orig.has_value()) return;
+		throw std::runtime_error("Order rejected - Size is not finite");
+	}
+	if (neworder.alert == IStrategy::Alert::forced && neworder.size == 0) {
+		if (orig.has_value() && orig->id.hasValue()) {
+			//cancel current order
+			batch.cancel(orig, error);
 		}
-		if (neworder.alert == IStrategy::Alert::forced && neworder.size == 0) {
-			if (orig.has_value() && orig->id.hasValue()) {
-				//cancel current order
-				stock->placeOrder(cfg.pairsymb,0,0,nullptr,orig->id,0);
-			}
+		alert = AlertInfo{neworder.price, neworder.ar};
+		neworder.size = 0;
+		neworder.update(orig);
+		return;
+	}
+
+	if (neworder.size == 0) {
+		if (neworder.alert == IStrategy::Alert::disabled|| orig.has_value()) return;
+		alert = AlertInfo{neworder.price, neworder.ar};
+		neworder.update(orig);
+		return;
+	}
+
+	IStockApi::Order n {json::undefined, secondary?magic2:magic, neworder.size, neworder.price};
+	json::Value replaceid;
+	double replaceSize = 0;
+	if (orig.has_value()) {
+		if (neworder.isSimilarTo(*orig, minfo.currency_step, minfo.invert_price)) return;
+		replaceid = orig->id;
+		replaceSize = std::fabs(orig->size);
+	}
+	batch.add({n.size, n.price, n.client_id, replaceid, replaceSize},
+			[&orig, &alert, &error, n, neworder, replaceid](const IStockApi::NewOrderResult &r) mutable {
+		if (!r.error.empty()) {
+			orig = n;
+			error = r.error;
+		} else if (!r.id.hasValue()) {
 			alert = AlertInfo{neworder.price, neworder.ar};
 			neworder.size = 0;
 			neworder.update(orig);
-			return;
-		}
-
-		if (neworder.size == 0) {
-			if (neworder.alert == IStrategy::Alert::disabled|| orig.has_value()) return;
-			alert = AlertInfo{neworder.price, neworder.ar};
+		} else if (r.id != replaceid) {
+			n.id = r.id;
+			orig = n;
+		} else {
 			neworder.update(orig);
-			return;
 		}
+	});
+}
 
-		IStockApi::Order n {json::undefined, secondary?magic2:magic, neworder.size, neworder.price};
-		try {
-			json::Value replaceid;
-			double replaceSize = 0;
-			if (orig.has_value()) {
-				if (neworder.isSimilarTo(*orig, minfo.currency_step, minfo.invert_price)) return;
-				replaceid = orig->id;
-				replaceSize = std::fabs(orig->size);
-			}
-			json::Value placeid = stock->placeOrder(
-						cfg.pairsymb,
-						n.size,
-						n.price,
-						n.client_id,
-						replaceid,
-						replaceSize);
-			if (!placeid.hasValue()) {
-				alert = AlertInfo{neworder.price, neworder.ar};
-				neworder.size = 0;
-				neworder.update(orig);
-			} else if (placeid != replaceid) {
-				n.id = placeid;
-				orig = n;
-			} else {
-				neworder.update(orig);
-			}
-		} catch (...) {
-			orig = n;
-			throw;
+void MTrader::OrderBatch::add(IStockApi::NewOrder &&order, Callback &&cb) {
+	orders.push_back(std::move(order));
+	callbacks.push_back(std::move(cb));
+}
+
+void MTrader::OrderBatch::add(IStockApi::NewOrder &&order) {
+	orders.push_back(std::move(order));
+	callbacks.push_back(nullptr);
+}
+
+void MTrader::OrderBatch::cancel(std::optional<IStockApi::Order> &ord, std::string &error) {
+	add({0, 0, json::Value(), ord->id, 0}, [&ord, &error, prev = *ord](const IStockApi::NewOrderResult &r) {
+		if (!r.error.empty()) {
+			ord = prev;
+			error = r.error;
 		}
-	} catch (...) {
-		throw;
+	});
+	ord.reset();
+}
+
+void MTrader::OrderBatch::commit(IStockApi &stock, const std::string_view &pair) {
+	if (orders.empty()) return;
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.place_orders");
+	PerfProbe probe(probe_hist);
+	std::vector<IStockApi::NewOrderResult> res;
+	try {
+		res = stock.placeOrders(pair, orders);
+	} catch (std::exception &e) {
+		//state of the orders is unknown, all operations failed
+		res.assign(orders.size(), IStockApi::NewOrderResult{json::Value(), e.what()});
 	}
+	std::vector<Callback> cbs;
+	std::swap(cbs, callbacks);
+	orders.clear();
+	std::string error;
+	for (std::size_t i = 0; i < cbs.size(); i++) {
+		if (cbs[i] != nullptr) cbs[i](res[i]);
+		else if (error.empty()) error = res[i].error;
+	}
+	if (!error.empty()) throw std::runtime_error(error);
 }
 
 
@@ -901,7 +992,10 @@ MTrader::Status MTrader::getMarketStatus() const {
 	res.chartItem.ask = ticker.ask;
 	res.chartItem.last = ticker.last;
 
+	static PerfHistogram &spread_probe_hist = PerfStats::global().get("mtrader.calc_spread");
+	PerfProbe spread_probe(spread_probe_hist);
 	auto step = calcSpread();
+	spread_probe.stop();
 	res.curStep = step.spread;
 	if (cfg.dynmult_sliding) {
 		res.spreadCenter = step.center;
@@ -1075,6 +1169,8 @@ MTrader::Order MTrader::calculateOrder(
 		double currency,
 		bool alerts) const {
 
+		static PerfHistogram &probe_hist = PerfStats::global().get("strategy.get_new_order");
+		PerfProbe probe(probe_hist);
 		double fakeSize = -step;
 		//remove fees from curPrice to effectively put order inside of bid/ask spread
 		minfo.removeFees(fakeSize, curPrice);
@@ -1189,31 +1285,47 @@ void MTrader::loadState() {
 			adj_wait = state["adj_wait"].getUInt();
 			adj_wait_price = state["adj_wait_price"].getNumber();
 			accumulated = state["accumulated"].getNumber();
+			archived_count = state["archived"].getUInt();
+			archived_first_time = state["archived_first_time"].getUIntLong();
+			archived_agg = IStatSvc::TradesAggregate::fromJSON(state["archived_agg"]);
 		}
 		auto chartSect = st["chart"];
 		if (chartSect.defined()) {
 			chart.clear();
-			for (json::Value v: chartSect) {
-				double ask = v["ask"].getNumber();
-				double bid = v["bid"].getNumber();
-				double last = v["last"].getNumber();
+			chart.setCapacity(chartCapacity());
+			auto pushItem = [&](ChartItem itm) {
 				if (minfo.invert_price) {
-					ask = 1.0/ask;
-					bid = 1.0/bid;
-					last = 1.0/last;
+					itm.ask = 1.0/itm.ask;
+					itm.bid = 1.0/itm.bid;
+					itm.last = 1.0/itm.last;
+				}
+				chart.push_back(itm);
+			};
+			if (columnar::Reader::isColumnar(chartSect)) {
+				columnar::ChartReader rd(chartSect);
+				while (auto itm = rd.next()) pushItem(*itm);
+			} else {
+				for (json::Value v: chartSect) {
+					pushItem({v["time"].getUIntLong(),
+						v["ask"].getNumber(),
+						v["bid"].getNumber(),
+						v["last"].getNumber()});
 				}
-				std::uint64_t tm = v["time"].getUIntLong();
-
-				chart.push_back({tm,ask,bid,last});
 			}
 		}
 		{
 			auto trSect = st["trades"];
 			if (trSect.defined()) {
 				trades.clear();
-				for (json::Value v: trSect) {
-					TWBItem itm = TWBItem::fromJSON(v);
-					trades.push_back(itm);
+				if (columnar::Reader::isColumnar(trSect)) {
+					columnar::TradesReader rd(trSect);
+					trades.reserve(rd.size());
+					while (auto itm = rd.next()) trades.push_back(*itm);
+				} else {
+					for (json::Value v: trSect) {
+						TWBItem itm = TWBItem::fromJSON(v);
+						trades.push_back(itm);
+					}
 				}
 			}
 		}
@@ -1239,13 +1351,36 @@ void MTrader::loadState() {
 
 		}
 	}
-	updateEnterPrice();
+	if (!restoreEnterPrice(st["acb"])) updateEnterPrice();
+	if (archive && archived_agg.count != archived_count) {
+		//aggregate is missing (older state), calculate it from the archive
+		TradeHistory arch = loadArchive(*archive, archived_count);
+		double sumsz = std::accumulate(trades.begin(), trades.end(), 0.0, [](double x, const TWBItem &t){return x+t.eff_size;});
+		archived_agg = aggregateTrades(arch, sumsz);
+		archived_agg.count = archived_count;
+	}
+	if (archive && archived_count && !columnar_format) {
+		//archive is converted, so it can be read by older versions
+		try {
+			json::Value data = archive->load();
+			if (columnar::Reader::isColumnar(data)) {
+				archive->store(encodeTrades(decodeArchive(data, archived_count)));
+			}
+		} catch (std::exception &e) {
+			logWarning("Failed to convert archive of trades: $1", e.what());
+		}
+	}
 
 
 }
 
 void MTrader::saveState() {
-	if (storage == nullptr || need_load) return;
+	if (need_load) return;
+	static PerfHistogram &probe_hist = PerfStats::global().get("mtrader.save_state");
+	PerfProbe probe(probe_hist);
+	publishSnapshot();
+	if (storage == nullptr) return;
+	json::ArenaScope arena;
 	json::Object obj;
 
 	{
@@ -1270,8 +1405,30 @@ void MTrader::saveState() {
 		if (need_initial_reset) st.set("need_initial_reset", need_initial_reset);
 		st.set("adj_wait",adj_wait);
 		if (adj_wait) st.set("adj_wait_price", adj_wait_price);
+		if (archived_count) {
+			st.set("archived", archived_count);
+			st.set("archived_first_time", archived_first_time);
+			st.set("archived_agg", archived_agg.toJSON());
+		}
 	}
 	{
+		//checkpoint of ACB, so it is not need to replay all trades on load
+		auto chk = obj.object("acb");
+		chk.set("count", archived_count + trades.size());
+		chk.set("last_id", trades.empty()?json::Value(nullptr):trades.back().id);
+		chk.set("init_open", cfg.init_open);
+		chk.set("pos", acb_state.getPos());
+		chk.set("open", acb_state.getPos()?acb_state.getOpen():0.0);
+		chk.set("rpnl", acb_state.getRPnL());
+		chk.set("spent", spent_currency);
+	}
+	if (columnar_format) {
+		columnar::ChartWriter ch;
+		for (auto &&itm: chart) {
+			ch.push(minfo.invert_price?ChartItem{itm.time, 1.0/itm.ask, 1.0/itm.bid, 1.0/itm.last}:itm);
+		}
+		obj.set("chart", ch.finish());
+	} else {
 		auto ch = obj.array("chart");
 		for (auto &&itm: chart) {
 			ch.push_back(json::Object({{"time", itm.time},
@@ -1280,12 +1437,7 @@ void MTrader::saveState() {
 				{"last",minfo.invert_price?1.0/itm.last:itm.last}}));
 		}
 	}
-	{
-		auto tr = obj.array("trades");
-		for (auto &&itm:trades) {
-			tr.push_back(itm.toJSON());
-		}
-	}
+	obj.set("trades", encodeTrades(trades));
 	obj.set("strategy",strategy.exportState());
 	storage->store(obj);
 }
@@ -1293,6 +1445,7 @@ void MTrader::saveState() {
 
 bool MTrader::eraseTrade(std::string_view id, bool trunc) {
 	init();
+	trades_modified = true;
 	auto iter = std::find_if(trades.begin(), trades.end(), [&](const IStockApi::Trade &tr) {
 		json::String s = tr.id.toString();
 		return s.str() == id;
@@ -1303,6 +1456,7 @@ bool MTrader::eraseTrade(std::string_view id, bool trunc) {
 	} else {
 		trades.erase(iter);
 	}
+	updateEnterPrice();
 	saveState();
 	return true;
 }
@@ -1390,14 +1544,19 @@ void MTrader::update_dynmult(bool buy_trade,bool sell_trade) {
 
 void MTrader::clearStats() {
 	init();
+	trades_modified = true;
 	trades.clear();
+	if (archive) archive->erase();
+	archived_count = 0;
+	archived_first_time = 0;
+	archived_agg = IStatSvc::TradesAggregate();
 	position = 0;
 	position_valid = false;
 	adj_wait = 0;
 	adj_wait_price = 0;
 	accumulated = 0;
-	saveState();
 	updateEnterPrice();
+	saveState();
 }
 
 void MTrader::stop() {
@@ -1419,6 +1578,7 @@ void MTrader::reset(const ResetOptions &ropt) {
 	}
 	lastPriceOffset = 0;
 	double lastPrice = 0;
+	trades_modified = true;
 	for (auto &&x : trades) {
 		if (!std::isfinite(x.norm_accum)) x.norm_accum = 0;
 		if (!std::isfinite(x.norm_profit)) x.norm_profit = 0;
@@ -1515,10 +1675,57 @@ void MTrader::reset(std::optional<double> achieve_pos) {
 	saveState();
 }
 #endif
+void MTrader::publishSnapshot() {
+	auto snp = std::make_shared<Snapshot>();
+	snp->cfg = cfg;
+	snp->minfo = minfo;
+	snp->broker = stock;
+	snp->strategy = strategy;
+	snp->chart = chart;
+	//trades are only appended most of time, so only new trades are published
+	if (trades_modified || published_trades.size() > trades.size()) {
+		published_trades.clear();
+		trades_modified = false;
+	}
+	for (std::size_t i = published_trades.size(); i < trades.size(); i++) {
+		published_trades.push_back(trades[i]);
+	}
+	snp->trades = published_trades;
+	snp->position = getPosition();
+	snp->currency = getCurrency();
+	snp->archive = archive;
+	snp->archived_count = archived_count;
+	snapshot_slot->set(std::move(snp));
+}
+
 MTrader::Chart MTrader::getChart() const {
 	return chart;
 }
 
+void MTrader::pushChartItem(const ChartItem &itm, unsigned int minutes) {
+	chart.setCapacity(chartCapacity());
+	if (!chart.empty() && itm.time > chart.back().time) {
+		ChartItem prev = chart.back();
+		std::uint64_t prev_minute = prev.time/60000;
+		for (unsigned int i = 1; i < minutes; i++) {
+			//interpolated items are placed on minute boundaries
+			std::uint64_t tm = (prev_minute+i)*60000;
+			double f = static_cast<double>(tm-prev.time)/(itm.time-prev.time);
+			chart.push_back(ChartItem{
+				tm,
+				prev.ask+(itm.ask-prev.ask)*f,
+				prev.bid+(itm.bid-prev.bid)*f,
+				prev.last+(itm.last-prev.last)*f
+			});
+		}
+	}
+	chart.push_back(itm);
+}
+
+unsigned int MTrader::chartCapacity() const {
+	return std::max<unsigned int>(std::max(cfg.spread_calc_sma_hours, cfg.spread_calc_stdev_hours),240*60);
+}
+
 
 void MTrader::addAcceptLossAlert() {
 	Status st = getMarketStatus();
@@ -1546,6 +1753,7 @@ void MTrader::acceptLoss(const Status &st, double dir) {
 
 void MTrader::dropState() {
 	storage->erase();
+	if (archive) archive->erase();
 }
 
 
@@ -1595,9 +1803,11 @@ MTrader::SpreadCalcResult MTrader::calcSpread() const {
 
 	ISpreadFunction::Result r;
 	auto state = spread_fn->start();
-	for (const auto &x: chart) {
-		r = spread_fn->point(state, x.last);
-	}
+	chart.forEachSegment([&](const auto &seg) {
+		for (const auto &x: seg) {
+			r = spread_fn->point(state, x.last);
+		}
+	});
 	if (r.valid) {
 		return {
 			r.spread,r.center
@@ -1792,10 +2002,12 @@ double MTrader::getAccumulated() const {
 
 void MTrader::recalcNorm() {
 	init();
+	trades_modified = true;
 	if (trades.empty()) return;
 	auto st = getMarketStatus();
 	double cur = st.currencyBalance;
 	double pos = st.assetBalance;
+	std::size_t acnt = mergeArchive();
 	double sumsz = std::accumulate(trades.begin(), trades.end(), 0.0, [&](double x, const IStatSvc::TradeRecord &rec){
 		return x+rec.eff_size;
 	});
@@ -1842,12 +2054,15 @@ void MTrader::recalcNorm() {
 		cur = newcur;
 		pos = newpos-=res.normAccum;
 	}
+	splitArchive(acnt);
 	saveState();
 }
 
 void MTrader::fixNorm() {
 	init();
+	trades_modified = true;
 	if (trades.empty()) return;
+	std::size_t acnt = mergeArchive();
 	double normp = std::accumulate(trades.begin(), trades.end(),0.0,[z=0.0](double x,const IStatSvc::TradeRecord &rec) mutable {
 		double df = std::abs(rec.norm_profit-z);
 		z = rec.norm_profit;
@@ -1884,6 +2099,7 @@ void MTrader::fixNorm() {
 		trades[i].norm_accum = cura;
 		trades[i].norm_profit = curp;
 	}
+	splitArchive(acnt);
 	saveState();
 }
 
@@ -1902,21 +2118,163 @@ double MTrader::getRPnL() const {
 }
 
 void MTrader::updateEnterPrice() {
-	double initState = (position_valid?position:0) - std::accumulate(trades.begin(), trades.end(), 0.0, [&](double a, const auto &tr) {
+	TradeHistory arch = archive && archived_count?loadArchive(*archive, archived_count):TradeHistory();
+	auto sumSize = [&](double a, const auto &tr) {
 		return a + tr.eff_size;
-	});
+	};
+	double initState = (position_valid?position:0)
+			- std::accumulate(arch.begin(), arch.end(), 0.0, sumSize)
+			- std::accumulate(trades.begin(), trades.end(), 0.0, sumSize);
 	double openPrice = cfg.init_open;
 	if (openPrice == 0) {
-		if (!trades.empty()) openPrice = trades[0].eff_price;
+		if (!arch.empty()) openPrice = arch[0].eff_price;
+		else if (!trades.empty()) openPrice = trades[0].eff_price;
 	} else {
 		if (minfo.invert_price) openPrice = 1.0/openPrice;
 	}
 
 	ACB acb(openPrice, initState);
 	spent_currency = 0;
-	for (const auto &tr: trades) {
-		acb = acb(tr.eff_price, tr.eff_size);
-		spent_currency += tr.size * tr.price;
+	for (const auto &hist: {&arch, &trades}) {
+		for (const auto &tr: *hist) {
+			acb = acb(tr.eff_price, tr.eff_size);
+			spent_currency += tr.size * tr.price;
+		}
 	}
 	acb_state = acb;
 }
+
+bool MTrader::restoreEnterPrice(json::Value chk) {
+	if (!chk.defined()) return false;
+	if (chk["count"].getUInt() != archived_count + trades.size()) return false;
+	if (chk["init_open"].getNumber() != cfg.init_open) return false;
+	if (chk["last_id"] != (trades.empty()?json::Value(nullptr):trades.back().id)) return false;
+	acb_state = ACB(chk["open"].getNumber(), chk["pos"].getNumber(), chk["rpnl"].getNumber());
+	spent_currency = chk["spent"].getNumber();
+	return true;
+}
+
+void MTrader::setTradeArchive(StoragePtr &&archive) {
+	this->archive = std::move(archive);
+}
+
+MTrader::TradeHistory MTrader::loadArchive(IStorage &archive, std::size_t count) {
+	return decodeArchive(archive.load(), count);
+}
+
+MTrader::TradeHistory MTrader::decodeArchive(json::Value data, std::size_t count) {
+	TradeHistory res;
+	if (columnar::Reader::isColumnar(data)) {
+		columnar::TradesReader rd(data);
+		res.reserve(std::min(count, rd.size()));
+		while (res.size() < count) {
+			auto itm = rd.next();
+			if (!itm.has_value()) break;
+			res.push_back(*itm);
+		}
+	} else {
+		res.reserve(std::min(count, data.size()));
+		for (json::Value v: data) {
+			if (res.size() >= count) break;
+			res.push_back(TWBItem::fromJSON(v));
+		}
+	}
+	return res;
+}
+
+json::Value MTrader::encodeTrades(ondra_shared::StringView<TWBItem> a, ondra_shared::StringView<TWBItem> b) {
+	if (columnar_format) {
+		columnar::TradesWriter data;
+		for (const auto &t: a) data.push(t);
+		for (const auto &t: b) data.push(t);
+		return data.finish();
+	} else {
+		json::Array data;
+		data.reserve(a.length+b.length);
+		for (const auto &t: a) data.push_back(t.toJSON());
+		for (const auto &t: b) data.push_back(t.toJSON());
+		return data;
+	}
+}
+
+void MTrader::archiveTrades() {
+	if (archive == nullptr || trades.size() < tradesInMemory + archiveBatch) return;
+	std::size_t cnt = trades.size() - tradesInMemory;
+	ondra_shared::StringView<TWBItem> newarch(trades.data(), cnt);
+	double sumsz = std::accumulate(trades.begin()+cnt, trades.end(), 0.0, [](double x, const TWBItem &t){return x+t.eff_size;});
+	IStatSvc::TradesAggregate agg;
+	try {
+		TradeHistory cur;
+		if (archived_count) {
+			//the archive can contain more trades, if the state was not saved after archivation
+			cur = loadArchive(*archive, archived_count);
+			if (cur.size() != archived_count) throw std::runtime_error("Archive of trades is damaged");
+		}
+		archive->store(encodeTrades(cur, newarch));
+		if (archived_count && archived_agg.count != archived_count) {
+			cur.insert(cur.end(), newarch.begin(), newarch.end());
+			agg = aggregateTrades(cur, sumsz);
+		}
+	} catch (std::exception &e) {
+		logWarning("Failed to archive trades: $1", e.what());
+		return;
+	}
+	if (!archived_count) {
+		archived_first_time = trades[0].time;
+		archived_agg = aggregateTrades(newarch, sumsz);
+	} else if (archived_agg.count != archived_count) {
+		archived_agg = agg;
+	} else {
+		archived_agg.addAll(newarch);
+	}
+	archived_count += cnt;
+	trades.erase(trades.begin(), trades.begin()+cnt);
+	trades_modified = true;
+}
+
+std::size_t MTrader::mergeArchive() {
+	if (archive == nullptr || archived_count == 0) return 0;
+	TradeHistory arch = loadArchive(*archive, archived_count);
+	std::size_t cnt = arch.size();
+	arch.insert(arch.end(), trades.begin(), trades.end());
+	std::swap(arch, trades);
+	return cnt;
+}
+
+void MTrader::splitArchive(std::size_t count) {
+	if (count == 0) return;
+	try {
+		archive->store(encodeTrades(ondra_shared::StringView<TWBItem>(trades.data(), count)));
+	} catch (std::exception &e) {
+		logWarning("Failed to update archive of trades: $1", e.what());
+		//all trades stay in the memory, the archive is rewritten by next archivation
+		archived_count = 0;
+		archived_first_time = 0;
+		archived_agg = IStatSvc::TradesAggregate();
+		return;
+	}
+	double sumsz = std::accumulate(trades.begin()+count, trades.end(), 0.0, [](double x, const TWBItem &t){return x+t.eff_size;});
+	archived_agg = aggregateTrades(ondra_shared::StringView<TWBItem>(trades.data(), count), sumsz);
+	archived_count = count;
+	trades.erase(trades.begin(), trades.begin()+count);
+}
+
+IStatSvc::TradesAggregate MTrader::aggregateTrades(ondra_shared::StringView<TWBItem> trades, double remain) const {
+	if (trades.empty()) return IStatSvc::TradesAggregate();
+	double sumsz = std::accumulate(trades.begin(), trades.end(), 0.0, [](double x, const TWBItem &t){return x+t.eff_size;});
+	auto agg = IStatSvc::TradesAggregate::start(trades[0].eff_price, position - remain - sumsz);
+	agg.addAll(trades);
+	return agg;
+}
+
+std::uint64_t MTrader::getFirstTradeTime() const {
+	if (archived_count) return archived_first_time;
+	return trades.empty()?0:trades[0].time;
+}
+
+MTrader::TradeHistory MTrader::Snapshot::getFullHistory() const {
+	TradeHistory res;
+	if (archive && archived_count) res = loadArchive(*archive, archived_count);
+	res.insert(res.end(), trades.begin(), trades.end());
+	return res;
+}
@@ -8,6 +8,8 @@
 #ifndef SRC_MAIN_MTRADER_H_
 #define SRC_MAIN_MTRADER_H_
 #include <deque>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <type_traits>
 #include <limits>
@@ -21,6 +23,7 @@
 #include "istatsvc.h"
 #include "storage.h"
 #include "report.h"
+#include "ringbuffer.h"
 #include "spread.h"
 #include "strategy.h"
 #include "walletDB.h"
@@ -129,6 +132,30 @@ public:
 		std::optional<IStockApi::Order> buy,sell,buy2,sell2;
 	};
 
+	///Collects changes of the orders of the cycle, so they are sent to the broker at once
+	class OrderBatch {
+	public:
+		using Callback = std::function<void(const IStockApi::NewOrderResult &)>;
+		///Adds operation, callback receives the result
+		void add(IStockApi::NewOrder &&order, Callback &&cb);
+		///Adds operation without callback (cancel), failure is reported by commit()
+		void add(IStockApi::NewOrder &&order);
+		///Adds cancel of the order and resets the order
+		/**
+		 * @param ord order to cancel, must have value. When the cancel fails, the order is restored
+		 * @param error receives error message when the cancel fails, commit() doesn't throw
+		 */
+		void cancel(std::optional<IStockApi::Order> &ord, std::string &error);
+		///Sends operations to the broker and calls the callbacks
+		/**
+		 * @exception std::runtime_error failure of an operation without callback
+		 */
+		void commit(IStockApi &stock, const std::string_view &pair);
+	protected:
+		std::vector<IStockApi::NewOrder> orders;
+		std::vector<Callback> callbacks;
+	};
+
 
 
 
@@ -143,14 +170,31 @@ public:
 	void perform(bool manually);
 
 	void init();
+	///Binds the trader to the market - the first part of init()
+	/** Retrieves the market info and registers the pair. Traders are bound in order of the
+	 * configuration, because the first trader wins the conflict on the pair */
+	void initMarket();
+	///Loads the state - the second part of init()
+	/** Must be called after initMarket(). Different traders can load their states in parallel */
+	void initState();
 	bool need_init() const;
 
 	OrderPair getOrders();
-	void setOrder(std::optional<IStockApi::Order> &orig, Order neworder, std::optional<AlertInfo> &alert, bool secondary);
+	///Compares the order with the current order and adds the change to the batch
+	/**
+	 * @param orig current order, updated when batch is committed
+	 * @param neworder new order
+	 * @param alert receives alert, if alert is created instead of the order
+	 * @param secondary the order is secondary order
+	 * @param batch batch
+	 * @param error receives error message when the operation fails during commit
+	 * @exception std::runtime_error order is rejected
+	 */
+	void setOrder(std::optional<IStockApi::Order> &orig, Order neworder, std::optional<AlertInfo> &alert, bool secondary, OrderBatch &batch, std::string &error);
 
 
 	using ChartItem = IStatSvc::ChartItem;
-	using Chart = std::vector<ChartItem>;
+	using Chart = RingBuffer<ChartItem>;
 
 
 	struct Status {
@@ -223,14 +267,66 @@ public:
 	void reset(const ResetOptions &opt);
 
 
+	///Returns snapshot of the minute chart (doesn't copy the data)
 	Chart getChart() const;
 	void dropState();
 	void stop();
 
 	using TradeHistory = std::vector<IStatSvc::TradeRecord>;
+	///Trades shared with snapshots. Capacity is unlimited, new trades are only appended
+	using TradeLog = RingBuffer<IStatSvc::TradeRecord>;
 
 	const TradeHistory &getTrades() const;
 
+	///Immutable copy of the trader's state
+	/**
+	 * The snapshot is published every time the state is saved (at the end of each cycle and
+	 * after every change made through the web interface). It is shared, so readers don't
+	 * need to copy the data and they don't need to lock the trader
+	 */
+	struct Snapshot {
+		Config cfg;
+		IStockApi::MarketInfo minfo;
+		PStockApi broker;
+		Strategy strategy = Strategy(nullptr);
+		Chart chart;
+		TradeLog trades;
+		std::optional<double> position;
+		std::optional<double> currency;
+		///storage of archived trades
+		std::shared_ptr<IStorage> archive;
+		///count of archived trades
+		std::size_t archived_count = 0;
+
+		///Returns whole trade history including archived trades (loads the archive)
+		TradeHistory getFullHistory() const;
+	};
+
+	using PSnapshot = std::shared_ptr<const Snapshot>;
+
+	///Holds the last published snapshot. It can be accessed without locking the trader
+	class SnapshotSlot {
+	public:
+		PSnapshot get() const {return std::atomic_load(&snapshot);}
+		void set(PSnapshot s) {std::atomic_store(&snapshot, std::move(s));}
+	protected:
+		PSnapshot snapshot;
+	};
+
+	using PSnapshotSlot = std::shared_ptr<SnapshotSlot>;
+
+	///Sets storage where old trades are archived
+	/**
+	 * Only recent trades are held in the memory and in the state. Older trades are moved to
+	 * the archive, which is loaded only when whole history is needed. Without the archive,
+	 * all trades are kept in the state.
+	 */
+	void setTradeArchive(StoragePtr &&archive);
+
+	///Returns slot of published snapshots
+	/** The slot can be kept outside of the trader's lock. It is empty until the trader is initialized */
+	PSnapshotSlot getSnapshotSlot() const {return snapshot_slot;}
+
 
 	Strategy getStrategy() const {return strategy;}
 	void setStrategy(const Strategy &s) {strategy = s;}
@@ -268,6 +364,36 @@ public:
 
 	static PStockApi selectStock(IStockSelector &stock_selector, std::string_view broker_name, SwapMode swap_mode, int emulate_leverage, bool paper_trading);
 
+	///Informations about the last cycle used to plan the next cycle
+	struct CycleHint {
+		///last price (0 - not available yet)
+		double price;
+		///price of the buy order or the buy alert (0 - none)
+		double buy;
+		///price of the sell order or the sell alert (0 - none)
+		double sell;
+		///current step (logarithmic distance)
+		double step;
+	};
+
+	///Enables adaptive cycle
+	/**
+	 * In adaptive cycle, the trader can be performed more or less often than once per minute. The chart
+	 * still stores one item per minute (missing minutes are interpolated) and per-minute counters are
+	 * advanced by the elapsed minutes
+	 */
+	void setAdaptiveCycle(bool en) {adaptive_cycle = en;}
+	///Selects format of the chart and the trades in the state and in the archive
+	/**
+	 * @param en true - columnar format (default), false - arrays of objects. Versions before
+	 * the columnar format load the columnar chart and trades as empty, so the format must be
+	 * switched off and the state saved before such version is started (the archive of the trades
+	 * is converted on load). Both formats are always accepted on load
+	 */
+	static void setColumnarFormat(bool en) {columnar_format = en;}
+	///Returns hint from the last cycle
+	const CycleHint &getCycleHint() const {return cycle_hint;}
+
 protected:
 
 	PStockApi stock;
@@ -284,6 +410,10 @@ protected:
 	bool achieve_mode = false;
 	bool need_initial_reset = true;
 	unsigned int adj_wait = 0;
+	bool adaptive_cycle = false;
+	///minutes elapsed since the last cycle (always 1 when adaptive cycle is disabled)
+	unsigned int cycle_minutes = 1;
+	CycleHint cycle_hint = {};
 	double adj_wait_price = 0;
 	double lastPriceOffset = 0;
 	double lastTradePrice = 0;
@@ -295,8 +425,27 @@ protected:
 	using TradeItem = IStockApi::Trade;
 	using TWBItem = IStatSvc::TradeRecord;
 
-	std::vector<ChartItem> chart;
+	static bool columnar_format;
+
+	Chart chart;
 	TradeHistory trades;
+	PSnapshotSlot snapshot_slot = std::make_shared<SnapshotSlot>();
+	///trades published in snapshots, new trades are appended, items are shared with snapshots
+	TradeLog published_trades = TradeLog(std::numeric_limits<std::size_t>::max());
+	///set when trades were modified in place or removed (so published trades must be rebuilt)
+	bool trades_modified = true;
+	std::shared_ptr<IStorage> archive;
+	///count of trades moved to the archive
+	std::size_t archived_count = 0;
+	///time of the first archived trade
+	std::uint64_t archived_first_time = 0;
+	///aggregate of the archived trades, the report continues from it
+	IStatSvc::TradesAggregate archived_agg;
+
+	///Count of trades kept in the memory, when the archive is used
+	static constexpr std::size_t tradesInMemory = 10000;
+	///Trades are archived in batches of this size (to avoid rewriting the archive every cycle)
+	static constexpr std::size_t archiveBatch = 2000;
 
 	double position = 0;
 	double currency = 0;
@@ -336,6 +485,44 @@ protected:
 
 
 	SpreadCalcResult calcSpread() const;
+	///Count of minutes kept in the chart
+	unsigned int chartCapacity() const;
+	///Appends item to the chart, missing minutes are interpolated
+	/**
+	 * @param itm item to append
+	 * @param minutes count of minute boundaries between the last item and the new item
+	 */
+	void pushChartItem(const ChartItem &itm, unsigned int minutes);
+	///Publishes current state as a snapshot
+	void publishSnapshot();
+	///Moves old trades to the archive
+	void archiveTrades();
+	///Loads archived trades
+	static TradeHistory loadArchive(IStorage &archive, std::size_t count);
+	///Decodes archived trades (columnar or array of objects)
+	static TradeHistory decodeArchive(json::Value data, std::size_t count);
+	///Encodes trades in the selected format (see setColumnarFormat())
+	/**
+	 * @param a trades
+	 * @param b trades which follow the trades a
+	 */
+	static json::Value encodeTrades(ondra_shared::StringView<TWBItem> a, ondra_shared::StringView<TWBItem> b = ondra_shared::StringView<TWBItem>());
+	///Prepends archived trades to the trades (to process whole history)
+	/** @return count of trades loaded from the archive */
+	std::size_t mergeArchive();
+	///Moves the trades back to the archive (after mergeArchive)
+	void splitArchive(std::size_t count);
+	///Calculates aggregate of the trades from the first trade
+	/**
+	 * @param trades trades from the first trade
+	 * @param remain sum of sizes of the trades, which follow the trades
+	 */
+	IStatSvc::TradesAggregate aggregateTrades(ondra_shared::StringView<TWBItem> trades, double remain) const;
+	///Restores ACB state from the checkpoint saved in the state
+	/** @retval false checkpoint is missing or doesn't match to the trades */
+	bool restoreEnterPrice(json::Value checkpoint);
+	///Returns time of the first trade
+	std::uint64_t getFirstTradeTime() const;
 	bool checkMinMaxBalance(double newBalance, double dir, double price) const;
 	std::pair<AlertReason, double> limitOrderMinMaxBalance(double balance, double orderSize, double price) const;
 
@@ -134,13 +134,17 @@ bool AbstractPaperTrading::canCreateOrder(const TradeState &st, double price, do
 	}
 }
 
+std::time_t AbstractPaperTrading::now() const {
+	return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
 //Trading function is implement in reset()
 //it loads ticker and performs simulation of market matching
 void AbstractPaperTrading::simulate(TradeState &st) {
 	//get ticker
 	st.ticker = st.source->getTicker(st.src_pair);
 
-	auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	auto now = this->now();
 
 	if (st.minfo.leverage) {
 		double eq = st.collateral.getEquity(st.ticker.last) + getRawBalance(st).currency;
@@ -294,7 +298,7 @@ json::Value PaperTrading::setSettings(json::Value v) {
 		if (state.minfo.invert_price) nv = -nv;
 		double diff = nv - pos;
 		if (std::abs(diff) > state.minfo.asset_step) {
-			auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())*1000;
+			auto now = this->now()*1000;
 			Trade t{
 					now,static_cast<std::uint64_t>(now),diff,state.ticker.last,diff,state.ticker.last
 			};
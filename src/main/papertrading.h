@@ -76,6 +76,9 @@ protected: //To override
 
 	virtual bool canCreateOrder(const TradeState &st, double price, double size);
 
+	///Returns current time (unix time in seconds), used as time of simulated trades
+	virtual std::time_t now() const;
+
 protected:
 
 	json::Value exportState(const TradeState &st);
@@ -0,0 +1,109 @@
+/*
+ * perfstats.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "perfstats.h"
+
+#include <imtjson/object.h>
+
+void PerfHistogram::record(std::uint64_t us) {
+	buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(us, std::memory_order_relaxed);
+	std::uint64_t m = max.load(std::memory_order_relaxed);
+	while (m < us && !max.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+}
+
+unsigned int PerfHistogram::bucketOf(std::uint64_t us) {
+	if (us < linearBuckets) return static_cast<unsigned int>(us);
+	unsigned int e = 63 - __builtin_clzll(us);
+	unsigned int sub = static_cast<unsigned int>(us >> (e - 3)) & (subBuckets - 1);
+	unsigned int idx = linearBuckets + (e - 4) * subBuckets + sub;
+	return std::min(idx, bucketCount - 1);
+}
+
+std::uint64_t PerfHistogram::bucketValue(unsigned int idx) {
+	if (idx < linearBuckets) return idx;
+	unsigned int e = (idx - linearBuckets) / subBuckets + 4;
+	unsigned int sub = (idx - linearBuckets) % subBuckets;
+	std::uint64_t lower = static_cast<std::uint64_t>(subBuckets + sub) << (e - 3);
+	std::uint64_t width = std::uint64_t(1) << (e - 3);
+	return lower + width / 2;
+}
+
+std::uint64_t PerfHistogram::getQuantile(double q) const {
+	std::uint64_t total = 0;
+	std::array<std::uint64_t, bucketCount> cp;
+	for (unsigned int i = 0; i < bucketCount; i++) {
+		cp[i] = buckets[i].load(std::memory_order_relaxed);
+		total += cp[i];
+	}
+	if (total == 0) return 0;
+	std::uint64_t rank = static_cast<std::uint64_t>(q * (total - 1)) + 1;
+	std::uint64_t acc = 0;
+	for (unsigned int i = 0; i < bucketCount; i++) {
+		acc += cp[i];
+		if (acc >= rank) return std::min(bucketValue(i), max.load(std::memory_order_relaxed));
+	}
+	return max.load(std::memory_order_relaxed);
+}
+
+PerfHistogram::Summary PerfHistogram::getSummary() const {
+	Summary s;
+	s.count = count.load(std::memory_order_relaxed);
+	s.sum = sum.load(std::memory_order_relaxed);
+	s.max = max.load(std::memory_order_relaxed);
+	s.p50 = getQuantile(0.5);
+	s.p90 = getQuantile(0.9);
+	s.p99 = getQuantile(0.99);
+	return s;
+}
+
+PerfHistogram &PerfStats::get(const std::string_view &name) {
+	std::unique_lock _(lock);
+	auto iter = histograms.find(name);
+	if (iter == histograms.end()) {
+		iter = histograms.emplace(std::string(name), std::make_unique<PerfHistogram>()).first;
+	}
+	return *iter->second;
+}
+
+json::Value PerfStats::toJSON() const {
+	std::unique_lock _(lock);
+	json::Object res;
+	for (const auto &x: histograms) {
+		auto s = x.second->getSummary();
+		res.set(x.first, json::Object({
+			{"count", s.count},
+			{"mean", s.count?s.sum*0.001/s.count:0.0},
+			{"p50", s.p50*0.001},
+			{"p90", s.p90*0.001},
+			{"p99", s.p99*0.001},
+			{"max", s.max*0.001}
+		}));
+	}
+	return res;
+}
+
+void PerfStats::exportPrometheus(std::ostream &out) const {
+	std::unique_lock _(lock);
+	out << "# HELP mmbot_probe_seconds Duration of the instrumented operations\n"
+		<< "# TYPE mmbot_probe_seconds summary\n";
+	for (const auto &x: histograms) {
+		auto s = x.second->getSummary();
+		const std::string &n = x.first;
+		out << "mmbot_probe_seconds{probe=\"" << n << "\",quantile=\"0.5\"} " << s.p50*0.000001 << "\n"
+			<< "mmbot_probe_seconds{probe=\"" << n << "\",quantile=\"0.9\"} " << s.p90*0.000001 << "\n"
+			<< "mmbot_probe_seconds{probe=\"" << n << "\",quantile=\"0.99\"} " << s.p99*0.000001 << "\n"
+			<< "mmbot_probe_seconds_sum{probe=\"" << n << "\"} " << s.sum*0.000001 << "\n"
+			<< "mmbot_probe_seconds_count{probe=\"" << n << "\"} " << s.count << "\n";
+	}
+}
+
+PerfStats &PerfStats::global() {
+	static PerfStats inst;
+	return inst;
+}
@@ -0,0 +1,133 @@
+/*
+ * perfstats.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_PERFSTATS_H_
+#define SRC_MAIN_PERFSTATS_H_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include <imtjson/value.h>
+
+///Histogram of durations with logarithmic buckets (HDR style)
+/**
+ * Values are stored in microseconds. Values below 16us have own bucket, larger values
+ * are split to 8 buckets per power of two, so relative error is less than 12.5%.
+ *
+ * Recording is lock-free, so it can be used from any thread.
+ */
+class PerfHistogram {
+public:
+
+	struct Summary {
+		std::uint64_t count = 0;
+		///all values are in microseconds
+		std::uint64_t sum = 0;
+		std::uint64_t max = 0;
+		std::uint64_t p50 = 0;
+		std::uint64_t p90 = 0;
+		std::uint64_t p99 = 0;
+	};
+
+	///Records a value
+	void record(std::uint64_t us);
+
+	///Calculates summary (approximate, when recording runs concurrently)
+	Summary getSummary() const;
+
+	///Returns value at given quantile (0.0 - 1.0)
+	std::uint64_t getQuantile(double q) const;
+
+protected:
+	static constexpr unsigned int linearBuckets = 16;
+	static constexpr unsigned int subBuckets = 8;
+	static constexpr unsigned int bucketCount = linearBuckets + 37 * subBuckets;
+
+	std::array<std::atomic<std::uint64_t>, bucketCount> buckets = {};
+	std::atomic<std::uint64_t> count = 0;
+	std::atomic<std::uint64_t> sum = 0;
+	std::atomic<std::uint64_t> max = 0;
+
+	static unsigned int bucketOf(std::uint64_t us);
+	static std::uint64_t bucketValue(unsigned int idx);
+};
+
+///Registry of named histograms
+class PerfStats {
+public:
+
+	///Returns histogram of given name. Reference stays valid until end of the process
+	PerfHistogram &get(const std::string_view &name);
+
+	///Exports summaries as json (values are in milliseconds)
+	json::Value toJSON() const;
+
+	///Exports summaries in the Prometheus text format
+	void exportPrometheus(std::ostream &out) const;
+
+	///Process wide instance
+	static PerfStats &global();
+
+protected:
+	mutable std::mutex lock;
+	std::map<std::string, std::unique_ptr<PerfHistogram>, std::less<> > histograms;
+};
+
+///Measures duration of the scope and records it to the histogram
+/**
+ * Lookup of the histogram locks the registry, so resolve the histogram only once at the
+ * call site:
+ * @code
+ * static PerfHistogram &probe_hist = PerfStats::global().get("name");
+ * PerfProbe probe(probe_hist);
+ * @endcode
+ */
+class PerfProbe {
+public:
+	explicit PerfProbe(PerfHistogram &hist)
+		:hist(suppressed?nullptr:&hist),start(std::chrono::steady_clock::now()) {}
+	~PerfProbe() {stop();}
+
+	PerfProbe(const PerfProbe &) = delete;
+	PerfProbe &operator=(const PerfProbe &) = delete;
+
+	///Records the duration now (only once)
+	void stop() {
+		if (hist) {
+			hist->record(std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - start).count());
+			hist = nullptr;
+		}
+	}
+
+	///Suppresses recording of the probes in the current thread while the object exists
+	/** Used by simulations (replay), which must not be mixed with statistics of the live traders */
+	class Suppress {
+	public:
+		Suppress():prev(suppressed) {suppressed = true;}
+		~Suppress() {suppressed = prev;}
+		Suppress(const Suppress &) = delete;
+		Suppress &operator=(const Suppress &) = delete;
+	protected:
+		bool prev;
+	};
+
+protected:
+	PerfHistogram *hist;
+	std::chrono::steady_clock::time_point start;
+
+	static inline thread_local bool suppressed = false;
+};
+
+
+#endif /* SRC_MAIN_PERFSTATS_H_ */
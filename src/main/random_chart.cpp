@@ -7,8 +7,13 @@
 
 #include "random_chart.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <random>
 
+#include "computepool.h"
+
 void generate_random_chart(double volatility, double noise, unsigned int minutes, std::size_t seed, std::vector<double> &prices) {
 	std::mt19937 rgen(seed);
 
@@ -17,6 +22,9 @@ void generate_random_chart(double volatility, double noise, unsigned int minutes
 	double cur_noise=0;
 	unsigned int stop=60;
 	std::uniform_int_distribution<> distr_n(0,1);
+	prices.reserve(prices.size()+minutes);
+	//note: distributions are constructed inside of the loop intentionally,
+	//hoisting them changes sequence of generated numbers
 	for (unsigned int i = 0; i < minutes; i++) {
 		if (i % stop == 0) {
 			std::normal_distribution<> distr2;
@@ -38,3 +46,124 @@ void generate_random_chart(double volatility, double noise, unsigned int minutes
 
 }
 
+namespace {
+
+///Counter based random stream (splitmix64 - n-th number is calculated directly)
+class RandomStream {
+public:
+	explicit RandomStream(std::uint64_t key):key(mix(key)) {}
+
+	std::uint64_t operator()(std::uint64_t counter) const {
+		return mix(key + counter * 0x9E3779B97F4A7C15ULL);
+	}
+	///uniform number in range (0,1>
+	double uniform(std::uint64_t counter) const {
+		return ((*this)(counter) >> 11) * 0x1.0p-53 + 0x1.0p-53;
+	}
+	///normal distributed number (Box-Muller), consumes two counters
+	double normal(std::uint64_t counter) const {
+		double u1 = uniform(counter);
+		double u2 = uniform(counter+1);
+		return std::sqrt(-2.0*std::log(u1))*std::cos(2.0*M_PI*u2);
+	}
+
+	static std::uint64_t mix(std::uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+protected:
+	std::uint64_t key;
+};
+
+struct Segment {
+	unsigned int begin;
+	double trend;
+	double noise;
+	double volmult;
+};
+
+///size of the chunk - it must not depend on count of threads
+constexpr unsigned int chunkSize = 65536;
+///count of counters consumed by single minute
+constexpr std::uint64_t minuteCounters = 8;
+
+template<typename Fn>
+void parallel_chunks(unsigned int chunks, ComputePool *pool, Fn &&fn) {
+	if (pool == nullptr) {
+		for (unsigned int i = 0; i < chunks; i++) fn(i);
+	} else {
+		pool->parallel(chunks, fn);
+	}
+}
+
+}
+
+void generate_random_chart(const RandomChartConfig &cfg, double *prices, ComputePool *pool) {
+	if (cfg.minutes == 0) return;
+	RandomStream seg_rnd(cfg.seed*2);
+	RandomStream min_rnd(cfg.seed*2+1);
+
+	//segments are short sequence, so they are generated sequentially
+	std::vector<Segment> segments;
+	double h = 0;
+	std::uint64_t sc = 0;
+	for (unsigned int b = 0; b < cfg.minutes; ) {
+		double trend = seg_rnd.normal(sc)*0.01*cfg.volatility;
+		double noise = seg_rnd.normal(sc+2)*cfg.noise*(1+std::abs(trend)*0.01);
+		unsigned int len = 60 + static_cast<unsigned int>(seg_rnd(sc+4) % 1381);
+		if (cfg.vol_clustering > 0) {
+			double c = std::min(cfg.vol_clustering, 0.999);
+			h = c*h + std::sqrt(1-c*c)*0.5*seg_rnd.normal(sc+5);
+		}
+		segments.push_back({b, trend, noise, std::exp(h)});
+		b += len;
+		sc += 8;
+	}
+
+	const double f = 1.0 - cfg.mean_reversion;
+	unsigned int chunks = (cfg.minutes + chunkSize - 1) / chunkSize;
+	std::vector<double> chunk_end(chunks);
+
+	//first pass - log prices of each chunk, as if chunk started at zero
+	parallel_chunks(chunks, pool, [&](unsigned int c){
+		unsigned int b = c * chunkSize;
+		unsigned int e = std::min(b + chunkSize, cfg.minutes);
+		auto seg = std::upper_bound(segments.begin(), segments.end(), b, [](unsigned int v, const Segment &s){
+			return v < s.begin;
+		}) - 1;
+		double y = 0;
+		for (unsigned int i = b; i < e; i++) {
+			if (seg+1 != segments.end() && seg[1].begin <= i) ++seg;
+			std::uint64_t cnt = static_cast<std::uint64_t>(i) * minuteCounters;
+			double diff = (seg->trend + min_rnd.normal(cnt))*0.01*cfg.volatility*seg->volmult;
+			double ns = 1+((min_rnd(cnt+2) & 1)*2.0-1.0)*seg->noise*0.01;
+			double d = std::log(std::max(1+diff, 1e-9)) + std::log(std::max(ns, 1e-9));
+			if (cfg.jump_prob > 0 && min_rnd.uniform(cnt+3) < cfg.jump_prob) {
+				d += min_rnd.normal(cnt+4) * cfg.jump_size;
+			}
+			y = f * y + d;
+			prices[i] = y;
+		}
+		chunk_end[c] = y;
+	});
+
+	//starting log price of each chunk
+	std::vector<double> chunk_start(chunks);
+	for (unsigned int c = 1; c < chunks; c++) {
+		chunk_start[c] = chunk_start[c-1]*std::pow(f, chunkSize) + chunk_end[c-1];
+	}
+
+	//second pass - apply starting price and convert to price
+	parallel_chunks(chunks, pool, [&](unsigned int c){
+		unsigned int b = c * chunkSize;
+		unsigned int e = std::min(b + chunkSize, cfg.minutes);
+		double y0 = chunk_start[c];
+		double pw = f;
+		for (unsigned int i = b; i < e; i++) {
+			prices[i] = std::exp(prices[i] + y0 * pw);
+			pw *= f;
+		}
+	});
+}
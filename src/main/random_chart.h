@@ -7,11 +7,45 @@
 
 #ifndef SRC_MAIN_RANDOM_CHART_H_
 #define SRC_MAIN_RANDOM_CHART_H_
+#include <cstddef>
 #include <vector>
 
+class ComputePool;
 
+///Generates random chart (classic generator)
+/** The generator is sequential. It is kept, because charts generated by already known seeds must not change */
 void generate_random_chart(double volatility, double noise, unsigned int minutes, std::size_t seed, std::vector<double> &prices);
 
+///Parameters of the stream based generator
+struct RandomChartConfig {
+	///Volatility (same meaning as for classic generator)
+	double volatility = 0.001;
+	///Noise (same meaning as for classic generator)
+	double noise = 0;
+	///Count of minutes
+	unsigned int minutes = 525600;
+	///Seed
+	std::size_t seed = 0;
+	///Probability of a price jump per minute
+	double jump_prob = 0;
+	///Standard deviation of the jump (relative to price, 0.05 = 5%)
+	double jump_size = 0;
+	///Pull of the log price to the initial price per minute (0 = pure random walk)
+	double mean_reversion = 0;
+	///Persistence of volatility between trend segments (0 = no clustering, close to 1 = long calm and volatile periods)
+	double vol_clustering = 0;
+};
+
+///Generates random chart using counter based random streams
+/**
+ * Every random number is a function of the seed and its position in the chart, so chart is
+ * generated in chunks in parallel, and the result is same for any count of threads.
+ *
+ * @param cfg configuration
+ * @param prices pointer to buffer, which must have space for cfg.minutes items
+ * @param pool compute pool used to generate chunks in parallel (nullptr = generate in calling thread)
+ */
+void generate_random_chart(const RandomChartConfig &cfg, double *prices, ComputePool *pool = nullptr);
 
 
 #endif /* SRC_MAIN_RANDOM_CHART_H_ */
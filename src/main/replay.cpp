@@ -0,0 +1,161 @@
+/*
+ * replay.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "replay.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "papertrading.h"
+#include "perfstats.h"
+#include "stats2report.h"
+
+namespace {
+
+///Exchange which only publishes prices and initial balances. Trading is simulated by the paper trading
+class ReplayExchange: public IStockApi {
+public:
+	ReplayExchange(const IStockApi::MarketInfo &minfo, double asset, double currency)
+		:minfo(minfo),asset(asset),currency(currency) {}
+
+	void setPrice(double p, std::uint64_t tm) {
+		price = p;
+		time = tm;
+	}
+
+	virtual double getBalance(const std::string_view &symb, const std::string_view &) override {
+		if (symb == minfo.asset_symbol) return asset;
+		if (symb == minfo.currency_symbol) return currency;
+		return 0;
+	}
+	virtual TradesSync syncTrades(json::Value lastId, const std::string_view &) override {
+		return {{}, lastId.defined()?lastId:json::Value(0)};
+	}
+	virtual Orders getOpenOrders(const std::string_view &) override {
+		return {};
+	}
+	virtual Ticker getTicker(const std::string_view &) override {
+		return {price, price, price, time};
+	}
+	virtual json::Value placeOrder(const std::string_view &, double, double, json::Value, json::Value, double) override {
+		throw std::runtime_error("Replay exchange doesn't accept orders");
+	}
+	virtual void reset(const std::chrono::system_clock::time_point &) override {}
+	virtual MarketInfo getMarketInfo(const std::string_view &) override {
+		return minfo;
+	}
+
+protected:
+	IStockApi::MarketInfo minfo;
+	double asset;
+	double currency;
+	double price = 0;
+	std::uint64_t time = 0;
+};
+
+///Paper trading running on the virtual clock
+/**
+ * The broker is reset only by the replay (advance()), resets requested by the trader are ignored,
+ * because they use the real time
+ */
+class ReplayPaperTrading: public PaperTrading {
+public:
+	using PaperTrading::PaperTrading;
+
+	void advance(std::uint64_t tm) {
+		vtime = tm;
+		PaperTrading::reset(std::chrono::system_clock::time_point(std::chrono::milliseconds(tm)));
+	}
+	double getCurrency() const {
+		return currency;
+	}
+
+	virtual void reset(const std::chrono::system_clock::time_point &) override {}
+
+protected:
+	std::uint64_t vtime = 0;
+
+	virtual std::time_t now() const override {
+		return static_cast<std::time_t>(vtime/1000);
+	}
+};
+
+class ReplaySelector: public IStockSelector {
+public:
+	ReplaySelector(PStockApi stock):stock(std::move(stock)) {}
+	virtual PStockApi getStock(const std::string_view &) const override {
+		return stock;
+	}
+	virtual void forEachStock(EnumFn fn) const override {
+		fn("replay", stock);
+	}
+protected:
+	PStockApi stock;
+};
+
+}
+
+std::optional<ReplayResult> run_replay(const ReplayConfig &cfg, const double *prices, std::size_t count, const ReplayProgress &progress) {
+	using Clock = std::chrono::steady_clock;
+	auto start = Clock::now();
+	Clock::duration perform_time(0);
+	//the simulated trader must not appear in the statistics of the live traders
+	PerfProbe::Suppress suppress_probes;
+
+	ReplayResult res;
+	if (count == 0) return res;
+
+	auto exchange = std::make_shared<ReplayExchange>(cfg.minfo, cfg.asset, cfg.currency);
+	auto paper = std::make_shared<ReplayPaperTrading>(exchange);
+	ReplaySelector selector(paper);
+
+	MTrader_Config mcfg = cfg.config;
+	mcfg.broker = "replay";
+	//simulation is already provided by the selected broker
+	mcfg.paper_trading = false;
+
+	PReport rpt = PReport::make(std::make_unique<MemStorage>(), ReportConfig{count*60000});
+	WalletCfg wcfg;
+	wcfg.walletDB = wcfg.walletDB.make();
+	wcfg.accumDB = wcfg.accumDB.make();
+	wcfg.balanceCache = wcfg.balanceCache.make();
+	wcfg.externalBalance = wcfg.externalBalance.make();
+	wcfg.conflicts = wcfg.conflicts.make();
+
+	MTrader trader(selector,
+			cfg.persist_state?std::make_unique<MemStorage>():PStorage(),
+			std::make_unique<Stats2Report>("replay", rpt, PPerfModule()),
+			wcfg, mcfg);
+
+	std::uint64_t tm = cfg.start_time;
+	exchange->setPrice(prices[0], tm);
+	//initializes the trader, which also binds the pair of the paper trading
+	trader.init();
+	paper->advance(tm);
+	trader.reset(MTrader::ResetOptions{1.0, 0, false});
+
+	for (std::size_t i = 0; i < count; i++) {
+		if (progress && (i & 0xFFF) == 0 && !progress(i*100.0/count)) {
+			return std::optional<ReplayResult>();
+		}
+		exchange->setPrice(prices[i], tm);
+		paper->advance(tm);
+		auto pstart = Clock::now();
+		trader.perform(false);
+		perform_time += Clock::now() - pstart;
+		tm += 60000;
+	}
+
+	res.cycles = count;
+	res.trades = trader.getTrades();
+	res.position = trader.getPosition().value_or(0);
+	res.currency = paper->getCurrency();
+	res.report = rpt.lock()->genReport_noStore();
+	res.perform_ms = std::chrono::duration<double, std::milli>(perform_time).count();
+	res.elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return res;
+}
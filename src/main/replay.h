@@ -0,0 +1,68 @@
+/*
+ * replay.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_REPLAY_H_
+#define SRC_MAIN_REPLAY_H_
+#include <functional>
+#include <optional>
+
+#include <imtjson/value.h>
+
+#include "mtrader.h"
+
+///Configuration of the replay
+struct ReplayConfig {
+	///Configuration of the trader (broker and paper trading settings are ignored)
+	MTrader_Config config;
+	///Market informations
+	IStockApi::MarketInfo minfo;
+	///Initial balance of the asset (position on leveraged market)
+	double asset = 0;
+	///Initial balance of the currency
+	double currency = 0;
+	///Time of the first price (unix time in milliseconds)
+	std::uint64_t start_time = 0;
+	///Store state of the trader after every cycle (as in production)
+	bool persist_state = true;
+};
+
+struct ReplayResult {
+	///Count of executed cycles
+	std::size_t cycles = 0;
+	///Total time spent in the replay (milliseconds)
+	double elapsed_ms = 0;
+	///Time spent in MTrader::perform (milliseconds)
+	double perform_ms = 0;
+	///Trades of the trader
+	MTrader::TradeHistory trades;
+	///Final position
+	double position = 0;
+	///Final currency balance of the simulated exchange (without unrealized profit on leveraged market)
+	double currency = 0;
+	///Report as it is generated for the web interface
+	json::Value report;
+};
+
+///Reports progress in percent, return false to cancel the replay
+using ReplayProgress = std::function<bool(double)>;
+
+///Runs the real MTrader against simulated exchange driven by a virtual clock
+/**
+ * Every price is one cycle (one minute of the virtual time). Before the cycle, the exchange
+ * is reset, which executes the orders crossed by the price, then MTrader::perform is called,
+ * exactly as the scheduler does it in production. Trades are simulated by the paper trading.
+ *
+ * @param cfg configuration
+ * @param prices minute prices
+ * @param count count of prices
+ * @param progress progress callback
+ * @return result, or no value when canceled
+ */
+std::optional<ReplayResult> run_replay(const ReplayConfig &cfg, const double *prices, std::size_t count, const ReplayProgress &progress);
+
+
+#endif /* SRC_MAIN_REPLAY_H_ */
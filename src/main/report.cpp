@@ -10,6 +10,7 @@
 #include <imtjson/value.h>
 #include <imtjson/object.h>
 #include <imtjson/array.h>
+#include <imtjson/arena.h>
 #include <chrono>
 #include <numeric>
 
@@ -24,6 +25,7 @@
 #include "alert.h"
 
 #include "acb.h"
+#include "perfstats.h"
 
 using ondra_shared::logError;
 using namespace std::chrono;
@@ -52,9 +54,15 @@ json::Value Report::genReport_noStore() {
 }
 
 void Report::genReport() {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.gen_report");
+	PerfProbe probe(probe_hist);
 	while (logLines.size()>30) logLines.erase(logLines.begin());
 	counter++;
-	report->store(genReport_noStore());
+	{
+		//temporary values are allocated in the arena, the storage promotes the stored report
+		json::ArenaScope arena;
+		report->store(genReport_noStore());
+	}
 
 	if (refresh_after_clear) {
 		refresh_after_clear = false;
@@ -92,6 +100,8 @@ void Report::sendStreamOrder(ME &me, const OKey &key, const OValue &data) {
 
 void Report::setOrders(std::size_t rev, StrViewA symb, int n, const std::optional<IStockApi::Order> &buy,
 	  	  	  	  	  	  	  	     const std::optional<IStockApi::Order> &sell) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.set_orders");
+	PerfProbe probe(probe_hist);
 	if (rev != revize) return;
 	const json::Value &info = infoMap[symb];
 	bool inverted = info["inverted"].getBool();
@@ -130,7 +140,22 @@ static double wavg(double a, double wa, double b, double wb) {
 	return (a * wa + b * wb)/s;
 }
 
-static IStatSvc::TradeRecord sumTrades(const IStatSvc::TradeRecord &a, const IStatSvc::TradeRecord &b) {
+IStatSvc::TradesAggregate IStatSvc::TradesAggregate::start(double price, double pos) {
+	TradesAggregate r;
+	r.prev_price = price;
+	r.pos = pos;
+	r.acb = ACB(price, pos);
+	return r;
+}
+
+bool IStatSvc::TradesAggregate::canMerge(const TradeRecord &prev, const TradeRecord &t) {
+	return std::abs(prev.price - t.price) <= std::abs(t.price*1e-8)
+			&& prev.size * t.size > 0
+			&& !prev.manual_trade
+			&& !t.manual_trade;
+}
+
+IStatSvc::TradeRecord IStatSvc::TradesAggregate::merge(const TradeRecord &a, const TradeRecord &b) {
 	return IStatSvc::TradeRecord(
 			IStockApi::Trade {
 				b.id,b.time,
@@ -145,9 +170,70 @@ static IStatSvc::TradeRecord sumTrades(const IStatSvc::TradeRecord &a, const ISt
 	);
 }
 
-template<typename ME>
-void Report::sendStreamTrades(ME &me, const std::string_view &symb, const json::Value &records) {
-	for (Value rw : records) {
+IStatSvc::TradesAggregate::Change IStatSvc::TradesAggregate::add(const TradeRecord &t) {
+	double gain = (t.eff_price - prev_price)*pos ;
+	prev_price = t.eff_price;
+	acb = acb(t.eff_price, t.eff_size);
+	pl += gain;
+	pos += t.eff_size;
+	double normch = (t.norm_accum - pap) * t.eff_price + (t.norm_profit - pnp);
+	pap = t.norm_accum;
+	pnp = t.norm_profit;
+	normaccum = normaccum || t.norm_accum != 0;
+	return {gain, normch};
+}
+
+void IStatSvc::TradesAggregate::addAll(ondra_shared::StringView<TradeRecord> trades) {
+	std::optional<TradeRecord> tmpTrade;
+	const TradeRecord *prevTrade = nullptr;
+	for (const auto &t: trades) {
+		if (prevTrade && canMerge(*prevTrade, t)) {
+			tmpTrade = merge(*prevTrade, t);
+			prevTrade = &(*tmpTrade);
+		} else {
+			if (prevTrade) add(*prevTrade);
+			prevTrade = &t;
+			iid++;
+		}
+	}
+	if (prevTrade) add(*prevTrade);
+	count += trades.length;
+}
+
+json::Value IStatSvc::TradesAggregate::toJSON() const {
+	return json::Object({
+		{"count", count},
+		{"price", prev_price},
+		{"pl", pl},
+		{"pos", pos},
+		{"pnp", pnp},
+		{"pap", pap},
+		{"acb_open", acb.getOpen()},
+		{"acb_pos", acb.getPos()},
+		{"acb_rpnl", acb.getRPnL()},
+		{"normaccum", normaccum},
+		{"iid", iid}
+	});
+}
+
+IStatSvc::TradesAggregate IStatSvc::TradesAggregate::fromJSON(json::Value v) {
+	TradesAggregate r;
+	r.count = v["count"].getUInt();
+	r.prev_price = v["price"].getNumber();
+	r.pl = v["pl"].getNumber();
+	r.pos = v["pos"].getNumber();
+	r.pnp = v["pnp"].getNumber();
+	r.pap = v["pap"].getNumber();
+	r.acb = ACB(v["acb_open"].getNumber(), v["acb_pos"].getNumber(), v["acb_rpnl"].getNumber());
+	r.normaccum = v["normaccum"].getBool();
+	r.iid = v["iid"].getInt();
+	return r;
+}
+
+template<typename ME, typename Iter>
+void Report::sendStreamTrades(ME &me, const std::string_view &symb, Iter beg, Iter end) {
+	for (Iter iter = beg; iter != end; ++iter) {
+		const Value &rw = *iter;
 		me.sendStream(
 			json::Object{
 			{ "type", "trade" },
@@ -172,90 +258,91 @@ static json::NamedEnum<AlertReason> strAlertReason({
 	{AlertReason::initial_reset, "initial_reset"}
 });
 
-void Report::setTrades(std::size_t rev, StrViewA symb, double finalPos, StringView<IStatSvc::TradeRecord> trades) {
+void Report::setTrades(std::size_t rev, StrViewA symb, double finalPos, StringView<IStatSvc::TradeRecord> trades, const IStatSvc::TradesAggregate &archived) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.set_trades");
+	PerfProbe probe(probe_hist);
 
 	if (rev != revize) return;
 
-	using ondra_shared::range;
-
-	json::Array records;
-
 	const json::Value &info = infoMap[symb];
 	bool inverted = info["inverted"].getBool();
-	double chng = std::accumulate(trades.begin(), trades.end(), 0.0, [](double x, const IStatSvc::TradeRecord &b){
-		return x+b.eff_size;
-	});
-	double pos = finalPos-chng;
+	//archived trades precede the trades, indexes in the state count them
+	std::size_t offset = archived.count;
+	std::size_t total = offset + trades.length;
+	//position before the trade at given index
+	auto posBefore = [&](std::size_t idx) {
+		return finalPos - std::accumulate(trades.begin()+(idx-offset), trades.end(), 0.0, [](double x, const IStatSvc::TradeRecord &b){
+			return x+b.eff_size;
+		});
+	};
 
-	if (!trades.empty()) {
+	TradeState &st = tradeMap[symb];
+	//continue from the last group, if the already processed trades were not changed
+	bool cont = st.count > 0
+			&& total >= st.count
+			&& st.groupStart >= offset
+			&& st.inverted == inverted
+			&& trades[st.count-1-offset].id == st.lastId
+			&& trades[st.groupStart-offset].id == st.groupId
+			&& std::abs(st.agg.pos - posBefore(st.groupStart)) <= (std::abs(st.agg.pos)+std::abs(finalPos)) * 1e-10;
+
+	if (trades.empty()) {
+		st = TradeState();
+	} else if (!cont || total > st.count) {
+
+		std::size_t prevRecords;
+		if (cont) {
+			//last group can be extended, so remove its record
+			if (st.groupEmitted) st.records.pop_back();
+		} else {
+			double pos = posBefore(offset);
+			st = TradeState();
+			st.inverted = inverted;
+			st.groupStart = offset;
+			if (offset) {
+				//continue from the checkpoint of the archived trades
+				st.agg = archived;
+				st.agg.pos = pos;
+			} else {
+				st.agg = IStatSvc::TradesAggregate::start(trades[0].eff_price, pos);
+			}
+		}
+		prevRecords = st.records.size();
 
 		const auto &last = trades[trades.length-1];
 		std::uint64_t last_time = last.time;
 		std::uint64_t first = last_time - interval_in_ms;
 
-
 		auto tend = trades.end();
-		auto iter = trades.begin();
-		auto &&t = *iter;
-
-
-		double init_price = t.eff_price;
+		auto iter = trades.begin()+(st.groupStart-offset);
 
-
-		double prev_price = init_price;
-		double cur_fromPos = 0;
-		double pnp = 0;
-		double pap = 0;
-
-		ACB acb(init_price, pos);
-		bool normaccum = false;
+		IStatSvc::TradesAggregate agg = st.agg;
 
 		std::optional<IStatSvc::TradeRecord> tmpTrade;
 		const IStatSvc::TradeRecord *prevTrade = nullptr;
 
-
-		int iid = 0;
 		do {
-			if (iter == tend || (prevTrade && (std::abs(prevTrade->price - iter->price) > std::abs(iter->price*1e-8)
-												|| prevTrade->size * iter->size <= 0
-												|| prevTrade->manual_trade
-												|| iter->manual_trade)))
+			if (iter == tend || (prevTrade && !IStatSvc::TradesAggregate::canMerge(*prevTrade, *iter)))
 				{
 
 				auto &&t = *prevTrade;
+				auto chg = agg.add(t);
 
-				double gain = (t.eff_price - prev_price)*pos ;
-
-				prev_price = t.eff_price;
-
-				acb = acb(t.eff_price, t.eff_size);
-
-				cur_fromPos += gain;
-				pos += t.eff_size;
-
-
-
-				double normch = (t.norm_accum - pap) * t.eff_price + (t.norm_profit - pnp);
-				pap = t.norm_accum;
-				pnp = t.norm_profit;
-				normaccum = normaccum || t.norm_accum != 0;
-
-
-
-				if (t.time >= first) {
-					records.push_back(Object({
+				st.groupEmitted = t.time >= first;
+				if (st.groupEmitted) {
+					st.records.push_back(Object({
 						{"id", t.id},
 						{"time", t.time},
 						{"achg", (inverted?-1:1)*t.size},
-						{"gain", gain},
+						{"gain", chg.gain},
 						{"norm", t.norm_profit},
-						{"normch", normch},
-						{"nacum", normaccum?Value((inverted?-1:1)*t.norm_accum):Value()},
-						{"pos", (inverted?-1:1)*pos},
-						{"pl", cur_fromPos},
-						{"rpl", acb.getRPnL()},
-						{"open", acb.getOpen()},
-						{"iid", std::to_string(iid)},
+						{"normch", chg.normch},
+						{"nacum", agg.normaccum?Value((inverted?-1:1)*t.norm_accum):Value()},
+						{"pos", (inverted?-1:1)*agg.pos},
+						{"pl", agg.pl},
+						{"rpl", agg.acb.getRPnL()},
+						{"open", agg.acb.getOpen()},
+						{"iid", std::to_string(agg.iid)},
 						{"price", (inverted?1.0/t.price:t.price)},
 						{"p0",t.neutral_price?Value(inverted?1.0/t.neutral_price:t.neutral_price):Value()},
 						{"volume", fabs(t.eff_price*t.eff_size)},
@@ -271,27 +358,43 @@ void Report::setTrades(std::size_t rev, StrViewA symb, double finalPos, StringVi
 					break;
 			}
 			if (prevTrade == nullptr) {
+				//new group starts here, remember state to continue next time
+				st.groupStart = (iter - trades.begin()) + offset;
+				st.agg = agg;
 				prevTrade = &(*iter);
 			} else {
-				tmpTrade = sumTrades(*prevTrade, *iter);
+				tmpTrade = IStatSvc::TradesAggregate::merge(*prevTrade, *iter);
 				prevTrade = &(*tmpTrade);
-				--iid;
+				--agg.iid;
 			}
 
 			++iter;
-			iid++;
+			agg.iid++;
 		} while (true);
 
+		st.count = total;
+		st.lastId = last.id;
+		st.groupId = trades[st.groupStart-offset].id;
+
+		//remove records which are out of the interval
+		std::size_t trimmed = 0;
+		while (!st.records.empty() && st.records.front()["time"].getUIntLong() < first) {
+			st.records.pop_front();
+			++trimmed;
+		}
+		//send only new records (the record of extended group is sent again)
+		if (!cont) prevRecords = 0;
+		else prevRecords = prevRecords > trimmed?prevRecords-trimmed:0;
+		sendStreamTrades(*this,symb, st.records.begin()+prevRecords, st.records.end());
 	}
-	tradeMap[symb] = records;
-	sendStreamTrades(*this,symb, records);
 }
 
 
 void Report::exportCharts(json::Object&& out) {
 
 	for (auto &&rec: tradeMap) {
-		out.set(rec.first, rec.second);
+		const auto &r = rec.second.records;
+		out.set(rec.first, Value(json::array, r.begin(), r.end(), [](const Value &v){return v;}));
 	}
 }
 
@@ -314,6 +417,8 @@ void Report::sendStreamInfo(ME &me, const std::string_view &symb, const json::Va
 }
 
 void Report::setInfo(std::size_t rev, StrViewA symb, const InfoObj &infoObj) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.set_info");
+	PerfProbe probe(probe_hist);
 
 	if (rev != revize) return;
 
@@ -343,6 +448,8 @@ void Report::sendStreamPrice(ME &me, const std::string_view &symb, double data)
 }
 
 void Report::setPrice(std::size_t rev, StrViewA symb, double price) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.set_price");
+	PerfProbe probe(probe_hist);
 
 	if (rev != revize) return;
 
@@ -457,6 +564,8 @@ void Report::sendStreamMisc(ME &me, const std::string_view &symb, const json::Va
 }
 
 void Report::setMisc(std::size_t rev, StrViewA symb, const MiscData &miscData, bool initial) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("report.set_misc");
+	PerfProbe probe(probe_hist);
 
 	if (rev != revize) return;
 
@@ -637,7 +746,7 @@ bool Report::stream_refresh(Stream &stream) const  {
 		sendStreamInfo(hlp,item.first, item.second);
 	}
 	for (const auto &item: tradeMap) {
-		sendStreamTrades(hlp,item.first, item.second);
+		sendStreamTrades(hlp,item.first, item.second.records.begin(), item.second.records.end());
 	}
 	for (const auto &item: miscMap) {
 		sendStreamMisc(hlp,item.first, item.second);
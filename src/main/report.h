@@ -9,8 +9,10 @@
 #define SRC_MAIN_REPORT_H_
 
 #include <imtjson/array.h>
+#include <deque>
 #include <string_view>
 #include <optional>
+#include "acb.h"
 #include "istockapi.h"
 #include "storage.h"
 #include "../shared/linear_map.h"
@@ -63,7 +65,7 @@ public:
 	template<typename T> using StringView = ondra_shared::StringView<T>;
 	void setOrders(std::size_t rev, StrViewA symb, int n, const std::optional<IStockApi::Order> &buy,
 			  	  	  	  	  	  const std::optional<IStockApi::Order> &sell);
-	void setTrades(std::size_t rev, StrViewA symb, double finalPos,  StringView<IStatSvc::TradeRecord> trades);
+	void setTrades(std::size_t rev, StrViewA symb, double finalPos,  StringView<IStatSvc::TradeRecord> trades, const IStatSvc::TradesAggregate &archived);
 	void setInfo(std::size_t rev, StrViewA symb, const InfoObj &info);
 	void setMisc(std::size_t rev, StrViewA symb, const MiscData &miscData, bool initial);
 
@@ -102,7 +104,25 @@ protected:
 	};
 
 	using OrderMap = ondra_shared::linear_map<OKey,OValue, OKeyCmp>;
-	using TradeMap = ondra_shared::linear_map<std::string, json::Value>;
+	///Rendered trade history of a symbol
+	/** It also keeps state of the calculation, so only new trades are processed next time */
+	struct TradeState {
+		std::deque<json::Value> records;
+		///count of processed trades, including archived trades
+		std::size_t count = 0;
+		///index of the first trade of the last group - this group can be extended by next trades.
+		///Indexes include archived trades
+		std::size_t groupStart = 0;
+		///id of the last processed trade, and id of the first trade of the last group
+		json::Value lastId, groupId;
+		bool inverted = false;
+		///true if the last group generated a record
+		bool groupEmitted = false;
+		///state of calculation before the last group
+		IStatSvc::TradesAggregate agg;
+	};
+
+	using TradeMap = ondra_shared::linear_map<std::string, TradeState>;
 	using InfoMap = ondra_shared::linear_map<std::string, json::Value>;
 	using MiscMap = ondra_shared::linear_map<std::string, json::Value>;
 	using PriceMap = ondra_shared::linear_map<std::string, double>;
@@ -141,7 +161,7 @@ protected:
 
 
 	template<typename ME> static void sendStreamOrder(ME &me, const OKey &key, const OValue &data);
-	template<typename ME> static void sendStreamTrades(ME &me, const std::string_view &symb, const json::Value &records);
+	template<typename ME, typename Iter> static void sendStreamTrades(ME &me, const std::string_view &symb, Iter beg, Iter end);
 	template<typename ME> static void sendStreamInfo(ME &me, const std::string_view &symb, const json::Value &object);
 	template<typename ME> static void sendStreamMisc(ME &me, const std::string_view &symb, const json::Value &object);
 	template<typename ME> static void sendStreamPrice(ME &me, const std::string_view &symb, double data);
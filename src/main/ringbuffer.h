@@ -0,0 +1,233 @@
+/*
+ * ringbuffer.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef SRC_MAIN_RINGBUFFER_H_
+#define SRC_MAIN_RINGBUFFER_H_
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "../shared/stringview.h"
+
+///Ring buffer with fixed capacity
+/**
+ * When buffer is full, adding a new item removes the oldest one. Items are stored in chunks
+ * of fixed size. Items are never modified once written, the chunks are only appended, and the
+ * chunk is released when all of its items are removed.
+ *
+ * Copying of the buffer is cheap, only the list of chunks is copied, the items are shared. The
+ * buffer (the owner) continues to append to its last chunk, the copy sees only the items
+ * which existed at the time of the copy. So a copy can be used as immutable snapshot, which can
+ * be read by other threads. When a copy is modified, it copies its last chunk only.
+ *
+ * @tparam T type of item. It must be copyable
+ */
+template<typename T>
+class RingBuffer {
+public:
+
+	using value_type = T;
+	using Segment = ondra_shared::StringView<T>;
+
+	///Count of items in one chunk
+	static constexpr std::size_t chunkSize = 256;
+
+	class const_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T *;
+		using reference = const T &;
+
+		const_iterator():owner(nullptr),pos(0) {}
+		const_iterator(const RingBuffer *owner, std::size_t pos):owner(owner),pos(pos) {}
+
+		reference operator*() const {return (*owner)[pos];}
+		pointer operator->() const {return &(*owner)[pos];}
+		reference operator[](difference_type n) const {return (*owner)[pos+n];}
+		const_iterator &operator++() {++pos; return *this;}
+		const_iterator &operator--() {--pos; return *this;}
+		const_iterator operator++(int) {auto x = *this; ++pos; return x;}
+		const_iterator operator--(int) {auto x = *this; --pos; return x;}
+		const_iterator &operator+=(difference_type n) {pos+=n; return *this;}
+		const_iterator &operator-=(difference_type n) {pos-=n; return *this;}
+		const_iterator operator+(difference_type n) const {return const_iterator(owner, pos+n);}
+		const_iterator operator-(difference_type n) const {return const_iterator(owner, pos-n);}
+		difference_type operator-(const const_iterator &other) const {return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);}
+		bool operator==(const const_iterator &other) const {return pos == other.pos;}
+		bool operator!=(const const_iterator &other) const {return pos != other.pos;}
+		bool operator<(const const_iterator &other) const {return pos < other.pos;}
+		bool operator>(const const_iterator &other) const {return pos > other.pos;}
+		bool operator<=(const const_iterator &other) const {return pos <= other.pos;}
+		bool operator>=(const const_iterator &other) const {return pos >= other.pos;}
+
+	protected:
+		const RingBuffer *owner;
+		std::size_t pos;
+	};
+
+	using iterator = const_iterator;
+
+	RingBuffer(std::size_t capacity = 0):cap(capacity) {}
+	///Copy shares the items, but it doesn't own the last chunk
+	RingBuffer(const RingBuffer &other)
+		:chunks(other.chunks),cap(other.cap),head(other.head),count(other.count),owner(false) {}
+	RingBuffer(RingBuffer &&other)
+		:chunks(std::move(other.chunks)),cap(other.cap),head(other.head),count(other.count),owner(other.owner) {
+		other.head = other.count = 0;
+	}
+	RingBuffer &operator=(const RingBuffer &other) {
+		if (this != &other) {
+			chunks = other.chunks;
+			cap = other.cap;
+			head = other.head;
+			count = other.count;
+			owner = false;
+		}
+		return *this;
+	}
+	RingBuffer &operator=(RingBuffer &&other) {
+		if (this != &other) {
+			chunks = std::move(other.chunks);
+			cap = other.cap;
+			head = other.head;
+			count = other.count;
+			owner = other.owner;
+			other.head = other.count = 0;
+		}
+		return *this;
+	}
+
+	std::size_t size() const {return count;}
+	bool empty() const {return count == 0;}
+	std::size_t capacity() const {return cap;}
+
+	///Changes capacity, when reduced, the oldest items are removed
+	void setCapacity(std::size_t capacity);
+
+	///Adds an item. If the buffer is full, the oldest item is removed
+	void push_back(const T &item);
+	///Removes all items
+	void clear();
+
+	const T &operator[](std::size_t idx) const {
+		std::size_t p = head + idx;
+		return chunks[p / chunkSize]->at(p % chunkSize);
+	}
+	const T &front() const {return (*this)[0];}
+	const T &back() const {return (*this)[count-1];}
+
+	const_iterator begin() const {return const_iterator(this, 0);}
+	const_iterator end() const {return const_iterator(this, count);}
+
+	///Calls the function for each contiguous segment of items, from the oldest to the newest
+	template<typename Fn>
+	void forEachSegment(Fn &&fn) const;
+
+protected:
+
+	class Chunk {
+	public:
+		Chunk() {}
+		Chunk(const Chunk &) = delete;
+		Chunk &operator=(const Chunk &) = delete;
+		~Chunk() {
+			for (std::size_t i = 0; i < filled; i++) data()[i].~T();
+		}
+		const T &at(std::size_t idx) const {return data()[idx];}
+		const T *data() const {return std::launder(reinterpret_cast<const T *>(buffer));}
+		T *data() {return std::launder(reinterpret_cast<T *>(buffer));}
+		///Appends item. Called only by the owner, readers never access unfilled items
+		void append(const T &item) {
+			new(buffer+filled*sizeof(T)) T(item);
+			++filled;
+		}
+		std::size_t size() const {return filled;}
+	protected:
+		alignas(T) unsigned char buffer[sizeof(T)*chunkSize];
+		std::size_t filled = 0;
+	};
+
+	using PChunk = std::shared_ptr<Chunk>;
+
+	std::vector<PChunk> chunks;
+	std::size_t cap;
+	///index of the oldest item in the first chunk
+	std::size_t head = 0;
+	std::size_t count = 0;
+	///true if the buffer can append to its last chunk
+	bool owner = true;
+
+	///Removes oldest items to fit into the capacity
+	void trim(std::size_t limit);
+};
+
+template<typename T>
+inline void RingBuffer<T>::setCapacity(std::size_t capacity) {
+	cap = capacity;
+	trim(cap);
+}
+
+template<typename T>
+inline void RingBuffer<T>::push_back(const T &item) {
+	if (cap == 0) return;
+	std::size_t pos = head + count;
+	if (pos % chunkSize == 0) {
+		chunks.push_back(std::make_shared<Chunk>());
+		owner = true;
+	} else if (!owner) {
+		//last chunk is shared, copy its items to own chunk
+		const Chunk &src = *chunks.back();
+		auto nc = std::make_shared<Chunk>();
+		for (std::size_t i = 0, cnt = pos % chunkSize; i < cnt; i++) nc->append(src.at(i));
+		chunks.back() = std::move(nc);
+		owner = true;
+	}
+	chunks.back()->append(item);
+	++count;
+	trim(cap);
+}
+
+template<typename T>
+inline void RingBuffer<T>::clear() {
+	chunks.clear();
+	head = 0;
+	count = 0;
+	owner = true;
+}
+
+template<typename T>
+inline void RingBuffer<T>::trim(std::size_t limit) {
+	if (count <= limit) return;
+	head += count - limit;
+	count = limit;
+	std::size_t drop = head / chunkSize;
+	if (drop) {
+		chunks.erase(chunks.begin(), chunks.begin()+drop);
+		head -= drop * chunkSize;
+	}
+	if (count == 0) clear();
+}
+
+template<typename T>
+template<typename Fn>
+inline void RingBuffer<T>::forEachSegment(Fn &&fn) const {
+	std::size_t pos = head;
+	std::size_t remain = count;
+	for (const auto &c: chunks) {
+		if (remain == 0) break;
+		std::size_t cnt = std::min(remain, chunkSize - pos);
+		fn(Segment(c->data()+pos, cnt));
+		remain -= cnt;
+		pos = 0;
+	}
+}
+
+#endif /* SRC_MAIN_RINGBUFFER_H_ */
@@ -39,8 +39,8 @@ public:
 							  const std::optional<IStockApi::Order> &sell) override {
 		rpt.lock()->setOrders(rev, name, n, buy, sell);
 	}
-	virtual void reportTrades(double finalPos, ondra_shared::StringView<IStatSvc::TradeRecord> trades) override {
-		rpt.lock()->setTrades(rev, name,finalPos, trades);
+	virtual void reportTrades(double finalPos, ondra_shared::StringView<IStatSvc::TradeRecord> trades, const TradesAggregate &archived) override {
+		rpt.lock()->setTrades(rev, name,finalPos, trades, archived);
 	}
 	virtual void reportMisc(const MiscData &miscData,bool initial) override{
 		rpt.lock()->setMisc(rev, name, miscData, initial);
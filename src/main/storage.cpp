@@ -12,10 +12,12 @@
 #include <shared/filesystem.h>
 #include <stack>
 
+#include <imtjson/arena.h>
 #include <imtjson/binjson.tcc>
 #include <unistd.h>
 
 #include "../shared/logOutput.h"
+#include "perfstats.h"
 
 using namespace std::filesystem;
 
@@ -34,6 +36,8 @@ std::stack<std::string> Storage::generateNames() {
 }
 
 void Storage::store(json::Value data) {
+	static PerfHistogram &probe_hist = PerfStats::global().get("storage.store");
+	PerfProbe probe(probe_hist);
 	std::string tmpname = file+".tmp";
 	std::ofstream f(tmpname, std::ios::out|std::ios::trunc);
 	if (!f) {
@@ -41,7 +45,7 @@ void Storage::store(json::Value data) {
 	}
 	switch(format) {
 	case binjson:
-		data.serializeBinary([&](char c) {f.put(c);},json::compressKeys);
+		data.serializeBinary(json::toStream(f),json::compressKeys);
 		break;
 	case jsonp:
 		f << "fetch_callback(\"" << path(file).filename().string() << "\"," << std::endl;
@@ -122,6 +126,8 @@ json::Value MemStorage::load() {
 }
 
 void MemStorage::store(json::Value data) {
+	//data are kept, so they must not hold an arena of the caller
+	data = json::ArenaScope::promote(data);
 	std::lock_guard _(lock);
 	this->data=data;
 }
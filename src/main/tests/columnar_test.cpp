@@ -0,0 +1,281 @@
+/*
+ * columnar_test.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <imtjson/array.h>
+#include <imtjson/binjson.tcc>
+#include <imtjson/object.h>
+#include <imtjson/string.h>
+#include <imtjson/value.h>
+#include <tests/testClass.h>
+
+#include "../columnar.h"
+
+using namespace json;
+
+static const double qnan = std::numeric_limits<double>::quiet_NaN();
+static const double infinity = std::numeric_limits<double>::infinity();
+
+///Numbers of all kinds - decimal, special and numbers which are not decimal
+static const std::vector<double> numbers = {
+	0.0, -0.0, 1.25, 1.25, 1.5, qnan, infinity, -infinity, 1.0/3.0, 2.0/3.0, 0.1, 12345.678,
+	-1e-300, 5e-324, 1e300, 100, 100, -0.0, qnan, 0.0
+};
+
+static bool same(double a, double b) {
+	return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+///Passes the value through binary json
+static Value viaBinjson(Value v) {
+	std::string buff;
+	v.serializeBinary([&](char c){buff.push_back(c);});
+	std::size_t pos = 0;
+	return Value::parseBinary([&]{return static_cast<unsigned char>(buff[pos++]);}, base64);
+}
+
+///Passes the value through text json, binary value becomes base64 string
+static Value viaText(Value v) {
+	return Value::fromString(v.stringify().str());
+}
+
+static std::vector<IStatSvc::ChartItem> chart() {
+	std::vector<IStatSvc::ChartItem> out;
+	std::uint64_t tm = 1600000000000;
+	for (std::size_t i = 0; i < numbers.size(); i++) {
+		//regular interval with some irregularities
+		tm += i % 7 == 3?61234:60000;
+		out.push_back({tm, numbers[i], numbers[(i+3)%numbers.size()], numbers[(i+7)%numbers.size()]});
+	}
+	return out;
+}
+
+static std::vector<IStatSvc::TradeRecord> trades() {
+	std::vector<Value> ids = {
+		Value(), Value(nullptr), Value(-5), Value(-3), Value(static_cast<ULongInt>(18446744073709551615ULL)),
+		Value(12), Value("abc123"), Value("abc124"), Value("x"), Value(""), Value(1.5),
+		Value(json::array,{1,"a"}), Object{{"id",1}}, Value(true), Value(static_cast<LongInt>(-9223372036854775807LL-1)),
+		Value(json::BinaryView(reinterpret_cast<const unsigned char *>("\x01\x02"), 2), base64)
+	};
+	std::vector<IStatSvc::TradeRecord> out;
+	std::uint64_t tm = 1600000000000;
+	for (std::size_t i = 0; i < ids.size(); i++) {
+		tm += i * 1000;
+		auto n = [&](std::size_t k) {return numbers[(i+k)%numbers.size()];};
+		out.emplace_back(IStockApi::Trade{ids[i], tm, n(0), n(1), n(2), n(3)}, n(4), n(5), n(6),
+				i % 3 == 0, static_cast<char>(i % 3) - 1, static_cast<char>(i % 5));
+	}
+	return out;
+}
+
+static Value encodeChart() {
+	columnar::ChartWriter wr;
+	for (const auto &x: chart()) wr.push(x);
+	return wr.finish();
+}
+
+static Value encodeTrades() {
+	columnar::TradesWriter wr;
+	for (const auto &x: trades()) wr.push(x);
+	return wr.finish();
+}
+
+///Decodes the chart and compares it with the source, prints count of rows and count of differences
+static void checkChart(std::ostream &out, Value data) {
+	auto src = chart();
+	columnar::ChartReader rd(data);
+	std::size_t cnt = 0, diff = 0;
+	while (auto itm = rd.next()) {
+		if (cnt >= src.size()) {diff++; break;}
+		const auto &s = src[cnt];
+		if (itm->time != s.time || !same(itm->ask, s.ask) || !same(itm->bid, s.bid) || !same(itm->last, s.last)) diff++;
+		cnt++;
+	}
+	out << rd.size() << " " << cnt << " " << diff;
+}
+
+///Decodes the trades and compares them with the source, prints count of rows and count of differences
+static void checkTrades(std::ostream &out, Value data) {
+	auto src = trades();
+	columnar::TradesReader rd(data);
+	std::size_t cnt = 0, diff = 0;
+	while (auto itm = rd.next()) {
+		if (cnt >= src.size()) {diff++; break;}
+		const auto &s = src[cnt];
+		//ids are compared as json, binary id is restored as base64 string
+		bool eq = itm->id.type() == s.id.type() && itm->id.stringify() == s.id.stringify()
+				&& itm->time == s.time
+				&& same(itm->size, s.size) && same(itm->price, s.price)
+				&& same(itm->eff_size, s.eff_size) && same(itm->eff_price, s.eff_price)
+				&& same(itm->norm_profit, s.norm_profit) && same(itm->norm_accum, s.norm_accum)
+				&& same(itm->neutral_price, s.neutral_price) && itm->manual_trade == s.manual_trade
+				&& itm->alertSide == s.alertSide && itm->alertReason == s.alertReason;
+		if (!eq) diff++;
+		cnt++;
+	}
+	out << rd.size() << " " << cnt << " " << diff;
+}
+
+///Replaces the binary content of the columnar data
+static Value patch(Value data, const std::function<void(std::string &)> &fn) {
+	std::string s(map_bin2str(data.getBinary(base64)));
+	fn(s);
+	return Value(map_str2bin(s), base64);
+}
+
+///Header and columns of the columnar data
+struct Layout {
+	std::string header;
+	std::uint64_t count = 0;
+	std::vector<std::string> columns;
+};
+
+static std::uint64_t readVarUInt(const std::string &s, std::size_t &pos) {
+	std::uint64_t r = 0;
+	for (unsigned int shift = 0; ; shift += 7) {
+		unsigned char g = static_cast<unsigned char>(s.at(pos++));
+		r |= static_cast<std::uint64_t>(g & 0x7F) << shift;
+		if (!(g & 0x80)) return r;
+	}
+}
+
+static void writeVarUInt(std::string &s, std::uint64_t v) {
+	do {
+		unsigned char g = v & 0x7F;
+		v >>= 7;
+		s.push_back(static_cast<char>(v?(g | 0x80):g));
+	} while (v);
+}
+
+static Layout split(const std::string &s) {
+	Layout l;
+	l.header = s.substr(0,3);
+	std::size_t pos = 3;
+	l.count = readVarUInt(s, pos);
+	while (pos < s.size()) {
+		std::size_t len = readVarUInt(s, pos);
+		l.columns.push_back(s.substr(pos, len));
+		pos += len;
+	}
+	return l;
+}
+
+static std::string join(const Layout &l) {
+	std::string s = l.header;
+	writeVarUInt(s, l.count);
+	for (const auto &c: l.columns) {
+		writeVarUInt(s, c.size());
+		s.append(c);
+	}
+	return s;
+}
+
+template<typename Fn>
+static void expectError(std::ostream &out, Fn &&fn) {
+	try {
+		fn();
+		out << "no error";
+	} catch (const std::runtime_error &e) {
+		out << e.what();
+	}
+}
+
+int main(int, char **) {
+
+	TestSimple tst;
+
+	tst.test("columnar.chart", "20 20 0") >> [&](std::ostream &out) {
+		checkChart(out, encodeChart());
+	};
+
+	tst.test("columnar.chart_binjson", "20 20 0") >> [&](std::ostream &out) {
+		checkChart(out, viaBinjson(encodeChart()));
+	};
+
+	tst.test("columnar.chart_text", "20 20 0") >> [&](std::ostream &out) {
+		checkChart(out, viaText(encodeChart()));
+	};
+
+	tst.test("columnar.trades", "16 16 0") >> [&](std::ostream &out) {
+		checkTrades(out, encodeTrades());
+	};
+
+	tst.test("columnar.trades_binjson", "16 16 0") >> [&](std::ostream &out) {
+		checkTrades(out, viaBinjson(encodeTrades()));
+	};
+
+	tst.test("columnar.trades_text", "16 16 0") >> [&](std::ostream &out) {
+		checkTrades(out, viaText(encodeTrades()));
+	};
+
+	tst.test("columnar.empty", "0 0 0") >> [&](std::ostream &out) {
+		columnar::TradesWriter wr;
+		columnar::TradesReader rd(viaText(wr.finish()));
+		out << rd.size() << " " << (rd.next().has_value()?1:0) << " " << columnar::Reader::isColumnar(Value(json::array));
+	};
+
+	tst.test("columnar.version", "Unsupported version of columnar data") >> [&](std::ostream &out) {
+		Value data = patch(encodeChart(), [](std::string &s){s[1] = static_cast<char>(columnar::version+1);});
+		expectError(out, [&]{columnar::ChartReader rd(data);});
+	};
+
+	tst.test("columnar.kind", "Unexpected kind of columnar data") >> [&](std::ostream &out) {
+		expectError(out, [&]{columnar::TradesReader rd(encodeChart());});
+	};
+
+	tst.test("columnar.not_columnar", "Expected columnar data") >> [&](std::ostream &out) {
+		expectError(out, [&]{columnar::TradesReader rd(Value(json::array));});
+	};
+
+	tst.test("columnar.truncated", "0") >> [&](std::ostream &out) {
+		Value data = encodeTrades();
+		std::size_t len = map_bin2str(data.getBinary(base64)).size();
+		std::size_t undetected = 0;
+		for (std::size_t i = 0; i < len; i++) {
+			Value d = patch(data, [&](std::string &s){s.resize(i);});
+			try {
+				columnar::TradesReader rd(d);
+				while (rd.next()) {}
+				undetected++;
+			} catch (const std::runtime_error &e) {
+				if (std::string_view(e.what()) != "Columnar data are damaged") undetected++;
+			}
+		}
+		out << undetected;
+	};
+
+	tst.test("columnar.truncated_column", "Columnar data are damaged") >> [&](std::ostream &out) {
+		//the last column is cut, but the header stays consistent
+		Value data = patch(encodeTrades(), [](std::string &s){
+			Layout l = split(s);
+			l.columns.back().resize(l.columns.back().size()/2);
+			s = join(l);
+		});
+		expectError(out, [&]{
+			columnar::TradesReader rd(data);
+			while (rd.next()) {}
+		});
+	};
+
+	tst.test("columnar.huge_count", "Columnar data are damaged") >> [&](std::ostream &out) {
+		Value data = patch(encodeChart(), [](std::string &s){
+			Layout l = split(s);
+			l.count = std::uint64_t(1) << 60;
+			s = join(l);
+		});
+		expectError(out, [&]{columnar::ChartReader rd(data);});
+	};
+
+	return tst.didFail()?1:0;
+}
@@ -0,0 +1,84 @@
+/*
+ * datasetparser_test.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <imtjson/array.h>
+#include <imtjson/string.h>
+#include <imtjson/value.h>
+#include <tests/testClass.h>
+
+#include "../datasetparser.h"
+
+using namespace json;
+
+///Parses the data fed in chunks of given size, prints kind, skipped rows and the rows
+static void parse(std::ostream &out, std::string_view data, std::size_t chunk = 4096, std::size_t max_rows = 1000) {
+	DatasetParser parser(max_rows);
+	try {
+		while (!data.empty()) {
+			std::size_t sz = std::min(chunk, data.size());
+			parser.feed(data.substr(0, sz));
+			data = data.substr(sz);
+		}
+		parser.finish();
+	} catch (const std::runtime_error &e) {
+		out << e.what();
+		return;
+	}
+	Array rows;
+	for (std::size_t i = 0, cnt = parser.getRows(); i < cnt; i++) rows.push_back(parser.getRow(i));
+	out << (parser.getKind() == DatasetParser::Kind::trades?"trades ":"prices ")
+		<< parser.getSkipped() << " " << Value(rows).toString();
+}
+
+int main(int, char **) {
+
+	TestSimple tst;
+
+	tst.test("datasetparser.json_prices", "prices 0 [1.5,1.6,1.7]") >> [&](std::ostream &out) {
+		parse(out, "[1.5, \"1.6\", 1.7]");
+	};
+	tst.test("datasetparser.json_trades", "trades 0 [[1000,10.5],[2000,11]]") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10.5],\n [2000, \"11\"]]");
+	};
+	tst.test("datasetparser.json_trades_range", "trades 0 [[1000,10,[9,11]],[2000,12,[12,12.5]]]") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10,[9,11]],[2000,12,[12,12.5]]]");
+	};
+	tst.test("datasetparser.json_trades_range_later", "trades 0 [[1000,10,[10,10]],[2000,12,[11,13]],[3000,14,[14,14]]]") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10],[2000,12,[11,13]],[3000,14]]");
+	};
+	tst.test("datasetparser.json_range_invalid", "trades 1 [[1000,10],[3000,14],[4000,15],[5000,16],[6000,17],[7000,18],[8000,19],[9000,20],[10000,21],[11000,22]]") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10],[2000,12,[11]],[3000,14],[4000,15],[5000,16],[6000,17],[7000,18],[8000,19],[9000,20],[10000,21],[11000,22]]");
+	};
+	tst.test("datasetparser.csv_header", "trades 1 [[1000,10],[2000,11]]") >> [&](std::ostream &out) {
+		parse(out, "time;price\r\n1000;10\r\n2000;\"11\"\r\n");
+	};
+	tst.test("datasetparser.csv_prices", "prices 0 [1.5,1.6]") >> [&](std::ostream &out) {
+		parse(out, "1.5\n1.6");
+	};
+	tst.test("datasetparser.chunks", "trades 0 [[1000,10,[9,11]],[2000,12,[12,12.5]]]") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10,[9,11]],[2000,12,[12,12.5]]]", 1);
+	};
+	tst.test("datasetparser.too_many_rows", "Too many rows (line 1)") >> [&](std::ostream &out) {
+		parse(out, "[1,2,3]", 4096, 2);
+	};
+	tst.test("datasetparser.nested", "Nested arrays are not supported (line 1)") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10,[9,[11]]]]");
+	};
+	tst.test("datasetparser.objects", "Objects are not supported (line 1)") >> [&](std::ostream &out) {
+		parse(out, "[{\"time\":1000}]");
+	};
+	tst.test("datasetparser.unterminated", "Unexpected end of the data (line 1)") >> [&](std::ostream &out) {
+		parse(out, "[[1000,10],[2000,11]");
+	};
+
+	return tst.didFail()?1:0;
+}
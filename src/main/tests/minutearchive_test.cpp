@@ -0,0 +1,94 @@
+/*
+ * minutearchive_test.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <imtjson/value.h>
+#include <tests/testClass.h>
+
+#include "../minutearchive.h"
+
+using namespace json;
+
+static const std::uint64_t t0 = 1600000020;
+
+///History source which returns given rows and records requested times
+struct StandInSource {
+	Value rows;
+	std::vector<std::uint64_t> requests;
+
+	MinuteArchive::Fetch fetch() {
+		return [this](std::uint64_t from) {
+			requests.push_back(from);
+			return rows;
+		};
+	}
+};
+
+static Value row(std::uint64_t minute, double price) {
+	return {t0+minute*60, price};
+}
+
+static void print(std::ostream &out, const MinuteArchive::Range &rng) {
+	out << (rng.getStartTime()-t0)/60 << ":";
+	for (double d: rng) out << " " << d;
+}
+
+int main(int, char **) {
+
+	TestSimple tst;
+
+	char tmpl[] = "/tmp/mmbot_minutearchive_XXXXXX";
+	if (mkdtemp(tmpl) == nullptr) return 1;
+	std::string dir = tmpl;
+
+	tst.test("minutearchive.gap", "0: 1 2 2 2 5") >> [&](std::ostream &out) {
+		MinuteArchive arch(dir+"/gap");
+		StandInSource src{{row(0,1), row(1,2), row(4,5)}};
+		print(out, arch.get("btc","usd", t0, src.fetch()));
+	};
+
+	tst.test("minutearchive.late_start", "2: 3 4") >> [&](std::ostream &out) {
+		MinuteArchive arch(dir+"/late");
+		StandInSource src{{row(2,3), row(3,4)}};
+		print(out, arch.get("btc","usd", t0, src.fetch()));
+	};
+
+	tst.test("minutearchive.append", "3 0: 1 2 3 3 3 6 7") >> [&](std::ostream &out) {
+		MinuteArchive arch(dir+"/append");
+		StandInSource src{{row(0,1), row(1,2), row(2,3)}};
+		arch.get("btc","usd", t0, src.fetch());
+		//overlaps the archive, then a gap of two minutes
+		src.rows = {row(1,20), row(2,30), row(5,6), row(6,7)};
+		auto rng = arch.get("btc","usd", t0, src.fetch());
+		out << (src.requests.back()-t0)/60 << " ";
+		print(out, rng);
+	};
+
+	tst.test("minutearchive.append_old", "0: 1 2") >> [&](std::ostream &out) {
+		MinuteArchive arch(dir+"/old");
+		StandInSource src{{row(0,1), row(1,2)}};
+		arch.get("btc","usd", t0, src.fetch());
+		src.rows = {row(0,10), row(1,20)};
+		print(out, arch.get("btc","usd", t0, src.fetch()));
+	};
+
+	tst.test("minutearchive.from", "1: 2 2 4") >> [&](std::ostream &out) {
+		MinuteArchive arch(dir+"/from");
+		StandInSource src{{row(0,1), row(1,2), row(3,4)}};
+		arch.get("btc","usd", t0, src.fetch());
+		print(out, arch.read("btc","usd", t0+60));
+	};
+
+	std::filesystem::remove_all(dir);
+
+	return tst.didFail()?1:0;
+}
@@ -10,6 +10,7 @@
 
 #include "traders.h"
 
+#include <algorithm>
 #include <set>
 #include "../imtjson/src/imtjson/object.h"
 #include "../shared/countdown.h"
@@ -17,6 +18,7 @@
 #include "simulator.h"
 
 #include "ext_stockapi.h"
+#include "perfstats.h"
 
 using ondra_shared::Countdown;
 using ondra_shared::logError;
@@ -97,6 +99,15 @@ void StockSelector::forEachStock(EnumFn fn)  const {
 		fn(x.first, x.second);
 	}
 }
+json::Value StockSelector::getMarketData() const {
+	json::Object res;
+	forEachStock([&](std::string_view name, const PStockApi &api){
+		auto *src = dynamic_cast<const IMarketDataSource *>(api.get());
+		if (src) res.set(name, src->getMarketSnapshot()->toJSON());
+	});
+	return res;
+}
+
 void StockSelector::clear() {
 	stock_markets.clear();
 }
@@ -125,6 +136,7 @@ sf(sf)
 
 void Traders::clear() {
 	traders.clear();
+	snapshots.clear();
 	stockSelector.clear();
 	wcfg.walletDB = wcfg.walletDB.make();
 	wcfg.accumDB = wcfg.accumDB.make();
@@ -143,6 +155,7 @@ json::Value Traders::getUtilization(std::size_t lastUpdate) const {
 	}
 	res.set("traders", ids);
 	res.set("reset",reset_time);
+	res.set("init",init_time);
 	res.set("updated", updated);
 	res.set("last_update", lastTime);
 	return res;
@@ -177,11 +190,9 @@ void Traders::addTrader(const MTrader::Config &mcfg ,ondra_shared::StrViewA n) {
 			auto t = SharedObject<NamedMTrader>::make(stockSelector, std::move(storage),
 				std::make_unique<StatsSvc>(n, rpt, perfMod), wcfg, mcfg, n);
 			auto lt = t.lock();
-			try {
-				lt->init();
-			} catch (...) {
-				//ignore exception now
-			}
+			lt->setTradeArchive(sf->create("_trades_"+std::string(n)));
+			pending_init.push_back(t);
+			snapshots.insert(std::pair(StrViewA(lt->ident), lt->getSnapshotSlot()));
 			traders.insert(std::pair(StrViewA(lt->ident), std::move(t)));
 		} else {
 			throw std::runtime_error("Unable to load broker");
@@ -195,6 +206,80 @@ void Traders::addTrader(const MTrader::Config &mcfg ,ondra_shared::StrViewA n) {
 }
 
 
+void Traders::setLoaderThreads(unsigned int threads) {
+	if (threads > 1) loader_pool = std::make_shared<ComputePool>(threads, threads);
+	else loader_pool = nullptr;
+}
+
+void Traders::runLoader(std::size_t count, const std::function<void(unsigned int)> &fn) {
+	if (loader_pool) {
+		loader_pool->parallel(static_cast<unsigned int>(count), fn);
+	} else {
+		for (std::size_t i = 0; i < count; i++) fn(static_cast<unsigned int>(i));
+	}
+}
+
+void Traders::initTraders() {
+	using namespace ondra_shared;
+
+	static PerfHistogram &probe_hist = PerfStats::global().get("traders.init");
+	PerfProbe probe(probe_hist);
+	auto t1 = std::chrono::steady_clock::now();
+	std::vector<SharedObject<NamedMTrader> > lst;
+	std::swap(lst, pending_init);
+
+	//prefetch market info, it is cached by the broker for the current cycle
+	std::vector<std::pair<PStockApi, std::string> > pairs;
+	{
+		std::set<std::pair<std::string, std::string> > seen;
+		for (auto &t: lst) {
+			auto cfg = t.lock()->getConfig();
+			if (!seen.emplace(cfg.broker, cfg.pairsymb).second) continue;
+			PStockApi api = stockSelector.getStock(cfg.broker);
+			if (api != nullptr) pairs.emplace_back(api, cfg.pairsymb);
+		}
+	}
+	runLoader(pairs.size(), [&](unsigned int i) {
+		try {
+			pairs[i].first->getMarketInfo(pairs[i].second);
+		} catch (...) {
+			//error is reported by the trader
+		}
+	});
+
+	//bind traders in order, the first trader wins the conflict
+	std::vector<char> bound(lst.size(), 0);
+	for (std::size_t i = 0; i < lst.size(); i++) {
+		auto lt = lst[i].lock();
+		LogObject lg(lt->ident);
+		LogObject::Swap swp(lg);
+		try {
+			lt->initMarket();
+			bound[i] = 1;
+		} catch (...) {
+			//ignore exception now
+		}
+	}
+
+	runLoader(lst.size(), [&](unsigned int i) {
+		if (!bound[i]) return;
+		auto lt = lst[i].lock();
+		LogObject lg(lt->ident);
+		LogObject::Swap swp(lg);
+		try {
+			lt->initState();
+		} catch (std::exception &e) {
+			logError("Failed to load state: $1", e.what());
+		} catch (...) {
+			logError("Failed to load state: unknown exception");
+		}
+	});
+
+	auto t2 = std::chrono::steady_clock::now();
+	init_time = std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count();
+	logNote("Initialized $1 traders in $2 ms", lst.size(), init_time);
+}
+
 void Traders::removeTrader(ondra_shared::StrViewA n, bool including_state) {
 	auto t = find(n).lock();
 	if (t != nullptr) {
@@ -209,6 +294,7 @@ void Traders::removeTrader(ondra_shared::StrViewA n, bool including_state) {
 			utilization.erase(n);
 			//now we can erase
 		}
+		snapshots.erase(n);
 		traders.erase(n);
 	}
 }
@@ -252,6 +338,12 @@ SharedObject<NamedMTrader> Traders::find(std::string_view id) const {
 	else return iter->second;
 }
 
+MTrader::PSnapshot Traders::getSnapshot(std::string_view id) const {
+	auto iter = snapshots.find(id);
+	if (iter == snapshots.end()) return nullptr;
+	else return iter->second->get();
+}
+
 StockSelector::StockSelector() {
 	temp_markets = temp_markets.make();
 }
@@ -10,6 +10,7 @@
 #include "../shared/scheduler.h"
 #include "../shared/shared_object.h"
 #include "../shared/worker.h"
+#include "computepool.h"
 #include "istockapi.h"
 #include "mtrader.h"
 #include "stats2report.h"
@@ -46,6 +47,8 @@ public:
 	void clear();
 	void housekeepingIdle(const std::chrono::system_clock::time_point &now);
 	void appendSimulator();
+	///Returns market data cached by brokers during current cycle - doesn't call brokers
+	json::Value getMarketData() const;
 };
 
 
@@ -53,7 +56,9 @@ class Traders {
 public:
 
 	using TMap = ondra_shared::linear_map<std::string_view, SharedObject<NamedMTrader> >;
+	using SnapshotMap = ondra_shared::linear_map<std::string_view, MTrader::PSnapshotSlot>;
 	TMap traders;
+	SnapshotMap snapshots;
     StockSelector stockSelector;
 	PStorageFactory &sf;
 	PReport rpt;
@@ -77,6 +82,14 @@ public:
 
 
 	void addTrader(const MTrader::Config &mcfg, ondra_shared::StrViewA n);
+	///Initializes traders added by addTrader
+	/**
+	 * Market info is prefetched for all pairs at once (requests to the same broker run
+	 * concurrently), then the traders are bound to their markets in order, and finally the
+	 * states are loaded in parallel by the loader pool (see setLoaderThreads). Traders, which failed to
+	 * initialize, retry the initialization in the next cycle
+	 */
+	void initTraders();
 	void removeTrader(ondra_shared::StrViewA n, bool including_state);
 
 
@@ -89,11 +102,19 @@ public:
 
 	void resetBrokers();
 	SharedObject<NamedMTrader> find(std::string_view id) const;
+	///Retrieves last published snapshot of the trader (doesn't lock the trader)
+	/** @return snapshot or nullptr, if trader doesn't exist or it was not initialized yet */
+	MTrader::PSnapshot getSnapshot(std::string_view id) const;
 	WalletCfg wcfg;
 
 
 	using Utilization = std::unordered_map<std::string, std::pair<double,std::size_t> >;
 	double reset_time;
+	///duration of the last initTraders (milliseconds)
+	double init_time = 0;
+	///Sets count of threads used to load states of the traders
+	/** Threads are created once and reused by every initTraders(). Value 1 loads states in the calling thread */
+	void setLoaderThreads(unsigned int threads);
 
 	Utilization utilization;
 
@@ -103,6 +124,14 @@ public:
 
 	static void resetBroker(const PStockApi &api, const std::chrono::system_clock::time_point &now);
 
+protected:
+	///traders added, but not initialized yet
+	std::vector<SharedObject<NamedMTrader> > pending_init;
+	///threads loading states of the traders
+	PComputePool loader_pool;
+
+	///Calls the function for indexes 0..count-1 using the loader pool
+	void runLoader(std::size_t count, const std::function<void(unsigned int)> &fn);
 };
 
 
@@ -8,9 +8,11 @@
 
 #include "webcfg.h"
 
+#include <optional>
 #include <random>
 #include <unordered_set>
 
+#include <imtjson/arena.h>
 #include <imtjson/array.h>
 #include <imtjson/object.h>
 #include <imtjson/string.h>
@@ -25,8 +27,12 @@
 #include "../shared/ini_config.h"
 #include "../shared/logOutput.h"
 #include "apikeys.h"
+#include "datasetparser.h"
 #include "ext_stockapi.h"
+#include "montecarlo.h"
+#include "perfstats.h"
 #include "random_chart.h"
+#include "replay.h"
 #include "sgn.h"
 #include "spread.h"
 
@@ -55,7 +61,9 @@ NamedEnum<WebCfg::Command> WebCfg::strCommand({
 	{WebCfg::visstrategy, "visstrategy"},
 	{WebCfg::utilization, "utilization"},
 	{WebCfg::progress, "progress"},
-	{WebCfg::news, "news"}
+	{WebCfg::news, "news"},
+	{WebCfg::marketdata, "marketdata"},
+	{WebCfg::metrics, "metrics"}
 });
 
 WebCfg::WebCfg( const SharedObject<State> &state,
@@ -64,7 +72,9 @@ WebCfg::WebCfg( const SharedObject<State> &state,
 		Dispatch &&dispatch,
 		json::PJWTCrypto jwt,
 		SharedObject<AbstractExtern> backtest_broker,
-		std::size_t upload_limit
+		std::size_t upload_limit,
+		PComputePool compute,
+		PMinuteArchive minute_archive
 )
 	:auth(realm, state.lock_shared()->users.admins,jwt, false)
 	,trlist(traders)
@@ -72,6 +82,8 @@ WebCfg::WebCfg( const SharedObject<State> &state,
 	,state(state)
 	,backtest_broker(backtest_broker)
 	,upload_limit(upload_limit)
+	,compute(std::move(compute))
+	,minute_archive(std::move(minute_archive))
 {
 
 }
@@ -113,6 +125,8 @@ bool WebCfg::operator ()(const simpleServer::HTTPRequest &req,
 		case utilization: return reqUtilization(req, qp);
 		case progress: return reqProgress(req,rest);
 		case news: return reqNews(req);
+		case marketdata: return reqMarketData(req);
+		case metrics: return reqMetrics(req);
 		}
 	}
 	return false;
@@ -399,10 +413,6 @@ bool WebCfg::reqBrokerSpec(simpleServer::HTTPRequest req,
 		std::string pairstr = urlDecode(pair);
 		pair = pairstr;
 
-		if (req.getPath().indexOf("reset=1") != StrViewA::npos) {
-			api->reset(std::chrono::system_clock::now());
-		}
-
 		IBrokerControl *bc = dynamic_cast<IBrokerControl *>(api.get());
 
 
@@ -583,16 +593,13 @@ bool WebCfg::reqBrokerSpec(simpleServer::HTTPRequest req,
 									orders.stringify().str());
 							return true;
 						} else if (req.getMethod() == "DELETE") {
-							api->reset(std::chrono::system_clock::now());
 							auto ords = api->getOpenOrders(p);
 							for (auto &&x : ords) {
 								api->placeOrder(p, 0, 0, Value(), x.id, 0);
 							}
-							api->reset(std::chrono::system_clock::now());
 							req.sendResponse(std::move(hdr), "true");
 							return true;
 						} else {
-							api->reset(std::chrono::system_clock::now());
 							Stream s = req.getBodyStream();
 							Value parsed = Value::parse(s);
 							Value price = parsed["price"];
@@ -648,6 +655,59 @@ bool WebCfg::reqBrokerSpec(simpleServer::HTTPRequest req,
 
 }
 
+///Retrieves the snapshot of the trader, doesn't lock the trader unless it was not initialized yet
+/** @return snapshot, or nullptr, if trader doesn't exist */
+static MTrader::PSnapshot getTraderSnapshot(const SharedObject<Traders> &trlist, std::string_view id) {
+	auto trl = trlist.lock_shared();
+	auto snp = trl->getSnapshot(id);
+	if (snp == nullptr) {
+		auto tr = trl->find(id);
+		trl.release();
+		if (tr == nullptr) return nullptr;
+		auto lk = tr.lock();
+		lk->init();
+		snp = lk->getSnapshotSlot()->get();
+	}
+	return snp;
+}
+
+static Value getTradingInfo(const MTrader::Snapshot &snp, double stprice) {
+	Object out;
+	const auto &chart = snp.chart;
+	PStockApi broker = snp.broker;
+	auto chbeg = chart.size()>600?chart.end()-600:chart.begin();
+	out.set("chart", Value(json::array,chbeg, chart.end(),[&](auto &&item) {
+		return Object({{"time", item.time},{"last",item.last}});
+	}));
+	std::size_t start = chbeg == chart.end()?0:chbeg->time;
+	const auto &trades = snp.trades;
+	out.set("trades", Value(json::array, trades.begin(), trades.end(),[&](auto &&item) {
+		if (item.time >= start) return item.toJSON(); else return Value();
+	}));
+	auto ticker = broker->getTicker(snp.cfg.pairsymb);
+	out.set("ticker", Object({{"ask", ticker.ask},{"bid", ticker.bid},{"last", ticker.last},{"time", ticker.time}}));
+	out.set("orders", getOpenOrders(broker, snp.cfg.pairsymb));
+	out.set("broker", snp.cfg.broker);
+	out.set("pair", getPairInfo(broker, snp.cfg.pairsymb));
+	{
+		auto strategy = snp.strategy;
+		double assets = snp.position.value_or(0);
+		double currencies = snp.currency.value_or(0);
+		auto eq = strategy.getEquilibrium(assets);
+		auto minfo = snp.minfo;
+		if (stprice) {
+			if (minfo.invert_price) stprice = 1.0/stprice;
+		}else {
+			stprice = ticker.last;
+		}
+		auto order = strategy.getNewOrder(minfo,ticker.last, stprice, sgn(eq - stprice),assets, currencies, false);
+		order.price = stprice;
+		minfo.addFees(order.size, order.price);
+		out.set("strategy",Object({{"size", (minfo.invert_price?-1:1)*order.size}}));
+	}
+	return out;
+}
+
 bool WebCfg::reqTraders(simpleServer::HTTPRequest req, ondra_shared::StrViewA vpath)  {
 	std::string path = vpath;
 	HTTPResponse hdr(200);
@@ -678,9 +738,20 @@ bool WebCfg::reqTraders(simpleServer::HTTPRequest req, ondra_shared::StrViewA vp
 						Value(Object({{"entries",{"stop","clear_stats","reset","broker","trading","strategy"}}})).stringify().str());
 				}
 			} else {
+				auto cmd = urlDecode(StrViewA(splt()));
+				if (cmd == "trading") {
+					//served from the snapshot, so it doesn't wait for the trader's cycle
+					auto snp = getTraderSnapshot(trlist, trid);
+					if (snp == nullptr) {
+						req.sendErrorPage(404);
+						return true;
+					}
+					double stprice = strtod(splt().data,0);
+					req.sendResponse(std::move(hdr), getTradingInfo(*snp, stprice).stringify().str());
+					return true;
+				}
 				auto trl = tr.lock();
 				trl->init();
-				auto cmd = urlDecode(StrViewA(splt()));
 				if (cmd == "clear_stats") {
 					if (!req.allowMethods({"POST"})) return true;
 					Stream s = req.getBodyStream();
@@ -730,44 +801,6 @@ bool WebCfg::reqTraders(simpleServer::HTTPRequest req, ondra_shared::StrViewA vp
 					StrViewA restpath = vpath.substr(nx.data - vpath.data);
 					std::string brokerName = trl->getConfig().broker;
 					reqBrokerSpec(req, restpath, (trl->getBroker()), brokerName);
-				} else if (cmd == "trading") {
-					Object out;
-					auto chartx = trl->getChart();
-					ondra_shared::StringView<MTrader::ChartItem> chart(chartx.data(), chartx.size());
-					PStockApi broker = trl->getBroker();
-					broker->reset(std::chrono::system_clock::now());
-					if (chart.length>600) chart = chart.substr(chart.length-600);
-					out.set("chart", Value(json::array,chart.begin(), chart.end(),[&](auto &&item) {
-						return Object({{"time", item.time},{"last",item.last}});
-					}));
-					std::size_t start = chart.empty()?0:chart[0].time;
-					auto trades = trl->getTrades();
-					out.set("trades", Value(json::array, trades.begin(), trades.end(),[&](auto &&item) {
-						if (item.time >= start) return item.toJSON(); else return Value();
-					}));
-					auto ticker = broker->getTicker(trl->getConfig().pairsymb);
-					double stprice = strtod(splt().data,0);
-					out.set("ticker", Object({{"ask", ticker.ask},{"bid", ticker.bid},{"last", ticker.last},{"time", ticker.time}}));
-					out.set("orders", getOpenOrders(broker, trl->getConfig().pairsymb));
-					out.set("broker", trl->getConfig().broker);
-					out.set("pair", getPairInfo(broker, trl->getConfig().pairsymb));
-					if (trl != nullptr) {
-						auto strategy = trl->getStrategy();
-						double assets = *trl->getPosition();
-						double currencies = *trl->getCurrency();
-						auto eq = strategy.getEquilibrium(assets);
-						auto minfo = trl->getMarketInfo();
-						if (stprice) {
-							if (minfo.invert_price) stprice = 1.0/stprice;
-						}else {
-							stprice = ticker.last;
-						}
-						auto order = strategy.getNewOrder(minfo,ticker.last, stprice, sgn(eq - stprice),assets, currencies, false);
-						order.price = stprice;
-						minfo.addFees(order.size, order.price);
-						out.set("strategy",Object({{"size", (minfo.invert_price?-1:1)*order.size}}));
-					}
-					req.sendResponse(std::move(hdr), Value(out).stringify().str());
 				} else if (cmd == "strategy") {
 					if (!req.allowMethods({"GET","PUT"})) return true;
 					Strategy strategy = trl->getStrategy();
@@ -899,6 +932,7 @@ void WebCfg::State::applyConfig(SharedObject<Traders>  &st) {
 			logError("Failed to initialized trader $1 - $2", v.getKey(), e.what());
 		}
 	}
+	t->initTraders();
 
 	Value bc = data["brokers"];
 	broker_config = bc;
@@ -1047,7 +1081,6 @@ bool WebCfg::reqEditor(simpleServer::HTTPRequest req)  {
 					p = symb.toString().str();
 				}
 
-				api->reset(std::chrono::system_clock::now());
 				auto bc = dynamic_cast<IBrokerControl *>(api.get());
 				auto binfo = bc?bc->getBrokerInfo():IBrokerControl::BrokerInfo{};
 
@@ -1203,158 +1236,164 @@ bool WebCfg::reqBacktest(simpleServer::HTTPRequest req, ondra_shared::StrViewA r
 	if (req.getMethod() == "DELETE") {
 		auto lkst = state.lock();
 		lkst->backtest_cache.clear();
-		lkst->prices_cache.clear();
 		lkst->spread_cache.clear();
 		req.sendResponse("application/json","true");
 		return true;
 	} else  {
-		req.readBodyAsync(50000,[&trlist = this->trlist,state =  this->state](simpleServer::HTTPRequest req)mutable{
+		req.readBodyAsync(50000,[trlist = this->trlist,state =  this->state, compute = this->compute](simpleServer::HTTPRequest req)mutable{
 			try {
 				Value orgdata = Value::fromString(map_bin2str(req.getUserBuffer()));
-				Value id = orgdata["id"];
-
-				Value reverse=orgdata["reverse"];
-				Value invert=orgdata["invert"];
-
-
-				auto process=[=](Traders &trlist, const BacktestCache::Subj &trades, bool inv, bool rev) {
-
-					Value data = orgdata;
-					Value config = data["config"];
-					Value init_pos = data["init_pos"];
-					Value balance = data["balance"];
-					Value init_price = data["init_price"];
-					Value fill_atprice= data["fill_atprice"];
-					Value negbal= data["neg_bal"];
-					Value spend= data["spend"];
-
-					std::uint64_t start_date=data["start_date"].getUIntLong();
-
-					MTrader_Config mconfig;
-					mconfig.loadConfig(config);
-					std::optional<double> m_init_pos;
-					if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
-
-					auto piter = trades.prices.begin();
-					auto pend = trades.prices.end();
-					double mlt = 1.0;
-					double avg = std::accumulate(trades.prices.begin(), trades.prices.end(),0.0,[](double a, const BTPrice &b){return a + b.price;})/trades.prices.size();
-					double ip = init_price.getNumber();
-					double fv = trades.prices.empty()?ip:trades.prices[rev?trades.prices.size()-1:0].price;
-					if (ip && !trades.prices.empty()) {
-						if (inv) fv = 2*avg - fv;
-						if (trades.minfo.invert_price) {
-							mlt = (1.0/ip)/fv;
-						} else {
-							mlt = ip/fv;
+				runCompute(compute, state, req, orgdata["progress"], [=](simpleServer::HTTPRequest &req, Progress *prg) mutable {
+					Value id = orgdata["id"];
+
+					Value reverse=orgdata["reverse"];
+					Value invert=orgdata["invert"];
+
+
+					auto process=[&](const BacktestCache::Subj &trades, bool inv, bool rev) {
+
+						Value data = orgdata;
+						Value config = data["config"];
+						Value init_pos = data["init_pos"];
+						Value balance = data["balance"];
+						Value init_price = data["init_price"];
+						Value fill_atprice= data["fill_atprice"];
+						Value negbal= data["neg_bal"];
+						Value spend= data["spend"];
+
+						std::uint64_t start_date=data["start_date"].getUIntLong();
+
+						MTrader_Config mconfig;
+						mconfig.loadConfig(config);
+						std::optional<double> m_init_pos;
+						if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
+
+						auto piter = trades.prices.begin();
+						auto pend = trades.prices.end();
+						double mlt = 1.0;
+						double avg = std::accumulate(trades.prices.begin(), trades.prices.end(),0.0,[](double a, const BTPrice &b){return a + b.price;})/trades.prices.size();
+						double ip = init_price.getNumber();
+						double fv = trades.prices.empty()?ip:trades.prices[rev?trades.prices.size()-1:0].price;
+						if (ip && !trades.prices.empty()) {
+							if (inv) fv = 2*avg - fv;
+							if (trades.minfo.invert_price) {
+								mlt = (1.0/ip)/fv;
+							} else {
+								mlt = ip/fv;
+							}
+							fv = fv * mlt;
 						}
-						fv = fv * mlt;
-					}
 
-					BTPriceSource source;
-					if (rev) {
-						auto priter = trades.prices.rbegin();
-
-						source = [&, priter]() mutable {
-							std::optional<BTPrice> x;
-							while (piter != pend && piter->time < start_date) {++piter; ++priter;}
-							if (piter != pend) {
-								x=BTPrice {piter->time,priter->price*mlt};
-								++piter;
-								++priter;
+						BTPriceSource source;
+						if (rev) {
+							auto priter = trades.prices.rbegin();
+
+							source = [&, priter]() mutable {
+								std::optional<BTPrice> x;
+								while (piter != pend && piter->time < start_date) {++piter; ++priter;}
+								if (piter != pend) {
+									x=BTPrice {piter->time,priter->price*mlt};
+									++piter;
+									++priter;
+								};
+								return x;
 							};
-							return x;
-						};
 
 
-					} else {
-						source = [&]{
-							std::optional<BTPrice> x;
-							while (piter != pend && piter->time < start_date) ++piter;
-							if (piter != pend) {
-								x=BTPrice {piter->time,piter->price*mlt};
-								++piter;
+						} else {
+							source = [&]{
+								std::optional<BTPrice> x;
+								while (piter != pend && piter->time < start_date) ++piter;
+								if (piter != pend) {
+									x=BTPrice {piter->time,piter->price*mlt};
+									++piter;
+								};
+								return x;
 							};
-							return x;
-						};
-					}
+						}
 
-					if (inv) {
-						source = [src = std::move(source),fv](){
-							auto r = src();
-							if (r.has_value()) r->price = fv*fv/r->price;
-							return r;
-						};
-					}
+						if (inv) {
+							source = [src = std::move(source),fv](){
+								auto r = src();
+								if (r.has_value()) r->price = fv*fv/r->price;
+								return r;
+							};
+						}
 
-					BTTrades rs = backtest_cycle(mconfig,std::move(source),
-							trades.minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
+						if (prg) {
+							source = [src = std::move(source), prg, cnt = std::size_t(0), total = trades.prices.size()]() mutable {
+								if ((cnt & 0xFFFF) == 0 && !prg->set(cnt*100.0/total)) throw JobCanceled();
+								++cnt;
+								return src();
+							};
+						}
 
+						BTTrades rs = backtest_cycle(mconfig,std::move(source),
+								trades.minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
 
 
-					Value result (json::array, rs.begin(), rs.end(), [](const BTTrade &x) {
-						Value event;
-						switch (x.event) {
-						default: event = btevent_no_event;break;
-						case BTEvent::accept_loss: event = btevent_accept_loss;break;
-						case BTEvent::liquidation: event = btevent_liquidation;break;
-						case BTEvent::margin_call: event = btevent_margin_call;break;
-						case BTEvent::no_balance: event = btevent_no_balance;break;
-						case BTEvent::error: event = btevent_error;break;
-						}
-						return Object({
-								{"np",x.neutral_price},
-								{"op",x.open_price},
-								{"na",x.norm_accum},
-								{"npl",x.norm_profit},
-								{"npla",x.norm_profit_total},
-								{"pl",x.pl},
-								{"ps",x.pos},
-								{"pr",x.price},
-								{"tm",x.time},
-								{"info",x.info},
-								{"sz",x.size},
-								{"event", event}
+
+						Value result (json::array, rs.begin(), rs.end(), [](const BTTrade &x) {
+							Value event;
+							switch (x.event) {
+							default: event = btevent_no_event;break;
+							case BTEvent::accept_loss: event = btevent_accept_loss;break;
+							case BTEvent::liquidation: event = btevent_liquidation;break;
+							case BTEvent::margin_call: event = btevent_margin_call;break;
+							case BTEvent::no_balance: event = btevent_no_balance;break;
+							case BTEvent::error: event = btevent_error;break;
+							}
+							return Object({
+									{"np",x.neutral_price},
+									{"op",x.open_price},
+									{"na",x.norm_accum},
+									{"npl",x.norm_profit},
+									{"npla",x.norm_profit_total},
+									{"pl",x.pl},
+									{"ps",x.pos},
+									{"pr",x.price},
+									{"tm",x.time},
+									{"info",x.info},
+									{"sz",x.size},
+									{"event", event}
+							});
 						});
-					});
-					String resstr = result.toString();
-					req.sendResponse("application/json",resstr.str());
-				};
+						String resstr = result.toString();
+						req.sendResponse("application/json",resstr.str());
+					};
 
 
 
-				auto lkst = state.lock_shared();
-				if (lkst->backtest_cache.available(id.toString().str())) {
-					auto t = lkst->backtest_cache.getSubject();
-					bool inv = t.inverted != invert.getBool();
-					bool rev = t.reversed != reverse.getBool();
-					process(*trlist.lock(), t, inv, rev);
-				} else {
-					lkst.release();
-						try {
-							auto tr = trlist.lock_shared()->find(id.getString()).lock_shared();
-							if (tr == nullptr) {
-								req.sendErrorPage(404);
-								return;
-							}
+					auto t = state.lock()->backtest_cache.find(id.toString().str());
+					if (t != nullptr) {
+						bool inv = t->inverted != invert.getBool();
+						bool rev = t->reversed != reverse.getBool();
+						process(*t, inv, rev);
+					} else {
+							try {
+								auto snp = getTraderSnapshot(trlist, id.getString());
+								if (snp == nullptr) {
+									req.sendErrorPage(404);
+									return;
+								}
 
-							const auto &tradeHist = tr->getTrades();
-							BacktestCacheSubj trs;
-							std::transform(tradeHist.begin(),tradeHist.end(),
-									std::back_insert_iterator(trs.prices),[](const IStatSvc::TradeRecord &r) {
-								return BTPrice{r.time, r.price};
-							});
-							trs.minfo = tr->getMarketInfo();
-							trs.inverted = false;
-							trs.reversed = false;
-							tr.release();
-
-							state.lock()->backtest_cache = BacktestCache(trs, id.toString().str());
-							process(*trlist.lock(), trs, invert.getBool(), reverse.getBool());
-						} catch (std::exception &e) {
-							req.sendErrorPage(400,"", e.what());
-						}
-				}
+								const auto tradeHist = snp->getFullHistory();
+								BacktestCacheSubj trs;
+								std::transform(tradeHist.begin(),tradeHist.end(),
+										std::back_insert_iterator(trs.prices),[](const IStatSvc::TradeRecord &r) {
+									return BTPrice{r.time, r.price};
+								});
+								trs.minfo = snp->minfo;
+								trs.inverted = false;
+								trs.reversed = false;
+
+								process(trs, invert.getBool(), reverse.getBool());
+								state.lock()->backtest_cache.store(id.toString().str(), std::move(trs));
+							} catch (std::exception &e) {
+								req.sendErrorPage(400,"", e.what());
+							}
+					}
+				});
 			} catch (std::exception &e) {
 				req.sendErrorPage(400,"", e.what());
 			}
@@ -1378,104 +1417,103 @@ public:
 
 bool WebCfg::reqSpread(simpleServer::HTTPRequest req)  {
 	if (!req.allowMethods({"POST"})) return true;
-		req.readBodyAsync(50000,[trlist = this->trlist,state =  this->state](simpleServer::HTTPRequest req)mutable{
+		req.readBodyAsync(50000,[trlist = this->trlist,state =  this->state, compute = this->compute](simpleServer::HTTPRequest req)mutable{
 		try {
 			Value args = Value::fromString(json::map_bin2str(req.getUserBuffer()));
-			Value id = args["id"];
-			auto process = [=](const SpreadCacheItem &data) {
-
-
-				Value sma = args["sma"];
-				Value stdev = args["stdev"];
-				Value force_spread = args["force_spread"];
-				Value mult = args["mult"];
-				Value dynmult_raise = args["raise"];
-				Value dynmult_fall = args["fall"];
-				Value dynmult_cap= args["cap"];
-				Value dynmult_mode = args["mode"];
-				Value dynmult_sliding = args["sliding"];
-				Value dynmult_mult = args["dyn_mult"];
-				Value order2 = args["order2"];
-				Value spread_freeze = args["spread_freeze"];
-
-				auto fn = defaultSpreadFunction(sma.getNumber(), stdev.getNumber(), force_spread.getNumber());
-				VisSpread vs(fn, {
-						{
-								dynmult_raise.getValueOrDefault(1.0),
-								dynmult_fall.getValueOrDefault(1.0),
-								dynmult_cap.getValueOrDefault(100.0),
-								strDynmult_mode[dynmult_mode.getValueOrDefault("independent")],
-								dynmult_mult.getBool()
-						},
-						mult.getNumber(),
-						order2.getNumber(),
-						dynmult_sliding.getBool(),
-						spread_freeze.getBool()
-				});
+			runCompute(compute, state, req, args["progress"], [=](simpleServer::HTTPRequest &req, Progress *) mutable {
+				Value id = args["id"];
+				auto process = [=](const SpreadCacheItem &data) {
 
-				json::Array chart;
-				for (const auto &d: data.chart) {
-					auto spinfo = vs.point(d.last);
-					if (spinfo.valid) {
-						double p = d.last;
-						if (data.invert_price) {
-							p = 1.0/p;
-							spinfo = VisSpread::Result{
-								true,1.0/spinfo.price,1.0/spinfo.high,1.0/spinfo.low,-spinfo.trade,1.0/spinfo.price2,-spinfo.trade2
-							};
-						}
-						chart.push_back(Value(json::object,{
-								Value("p",p),
-								Value("x",spinfo.price),
-								Value("l",spinfo.low),
-								Value("h",spinfo.high),
-								Value("s",spinfo.trade),
-								Value("t",d.time)
-						}));
-						if (spinfo.trade2) {
+
+					Value sma = args["sma"];
+					Value stdev = args["stdev"];
+					Value force_spread = args["force_spread"];
+					Value mult = args["mult"];
+					Value dynmult_raise = args["raise"];
+					Value dynmult_fall = args["fall"];
+					Value dynmult_cap= args["cap"];
+					Value dynmult_mode = args["mode"];
+					Value dynmult_sliding = args["sliding"];
+					Value dynmult_mult = args["dyn_mult"];
+					Value order2 = args["order2"];
+					Value spread_freeze = args["spread_freeze"];
+
+					auto fn = defaultSpreadFunction(sma.getNumber(), stdev.getNumber(), force_spread.getNumber());
+					VisSpread vs(fn, {
+							{
+									dynmult_raise.getValueOrDefault(1.0),
+									dynmult_fall.getValueOrDefault(1.0),
+									dynmult_cap.getValueOrDefault(100.0),
+									strDynmult_mode[dynmult_mode.getValueOrDefault("independent")],
+									dynmult_mult.getBool()
+							},
+							mult.getNumber(),
+							order2.getNumber(),
+							dynmult_sliding.getBool(),
+							spread_freeze.getBool()
+					});
+
+					json::Array chart;
+					for (const auto &d: data.chart) {
+						auto spinfo = vs.point(d.last);
+						if (spinfo.valid) {
+							double p = d.last;
+							if (data.invert_price) {
+								p = 1.0/p;
+								spinfo = VisSpread::Result{
+									true,1.0/spinfo.price,1.0/spinfo.high,1.0/spinfo.low,-spinfo.trade,1.0/spinfo.price2,-spinfo.trade2
+								};
+							}
 							chart.push_back(Value(json::object,{
 									Value("p",p),
-									Value("x",spinfo.price2),
+									Value("x",spinfo.price),
 									Value("l",spinfo.low),
 									Value("h",spinfo.high),
-									Value("s",spinfo.trade2),
+									Value("s",spinfo.trade),
 									Value("t",d.time)
 							}));
+							if (spinfo.trade2) {
+								chart.push_back(Value(json::object,{
+										Value("p",p),
+										Value("x",spinfo.price2),
+										Value("l",spinfo.low),
+										Value("h",spinfo.high),
+										Value("s",spinfo.trade2),
+										Value("t",d.time)
+								}));
+							}
 						}
 					}
-				}
 
 
 
-				Value out (json::object,{Value("chart",chart)});
-				req.sendResponse("application/json", out.stringify().str());
-			};
+					Value out (json::object,{Value("chart",chart)});
+					req.sendResponse("application/json", out.stringify().str());
+				};
 
-			auto lkst = state.lock_shared();
-			if (lkst->spread_cache.available(id.toString().str())) {
-				auto t = lkst->spread_cache.getSubject();
-				process(t);
-			} else {
-				lkst.release();
-				try {
-					auto tr = trlist.lock_shared()->find(id.getString()).lock_shared();
-					if (tr == nullptr) {
-						req.sendErrorPage(404);
-						return;
+				auto t = state.lock()->spread_cache.find(id.toString().str());
+				if (t != nullptr) {
+					process(*t);
+				} else {
+					try {
+						auto snp = getTraderSnapshot(trlist, id.getString());
+						if (snp == nullptr) {
+							req.sendErrorPage(404);
+							return;
+						}
+						SpreadCacheItem x;
+						x.chart = snp->chart;
+						x.invert_price = snp->minfo.invert_price;
+						process(x);
+						state.lock()->spread_cache.store(id.toString().str(), std::move(x));
+					} catch (std::exception &e) {
+						req.sendErrorPage(400,"", e.what());
 					}
-					SpreadCacheItem x;
-					x.chart = tr->getChart();
-					x.invert_price = tr->getMarketInfo().invert_price;
-					tr.release();
-					state.lock()->spread_cache= SpreadCache(x, id.toString().str());
-					process(x);
-				} catch (std::exception &e) {
-					req.sendErrorPage(400,"", e.what());
-				}
 
-			}
+				}
 
 
+			});
 		} catch (std::exception &e) {
 			req.sendErrorPage(400,"",e.what());
 		}
@@ -1505,10 +1543,10 @@ bool WebCfg::reqStrategy(simpleServer::HTTPRequest req) {
 
 
 	if (!trader.empty()) {
-		auto tr = this->trlist.lock_shared()->find(trader);
-		if (tr != nullptr) {
-			Strategy trs = tr.lock_shared()->getStrategy();
-			minfo = tr.lock_shared()->getMarketInfo();
+		auto snp = getTraderSnapshot(trlist, trader);
+		if (snp != nullptr) {
+			const Strategy &trs = snp->strategy;
+			minfo = snp->minfo;
 			if (trs.getID() == s.getID()) {
 				s.importState(trs.exportState(),minfo);
 			}
@@ -1631,9 +1669,9 @@ bool WebCfg::reqVisStrategy(simpleServer::HTTPRequest req,  simpleServer::QueryP
 	double bal_a = std::strtod(assets.data,nullptr);
 	double bal_c = std::strtod(currency.data,nullptr);
 	double price = std::strtod(sprice.data,nullptr);
-	auto trader = trlist.lock_shared()->find(id);
+	auto snp = getTraderSnapshot(trlist, id);
 	std::ostringstream tmp;
-	if (trader == nullptr) {
+	if (snp == nullptr) {
 		req.sendErrorPage(404);
 	} else {
 		Strategy st(nullptr);
@@ -1641,11 +1679,10 @@ bool WebCfg::reqVisStrategy(simpleServer::HTTPRequest req,  simpleServer::QueryP
 		IStrategy::MinMax range;
 		std::vector<double> pt_budget, pt_value;
 		{
-			auto tr = trader.lock_shared();
-			auto trades = tr->getTrades();
+			const auto &trades = snp->trades;
 			if (!trades.empty()) price = trades.back().price;
-			st = tr->getStrategy();
-			minfo = tr->getMarketInfo();
+			st = snp->strategy;
+			minfo = snp->minfo;
 			range = st.calcSafeRange(minfo, bal_a, bal_c);
 		}
 
@@ -1802,6 +1839,29 @@ bool WebCfg::reqUtilization(simpleServer::HTTPRequest req,  simpleServer::QueryP
 	if (!req.allowMethods({"GET"})) return true;
 	HeaderValue v = qp["tm"];
 	json::Value res = trlist.lock_shared()->getUtilization(v.getUInt());
+	{
+		auto lkst = state.lock_shared();
+		res.setItems({{"cache", json::Object{
+			{"backtest", lkst->backtest_cache.getStats()},
+			{"spread", lkst->spread_cache.getStats()}
+		}}});
+	}
+	res.setItems({{"perf", PerfStats::global().toJSON()}});
+	req.sendResponse("application/json", res.stringify().str());
+	return true;
+}
+
+bool WebCfg::reqMetrics(simpleServer::HTTPRequest req) {
+	if (!req.allowMethods({"GET"})) return true;
+	std::ostringstream out;
+	PerfStats::global().exportPrometheus(out);
+	req.sendResponse("text/plain; version=0.0.4", out.str());
+	return true;
+}
+
+bool WebCfg::reqMarketData(simpleServer::HTTPRequest req) {
+	if (!req.allowMethods({"GET"})) return true;
+	json::Value res = trlist.lock_shared()->stockSelector.getMarketData();
 	req.sendResponse("application/json", res.stringify().str());
 	return true;
 }
@@ -1815,7 +1875,9 @@ enum class BTAction {
 	historical_chart,
 	gen_trades,
 	run,
-	probe
+	probe,
+	montecarlo,
+	replay
 };
 
 
@@ -1829,8 +1891,34 @@ static NamedEnum<BTAction> strBTAction({
 	{BTAction::gen_trades, "gen_trades"},
 	{BTAction::run, "run"},
 	{BTAction::probe, "probe"},
+	{BTAction::montecarlo, "montecarlo"},
+	{BTAction::replay, "replay"},
 });
 
+///Limits of the random_chart and montecarlo actions
+static constexpr unsigned int maxMonteCarloPaths = 10000;
+static constexpr unsigned int maxRandomChartMinutes = 5*525600;
+///Limit of rows of the uploaded dataset (20 years of minute data)
+static constexpr std::size_t maxUploadRows = 20*525600;
+
+///Parses arguments of the random chart generator (volatility and noise are in percent)
+static RandomChartConfig parseRandomChart(const Value &args) {
+	RandomChartConfig cfg;
+	cfg.volatility = args["volatility"].getValueOrDefault(0.1)*0.01;
+	cfg.noise = args["noise"].getValueOrDefault(0.0)*0.01;
+	cfg.minutes = std::min<unsigned int>(args["minutes"].getValueOrDefault(525600U), maxRandomChartMinutes);
+	cfg.jump_prob = args["jump_prob"].getNumber();
+	cfg.jump_size = args["jump_size"].getNumber()*0.01;
+	cfg.mean_reversion = args["mean_reversion"].getNumber();
+	cfg.vol_clustering = args["vol_clustering"].getNumber();
+	return cfg;
+}
+
+///Classic generator is default, so known seeds generate the same charts
+static bool isClassicRandomChart(const Value &args) {
+	return args["generator"].getValueOrDefault(std::string_view("classic")) != "streams";
+}
+
 bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrViewA rest) {
 	if (!req.allowMethods({"POST","GET"})) return true;
 	if (req.getMethod() == "GET") {
@@ -1852,401 +1940,611 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 
 	} else {
 		auto action = strBTAction[rest];
+		if (action == BTAction::upload_file) {
+			//the dataset is parsed as it arrives, the body is never held in the memory
+			auto storage = state.lock_shared()->backtest_storage;
+			runCompute(compute, state, req, Value(), [storage](simpleServer::HTTPRequest &req, Progress *) mutable {
+				DatasetParser parser(maxUploadRows);
+				try {
+					simpleServer::Stream s = req.getBodyStream();
+					simpleServer::BinaryView data = s.read();
+					while (!data.empty()) {
+						parser.feed(std::string_view(reinterpret_cast<const char *>(data.data), data.length));
+						data = s.read();
+					}
+					parser.finish();
+				} catch (const std::runtime_error &e) {
+					req.sendErrorPage(400,"",e.what());
+					return;
+				}
+				std::string id = storage.lock()->store_array(parser.getRows(), [&](std::size_t idx) {
+					return parser.getRow(idx);
+				});
+				Value response = Object{
+					{"id", id},
+					{"kind", parser.getKind() == DatasetParser::Kind::trades?"trades":"prices"},
+					{"rows", parser.getRows()},
+					{"skipped", parser.getSkipped()}
+				};
+				auto stream = req.sendResponse("application/json");
+				response.serialize(stream);
+			});
+			return true;
+		}
 		req.readBodyAsync(upload_limit,[action,
 										trlist = this->trlist,
 										state =  this->state,
-										prices = this->backtest_broker](simpleServer::HTTPRequest req) mutable{
+										prices = this->backtest_broker,
+										compute = this->compute,
+										minute_archive = this->minute_archive](simpleServer::HTTPRequest req) mutable{
 			Value args = Value::fromString(json::map_bin2str(req.getUserBuffer()));
-			auto storage = state.lock()->backtest_storage;
-			Value response;
-
-			switch (action) {
-				case BTAction::upload_file: {
-					std::string id = storage.lock()->store_data(args);
-					response=Value(json::object, {Value("id",id)});
-				}break;
-				case BTAction::trader_minute_chart: {
-					Value trader = args["trader"];
-					auto tr  =trlist.lock()->find(trader.getString());
-					if (tr == nullptr) {req.sendErrorPage(404);return;}
-					auto chart = tr.lock_shared()->getChart();
-					Value chart_data (json::array, chart.begin(), chart.end(), [](const MTrader::ChartItem &itm)->Value{
-						return itm.last;
-					});
-					std::string id = storage.lock()->store_data(chart_data);
-					response=Value(json::object, {Value("id",id)});
-				}break;
-				case BTAction::trader_chart: {
-					Value trader = args["trader"];
-					auto tr  =trlist.lock()->find(trader.getString());
-					if (tr == nullptr) {req.sendErrorPage(404);return;}
-					auto trl = tr.lock_shared();
-					auto trd = trl->getTrades();
-					auto nfo = trl->getMarketInfo();
-					Value chart_data (json::array, trd.begin(), trd.end(), [&](const IStatSvc::TradeRecord &itm)->Value{
-						if (nfo.invert_price) return {itm.time, 1.0/itm.price};
-						else return {itm.time, itm.price};
-					});
-					std::string id = storage.lock()->store_data(chart_data);
-					response=Value(json::object, {Value("id",id)});
-				}break;
-				case BTAction::historical_chart: {
-					Value asset = args["asset"];
-					Value currency = args["currency"];
-					unsigned int smooth = args["smooth"].getUInt();
-
-					auto from = std::chrono::system_clock::to_time_t(
-							std::chrono::system_clock::now()-std::chrono::hours(365*24)
-					);
-					from = (from/86400)*86400;
-					auto btb = prices.lock();
-					Value chart_data = btb->jsonRequestExchange("minute", Object({{"asset", asset},{"currency",currency},{"from",from}}));
-					if (smooth>1) {
-						double accum = chart_data[0].getNumber()*smooth;
-						Value smth_data (json::array,chart_data.begin(), chart_data.end(),[&](const Value &d){
-							accum -= accum / smooth;
-							accum += d.getNumber();
-							return accum/smooth;
+			auto storage = state.lock_shared()->backtest_storage;
+			ComputeJob job = [=](simpleServer::HTTPRequest &req, Progress *prg) mutable {
+				//opened for large results, the response is sent before the scope ends
+				std::optional<json::ArenaScope> arena;
+				Value response;
+
+				switch (action) {
+					case BTAction::trader_minute_chart: {
+						Value trader = args["trader"];
+						auto snp = getTraderSnapshot(trlist, trader.getString());
+						if (snp == nullptr) {req.sendErrorPage(404);return;}
+						const auto &chart = snp->chart;
+						Value chart_data (json::array, chart.begin(), chart.end(), [](const MTrader::ChartItem &itm)->Value{
+							return itm.last;
 						});
-						chart_data = smth_data;
-					}
-					std::string id = storage.lock()->store_data(chart_data);
-					response=Value(json::object, {Value("id",id)});
-				}break;
-				case BTAction::random_chart: {
-
-					std::size_t seed = args["seed"].getUInt();
-					double volatility = args["volatility"].getValueOrDefault(0.1);
-					double noise = args["noise"].getValueOrDefault(0.0);
-					std::vector<double> chart;
-					generate_random_chart(volatility*0.01, noise*0.01, 525600, seed, chart);
-					Value chart_data (json::array, chart.begin(), chart.end(), [](double &itm)->Value{return itm;});
-					std::string id = storage.lock()->store_data(chart_data);
-					response=Value(json::object, {Value("id",id)});
-				}break;
-				case BTAction::get_file: {
-					Value source = args["source"];
-					json::Value v = storage.lock()->load_data(source.getString());
-					if (v.defined()) {
-						response = v;
-					} else {
-						req.sendErrorPage(410);
-						return;
-					}
-				}break;
-				case BTAction::gen_trades: {
-					Value source = args["source"];
-					Value sma = args["sma"];
-					Value stdev = args["stdev"];
-					Value force_spread = args["force_spread"];
-					Value mult = args["mult"];
-					Value dynmult_raise = args["raise"];
-					Value dynmult_fall = args["fall"];
-					Value dynmult_cap = args["cap"];
-					Value dynmult_mode = args["mode"];
-					Value dynmult_sliding = args["sliding"];
-					Value dynmult_mult = args["dyn_mult"];
-					Value reverse=args["reverse"];
-					Value invert=args["invert"];
-					Value ifutures=args["ifutures"];
-					Value order2 =args["order2"];
-					Value spread_freeze = args["spread_freeze"];
-					Value offset = args["offset"];
-					Value limit = args["limit"];
-					Value begin_time = args["begin_time"];
-					auto swap = args["swap"].getBool();
-
-					Value srcminute = storage.lock()->load_data(source.getString());
-					if (!srcminute.defined()) {
-						req.sendErrorPage(410);
-						return;
-					}
-
-					auto fn = defaultSpreadFunction(sma.getNumber(), stdev.getNumber(), force_spread.getNumber());
-					VisSpread spreadCalc(fn,{
-						{
-								dynmult_raise.getValueOrDefault(1.0),
-								dynmult_fall.getValueOrDefault(1.0),
-								dynmult_cap.getValueOrDefault(100.0),
-								strDynmult_mode[dynmult_mode.getValueOrDefault("independent")],
-								dynmult_mult.getBool()
-						},
-						mult.getNumber(),
-						order2.getNumber(),
-						dynmult_sliding.getBool(),
-						spread_freeze.getBool()
-					});
-					if (reverse.getBool()) {
-						srcminute = srcminute.reverse();
-					}
-					bool inv = invert.getBool();
-					bool ifut = ifutures.getBool();
-					double init = 0;
-					std::vector<BTPrice> out;
-					out.reserve(srcminute.size());
-					std::uint64_t t = !begin_time.defined()?std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() - std::chrono::minutes(srcminute.size())).time_since_epoch()).count()
-								:begin_time.getUIntLong();
-					BTPrice tmp;
-					BTPrice *last = &tmp;
-					std::size_t ofs = offset.getUInt();
-					std::size_t lim = std::min<std::size_t>(limit.defined()?limit.getUInt()+ofs:static_cast<std::size_t>(-1),srcminute.size());
-					for (std::size_t pos = ofs; pos < lim;++pos) {
-						const auto &itm =  srcminute[pos];
-						double w = itm.getNumber();
-						if (swap) w = 1.0/w;
-						if (inv) {
-							if (init == 0) init = pow2(w);
-							w = init/w;
+						std::string id = storage.lock()->store_data(chart_data);
+						response=Value(json::object, {Value("id",id)});
+					}break;
+					case BTAction::trader_chart: {
+						Value trader = args["trader"];
+						auto snp = getTraderSnapshot(trlist, trader.getString());
+						if (snp == nullptr) {req.sendErrorPage(404);return;}
+						const auto trd = snp->getFullHistory();
+						const auto &nfo = snp->minfo;
+						Value chart_data (json::array, trd.begin(), trd.end(), [&](const IStatSvc::TradeRecord &itm)->Value{
+							if (nfo.invert_price) return {itm.time, 1.0/itm.price};
+							else return {itm.time, itm.price};
+						});
+						std::string id = storage.lock()->store_data(chart_data);
+						response=Value(json::object, {Value("id",id)});
+					}break;
+					case BTAction::historical_chart: {
+						Value asset = args["asset"];
+						Value currency = args["currency"];
+						unsigned int smooth = args["smooth"].getUInt();
+
+						auto from = std::chrono::system_clock::to_time_t(
+								std::chrono::system_clock::now()-std::chrono::hours(365*24)
+						);
+						from = (from/86400)*86400;
+						auto rng = minute_archive->get(asset.getString(), currency.getString(), from, [&](std::uint64_t from){
+							return prices.lock()->jsonRequestExchange("minute", Object({{"asset", asset},{"currency",currency},{"from",from}}));
+						});
+						Value chart_data;
+						if (smooth>1 && !rng.empty()) {
+							double accum = rng[0]*smooth;
+							chart_data = Value(json::array,rng.begin(), rng.end(),[&](double d){
+								accum -= accum / smooth;
+								accum += d;
+								return accum/smooth;
+							});
+						} else {
+							chart_data = Value(json::array,rng.begin(), rng.end(),[&](double d){return d;});
+						}
+						std::string id = storage.lock()->store_data(chart_data);
+						response=Value(json::object, {Value("id",id)});
+					}break;
+					case BTAction::random_chart: {
+
+						RandomChartConfig chcfg = parseRandomChart(args);
+						chcfg.seed = args["seed"].getUInt();
+						std::vector<double> chart;
+						if (prg && !prg->set(0)) throw JobCanceled();
+						if (isClassicRandomChart(args)) {
+							generate_random_chart(chcfg.volatility, chcfg.noise, chcfg.minutes, chcfg.seed, chart);
+						} else {
+							chart.resize(chcfg.minutes);
+							generate_random_chart(chcfg, chart.data(), compute.get());
+						}
+						Value chart_data (json::array, chart.begin(), chart.end(), [](double &itm)->Value{return itm;});
+						std::string id = storage.lock()->store_data(chart_data);
+						response=Value(json::object, {Value("id",id)});
+					}break;
+					case BTAction::get_file: {
+						Value source = args["source"];
+						json::Value v = storage.lock()->load_data(source.getString());
+						if (v.defined()) {
+							response = v;
+						} else {
+							req.sendErrorPage(410);
+							return;
 						}
-						double v = w;
-						if (ifut) {
-							v = 1.0/v;
+					}break;
+					case BTAction::gen_trades: {
+						Value source = args["source"];
+						Value sma = args["sma"];
+						Value stdev = args["stdev"];
+						Value force_spread = args["force_spread"];
+						Value mult = args["mult"];
+						Value dynmult_raise = args["raise"];
+						Value dynmult_fall = args["fall"];
+						Value dynmult_cap = args["cap"];
+						Value dynmult_mode = args["mode"];
+						Value dynmult_sliding = args["sliding"];
+						Value dynmult_mult = args["dyn_mult"];
+						Value reverse=args["reverse"];
+						Value invert=args["invert"];
+						Value ifutures=args["ifutures"];
+						Value order2 =args["order2"];
+						Value spread_freeze = args["spread_freeze"];
+						Value offset = args["offset"];
+						Value limit = args["limit"];
+						Value begin_time = args["begin_time"];
+						auto swap = args["swap"].getBool();
+
+						Value srcminute = storage.lock()->load_data(source.getString());
+						if (!srcminute.defined()) {
+							req.sendErrorPage(410);
+							return;
 						}
-						auto res = spreadCalc.point(v);
-						if (res.trade && res.valid) {
-							double p = ifut?1.0/res.price:res.price;
-							out.push_back({t, p,p,p});
-							last = &out.back();
-							if (res.trade2) {
-								double p = ifut?1.0/res.price2:res.price2;
+
+						auto fn = defaultSpreadFunction(sma.getNumber(), stdev.getNumber(), force_spread.getNumber());
+						VisSpread spreadCalc(fn,{
+							{
+									dynmult_raise.getValueOrDefault(1.0),
+									dynmult_fall.getValueOrDefault(1.0),
+									dynmult_cap.getValueOrDefault(100.0),
+									strDynmult_mode[dynmult_mode.getValueOrDefault("independent")],
+									dynmult_mult.getBool()
+							},
+							mult.getNumber(),
+							order2.getNumber(),
+							dynmult_sliding.getBool(),
+							spread_freeze.getBool()
+						});
+						if (reverse.getBool()) {
+							srcminute = srcminute.reverse();
+						}
+						bool inv = invert.getBool();
+						bool ifut = ifutures.getBool();
+						double init = 0;
+						std::vector<BTPrice> out;
+						out.reserve(srcminute.size());
+						std::uint64_t t = !begin_time.defined()?std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() - std::chrono::minutes(srcminute.size())).time_since_epoch()).count()
+									:begin_time.getUIntLong();
+						BTPrice tmp;
+						BTPrice *last = &tmp;
+						std::size_t ofs = offset.getUInt();
+						std::size_t lim = std::min<std::size_t>(limit.defined()?limit.getUInt()+ofs:static_cast<std::size_t>(-1),srcminute.size());
+						for (std::size_t pos = ofs; pos < lim;++pos) {
+							if (prg && ((pos - ofs) & 0xFFFF) == 0 && !prg->set((pos - ofs)*100.0/(lim - ofs))) {
+								throw JobCanceled();
+							}
+							const auto &itm =  srcminute[pos];
+							double w = itm.getNumber();
+							if (swap) w = 1.0/w;
+							if (inv) {
+								if (init == 0) init = pow2(w);
+								w = init/w;
+							}
+							double v = w;
+							if (ifut) {
+								v = 1.0/v;
+							}
+							auto res = spreadCalc.point(v);
+							if (res.trade && res.valid) {
+								double p = ifut?1.0/res.price:res.price;
 								out.push_back({t, p,p,p});
 								last = &out.back();
+								if (res.trade2) {
+									double p = ifut?1.0/res.price2:res.price2;
+									out.push_back({t, p,p,p});
+									last = &out.back();
+								}
+							} else if (w<last->pmin) {
+								last->pmin = w;
+							} else if (w>last->pmax) {
+								last->pmax = w;
 							}
-						} else if (w<last->pmin) {
-							last->pmin = w;
-						} else if (w>last->pmax) {
-							last->pmax = w;
-						}
 
-						t+=60000;
-					}
-					Value chart_data(json::array, out.begin(), out.end(), [](const BTPrice &bt)->json::Value{
-						return {bt.time, bt.price, {bt.pmin, bt.pmax}};
-					});
-					std::string id = storage.lock()->store_data(chart_data);
-					response=Value(json::object, {
-							Value("id",id),
-							Value("samples",srcminute.size()),
-							Value("trades",chart_data.size())
-					});
-				}break;
-				case BTAction::probe:
-				case BTAction::run: {
+							t+=60000;
+						}
+						Value chart_data(json::array, out.begin(), out.end(), [](const BTPrice &bt)->json::Value{
+							return {bt.time, bt.price, {bt.pmin, bt.pmax}};
+						});
+						std::string id = storage.lock()->store_data(chart_data);
+						response=Value(json::object, {
+								Value("id",id),
+								Value("samples",srcminute.size()),
+								Value("trades",chart_data.size())
+						});
+					}break;
+					case BTAction::probe:
+					case BTAction::run: {
 
-					Value minfo_val = args["minfo"];
-					Value source = args["source"];
+						Value minfo_val = args["minfo"];
+						Value source = args["source"];
 
-					Value reverse=args["reverse"];
-					Value invert=args["invert"];
+						Value reverse=args["reverse"];
+						Value invert=args["invert"];
 
-					Value config = args["config"];
-					Value init_pos = args["init_pos"];
-					Value balance = args["balance"];
-					Value init_price = args["init_price"];
-					Value fill_atprice= args["fill_atprice"];
-					Value negbal= args["neg_bal"];
-					Value spend= args["spend"];
+						Value config = args["config"];
+						Value init_pos = args["init_pos"];
+						Value balance = args["balance"];
+						Value init_price = args["init_price"];
+						Value fill_atprice= args["fill_atprice"];
+						Value negbal= args["neg_bal"];
+						Value spend= args["spend"];
 
-					bool rev = reverse.getBool();
-					bool inv = invert.getBool();
+						bool rev = reverse.getBool();
+						bool inv = invert.getBool();
 
-					if (!minfo_val.defined()) {
-						req.sendErrorPage(400,"Missing minfo");return;
-					}
-					auto minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
+						if (!minfo_val.defined()) {
+							req.sendErrorPage(400,"Missing minfo");return;
+						}
+						auto minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
 
-					std::uint64_t start_date=args["start_date"].getUIntLong();
+						std::uint64_t start_date=args["start_date"].getUIntLong();
 
-					MTrader_Config mconfig;
-					mconfig.loadConfig(config);
-					std::optional<double> m_init_pos;
-					if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
+						MTrader_Config mconfig;
+						mconfig.loadConfig(config);
+						std::optional<double> m_init_pos;
+						if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
 
-					Value jtrades = storage.lock()->load_data(source.getString());
-					if (!jtrades.defined()) {
-						req.sendErrorPage(410);
-						return;
-					}
+						Value jtrades = storage.lock()->load_data(source.getString());
+						if (!jtrades.defined()) {
+							req.sendErrorPage(410);
+							return;
+						}
 
 
-					std::vector<BTPrice> trades;
-					trades.reserve(jtrades.size());
+						std::vector<BTPrice> trades;
+						trades.reserve(jtrades.size());
 
 
-					for (Value x: jtrades) {
-						std::uint64_t tm = x[0].getUIntLong();
-						if (tm >= start_date) {
-							Value r = x[2];
-							bool hasr = r.type() == json::array;
-							double p = x[1].getNumber();
-							double pmin = hasr?x[2][0].getNumber():p;
-							double pmax = hasr?x[2][1].getNumber():p;
-							trades.push_back({tm, p, pmin,pmax});
+						for (Value x: jtrades) {
+							std::uint64_t tm = x[0].getUIntLong();
+							if (tm >= start_date) {
+								Value r = x[2];
+								bool hasr = r.type() == json::array;
+								double p = x[1].getNumber();
+								double pmin = hasr?x[2][0].getNumber():p;
+								double pmax = hasr?x[2][1].getNumber():p;
+								trades.push_back({tm, p, pmin,pmax});
+							}
 						}
-					}
 
-					if (rev) {
-						for (std::size_t i = 0, cnt = trades.size(); i<cnt/2; i++) {
-							std::swap(trades[i].price, trades[cnt-i-1].price);
+						if (rev) {
+							for (std::size_t i = 0, cnt = trades.size(); i<cnt/2; i++) {
+								std::swap(trades[i].price, trades[cnt-i-1].price);
+							}
 						}
-					}
 
-					double mlt = 1.0;
-					double avg = std::accumulate(trades.begin(), trades.end(),0.0,[](double a, const BTPrice &b){
-						return a + b.price;
-					})/trades.size();
-
-					double ip = init_price.getNumber();
-					double fv = trades.empty()?ip:trades[0].price;
-					if (ip && !trades.empty()) {
-						if (inv) fv = 2*avg - fv;
-						mlt = ip/fv;
-						fv = fv * mlt;
-					}
-
-					for (auto &x: trades) {
-						x.price *= mlt;
-						x.pmin *= mlt;
-						x.pmax *= mlt;
-					}
+						double mlt = 1.0;
+						double avg = std::accumulate(trades.begin(), trades.end(),0.0,[](double a, const BTPrice &b){
+							return a + b.price;
+						})/trades.size();
 
-					if (inv) {
-						for (auto &x: trades) {
-							x.price = pow2(fv)/x.price;
-							double tmp = pow2(fv)/x.pmin;
-							x.pmin = pow2(fv)/x.pmax;
-							x.pmax = tmp;
+						double ip = init_price.getNumber();
+						double fv = trades.empty()?ip:trades[0].price;
+						if (ip && !trades.empty()) {
+							if (inv) fv = 2*avg - fv;
+							mlt = ip/fv;
+							fv = fv * mlt;
 						}
-					}
-					if (minfo.invert_price) {
+
 						for (auto &x: trades) {
-							x.price = 1.0/x.price;
-							double tmp = 1.0/x.pmin;
-							x.pmin = 1.0/x.pmax;
-							x.pmax = tmp;
+							x.price *= mlt;
+							x.pmin *= mlt;
+							x.pmax *= mlt;
 						}
-					}
-
 
+						if (inv) {
+							for (auto &x: trades) {
+								x.price = pow2(fv)/x.price;
+								double tmp = pow2(fv)/x.pmin;
+								x.pmin = pow2(fv)/x.pmax;
+								x.pmax = tmp;
+							}
+						}
+						if (minfo.invert_price) {
+							for (auto &x: trades) {
+								x.price = 1.0/x.price;
+								double tmp = 1.0/x.pmin;
+								x.pmin = 1.0/x.pmax;
+								x.pmax = tmp;
+							}
+						}
 
 
-					BTTrades rs = backtest_cycle(mconfig,
-							[iter = trades.begin(), end = trades.end()]() mutable {
-						if (iter == end) return std::optional<BTPrice>();
-						else return std::optional<BTPrice>(*iter++);
-					},minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
 
-					if (action == BTAction::run) {
 
-						ACB acb(0,0);
-						double prev_open = 0;
-						Value result (json::array, rs.begin(), rs.end(), [&](const BTTrade &x) {
-							Value event;
-							double open;
-							if (minfo.invert_price) {
-								acb = acb(1.0/x.price, -x.size);
-								open = 1.0/acb.getOpen();
-							} else {
-								acb = acb(x.price, x.size);
-								open = acb.getOpen();
-							}
-							if (acb.getPos() == 0) {
-								open = prev_open;
-							} else {
-								prev_open = open;
+						BTTrades rs = backtest_cycle(mconfig,
+								[iter = trades.begin(), beg = trades.begin(), end = trades.end(), prg]() mutable {
+							if (iter == end) return std::optional<BTPrice>();
+							if (prg && ((iter - beg) & 0xFFFF) == 0 && !prg->set((iter - beg)*100.0/(end - beg))) {
+								throw JobCanceled();
 							}
+							return std::optional<BTPrice>(*iter++);
+						},minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
+
+						if (action == BTAction::run) {
+
+							arena.emplace();
+							ACB acb(0,0);
+							double prev_open = 0;
+							Value result (json::array, rs.begin(), rs.end(), [&](const BTTrade &x) {
+								Value event;
+								double open;
+								if (minfo.invert_price) {
+									acb = acb(1.0/x.price, -x.size);
+									open = 1.0/acb.getOpen();
+								} else {
+									acb = acb(x.price, x.size);
+									open = acb.getOpen();
+								}
+								if (acb.getPos() == 0) {
+									open = prev_open;
+								} else {
+									prev_open = open;
+								}
 
-							switch (x.event) {
-							default: event = btevent_no_event;break;
-							case BTEvent::accept_loss: event = btevent_accept_loss;break;
-							case BTEvent::liquidation: event = btevent_liquidation;break;
-							case BTEvent::margin_call: event = btevent_margin_call;break;
-							case BTEvent::no_balance: event = btevent_no_balance;break;
-							case BTEvent::error: event = btevent_error;break;
-							}
-							return Object({
-									{"np",x.neutral_price},
-									{"op",open},
-									{"rpnl",acb.getRPnL()},
-									{"upnl",acb.getUPnL(x.price)},
-									{"na",x.norm_accum},
-									{"npl",x.norm_profit},
-									{"npla",x.norm_profit_total},
-									{"pl",x.pl},
-									{"ps",x.pos},
-									{"pr",x.price},
-									{"tm",x.time},
-									{"bal",x.bal},
-									{"ubal",x.unspend_balance},
-									{"info",x.info},
-									{"sz",x.size},
-									{"event", event}
+								switch (x.event) {
+								default: event = btevent_no_event;break;
+								case BTEvent::accept_loss: event = btevent_accept_loss;break;
+								case BTEvent::liquidation: event = btevent_liquidation;break;
+								case BTEvent::margin_call: event = btevent_margin_call;break;
+								case BTEvent::no_balance: event = btevent_no_balance;break;
+								case BTEvent::error: event = btevent_error;break;
+								}
+								return Object({
+										{"np",x.neutral_price},
+										{"op",open},
+										{"rpnl",acb.getRPnL()},
+										{"upnl",acb.getUPnL(x.price)},
+										{"na",x.norm_accum},
+										{"npl",x.norm_profit},
+										{"npla",x.norm_profit_total},
+										{"pl",x.pl},
+										{"ps",x.pos},
+										{"pr",x.price},
+										{"tm",x.time},
+										{"bal",x.bal},
+										{"ubal",x.unspend_balance},
+										{"info",x.info},
+										{"sz",x.size},
+										{"event", event}
+								});
 							});
-						});
 
-						response = result;
-					} else {
-						std::size_t accept_loss = 0, liquidation=0,margin_call=0,no_balance=0,error=0,alerts=0;
-						for (const auto &item: rs) {
-							switch (item.event) {
-								case BTEvent::accept_loss: ++accept_loss;break;
-								case BTEvent::liquidation: ++liquidation;break;
-								case BTEvent::margin_call: ++margin_call;break;
-								case BTEvent::no_balance: ++no_balance;break;
-								case BTEvent::error: ++error;break;
-								default:break;
+							response = result;
+						} else {
+							std::size_t accept_loss = 0, liquidation=0,margin_call=0,no_balance=0,error=0,alerts=0;
+							for (const auto &item: rs) {
+								switch (item.event) {
+									case BTEvent::accept_loss: ++accept_loss;break;
+									case BTEvent::liquidation: ++liquidation;break;
+									case BTEvent::margin_call: ++margin_call;break;
+									case BTEvent::no_balance: ++no_balance;break;
+									case BTEvent::error: ++error;break;
+									default:break;
+								}
+								if (item.size == 0) ++alerts;
 							}
-							if (item.size == 0) ++alerts;
-						}
 
-						double bal = 1;
-						double pl = 0;
-						double npl = 0;
-						double na = 0;
+							double bal = 1;
+							double pl = 0;
+							double npl = 0;
+							double na = 0;
 
-						if (!rs.empty()) {
-							bal = balance.getNumber();
-							if (minfo.leverage==0) {
-								bal += init_pos.getNumber()*rs[0].price;
+							if (!rs.empty()) {
+								bal = balance.getNumber();
+								if (minfo.leverage==0) {
+									bal += init_pos.getNumber()*rs[0].price;
+								}
+								pl = rs.back().pl;
+								npl = rs.back().norm_profit;
+								na = rs.back().norm_accum;
 							}
-							pl = rs.back().pl;
-							npl = rs.back().norm_profit;
-							na = rs.back().norm_accum;
+
+							response = json::Object {
+								{"events",json::Object {
+									{"accept_loss",accept_loss},
+									{"liquidation",liquidation},
+									{"margin_call",margin_call},
+									{"no_balance",no_balance},
+									{"error",error},
+									{"alerts",alerts},
+								}},
+								{"pl",pl},
+								{"npl",npl},
+								{"na",na},
+								{"pc_pl",pl/bal*100.0},
+								{"pc_npl",npl/bal*100.0}
+							};
 						}
 
+
+
+					}break;
+					case BTAction::montecarlo: {
+						Value minfo_val = args["minfo"];
+						if (!minfo_val.defined()) {
+							req.sendErrorPage(400,"Missing minfo");return;
+						}
+						MonteCarloConfig mc;
+						mc.minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
+						mc.config.loadConfig(args["config"]);
+						mc.sma = args["sma"].getNumber();
+						mc.stdev = args["stdev"].getNumber();
+						mc.force_spread = args["force_spread"].getNumber();
+						mc.spread = {
+							{
+									args["raise"].getValueOrDefault(1.0),
+									args["fall"].getValueOrDefault(1.0),
+									args["cap"].getValueOrDefault(100.0),
+									strDynmult_mode[args["mode"].getValueOrDefault("independent")],
+									args["dyn_mult"].getBool()
+							},
+							args["mult"].getNumber(),
+							args["order2"].getNumber(),
+							args["sliding"].getBool(),
+							args["spread_freeze"].getBool()
+						};
+						mc.chart = parseRandomChart(args);
+						mc.classic_chart = isClassicRandomChart(args);
+						mc.paths = std::min<unsigned int>(args["paths"].getValueOrDefault(100U), maxMonteCarloPaths);
+						mc.seed = args["seed"].getUInt();
+						mc.init_price = args["init_price"].getNumber();
+						Value init_pos = args["init_pos"];
+						if (init_pos.hasValue()) mc.init_pos = init_pos.getNumber();
+						mc.balance = args["balance"].getNumber();
+						mc.neg_bal = args["neg_bal"].getBool();
+						mc.spend = args["spend"].getBool();
+
+						auto paths = run_montecarlo(mc, *compute, [&](double pct){
+							return !prg || prg->set(pct);
+						});
+						if (!paths.has_value()) throw JobCanceled();
+
+						std::vector<double> pl, pc_pl, dd, pc_dd, npl;
+						std::size_t liq_paths = 0, mc_paths = 0, liq = 0, mcall = 0;
+						for (const MonteCarloPath &p: *paths) {
+							pl.push_back(p.pl);
+							pc_pl.push_back(p.pl/p.base_balance*100.0);
+							dd.push_back(p.max_drawdown);
+							pc_dd.push_back(p.max_drawdown/p.base_balance*100.0);
+							npl.push_back(p.npl);
+							if (p.liquidations) ++liq_paths;
+							if (p.margin_calls) ++mc_paths;
+							liq += p.liquidations;
+							mcall += p.margin_calls;
+						}
+						auto distToJSON = [](const MonteCarloDistribution &d) {
+							return Value(json::object, {
+									Value("min", d.min),
+									Value("p5", d.p5),
+									Value("p25", d.p25),
+									Value("p50", d.p50),
+									Value("p75", d.p75),
+									Value("p95", d.p95),
+									Value("max", d.max),
+									Value("mean", d.mean)
+							});
+						};
+						auto pc_pl_dist = MonteCarloDistribution::calc(pc_pl);
+						//seeds of the paths at or below 5th percentile, so they can be replayed by random_chart
+						Value worst_seeds(json::array, paths->begin(), paths->end(), [&](const MonteCarloPath &p)->Value{
+							if (p.pl/p.base_balance*100.0 <= pc_pl_dist.p5) return p.seed;
+							else return json::undefined;
+						});
+						double cnt = std::max<std::size_t>(paths->size(),1);
 						response = json::Object {
-							{"events",json::Object {
-								{"accept_loss",accept_loss},
-								{"liquidation",liquidation},
-								{"margin_call",margin_call},
-								{"no_balance",no_balance},
-								{"error",error},
-								{"alerts",alerts},
+							{"paths", paths->size()},
+							{"pl", distToJSON(MonteCarloDistribution::calc(pl))},
+							{"pc_pl", distToJSON(pc_pl_dist)},
+							{"npl", distToJSON(MonteCarloDistribution::calc(npl))},
+							{"max_drawdown", distToJSON(MonteCarloDistribution::calc(dd))},
+							{"pc_max_drawdown", distToJSON(MonteCarloDistribution::calc(pc_dd))},
+							{"liquidation", json::Object {
+								{"paths", liq_paths},
+								{"freq", liq_paths/cnt},
+								{"events", liq}
 							}},
-							{"pl",pl},
-							{"npl",npl},
-							{"na",na},
-							{"pc_pl",pl/bal*100.0},
-							{"pc_npl",npl/bal*100.0}
+							{"margin_call", json::Object {
+								{"paths", mc_paths},
+								{"freq", mc_paths/cnt},
+								{"events", mcall}
+							}},
+							{"worst_seeds", worst_seeds}
 						};
-					}
+					}break;
+					case BTAction::replay: {
+						Value minfo_val = args["minfo"];
+						if (!minfo_val.defined()) {
+							req.sendErrorPage(400,"Missing minfo");return;
+						}
+						Value srcminute = storage.lock()->load_data(args["source"].getString());
+						if (!srcminute.defined()) {
+							req.sendErrorPage(410);
+							return;
+						}
+						ReplayConfig rc;
+						rc.minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
+						rc.config.loadConfig(args["config"]);
+						rc.asset = args["init_pos"].getNumber();
+						rc.currency = args["balance"].getNumber();
+						rc.persist_state = args["persist"].getValueOrDefault(true);
+
+						std::vector<double> prices;
+						prices.reserve(srcminute.size());
+						for (Value x: srcminute) prices.push_back(x.getNumber());
+						double ip = args["init_price"].getNumber();
+						if (ip && !prices.empty()) {
+							double mlt = ip/prices[0];
+							for (double &x: prices) x *= mlt;
+						}
+						if (rc.minfo.invert_price) {
+							for (double &x: prices) x = 1.0/x;
+						}
+						Value start_time = args["start_time"];
+						rc.start_time = start_time.defined()?start_time.getUIntLong()
+								:std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() - std::chrono::minutes(prices.size())).time_since_epoch()).count();
 
+						auto rs = run_replay(rc, prices.data(), prices.size(), [&](double pct){
+							return !prg || prg->set(pct);
+						});
+						if (!rs.has_value()) throw JobCanceled();
 
+						arena.emplace();
+						response = json::Object {
+							{"cycles", rs->cycles},
+							{"elapsed_ms", rs->elapsed_ms},
+							{"perform_ms", rs->perform_ms},
+							{"cycles_per_sec", rs->elapsed_ms>0?rs->cycles*1000.0/rs->elapsed_ms:0.0},
+							{"position", rs->position},
+							{"currency", rs->currency},
+							{"trades", Value(json::array, rs->trades.begin(), rs->trades.end(), [](const IStatSvc::TradeRecord &t){
+								return t.toJSON();
+							})},
+							{"report", args["report"].getBool()?rs->report:Value()}
+						};
+					}break;
+					default:
+						req.sendErrorPage(404);
+						return;
+				}
 
-				}break;
+				auto stream = req.sendResponse("application/json");
+				response.serialize(stream);
+			};
+			switch (action) {
+				case BTAction::random_chart:
+				case BTAction::gen_trades:
+				case BTAction::probe:
+				case BTAction::run:
+				case BTAction::montecarlo:
+				case BTAction::replay:
+					runCompute(compute, state, req, args["progress"], std::move(job));
+					break;
 				default:
-					req.sendErrorPage(404);
-					return;
+					job(req, nullptr);
+					break;
 			}
-
-			auto stream = req.sendResponse("application/json");
-			response.serialize(stream);
 		});
 	}
 	return true;
 }
 
 
+std::size_t cacheItemSize(const WebCfg::BacktestCacheSubj &item) {
+	return sizeof(item) + item.prices.capacity() * sizeof(BTPrice);
+}
+std::size_t cacheItemSize(const WebCfg::SpreadCacheItem &item) {
+	return sizeof(item) + item.chart.size() * sizeof(MTrader::ChartItem);
+}
+
 void WebCfg::State::initProgress(std::size_t i) {
 	progress_map.emplace(i,std::pair(0,false));
 }
@@ -2291,6 +2589,26 @@ bool WebCfg::Progress::set(json::Value amount) {
 	return state.lock()->setProgress(id, amount);
 }
 
+void WebCfg::runCompute(const PComputePool &pool, const PState &state,
+		simpleServer::HTTPRequest req, json::Value progress_id, ComputeJob &&job) {
+	std::shared_ptr<Progress> prg;
+	if (progress_id.defined()) prg = std::make_shared<Progress>(state, progress_id.getUIntLong());
+	bool ok = pool->run([req, prg, job = std::move(job)]() mutable {
+		try {
+			//job could be canceled while it was waiting in the queue
+			if (prg && !prg->set(0)) throw JobCanceled();
+			job(req, prg.get());
+		} catch (const JobCanceled &) {
+			req.sendErrorPage(409,"","Canceled");
+		} catch (std::exception &e) {
+			req.sendErrorPage(500,"",e.what());
+		}
+	});
+	if (!ok) {
+		req.sendErrorPage(503,"","Too many pending calculations");
+	}
+}
+
 bool WebCfg::reqProgress(simpleServer::HTTPRequest req, ondra_shared::StrViewA rest) {
 	if (!req.allowMethods({"GET","DELETE"})) return true;
 	std::size_t id = 0;
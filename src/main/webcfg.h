@@ -12,6 +12,8 @@
 #include <shared/shared_function.h>
 #include <simpleServer/http_parser.h>
 #include <imtjson/namedEnum.h>
+#include <algorithm>
+#include <list>
 #include <mutex>
 
 #include <shared/ini_config.h>
@@ -22,6 +24,8 @@
 #include "authmapper.h"
 #include "backtest.h"
 #include "btstore.h"
+#include "computepool.h"
+#include "minutearchive.h"
 #include "traders.h"
 
 
@@ -34,27 +38,46 @@ public:
 		ondra_shared::RefCntPtr<AuthUserList> users, admins, reports;
 	};
 
+	///Memory cache of the data extracted from the traders
+	/**
+	 * Items are identified by name (trader's id). The cache holds multiple items, its size
+	 * is limited by total size of the items in bytes. When the limit is reached, least
+	 * recently used items are removed. At least one item is always kept.
+	 *
+	 * Items are shared, so they can be used outside of the lock
+	 *
+	 * @tparam T type of item. There must be function cacheItemSize(const T &) which
+	 * returns approximate size of the item in bytes
+	 */
 	template<typename T>
 	class Cache {
 	public:
 		using Subj = T;
+		using PSubj = std::shared_ptr<const T>;
 
-		Cache() {}
-		Cache(const T &t, std::string name)
-			:t(t),name(name) {}
+		Cache(std::size_t max_size):max_size(max_size) {}
 
-		const T getSubject() const {return t;}
-		bool available(const std::string_view &name) const {
-			return name == this->name;
-		}
-		void clear() {
-			name.clear();
-			t = T();
-		}
+		///Finds the item and marks it as recently used
+		/** @return pointer to item or nullptr if not found */
+		PSubj find(const std::string_view &name);
+		///Stores the item
+		void store(const std::string_view &name, T &&t);
+		void clear();
+		///Returns statistics - hits, misses, count of items and size
+		json::Value getStats() const;
 
 	protected:
-		T t;
-		std::string name;
+		struct Item {
+			std::string name;
+			PSubj subj;
+			std::size_t size;
+		};
+		///List of items, most recently used is first
+		std::list<Item> items;
+		std::size_t max_size;
+		std::size_t cur_size = 0;
+		std::size_t hits = 0;
+		std::size_t misses = 0;
 	};
 
 	struct SpreadCacheItem {
@@ -71,7 +94,6 @@ public:
 
 	using BacktestCache = Cache<BacktestCacheSubj>;
 	using SpreadCache = Cache<SpreadCacheItem>;
-	using PricesCache = Cache<std::vector<double> >;
 
 	class State {
 	public:
@@ -82,7 +104,6 @@ public:
 		json::Value broker_config;
 		BacktestCache backtest_cache;
 		SpreadCache spread_cache;
-		PricesCache prices_cache;
 		std::map<std::size_t,std::pair<json::Value,bool> > progress_map;
 		SharedObject<BacktestStorage> backtest_storage;
 		std::string news_url;
@@ -92,10 +113,13 @@ public:
 			  Users users,
 			  std::size_t backtest_cache_size,
 			  bool backtest_in_memory,
+			  std::size_t memory_cache_size,
 			  std::string news_url
 			):
 				  config(std::move(config)),
 				  users(users),
+				  backtest_cache(memory_cache_size),
+				  spread_cache(memory_cache_size),
 				  backtest_storage(SharedObject<BacktestStorage>::make(backtest_cache_size,backtest_in_memory)),
 				  news_url(news_url)
 		{
@@ -140,7 +164,9 @@ public:
 			Dispatch &&dispatch,
 			json::PJWTCrypto jwt,
 			SharedObject<AbstractExtern> backtest_broker,
-			std::size_t upload_limit
+			std::size_t upload_limit,
+			PComputePool compute,
+			PMinuteArchive minute_archive
 	);
 
 	~WebCfg();
@@ -167,7 +193,9 @@ public:
 		visstrategy,
 		utilization,
 		progress,
-		news
+		news,
+		marketdata,
+		metrics
 	};
 
 	AuthMapper auth;
@@ -195,6 +223,8 @@ protected:
 	bool reqBTData(simpleServer::HTTPRequest req);
 	bool reqVisStrategy(simpleServer::HTTPRequest req,  simpleServer::QueryParser &qp);
 	bool reqUtilization(simpleServer::HTTPRequest req,  simpleServer::QueryParser &qp);
+	bool reqMarketData(simpleServer::HTTPRequest req);
+	bool reqMetrics(simpleServer::HTTPRequest req);
 	bool reqProgress(simpleServer::HTTPRequest req, ondra_shared::StrViewA rest);
 	bool reqNews(simpleServer::HTTPRequest req);
 
@@ -205,6 +235,31 @@ protected:
 	PState state;
 	SharedObject<AbstractExtern> backtest_broker;
 	std::size_t upload_limit;
+	PComputePool compute;
+	PMinuteArchive minute_archive;
+
+	///Job executed in the compute pool. It is responsible to send the response
+	/**
+	 * @param req request
+	 * @param prg progress object, can be nullptr, if progress was not requested. The job
+	 * should report progress periodically and stop (throw JobCanceled) when Progress::set returns false
+	 */
+	using ComputeJob = std::function<void(simpleServer::HTTPRequest &req, Progress *prg)>;
+	///Thrown by the compute job, when it was canceled
+	struct JobCanceled {};
+
+	///Runs the job in the compute pool
+	/**
+	 * @param pool compute pool
+	 * @param state state (for progress)
+	 * @param req request
+	 * @param progress_id optional id of the progress, which can be used to monitor and cancel the job
+	 * @param job job to run
+	 *
+	 * If the queue is full, the request is rejected with the status 503
+	 */
+	static void runCompute(const PComputePool &pool, const PState &state,
+			simpleServer::HTTPRequest req, json::Value progress_id, ComputeJob &&job);
 
 
 	bool reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrViewA rest);
@@ -217,4 +272,52 @@ protected:
 
 
 
+std::size_t cacheItemSize(const WebCfg::BacktestCacheSubj &item);
+std::size_t cacheItemSize(const WebCfg::SpreadCacheItem &item);
+
+template<typename T>
+inline typename WebCfg::Cache<T>::PSubj WebCfg::Cache<T>::find(const std::string_view &name) {
+	auto iter = std::find_if(items.begin(), items.end(), [&](const Item &itm){return itm.name == name;});
+	if (iter == items.end()) {
+		++misses;
+		return nullptr;
+	}
+	++hits;
+	items.splice(items.begin(), items, iter);
+	return iter->subj;
+}
+
+template<typename T>
+inline void WebCfg::Cache<T>::store(const std::string_view &name, T &&t) {
+	auto iter = std::find_if(items.begin(), items.end(), [&](const Item &itm){return itm.name == name;});
+	if (iter != items.end()) {
+		cur_size -= iter->size;
+		items.erase(iter);
+	}
+	std::size_t sz = cacheItemSize(t);
+	items.push_front(Item{std::string(name), std::make_shared<const T>(std::move(t)), sz});
+	cur_size += sz;
+	while (cur_size > max_size && items.size() > 1) {
+		cur_size -= items.back().size;
+		items.pop_back();
+	}
+}
+
+template<typename T>
+inline void WebCfg::Cache<T>::clear() {
+	items.clear();
+	cur_size = 0;
+}
+
+template<typename T>
+inline json::Value WebCfg::Cache<T>::getStats() const {
+	return json::Value(json::object,{
+		json::Value("hits", hits),
+		json::Value("misses", misses),
+		json::Value("items", items.size()),
+		json::Value("size", cur_size),
+		json::Value("limit", max_size)
+	});
+}
+
 #endif /* SRC_MAIN_WEBCFG_H_ */
@@ -750,6 +750,10 @@ public:
 	BinaryView write(const BinaryView &buffer, WriteMode wrmode = writeWholeBuffer) const {
 		return (*this)->write(buffer, wrmode);
 	}
+	///Writes text (allows serializers to write whole blocks instead of single characters)
+	BinaryView write(const std::string_view &text, WriteMode wrmode = writeWholeBuffer) const {
+		return (*this)->write(BinaryView(StrViewA(text)), wrmode);
+	}
 	int setIOTimeout(int timeoutms) const {
 		return (*this)->setIOTimeout(timeoutms);
 	}
@@ -7,6 +7,8 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <ctime>
+#include <map>
 #include "tcpStream.h"
 #include "ssl_socket.h"
 #include <poll.h>
@@ -193,7 +195,8 @@ void SSLTcpStream::implCloseOutput() {
 	do {
 		Sync _(lock);
 		int r = SSL_shutdown(ssl);
-		if (r <= 0) {
+		//zero means, that close_notify was sent, which is enough to close the output
+		if (r < 0) {
 			bool rt = handleSSLError(r);
 			if (!rt) return;
 		} else {
@@ -389,50 +392,138 @@ std::string SSLError::getMessage() const {
 
 Stream SSLServerFactory::convert_to_ssl(Stream stream) {
 
+	AbstractStream * as = stream;
+	TCPStream &tcp = dynamic_cast<TCPStream &> (*as);
 
+	SSL_CTX *ctx = acquireContext(TLS_server_method());
+	//stream takes ownership of the reference
+	RefCntPtr<SSLTcpStream> ssl_stream = new SSLTcpStream(ctx, &tcp);
 
-	SSL_CTX *ctx;
-	ctx = SSL_CTX_new(TLS_server_method());
-	try {
-		setup(ctx);
+	SSL *ssl = ssl_stream->getSSL();
+	precreateConnection(ctx,ssl);
+	ssl_stream->accept();
+	verifyConnection(ctx, ssl_stream->getSSL(), ssl_stream);
+	return (SSLTcpStream *)ssl_stream;
+}
 
-		AbstractStream * as = stream;
-		TCPStream &tcp = dynamic_cast<TCPStream &> (*as);
+///Client sessions cached per host
+/**
+ * The cache is owned by the SSL_CTX (stored as its ex_data), because the sessions
+ * (TLS 1.3 tickets) can arrive after the handshake, when the stream is already returned
+ * to the caller, which can also outlive the factory
+ */
+class SSLSessionCache {
+public:
 
-		RefCntPtr<SSLTcpStream> ssl_stream = new SSLTcpStream(ctx, &tcp);
+	///Maximum count of cached hosts
+	static const std::size_t maxHosts = 256;
 
-		SSL *ssl = ssl_stream->getSSL();
-		precreateConnection(ctx,ssl);
-		ssl_stream->accept();
-		verifyConnection(ctx, ssl_stream->getSSL(), ssl_stream);
-		return (SSLTcpStream *)ssl_stream;
-	} catch (...) {
-		SSL_CTX_free(ctx);
-		throw;
+	~SSLSessionCache() {
+		for (auto &x: sessions) SSL_SESSION_free(x.second);
 	}
-}
 
-Stream SSLClientFactory::convert_to_ssl(Stream stream, const std::string &host) {
-	SSL_CTX *ctx;
-	ctx = SSL_CTX_new(TLS_client_method());
-	try {
-		setup(ctx);
-	} catch (...) {
-		SSL_CTX_free(ctx);
-		throw;
+	///Returns session for the host (with reference), or nullptr
+	SSL_SESSION *get(const std::string &host) {
+		std::lock_guard<std::mutex> _(lock);
+		auto iter = sessions.find(host);
+		if (iter == sessions.end()) return nullptr;
+		SSL_SESSION *sess = iter->second;
+		if (!SSL_SESSION_is_resumable(sess)
+				|| static_cast<long>(std::time(nullptr)) > SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess)) {
+			SSL_SESSION_free(sess);
+			sessions.erase(iter);
+			return nullptr;
+		}
+		SSL_SESSION_up_ref(sess);
+		return sess;
+	}
+
+	///Stores session, takes ownership of the reference
+	void put(const std::string &host, SSL_SESSION *sess) {
+		std::lock_guard<std::mutex> _(lock);
+		auto iter = sessions.find(host);
+		if (iter != sessions.end()) {
+			SSL_SESSION_free(iter->second);
+			iter->second = sess;
+		} else if (sessions.size() < maxHosts) {
+			sessions.emplace(host, sess);
+		} else {
+			SSL_SESSION_free(sess);
+		}
+	}
+
+	void remove(const std::string &host) {
+		std::lock_guard<std::mutex> _(lock);
+		auto iter = sessions.find(host);
+		if (iter != sessions.end()) {
+			SSL_SESSION_free(iter->second);
+			sessions.erase(iter);
+		}
+	}
+
+	static int getIndex() {
+		static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr,
+				[](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+			delete reinterpret_cast<SSLSessionCache *>(ptr);
+		});
+		return index;
 	}
 
+	static SSLSessionCache *fromContext(SSL_CTX *ctx) {
+		return reinterpret_cast<SSLSessionCache *>(SSL_CTX_get_ex_data(ctx, getIndex()));
+	}
+
+	static void install(SSL_CTX *ctx) {
+		if (fromContext(ctx)) return;
+		SSL_CTX_set_ex_data(ctx, getIndex(), new SSLSessionCache);
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(ctx, [](SSL *ssl, SSL_SESSION *sess) -> int {
+			const char *host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+			SSLSessionCache *cache = fromContext(SSL_get_SSL_CTX(ssl));
+			if (host == nullptr || cache == nullptr) return 0;
+			//copy is stored, because the session of the connection closed without
+			//close_notify is marked as not resumable
+			SSL_SESSION *cp = SSL_SESSION_dup(sess);
+			if (cp) cache->put(host, cp);
+			return 0;
+		});
+	}
+
+protected:
+	std::mutex lock;
+	std::map<std::string, SSL_SESSION *> sessions;
+};
+
+Stream SSLClientFactory::convert_to_ssl(Stream stream, const std::string &host) {
+
 	AbstractStream * as = stream;
 	TCPStream &tcp = dynamic_cast<TCPStream &> (*as);
 
+	SSL_CTX *ctx = acquireContext(TLS_client_method());
+	//stream takes ownership of the reference
 	RefCntPtr<SSLTcpStream> ssl_stream = new SSLTcpStream(ctx, &tcp);
 
 	SSL *ssl = ssl_stream->getSSL();
 	precreateConnection(ctx,ssl);
 	if(!SSL_set_tlsext_host_name(ssl, host.c_str())) throw SSLError();
 	if(!X509_VERIFY_PARAM_set1_host(SSL_get0_param(ssl), host.c_str(), 0)) throw SSLError();
-	ssl_stream->connect();
-	verifyConnection(ctx, ssl_stream->getSSL(), ssl_stream);
+	SSLSessionCache *cache = SSLSessionCache::fromContext(ctx);
+	if (cache) {
+		SSL_SESSION *sess = cache->get(host);
+		if (sess) {
+			SSL_set_session(ssl, sess);
+			SSL_SESSION_free(sess);
+		}
+	}
+	try {
+		ssl_stream->connect();
+		verifyConnection(ctx, ssl_stream->getSSL(), ssl_stream);
+	} catch (...) {
+		if (cache) cache->remove(host);
+		throw;
+	}
+	++handshakes;
+	if (SSL_session_reused(ssl)) ++resumed;
 	return (SSLTcpStream *)ssl_stream;
 
 
@@ -460,13 +551,13 @@ void SSLAbstractStreamFactory::setup(SSL_CTX* ctx) {
 
 void SSLServerFactory::setup(SSL_CTX* ctx) {
 	SSLAbstractStreamFactory::setup(ctx);
-
-
+	static const unsigned char sessionCtx[] = "simpleServer";
+	SSL_CTX_set_session_id_context(ctx, sessionCtx, sizeof(sessionCtx)-1);
 }
 
 void SSLClientFactory::setup(SSL_CTX* ctx) {
 	SSLAbstractStreamFactory::setup(ctx);
-
+	SSLSessionCache::install(ctx);
 }
 
 void SSLClientFactory::setHost(const std::string& host) {
@@ -497,10 +588,45 @@ void SSLServerFactory::verifyConnection(SSL_CTX* ctx, SSL* ssl, AbstractStream*
 
 void SSLAbstractStreamFactory::setCertFile(std::string certfile) {
 	this->certfile = certfile;
+	resetContext();
 }
 
 void SSLAbstractStreamFactory::setPrivKeyFile(std::string privkeyfile) {
 	this->privkeyfile = privkeyfile;
+	resetContext();
+}
+
+SSL_CTX *SSLAbstractStreamFactory::acquireContext(const SSL_METHOD *method) {
+	std::lock_guard<std::mutex> _(ctxLock);
+	if (sharedCtx == nullptr) {
+		SSL_CTX *ctx = SSL_CTX_new(method);
+		if (ctx == nullptr) throw SSLError();
+		try {
+			setup(ctx);
+		} catch (...) {
+			SSL_CTX_free(ctx);
+			throw;
+		}
+		sharedCtx = ctx;
+		++contexts;
+	}
+	SSL_CTX_up_ref(sharedCtx);
+	return sharedCtx;
+}
+
+void SSLAbstractStreamFactory::resetContext() {
+	std::lock_guard<std::mutex> _(ctxLock);
+	//existing connections keep own references
+	if (sharedCtx) SSL_CTX_free(sharedCtx);
+	sharedCtx = nullptr;
+}
+
+SSLClientFactory::Stats SSLClientFactory::getStats() const {
+	Stats st;
+	st.contexts = contexts;
+	st.handshakes = handshakes;
+	st.resumed = resumed;
+	return st;
 }
 
 void SSLClientFactory::verifyConnection(SSL_CTX* ctx, SSL* ssl, AbstractStream* stream) {
@@ -528,6 +654,10 @@ SSLAbstractStreamFactory::SSLAbstractStreamFactory() {
 	});
 }
 
+SSLAbstractStreamFactory::~SSLAbstractStreamFactory() {
+	if (sharedCtx) SSL_CTX_free(sharedCtx);
+}
+
 class HttpsProvider: public IHttpsProvider {
 public:
 	HttpsProvider(SSLClientFactory *f):f(f?f:new SSLClientFactory) {}
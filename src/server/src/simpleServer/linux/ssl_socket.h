@@ -8,6 +8,9 @@
 #ifndef SRC_SIMPLESERVER_SRC_SIMPLESERVER_LINUX_SSL_SOCKET_H_
 #define SRC_SIMPLESERVER_SRC_SIMPLESERVER_LINUX_SSL_SOCKET_H_
 #include <openssl/ssl.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include "../exceptions.h"
 #include "../abstractStream.h"
 
@@ -24,7 +27,7 @@ enum class SSLMode {
 class SSLAbstractStreamFactory {
 public:
 	SSLAbstractStreamFactory();
-	virtual ~SSLAbstractStreamFactory() {};
+	virtual ~SSLAbstractStreamFactory();
 	virtual Stream convert_to_ssl(Stream stream) = 0;
 	virtual void setup(SSL_CTX *ctx);
 	virtual void verifyConnection(SSL_CTX *ctx, SSL *ssl, AbstractStream *stream);
@@ -34,12 +37,26 @@ public:
 	void setCertFile(std::string certfile);
 	void setPrivKeyFile(std::string privkeyfile);
 
+	///Drops the shared context, next connection creates new one (calls setup() again)
+	void resetContext();
+
 
 protected:
 
 	std::string certfile;
 	std::string privkeyfile;
 
+	///Returns shared context, creates it on the first call
+	/**
+	 * @param method method used to create the context
+	 * @return context with reference owned by the caller (release it by SSL_CTX_free)
+	 */
+	SSL_CTX *acquireContext(const SSL_METHOD *method);
+
+	std::mutex ctxLock;
+	SSL_CTX *sharedCtx = nullptr;
+	std::atomic<std::uint64_t> contexts{0};
+
 };
 
 class SSLServerFactory: public SSLAbstractStreamFactory {
@@ -52,8 +69,24 @@ public:
 
 };
 
+///Creates client connections
+/**
+ * All connections share single SSL_CTX. Sessions are cached per host (SNI name), so
+ * the reconnect to the same host can resume the previous session (or use the session ticket)
+ * and skip the full handshake
+ */
 class SSLClientFactory: public SSLAbstractStreamFactory {
 public:
+
+	struct Stats {
+		///count of created contexts
+		std::uint64_t contexts = 0;
+		///count of finished handshakes
+		std::uint64_t handshakes = 0;
+		///count of handshakes, which resumed a cached session
+		std::uint64_t resumed = 0;
+	};
+
 	virtual Stream convert_to_ssl(Stream stream) override;
 	virtual Stream convert_to_ssl(Stream stream, const std::string &host);
 	virtual void setup(SSL_CTX *ctx) override;
@@ -64,6 +97,12 @@ public:
 	void setHost(const std::string &host);
 	std::string host;
 
+	Stats getStats() const;
+
+protected:
+	std::atomic<std::uint64_t> handshakes{0};
+	std::atomic<std::uint64_t> resumed{0};
+
 };
 
 class IHttpsProvider;
@@ -20,6 +20,7 @@
 
 #include "../simpleServer/http_client.h"
 #include "../simpleServer/linux/ssl_exceptions.h"
+#include "../simpleServer/linux/ssl_socket.h"
 #include "../simpleServer/shared/mtcounter.h"
 #include "../simpleServer/websockets_stream.h"
 
@@ -219,6 +220,51 @@ int main(int argc, char *argv[]) {
 		}
 	};
 
+	tst.test("Listener.ssl.resumeSession","pong pong 1/2/1") >> [](std::ostream &out) {
+		//self-signed certificate for the local server
+		if (system("openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes -days 1 "
+				"-subj /CN=localhost -keyout /tmp/simpleServer_test.key -out /tmp/simpleServer_test.crt 2>/dev/null") != 0) {
+			throw TestNotImplemented();
+		}
+		class NoVerifyClient: public SSLClientFactory {
+		public:
+			virtual void verifyConnection(SSL_CTX *, SSL *, AbstractStream *) override {}
+		};
+		class NoVerifyServer: public SSLServerFactory {
+		public:
+			virtual void verifyConnection(SSL_CTX *, SSL *, AbstractStream *) override {}
+		};
+		StreamFactory server = TCPListen::create(true,0);
+		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
+		MTCounter done(1);
+		runThread([&server,&done] {
+			NoVerifyServer sf;
+			sf.setCertFile("/tmp/simpleServer_test.crt");
+			sf.setPrivKeyFile("/tmp/simpleServer_test.key");
+			for (int i = 0; i < 2; i++) {
+				Stream s = sf.convert_to_ssl(server());
+				s.read();
+				s.write(BinaryView(StrViewA("pong")),writeAndFlush);
+				s.closeOutput();
+			}
+			done.dec();
+		});
+		NoVerifyClient cf;
+		for (int i = 0; i < 2; i++) {
+			Stream s = cf.convert_to_ssl(tcpConnect(srvAddr,30000), "localhost");
+			s.write(BinaryView(StrViewA("ping")),writeAndFlush);
+			BinaryView data = s.read();
+			while (!data.empty()) {
+				out << StrViewA(data);
+				data = s.read();
+			}
+			out << " ";
+		}
+		done.wait();
+		auto st = cf.getStats();
+		out << st.contexts << "/" << st.handshakes << "/" << st.resumed;
+	};
+
 	tst.test("Listener.async.receiveMsg","test message") >> [](std::ostream &out) {
 		StreamFactory server = TCPListen::create(true,0);
 		NetAddr srvAddr = TCPStreamFactory::getLocalAddress(server);
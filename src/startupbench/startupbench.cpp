@@ -0,0 +1,164 @@
+/*
+ * startupbench.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+///Measures the startup time of the traders
+/**
+ * Generates states of the traders (minute chart and trades in the columnar format) to a
+ * temporary directory and measures Traders::initTraders for the given counts of loader
+ * threads. The broker answers market info with a delay, as a real broker does.
+ *
+ * Arguments: <loader threads,...> [count of traders] [delay of market info in ms]
+ * @code
+ * startupbench 1,4,8 32 80
+ * @endcode
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <imtjson/object.h>
+#include <imtjson/string.h>
+#include <shared/filesystem.h>
+#include <shared/ini_config.h>
+
+#include "../main/columnar.h"
+#include "../main/marketdata.h"
+#include "../main/storage.h"
+#include "../main/traders.h"
+
+using namespace std::chrono;
+
+///Count of minutes in the chart of each trader
+static constexpr unsigned int chartItems = 14400;
+///Count of trades of each trader (not archived)
+static constexpr unsigned int tradeCount = 10000;
+
+///Exchange, which answers market info with a delay
+class SlowExchange: public IStockApi {
+public:
+	SlowExchange(unsigned int delay_ms):delay_ms(delay_ms) {}
+	virtual double getBalance(const std::string_view &, const std::string_view &) override {return 1;}
+	virtual TradesSync syncTrades(json::Value lastId, const std::string_view &) override {return {{}, lastId};}
+	virtual Orders getOpenOrders(const std::string_view &) override {return {};}
+	virtual Ticker getTicker(const std::string_view &) override {return {100,100,100,0};}
+	virtual json::Value placeOrder(const std::string_view &, double, double, json::Value, json::Value, double) override {return nullptr;}
+	virtual void reset(const std::chrono::system_clock::time_point &) override {}
+	virtual MarketInfo getMarketInfo(const std::string_view &pair) override {
+		return mdcache.getMarketInfo(pair, [&]{
+			std::this_thread::sleep_for(milliseconds(delay_ms));
+			calls++;
+			MarketInfo nfo = {};
+			nfo.asset_symbol = "BTC";
+			nfo.currency_symbol = "USD";
+			nfo.asset_step = 0.0001;
+			nfo.currency_step = 0.01;
+			nfo.min_size = 0.0001;
+			nfo.feeScheme = income;
+			nfo.wallet_id = "bench";
+			return nfo;
+		});
+	}
+
+	unsigned int delay_ms;
+	MarketDataCache mdcache;
+	std::atomic<unsigned int> calls = 0;
+};
+
+static void generateStates(IStorageFactory &sf, unsigned int count) {
+	std::mt19937 rnd(1);
+	std::normal_distribution<double> noise(0,0.0005);
+	for (unsigned int t = 0; t < count; t++) {
+		columnar::ChartWriter chart;
+		columnar::TradesWriter trades;
+		double p = 100;
+		std::uint64_t tm = 1700000000000ULL;
+		for (unsigned int i = 0; i < chartItems; i++) {
+			p *= std::exp(noise(rnd));
+			double pr = std::round(p*100)/100;
+			chart.push({tm,pr,pr,pr});
+			tm += 60000;
+		}
+		double np = 0;
+		for (unsigned int i = 0; i < tradeCount; i++) {
+			double sz = (i%2?1:-1)*0.001;
+			double pr = std::round(100*std::exp(noise(rnd)*20)*100)/100;
+			np += 0.001;
+			trades.push(IStatSvc::TradeRecord(IStockApi::Trade{
+				json::Value(std::to_string(900000+i)), 1700000000000ULL+i*60000ULL, sz, pr, sz, pr
+			}, np, 0, pr));
+		}
+		sf.create("t"+std::to_string(t))->store(json::Object{
+			{"state", json::Object{{"uid", t+1},{"internal_balance",1.0},{"recalc",false}}},
+			{"chart", chart.finish()},
+			{"trades", trades.finish()}
+		});
+	}
+}
+
+static void measure(PStorageFactory &sf, unsigned int threads, unsigned int count, unsigned int delay_ms) {
+	ondra_shared::IniConfig ini;
+	PReport rpt = PReport::make(std::make_unique<MemStorage>(), ReportConfig{86400000});
+	auto traders = ondra_shared::SharedObject<Traders>::make(ondra_shared::Scheduler(), ini["brokers"], sf, rpt, PPerfModule(), "", 10000);
+	auto ex = std::make_shared<SlowExchange>(delay_ms);
+	auto tl = traders.lock();
+	tl->stockSelector.stock_markets.insert(std::pair(std::string("bench"), PStockApi(ex)));
+	tl->setLoaderThreads(threads);
+	for (unsigned int t = 0; t < count; t++) {
+		MTrader_Config cfg;
+		cfg.loadConfig(json::Object{
+			{"strategy", json::Object{{"type","halfhalf"},{"accum",0},{"ea",0}}},
+			{"pair_symbol", "P"+std::to_string(t)},
+			{"broker", "bench"},
+			{"enabled", true},
+			{"dont_allocate", true}
+		});
+		tl->addTrader(cfg, "t"+std::to_string(t));
+	}
+	auto start = steady_clock::now();
+	tl->initTraders();
+	double ms = duration<double, std::milli>(steady_clock::now()-start).count();
+	std::size_t trades = 0;
+	for (const auto &x: *tl) trades += x.second.lock_shared()->getTrades().size();
+	std::cout << "threads " << threads << ": " << ms << " ms, market info calls: " << ex->calls
+			<< ", trades loaded: " << trades << std::endl;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <loader threads,...> [count of traders] [delay of market info in ms]" << std::endl;
+		return 1;
+	}
+	std::vector<unsigned int> threads;
+	{
+		std::istringstream lst(argv[1]);
+		std::string n;
+		while (std::getline(lst, n, ',')) threads.push_back(std::max(1, std::atoi(n.c_str())));
+	}
+	unsigned int count = argc > 2?std::atoi(argv[2]):32;
+	unsigned int delay_ms = argc > 3?std::atoi(argv[3]):80;
+
+	auto dir = std::filesystem::temp_directory_path() / ("startupbench_"+std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	try {
+		PStorageFactory sf = std::make_unique<StorageFactory>(dir.string(), 1, Storage::binjson);
+		generateStates(*sf, count);
+		for (unsigned int t: threads) measure(sf, t, count, delay_ms);
+	} catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+	std::filesystem::remove_all(dir);
+	return 0;
+}